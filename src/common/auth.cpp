@@ -646,31 +646,6 @@ bool LoadPublicKey(const string& pubkey_filename, string &pubkey)
     return ret;
 }
 
-bool TryLoadPublicKey(string &pubkey)
-{
-    string prikey_filename;
-    struct stat status;
-    if (!GetUserKeyPath(prikey_filename)) {
-        WRITE_LOG(LOG_FATAL, "get key path failed");
-        return false;
-    }
-    string pubkey_filename = prikey_filename + ".pub";
-    if (stat(prikey_filename.c_str(), &status) == -1) {
-        if (!GenerateKeyPair(prikey_filename, pubkey_filename)) {
-            WRITE_LOG(LOG_FATAL, "generate new key failed");
-            return false;
-        }
-    }
-    if (!LoadPublicKey(pubkey_filename, pubkey)) {
-        WRITE_LOG(LOG_FATAL, "load key failed");
-        return false;
-    }
-
-    WRITE_LOG(LOG_INFO, "load pubkey success");
-
-    return true;
-}
-
 bool GetHostName(string &hostname)
 {
     int ret;
@@ -690,27 +665,6 @@ bool GetHostName(string &hostname)
     return true;
 }
 
-bool GetPublicKeyinfo(string &pubkey_info)
-{
-    string hostname;
-    if (!GetHostName(hostname)) {
-        WRITE_LOG(LOG_FATAL, "gethostname failed");
-        return false;
-    }
-    string pubkey;
-    if (!HdcAuth::TryLoadPublicKey(pubkey)) {
-        WRITE_LOG(LOG_FATAL, "load public key failed");
-        return false;
-    }
-    pubkey_info = hostname;
-    pubkey_info.append(HDC_HOST_DAEMON_BUF_SEPARATOR);
-    pubkey_info.append(pubkey);
-
-    WRITE_LOG(LOG_INFO, "Get pubkey info success");
-
-    return true;
-}
-
 static bool LoadPrivateKey(const string& prikey_filename, RSA **rsa, EVP_PKEY **evp)
 {
     FILE *file_prikey = nullptr;
@@ -741,6 +695,128 @@ static bool LoadPrivateKey(const string& prikey_filename, RSA **rsa, EVP_PKEY **
     return ret;
 }
 
+// The user key of the host is read once and shared by all the sessions, a handshake only stats the key files and
+// they are read again when changed, by keygen or by hand.
+struct HostKey {
+    EVP_PKEY *evp = nullptr;
+    RSA *rsa = nullptr;
+    string pubkeyInfo;  // hostname HDC_HOST_DAEMON_BUF_SEPARATOR public key
+
+    ~HostKey()
+    {
+        if (rsa != nullptr) {
+            RSA_free(rsa);
+        }
+        if (evp != nullptr) {
+            EVP_PKEY_free(evp);
+        }
+    }
+};
+
+struct KeyFileStamp {
+    uint64_t size = 0;
+    uint64_t ino = 0;
+    int64_t mtimeSec = 0;
+    int64_t mtimeNsec = 0;
+
+    bool operator==(const KeyFileStamp &other) const
+    {
+        return size == other.size && ino == other.ino && mtimeSec == other.mtimeSec && mtimeNsec == other.mtimeNsec;
+    }
+};
+
+struct HostKeyCache {
+    std::mutex mutex;
+    string prikeyFileName;
+    KeyFileStamp prikeyStamp;
+    KeyFileStamp pubkeyStamp;
+    std::shared_ptr<const HostKey> key;
+};
+static HostKeyCache g_hostKeyCache;
+
+static bool GetKeyFileStamp(const string &filename, KeyFileStamp &stamp)
+{
+    uv_fs_t req;
+    int ret = uv_fs_stat(nullptr, &req, filename.c_str(), nullptr);
+    if (ret == 0) {
+        stamp.size = req.statbuf.st_size;
+        stamp.ino = req.statbuf.st_ino;
+        stamp.mtimeSec = req.statbuf.st_mtim.tv_sec;
+        stamp.mtimeNsec = req.statbuf.st_mtim.tv_nsec;
+    }
+    uv_fs_req_cleanup(&req);
+    return ret == 0;
+}
+
+static std::shared_ptr<const HostKey> LoadHostKey(const string &prikeyFileName, const string &pubkeyFileName)
+{
+    std::shared_ptr<HostKey> key = std::make_shared<HostKey>();
+    string hostname;
+    string pubkey;
+    if (!GetHostName(hostname)) {
+        WRITE_LOG(LOG_FATAL, "gethostname failed");
+        return nullptr;
+    }
+    if (!LoadPublicKey(pubkeyFileName, pubkey)) {
+        WRITE_LOG(LOG_FATAL, "load public key failed");
+        return nullptr;
+    }
+    if (!LoadPrivateKey(prikeyFileName, &key->rsa, &key->evp)) {
+        WRITE_LOG(LOG_FATAL, "load prikey from file(%s) failed", prikeyFileName.c_str());
+        return nullptr;
+    }
+    key->pubkeyInfo = hostname;
+    key->pubkeyInfo.append(HDC_HOST_DAEMON_BUF_SEPARATOR);
+    key->pubkeyInfo.append(pubkey);
+    return key;
+}
+
+// the key pair is generated if there is none yet
+static std::shared_ptr<const HostKey> GetHostKey()
+{
+    HostKeyCache &cache = g_hostKeyCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.prikeyFileName.empty() && !GetUserKeyPath(cache.prikeyFileName)) {
+        WRITE_LOG(LOG_FATAL, "get key path failed");
+        cache.prikeyFileName.clear();
+        return nullptr;
+    }
+    string pubkeyFileName = cache.prikeyFileName + ".pub";
+    KeyFileStamp prikeyStamp;
+    KeyFileStamp pubkeyStamp;
+    if (!GetKeyFileStamp(cache.prikeyFileName, prikeyStamp)) {
+        if (!GenerateKeyPair(cache.prikeyFileName, pubkeyFileName)) {
+            WRITE_LOG(LOG_FATAL, "generate new key failed");
+            return nullptr;
+        }
+        GetKeyFileStamp(cache.prikeyFileName, prikeyStamp);
+    }
+    GetKeyFileStamp(pubkeyFileName, pubkeyStamp);
+    if (cache.key != nullptr && prikeyStamp == cache.prikeyStamp && pubkeyStamp == cache.pubkeyStamp) {
+        return cache.key;
+    }
+    std::shared_ptr<const HostKey> key = LoadHostKey(cache.prikeyFileName, pubkeyFileName);
+    if (key == nullptr) {
+        return nullptr;
+    }
+    WRITE_LOG(LOG_INFO, "host key %s", cache.key == nullptr ? "loaded" : "changed, reloaded");
+    cache.prikeyStamp = prikeyStamp;
+    cache.pubkeyStamp = pubkeyStamp;
+    cache.key = key;
+    return key;
+}
+
+bool GetPublicKeyinfo(string &pubkey_info)
+{
+    std::shared_ptr<const HostKey> key = GetHostKey();
+    if (key == nullptr) {
+        WRITE_LOG(LOG_FATAL, "load public key failed");
+        return false;
+    }
+    pubkey_info = key->pubkeyInfo;
+    return true;
+}
+
 static bool MakeRsaSign(EVP_PKEY_CTX *ctx, string &result, unsigned char *digest, int digestLen)
 {
     size_t signResultLen = 0;
@@ -841,32 +917,100 @@ static bool RsaEncrypt(string &buf, RSA *rsa)
 
 bool RsaSignAndBase64(string &buf, AuthVerifyType type)
 {
-    RSA *rsa = nullptr;
-    EVP_PKEY *evp = nullptr;
-    string prikeyFileName;
-    bool signResult = false;
-
-    if (!GetUserKeyPath(prikeyFileName)) {
-        WRITE_LOG(LOG_FATAL, "get key path failed");
-        return false;
-    }
-    if (!LoadPrivateKey(prikeyFileName, &rsa, &evp)) {
-        WRITE_LOG(LOG_FATAL, "load prikey from file(%s) failed", prikeyFileName.c_str());
+    // the key is not changed while in use, a reload makes a new one
+    std::shared_ptr<const HostKey> key = GetHostKey();
+    if (key == nullptr) {
+        WRITE_LOG(LOG_FATAL, "load prikey failed");
         return false;
     }
     if (type == AuthVerifyType::RSA_3072_SHA512) {
-        signResult = RsaSign(buf, evp);
+        return RsaSign(buf, key->evp);
     } else {
-        signResult = RsaEncrypt(buf, rsa);
+        return RsaEncrypt(buf, key->rsa);
     }
-    if (rsa != nullptr) {
-        RSA_free(rsa);
+}
+
+static bool SetOaepPadding(EVP_PKEY_CTX *ctx)
+{
+    return EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_OAEP_PADDING) > 0 &&
+           EVP_PKEY_CTX_set_rsa_oaep_md(ctx, EVP_sha256()) > 0 && EVP_PKEY_CTX_set_rsa_mgf1_md(ctx, EVP_sha256()) > 0;
+}
+
+bool PublicKeyEncryptBase64(const string &pubkey, string &buf)
+{
+    BIO *bio = BIO_new_mem_buf(pubkey.data(), pubkey.size());
+    EVP_PKEY *evp = bio != nullptr ? PEM_read_bio_PUBKEY(bio, nullptr, nullptr, nullptr) : nullptr;
+    EVP_PKEY_CTX *ctx = evp != nullptr ? EVP_PKEY_CTX_new(evp, nullptr) : nullptr;
+    bool ret = false;
+    do {
+        if (ctx == nullptr) {
+            WRITE_LOG(LOG_FATAL, "read pubkey failed");
+            break;
+        }
+        size_t outSize = 0;
+        const unsigned char *in = reinterpret_cast<const unsigned char *>(buf.data());
+        if (EVP_PKEY_encrypt_init(ctx) <= 0 || !SetOaepPadding(ctx) ||
+            EVP_PKEY_encrypt(ctx, nullptr, &outSize, in, buf.size()) <= 0) {
+            WRITE_LOG(LOG_FATAL, "encrypt init failed");
+            break;
+        }
+        vector<uint8_t> out(outSize);
+        if (EVP_PKEY_encrypt(ctx, out.data(), &outSize, in, buf.size()) <= 0) {
+            WRITE_LOG(LOG_FATAL, "encrypt failed");
+            break;
+        }
+        vector<uint8_t> base64 = Base::Base64Encode(out.data(), outSize);
+        buf = string(base64.begin(), base64.end());
+        ret = !buf.empty();
+    } while (0);
+
+    if (ctx != nullptr) {
+        EVP_PKEY_CTX_free(ctx);
     }
     if (evp != nullptr) {
         EVP_PKEY_free(evp);
     }
-    
-    return signResult;
+    if (bio != nullptr) {
+        BIO_free(bio);
+    }
+    return ret;
+}
+
+bool PrivateKeyDecryptBase64(string &buf)
+{
+    std::shared_ptr<const HostKey> key = GetHostKey();
+    if (key == nullptr) {
+        WRITE_LOG(LOG_FATAL, "load prikey failed");
+        return false;
+    }
+    vector<uint8_t> in(buf.size());
+    int inSize = Base::Base64DecodeBuf(reinterpret_cast<const uint8_t *>(buf.data()), buf.size(), in.data());
+    EVP_PKEY_CTX *ctx = inSize > 0 ? EVP_PKEY_CTX_new(key->evp, nullptr) : nullptr;
+    bool ret = false;
+    do {
+        if (ctx == nullptr) {
+            WRITE_LOG(LOG_FATAL, "decode failed");
+            break;
+        }
+        size_t outSize = 0;
+        if (EVP_PKEY_decrypt_init(ctx) <= 0 || !SetOaepPadding(ctx) ||
+            EVP_PKEY_decrypt(ctx, nullptr, &outSize, in.data(), inSize) <= 0) {
+            WRITE_LOG(LOG_FATAL, "decrypt init failed");
+            break;
+        }
+        vector<uint8_t> out(outSize);
+        if (EVP_PKEY_decrypt(ctx, out.data(), &outSize, in.data(), inSize) <= 0) {
+            WRITE_LOG(LOG_FATAL, "decrypt failed");
+            break;
+        }
+        buf = string(out.begin(), out.begin() + outSize);
+        ret = true;
+    } while (0);
+
+    if (ctx != nullptr) {
+        EVP_PKEY_CTX_free(ctx);
+    }
+    return ret;
 }
 #endif
 }
@@ -27,6 +27,9 @@ void FreeKey(bool publicOrPrivate, list<void *> *listKey);
 #ifdef HDC_HOST
 bool RsaSignAndBase64(string &buf, Hdc::AuthVerifyType type);
 bool GetPublicKeyinfo(string &pubkey_info);
+// RSA-OAEP(SHA256) to the pem public key and base64, and back with the host key, for the key of a session ticket
+bool PublicKeyEncryptBase64(const string &pubkey, string &buf);
+bool PrivateKeyDecryptBase64(string &buf);
 #endif
 
 // host
@@ -819,6 +819,17 @@ namespace Base {
         return static_cast<int>(GetRandom(min, max));
     }
 
+    uint32_t GetBackoffTime(const uint16_t retry, const uint32_t base, const uint32_t max)
+    {
+        constexpr uint16_t maxShift = 16;
+        uint64_t wait = static_cast<uint64_t>(base) << std::min(retry, maxShift);
+        if (wait > max) {
+            wait = max;
+        }
+        // GetRandom takes no range with uv_random
+        return static_cast<uint32_t>(wait / 2 + GetRandom() % (wait - wait / 2 + 1));
+    }
+
     int ConnectKey2IPPort(const char *connectKey, char *outIP, uint16_t *outPort, size_t outSize)
     {
         char bufString[BUF_SIZE_TINY] = "";
@@ -1886,6 +1897,11 @@ namespace Base {
         g_logCache = enable;
     }
 
+    bool GetLogCache()
+    {
+        return g_logCache;
+    }
+
     void RemoveLogFile()
     {
         if (g_logCache) {
@@ -63,6 +63,8 @@ namespace Base {
     string GetSecureRandomString(const uint16_t expectedLen);
 #endif
     int GetRandomNum(const int min, const int max);
+    // wait of the retry-th retry(from 0) in ms, base doubled each time up to max, with jitter in [1/2, 1] of it
+    uint32_t GetBackoffTime(const uint16_t retry, const uint32_t base, const uint32_t max);
     uint64_t GetRandom(const uint64_t min = 0, const uint64_t max = UINT64_MAX);
     uint32_t GetSecureRandom(void);
     int ConnectKey2IPPort(const char *connectKey, char *outIP, uint16_t *outPort, size_t outSize);
@@ -174,6 +176,7 @@ namespace Base {
     string GetTmpDir();
 #ifndef  HDC_HILOG
     void SetLogCache(bool enable);
+    bool GetLogCache();
     void RemoveLogFile();
     void RemoveLogCache();
     void RollLogFile(const char *path);
@@ -184,6 +187,30 @@ namespace Base {
     char GetPathSep();
     string GetHdcAbsolutePath();
     bool IsAbsolutePath(string &path);
+    // little endian fields of the fixed layout headers, at any alignment. Written out byte by byte so that the
+    // compiler merges them into one load or store
+    inline void StoreLe32(uint8_t *buf, uint32_t value)
+    {
+        buf[0] = static_cast<uint8_t>(value);
+        buf[1] = static_cast<uint8_t>(value >> 8);   // 8: byte 1
+        buf[2] = static_cast<uint8_t>(value >> 16);  // 16: byte 2
+        buf[3] = static_cast<uint8_t>(value >> 24);  // 24: byte 3
+    }
+    inline uint32_t LoadLe32(const uint8_t *buf)
+    {
+        return static_cast<uint32_t>(buf[0]) | (static_cast<uint32_t>(buf[1]) << 8) |  // 8: byte 1
+               (static_cast<uint32_t>(buf[2]) << 16) | (static_cast<uint32_t>(buf[3]) << 24);  // 16 24: byte 2 3
+    }
+    inline void StoreLe64(uint8_t *buf, uint64_t value)
+    {
+        StoreLe32(buf, static_cast<uint32_t>(value));
+        StoreLe32(buf + sizeof(uint32_t), static_cast<uint32_t>(value >> 32));  // 32: high half
+    }
+    inline uint64_t LoadLe64(const uint8_t *buf)
+    {
+        return static_cast<uint64_t>(LoadLe32(buf)) |
+               (static_cast<uint64_t>(LoadLe32(buf + sizeof(uint32_t))) << 32);  // 32: high half
+    }
     inline int GetMaxBufSize()
     {
         return MAX_SIZE_IOBUF;
@@ -233,6 +260,10 @@ namespace Base {
     #define TAG_TOKEN "token"
     #define TAG_DAEOMN_AUTHSTATUS "daemonauthstatus"
     #define TAG_AUTH_TYPE "authtype"
+    #define TAG_FEATURE "feature"
+    #define TAG_TICKET_ID "ticketid"
+    #define TAG_TICKET_KEY "ticketkey"
+    #define TAG_TICKET_LIFE "ticketlife"
     void TrimSubString(string &str, string substr);
     bool TlvAppend(string &tlv, string tag, string val);
     bool TlvToStringMap(string tlv, std::map<string, string> &tlvmap);
@@ -136,18 +136,47 @@ void HdcChannelBase::ReadStream(uv_stream_t *tcp, ssize_t nread, const uv_buf_t
     } else {
         hChannel->availTailIndex += nread;
     }
-    while (hChannel->availTailIndex > DWORD_SERIALIZE_SIZE) {
-        size = ntohl(*reinterpret_cast<uint32_t *>(hChannel->ioBuf + indexBuf));  // big endian
+    // a frame in the ring is its header alone
+    while (hChannel->availTailIndex >= DWORD_SERIALIZE_SIZE) {
+        uint32_t header = ntohl(*reinterpret_cast<uint32_t *>(hChannel->ioBuf + indexBuf));  // big endian
+        uint8_t *payload = reinterpret_cast<uint8_t *>(hChannel->ioBuf) + DWORD_SERIALIZE_SIZE + indexBuf;
+        int inlineSize = 0;
+#ifdef HOST_LINUX
+        bool inRing = hChannel->shm != nullptr && (header & ChannelShm::RING_FRAME);
+        if (inRing) {
+            header &= ~ChannelShm::RING_FRAME;
+        }
+#endif
+        size = static_cast<int>(header);
         if (size <= 0 || static_cast<uint32_t>(size) > HDC_BUF_MAX_BYTES) {
             WRITE_LOG(LOG_FATAL, "ReadStream size:%d channelId:%u", size, channelId);
             needExit = true;
             break;
         }
-        if (hChannel->availTailIndex - DWORD_SERIALIZE_SIZE < size) {
+#ifdef HOST_LINUX
+        if (inRing && (payload = hChannel->shm->ReadBegin(size)) == nullptr) {
+            WRITE_LOG(LOG_FATAL, "ReadStream ring size:%d channelId:%u", size, channelId);
+            needExit = true;
             break;
         }
-        childRet = thisClass->ReadChannel(hChannel, reinterpret_cast<uint8_t *>(hChannel->ioBuf) +
-                                          DWORD_SERIALIZE_SIZE + indexBuf, size);
+        inlineSize = inRing ? 0 : size;
+#else
+        inlineSize = size;
+#endif
+        if (hChannel->availTailIndex - DWORD_SERIALIZE_SIZE < inlineSize) {
+            break;
+        }
+        hChannel->stat.dataRecvBytes += DWORD_SERIALIZE_SIZE + size;
+        ++hChannel->stat.recvPackets;
+        {
+            Metrics::LatencyScope latency(hChannel->stat.recvLatency);
+            childRet = thisClass->ReadChannel(hChannel, payload, size);
+        }
+#ifdef HOST_LINUX
+        if (inRing) {
+            hChannel->shm->ReadEnd();
+        }
+#endif
         if (childRet < 0) {
             WRITE_LOG(LOG_WARN, "ReadStream childRet:%d channelId:%u keepAlive:%d",
                 childRet, channelId, hChannel->keepAlive);
@@ -157,8 +186,8 @@ void HdcChannelBase::ReadStream(uv_stream_t *tcp, ssize_t nread, const uv_buf_t
             }
         }
         // update io
-        hChannel->availTailIndex -= (DWORD_SERIALIZE_SIZE + size);
-        indexBuf += DWORD_SERIALIZE_SIZE + size;
+        hChannel->availTailIndex -= (DWORD_SERIALIZE_SIZE + inlineSize);
+        indexBuf += DWORD_SERIALIZE_SIZE + inlineSize;
     }
     if (indexBuf > 0 && hChannel->availTailIndex > 0) {
         if (memmove_s(hChannel->ioBuf, hChannel->bufSize, hChannel->ioBuf + indexBuf, hChannel->availTailIndex)) {
@@ -308,10 +337,60 @@ void HdcChannelBase::SendWithCmd(const uint32_t channelId, const uint16_t comman
     --hChannel->ref;
 }
 
+#ifdef HOST_LINUX
+// the payload in the out ring of a local channel, only the header on the stream
+bool HdcChannelBase::SendRingFrame(HChannel hChannel, uv_stream_t *sendStream, uint8_t *bufPtr, const int size)
+{
+    if (hChannel->shm == nullptr || size < static_cast<int>(ChannelShm::MIN_RING_PAYLOAD) ||
+        uv_is_closing((const uv_handle_t *)sendStream) || !uv_is_writable(sendStream)) {
+        return false;
+    }
+    // another thread or stream goes inline, its header could pass or be passed by the ones of the ring
+    uv_stream_t *ringStream = hChannel->ringStream.load(std::memory_order_acquire);
+    uv_thread_t self = uv_thread_self();
+    if (sendStream != ringStream || !uv_thread_equal(&hChannel->ringThread, &self)) {
+        return false;
+    }
+    auto data = new(std::nothrow) uint8_t[DWORD_SERIALIZE_SIZE]();
+    if (data == nullptr) {
+        return false;
+    }
+    *reinterpret_cast<uint32_t *>(data) = htonl(static_cast<uint32_t>(size) | ChannelShm::RING_FRAME);
+    bool ret = hChannel->shm->Write(bufPtr, size, [&]() {
+        ++hChannel->ref;
+        if (Base::SendToStreamEx(sendStream, data, DWORD_SERIALIZE_SIZE, nullptr, (void *)WriteCallback, data) < 0) {
+            --hChannel->ref;
+            return false;
+        }
+        hChannel->stat.dataSendBytes += DWORD_SERIALIZE_SIZE + size;
+        ++hChannel->stat.sendPackets;
+        return true;
+    });
+    if (!ret) {
+        delete[] data;
+    }
+    return ret;
+}
+#endif
+
 void HdcChannelBase::SendChannel(HChannel hChannel, uint8_t *bufPtr, const int size)
 {
     StartTraceScope("HdcChannelBase::SendChannel");
+    if (hChannel->sink) {
+        SinkOutput(hChannel, bufPtr, size);
+        return;
+    }
     uv_stream_t *sendStream = nullptr;
+    if (hChannel->hWorkThread == uv_thread_self()) {
+        sendStream = (uv_stream_t *)&hChannel->hWorkTCP;
+    } else {
+        sendStream = (uv_stream_t *)&hChannel->hChildWorkTCP;
+    }
+#ifdef HOST_LINUX
+    if (SendRingFrame(hChannel, sendStream, bufPtr, size)) {
+        return;
+    }
+#endif
     int sizeNewBuf = size + DWORD_SERIALIZE_SIZE;
     auto data = new uint8_t[sizeNewBuf]();
     if (!data) {
@@ -322,13 +401,10 @@ void HdcChannelBase::SendChannel(HChannel hChannel, uint8_t *bufPtr, const int s
         delete[] data;
         return;
     }
-    if (hChannel->hWorkThread == uv_thread_self()) {
-        sendStream = (uv_stream_t *)&hChannel->hWorkTCP;
-    } else {
-        sendStream = (uv_stream_t *)&hChannel->hChildWorkTCP;
-    }
     if (!uv_is_closing((const uv_handle_t *)sendStream) && uv_is_writable(sendStream)) {
         ++hChannel->ref;
+        hChannel->stat.dataSendBytes += sizeNewBuf;
+        ++hChannel->stat.sendPackets;
         Base::SendToStreamEx(sendStream, data, sizeNewBuf, nullptr, (void *)WriteCallback, data);
     } else {
         delete[] data;
@@ -393,9 +469,12 @@ uint32_t HdcChannelBase::MallocChannel(HChannel *hOutChannel)
     uv_tcp_init(loopMain, &hChannel->hWorkTCP);
     ++hChannel->uvHandleRef;
     hChannel->hWorkThread = uv_thread_self();
+    hChannel->ringThread = hChannel->hWorkThread;
+    hChannel->ringStream = (uv_stream_t *)&hChannel->hWorkTCP;
     hChannel->hWorkTCP.data = hChannel;
     hChannel->clsChannel = this;
     hChannel->channelId = channelId;
+    hChannel->stat.beginTime = Metrics::NowUs();
     (void)memset_s(&hChannel->hChildWorkTCP, sizeof(hChannel->hChildWorkTCP), 0, sizeof(uv_tcp_t));
     AdminChannel(OP_ADD, channelId, hChannel);
     *hOutChannel = hChannel;
@@ -435,6 +514,9 @@ void HdcChannelBase::FreeChannelFinally(uv_idle_t *handle)
     }
 #ifdef HDC_HOST
     Base::TryCloseHandle((const uv_handle_t *)&hChannel->hChildWorkTCP);
+#endif
+#ifdef HOST_LINUX
+    delete hChannel->shm;
 #endif
     delete hChannel;
     Base::TryCloseHandle((const uv_handle_t *)handle, Base::CloseIdleCallback);
@@ -564,7 +646,16 @@ HChannel HdcChannelBase::AdminChannel(const uint8_t op, const uint32_t channelId
 void HdcChannelBase::EchoToClient(HChannel hChannel, uint8_t *bufPtr, const int size)
 {
     StartTraceScope("HdcChannelBase::EchoToClient");
-    uv_stream_t *sendStream = nullptr;
+    if (hChannel->sink) {
+        SinkOutput(hChannel, bufPtr, size);
+        return;
+    }
+    uv_stream_t *sendStream = (uv_stream_t *)&hChannel->hChildWorkTCP;
+#ifdef HOST_LINUX
+    if (SendRingFrame(hChannel, sendStream, bufPtr, size)) {
+        return;
+    }
+#endif
     int sizeNewBuf = size + DWORD_SERIALIZE_SIZE;
     auto data = new uint8_t[sizeNewBuf]();
     if (!data) {
@@ -575,9 +666,10 @@ void HdcChannelBase::EchoToClient(HChannel hChannel, uint8_t *bufPtr, const int
         delete[] data;
         return;
     }
-    sendStream = (uv_stream_t *)&hChannel->hChildWorkTCP;
     if (!uv_is_closing((const uv_handle_t *)sendStream) && uv_is_writable(sendStream)) {
         ++hChannel->ref;
+        hChannel->stat.dataSendBytes += sizeNewBuf;
+        ++hChannel->stat.sendPackets;
         Base::SendToStreamEx(sendStream, data, sizeNewBuf, nullptr, (void *)WriteCallback, data);
     } else {
         WRITE_LOG(LOG_WARN, "EchoToClient, channelId:%u is unwritable.", hChannel->channelId);
@@ -585,6 +677,24 @@ void HdcChannelBase::EchoToClient(HChannel hChannel, uint8_t *bufPtr, const int
     }
 }
 
+void HdcChannelBase::Output(const char *data, const int size)
+{
+    fwrite(data, 1, size, stdout);
+    fflush(stdout);
+}
+
+void HdcChannelBase::EnumChannel(const std::function<void(HChannel hChannel)> &callback)
+{
+    uv_rwlock_rdlock(&lockMapChannel);
+    for (auto &v : mapChannel) {
+        HChannel hChannel = v.second;
+        if (hChannel != nullptr && !hChannel->isDead) {
+            callback(hChannel);
+        }
+    }
+    uv_rwlock_rdunlock(&lockMapChannel);
+}
+
 void HdcChannelBase::EchoToAllChannelsViaSessionId(uint32_t targetSessionId, const string &echo)
 {
     for (auto v : mapChannel) {
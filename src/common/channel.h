@@ -28,8 +28,12 @@ public:
     void WorkerPendding();
     void FreeChannel(const uint32_t channelId);
     void EchoToAllChannelsViaSessionId(uint32_t targetSessionId, const string &echo);
+    // callback under read lock of mapChannel, for each alive channel
+    void EnumChannel(const std::function<void(HChannel hChannel)> &callback);
     vector<uint8_t> GetChannelHandshake(string &connectKey) const;
     void SendWithCmd(const uint32_t channelId, const uint16_t commandFlag, uint8_t *bufPtr, const int size);
+    // text for the user from the client or a task of its channel, stdout by default
+    virtual void Output(const char *data, const int size);
 
 protected:
     struct ChannelHandShake {
@@ -46,10 +50,15 @@ protected:
         return 0;
     }
     virtual void NotifyInstanceChannelFree(HChannel hChannel) {};
+    // what is sent to a channel with sink set, it has no stream
+    virtual void SinkOutput(HChannel hChannel, uint8_t *bufPtr, const int size) {};
     void Send(const uint32_t channelId, uint8_t *bufPtr, const int size);
     void SendChannel(HChannel hChannel, uint8_t *bufPtr, const int size);
     void SendChannelWithCmd(HChannel hChannel, const uint16_t commandFlag, uint8_t *bufPtr, const int size);
     void EchoToClient(HChannel hChannel, uint8_t *bufPtr, const int size);
+#ifdef HOST_LINUX
+    bool SendRingFrame(HChannel hChannel, uv_stream_t *sendStream, uint8_t *bufPtr, const int size);
+#endif
     virtual bool ChannelSendSessionCtrlMsg(vector<uint8_t> &ctrlMsg, uint32_t sessionId)
     {
         return true;  // just server use
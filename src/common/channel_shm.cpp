@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "channel_shm.h"
+#ifdef HOST_LINUX
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "base.h"
+
+namespace Hdc {
+constexpr size_t CONTROL_SIZE = 64;
+constexpr int LISTEN_BACKLOG = 128;
+
+ChannelShm::~ChannelShm()
+{
+    if (base != nullptr) {
+        munmap(base, mapSize);
+    }
+}
+
+ChannelShm *ChannelShm::Create(int &fd)
+{
+    fd = memfd_create("hdc_channel", MFD_CLOEXEC);
+    if (fd < 0) {
+        WRITE_LOG(LOG_WARN, "memfd_create failed errno:%d", errno);
+        return nullptr;
+    }
+    if (ftruncate(fd, CONTROL_SIZE * 2 + static_cast<size_t>(RING_SIZE) * 2) < 0) {
+        WRITE_LOG(LOG_WARN, "memfd ftruncate failed errno:%d", errno);
+        close(fd);
+        fd = -1;
+        return nullptr;
+    }
+    ChannelShm *shm = Map(fd, true);
+    if (shm == nullptr) {
+        close(fd);
+        fd = -1;
+    }
+    return shm;
+}
+
+ChannelShm *ChannelShm::Attach(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        static_cast<size_t>(st.st_size) != CONTROL_SIZE * 2 + static_cast<size_t>(RING_SIZE) * 2) {
+        WRITE_LOG(LOG_WARN, "memfd of the channel has a wrong size");
+        return nullptr;
+    }
+    return Map(fd, false);
+}
+
+ChannelShm *ChannelShm::Map(int fd, bool serverSide)
+{
+    size_t size = CONTROL_SIZE * 2 + static_cast<size_t>(RING_SIZE) * 2;
+    void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        WRITE_LOG(LOG_WARN, "mmap memfd failed errno:%d", errno);
+        return nullptr;
+    }
+    ChannelShm *shm = new(std::nothrow) ChannelShm();
+    if (shm == nullptr) {
+        munmap(addr, size);
+        return nullptr;
+    }
+    // client to server first, then server to client
+    shm->base = static_cast<uint8_t *>(addr);
+    shm->mapSize = size;
+    auto control = reinterpret_cast<RingControl *>(shm->base);
+    uint8_t *data = shm->base + CONTROL_SIZE * 2;
+    shm->outControl = serverSide ? &control[1] : &control[0];
+    shm->inControl = serverSide ? &control[0] : &control[1];
+    shm->outData = serverSide ? data + RING_SIZE : data;
+    shm->inData = serverSide ? data : data + RING_SIZE;
+    return shm;
+}
+
+bool ChannelShm::Write(const uint8_t *buf, uint32_t size, const std::function<bool()> &commit)
+{
+    if (size > MAX_RING_PAYLOAD) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(writeMutex);
+    uint64_t offset = writeHead % RING_SIZE;
+    uint64_t skip = (offset + size > RING_SIZE) ? RING_SIZE - offset : 0;
+    uint64_t used = writeHead - outControl->tail.load(std::memory_order_acquire);
+    if (used + skip + size > RING_SIZE) {
+        return false;
+    }
+    offset = (offset + skip) % RING_SIZE;
+    if (memcpy_s(outData + offset, RING_SIZE - offset, buf, size) != EOK) {
+        return false;
+    }
+    writeHead += skip + size;
+    if (!commit()) {
+        // no header went out, the reader never skips to this frame
+        writeHead -= skip + size;
+        return false;
+    }
+    return true;
+}
+
+uint8_t *ChannelShm::ReadBegin(uint32_t size)
+{
+    if (size > MAX_RING_PAYLOAD) {
+        return nullptr;
+    }
+    uint64_t offset = readHead % RING_SIZE;
+    if (offset + size > RING_SIZE) {
+        readHead += RING_SIZE - offset;
+        offset = 0;
+    }
+    readSize = size;
+    return inData + offset;
+}
+
+void ChannelShm::ReadEnd()
+{
+    readHead += readSize;
+    readSize = 0;
+    inControl->tail.store(readHead, std::memory_order_release);
+}
+
+std::string ChannelShm::LocalName(uint16_t port)
+{
+    return SERVER_NAME + "." + std::to_string(port);
+}
+
+static socklen_t LocalAddress(uint16_t port, struct sockaddr_un &addr)
+{
+    std::string name = ChannelShm::LocalName(port);
+    (void)memset_s(&addr, sizeof(addr), 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    // abstract, sun_path[0] stays 0
+    if (memcpy_s(addr.sun_path + 1, sizeof(addr.sun_path) - 1, name.c_str(), name.size()) != EOK) {
+        return 0;
+    }
+    return offsetof(struct sockaddr_un, sun_path) + 1 + name.size();
+}
+
+int ChannelShm::Listen(uint16_t port)
+{
+    struct sockaddr_un addr;
+    socklen_t len = LocalAddress(port, addr);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (len == 0 || fd < 0) {
+        WRITE_LOG(LOG_WARN, "local channel socket failed errno:%d", errno);
+        return -1;
+    }
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), len) < 0 || listen(fd, LISTEN_BACKLOG) < 0) {
+        WRITE_LOG(LOG_WARN, "local channel listen %s failed errno:%d", LocalName(port).c_str(), errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ChannelShm::Accept(int listenFd)
+{
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    // abstract sockets have no file permission, anyone of the network namespace may connect
+    struct ucred cred = {};
+    socklen_t credLen = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) < 0 || cred.uid != getuid()) {
+        WRITE_LOG(LOG_WARN, "local channel peer uid:%u refused", cred.uid);
+        close(fd);
+        errno = EACCES;
+        return -1;
+    }
+    return fd;
+}
+
+int ChannelShm::Connect(uint16_t port)
+{
+    struct sockaddr_un addr;
+    socklen_t len = LocalAddress(port, addr);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (len == 0 || fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), len) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool ChannelShm::SendFd(int sock, int fd)
+{
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))] = { 0 };
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    if (memcpy_s(CMSG_DATA(cmsg), sizeof(int), &fd, sizeof(int)) != EOK) {
+        return false;
+    }
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+int ChannelShm::RecvFd(int sock, int timeoutMs)
+{
+    struct timeval tv = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };  // 1000: ms per s, us per ms
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+        return -1;
+    }
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))] = { 0 };
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    int fd = -1;
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) == 1) {
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+            (void)memcpy_s(&fd, sizeof(fd), CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    tv = { 0, 0 };
+    (void)setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+}  // namespace Hdc
+#endif  // HOST_LINUX
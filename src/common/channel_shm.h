@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_CHANNEL_SHM_H
+#define HDC_CHANNEL_SHM_H
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace Hdc {
+// Local channel of client and server on the same host (linux):
+//   the client connects to the abstract unix socket "\0HDCServer.<port>" instead of TCP 127.0.0.1:<port>, the
+//   server checks the peer is the same user and gives a memfd with one ring per direction over SCM_RIGHTS (1 byte
+//   with the fd), then the channel goes on as usual on the socket.
+//   The payload of a big frame is written in the ring and only its length, with RING_FRAME, on the socket. A frame
+//   never wraps, it begins at 0 if it does not fit before the end, both sides skip the same way. A frame the ring has
+//   no room for goes inline.
+// OHOS_HDC_LOCAL_CHANNEL=0 keeps the client on TCP.
+class ChannelShm {
+public:
+    static constexpr uint32_t RING_FRAME = 0x80000000;        // in the length of a frame, the payload is in the ring
+    static constexpr uint32_t RING_SIZE = 4 * 1024 * 1024;    // each direction
+    static constexpr uint32_t MIN_RING_PAYLOAD = 4096;        // smaller ones go inline
+    static constexpr uint32_t MAX_RING_PAYLOAD = RING_SIZE / 2;
+    static constexpr int RECV_FD_TIMEOUT = 1000;              // ms, client waits the memfd
+
+    ~ChannelShm();
+    // server, a new memfd for the channel, fd is for the client, the caller closes it
+    static ChannelShm *Create(int &fd);
+    // client, the memfd from the server
+    static ChannelShm *Attach(int fd);
+    // copy a payload in the ring and call commit, which sends the header, under the writer lock: the headers go in
+    // the order of the ring. false if there is no room now, or commit could not send the header and the room is
+    // given back
+    bool Write(const uint8_t *buf, uint32_t size, const std::function<bool()> &commit);
+    // the payload of the next ring frame, valid until ReadEnd gives its room back
+    uint8_t *ReadBegin(uint32_t size);
+    void ReadEnd();
+
+    // sockets, fd <0 on error
+    static std::string LocalName(uint16_t port);
+    static int Listen(uint16_t port);
+    static int Accept(int listenFd);  // nonblocking, -1 with errno EAGAIN if none
+    static int Connect(uint16_t port);
+    static bool SendFd(int sock, int fd);
+    static int RecvFd(int sock, int timeoutMs);
+
+private:
+    struct RingControl {
+        alignas(64) std::atomic<uint64_t> tail;  // consumed bytes, reader writes it
+    };
+    static ChannelShm *Map(int fd, bool serverSide);
+
+    uint8_t *base = nullptr;
+    size_t mapSize = 0;
+    RingControl *outControl = nullptr;
+    RingControl *inControl = nullptr;
+    uint8_t *outData = nullptr;
+    uint8_t *inData = nullptr;
+    std::mutex writeMutex;
+    uint64_t writeHead = 0;  // produced bytes, skips included
+    uint64_t readHead = 0;
+    uint32_t readSize = 0;
+};
+}  // namespace Hdc
+
+#endif
@@ -68,8 +68,10 @@ using std::vector;
 
 #include "circle_buffer.h"
 #include "define.h"
+#include "trace.h"
 #include "debug.h"
 #include "base.h"
+#include "log_binary.h"
 #include "task.h"
 #include "channel.h"
 #include "session.h"
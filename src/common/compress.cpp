@@ -15,8 +15,32 @@
 #include "compress.h"
 
 #include <fstream>
+#ifdef HARMONY_PROJECT
+#include <lz4frame.h>
+#endif
 
 namespace Hdc {
+// of the tar compressed at a time, the frame has blocks of 256KB linked to the one before
+constexpr size_t COMPRESS_LZ4_CHUNK = 256 * 1024;
+
+#ifdef HARMONY_PROJECT
+static LZ4F_preferences_t Lz4Preferences()
+{
+    LZ4F_preferences_t prefs;
+    (void)memset_s(&prefs, sizeof(prefs), 0, sizeof(prefs));
+    prefs.frameInfo.blockSizeID = LZ4F_max256KB;
+    prefs.frameInfo.blockMode = LZ4F_blockLinked;
+    prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+    return prefs;
+}
+#endif
+
+Compress::~Compress()
+{
+    CloseStream();
+    EndLz4();
+}
+
 bool Compress::AddPath(std::string path)
 {
     uv_fs_t req;
@@ -27,34 +51,50 @@ bool Compress::AddPath(std::string path)
         return false;
     }
     if (req.statbuf.st_mode & S_IFREG) {
-        return AddEntry(path);
+        return AddEntry(path, req.statbuf);
     }
-    if (!AddEntry(path)) {
+    if (!AddEntry(path, req.statbuf)) {
         WRITE_LOG(LOG_DEBUG, "AddEntry failed dir:%s", path.c_str());
         return false;
     }
-    rc = uv_fs_scandir(nullptr, &req, path.c_str(), 0, nullptr);
-    if (rc < 0) {
+    DirWalker walker(path, DirWalker::STAT_FILES | DirWalker::SKIP_HIDDEN);
+    walker.Start();
+    std::vector<DirWalker::Item> items;
+    DirWalker::Item item;
+    while (walker.Next(item, true)) {
+        items.push_back(std::move(item));
+        if (this->maxcount > 0 && this->entrys.size() + items.size() > this->maxcount) {
+            WRITE_LOG(LOG_FATAL, "Entry.size %zu exceeded maximum %zu", entrys.size() + items.size(), maxcount);
+            return false;
+        }
+    }
+    if (walker.Failed()) {
         WRITE_LOG(LOG_DEBUG, "uv_fs_scandir failed dir:%s", path.c_str());
-        uv_fs_req_cleanup(&req);
         return false;
     }
-    uv_dirent_t dent;
-    while (uv_fs_scandir_next(&req, &dent) != UV_EOF) {
-        if (strncmp(dent.name, ".", 1) == 0 || strncmp(dent.name, "..", 2) == 0) {
-            continue;
-        }
-        string subpath = path + Base::GetPathSep() + dent.name;
-        if (!AddPath(subpath)) {
-            uv_fs_req_cleanup(&req);
+    // the walk is done on threads, sorted the tar is the same every time, and a directory is still before its files
+    std::sort(items.begin(), items.end(),
+              [](const DirWalker::Item &a, const DirWalker::Item &b) { return a.relative < b.relative; });
+    for (auto &it : items) {
+        if (!AddEntry(path + Base::GetPathSep() + it.relative, it.stat)) {
             return false;
         }
     }
-    uv_fs_req_cleanup(&req);
     return true;
 }
 
 bool Compress::AddEntry(std::string path)
+{
+    uv_fs_t req;
+    int rc = uv_fs_lstat(nullptr, &req, path.c_str(), nullptr);
+    uv_fs_req_cleanup(&req);
+    if (rc != 0) {
+        (void)memset_s(&req.statbuf, sizeof(req.statbuf), 0, sizeof(req.statbuf));
+    }
+    return AddEntry(path, req.statbuf);
+}
+
+bool Compress::AddEntry(std::string path, const uv_stat_t &st)
 {
     if (this->maxcount > 0 && this->entrys.size() > this->maxcount) {
         WRITE_LOG(LOG_FATAL, "Entry.size %zu exceeded maximum %zu", entrys.size(), maxcount);
@@ -64,7 +104,7 @@ bool Compress::AddEntry(std::string path)
         WRITE_LOG(LOG_DEBUG, "Ignoring compressed root directory");
         return true;
     }
-    Entry entry(this->prefix, path);
+    Entry entry(this->prefix, path, st);
     WRITE_LOG(LOG_DEBUG, "AddEntry %s", path.c_str());
     entrys.push_back(entry);
     return true;
@@ -103,4 +143,174 @@ void Compress::UpdataMaxCount(size_t maxCount)
 {
     this->maxcount = maxCount;
 }
+
+uint64_t Compress::Layout()
+{
+    CloseStream();
+    EndLz4();
+    offsets.clear();
+    uint64_t size = 0;
+    for (auto& entry : entrys) {
+        offsets.push_back(size);
+        size += entry.TarSize();
+    }
+    offsets.push_back(size);
+    WRITE_LOG(LOG_DEBUG, "Layout entrys len : %zu tar size : %" PRIu64, entrys.size(), size);
+    return size;
+}
+
+int Compress::ReadTar(uint64_t offset, uint8_t *buf, size_t len)
+{
+    return lz4Ctx != nullptr ? ReadLz4(offset, buf, len) : ReadPlain(offset, buf, len);
+}
+
+int Compress::ReadPlain(uint64_t offset, uint8_t *buf, size_t len)
+{
+    if (offsets.size() != entrys.size() + 1 || len > INT_MAX) {
+        return -1;
+    }
+    size_t done = 0;
+    while (done < len && offset + done < offsets.back()) {
+        uint64_t pos = offset + done;
+        // the last entry that begins at or before pos, skips the empty ones
+        size_t index = std::upper_bound(offsets.begin(), offsets.end(), pos) - offsets.begin() - 1;
+        if (index != streamIndex) {
+            CloseStream();
+            streamIndex = index;
+        }
+        size_t size = static_cast<size_t>(std::min(static_cast<uint64_t>(len - done), offsets[index + 1] - pos));
+        if (!entrys[index].ReadTar(pos - offsets[index], buf + done, size, streamFd)) {
+            return -1;
+        }
+        done += size;
+    }
+    return static_cast<int>(done);
+}
+
+void Compress::CloseStream()
+{
+    if (streamFd >= 0) {
+        uv_fs_t req;
+        uv_fs_close(nullptr, &req, streamFd, nullptr);
+        uv_fs_req_cleanup(&req);
+        streamFd = -1;
+    }
+}
+
+bool Compress::StartLz4()
+{
+#ifdef HARMONY_PROJECT
+    if (offsets.size() != entrys.size() + 1 || lz4Ctx != nullptr) {
+        return false;
+    }
+    LZ4F_cctx *ctx = nullptr;
+    if (LZ4F_isError(LZ4F_createCompressionContext(&ctx, LZ4F_VERSION))) {
+        WRITE_LOG(LOG_WARN, "LZ4F_createCompressionContext failed");
+        return false;
+    }
+    LZ4F_preferences_t prefs = Lz4Preferences();
+    lz4In.resize(COMPRESS_LZ4_CHUNK);
+    lz4Out.resize(LZ4F_compressBound(COMPRESS_LZ4_CHUNK, &prefs));
+    size_t rc = LZ4F_compressBegin(ctx, lz4Out.data(), lz4Out.size(), &prefs);
+    if (LZ4F_isError(rc)) {
+        WRITE_LOG(LOG_WARN, "LZ4F_compressBegin failed:%s", LZ4F_getErrorName(rc));
+        LZ4F_freeCompressionContext(ctx);
+        return false;
+    }
+    lz4Ctx = ctx;
+    lz4OutBegin = 0;
+    lz4OutEnd = rc;
+    lz4TarOffset = 0;
+    lz4FrameOffset = 0;
+    lz4Ended = false;
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t Compress::Lz4Bound()
+{
+    uint64_t tarSize = offsets.empty() ? 0 : offsets.back();
+#ifdef HARMONY_PROJECT
+    LZ4F_preferences_t prefs = Lz4Preferences();
+    return std::max(tarSize, static_cast<uint64_t>(LZ4F_HEADER_SIZE_MAX + LZ4F_compressBound(tarSize, &prefs)));
+#else
+    return tarSize;
+#endif
+}
+
+int Compress::ReadLz4(uint64_t offset, uint8_t *buf, size_t len)
+{
+    if (offset != lz4FrameOffset || len > INT_MAX) {
+        WRITE_LOG(LOG_WARN, "lz4 tar read at %" PRIu64 ", it is at %" PRIu64, offset, lz4FrameOffset);
+        return -1;
+    }
+    size_t done = 0;
+    while (done < len) {
+        if (lz4OutBegin == lz4OutEnd) {
+            if (!FillLz4()) {
+                return -1;
+            }
+            if (lz4OutBegin == lz4OutEnd) {
+                break;
+            }
+        }
+        size_t size = std::min(len - done, lz4OutEnd - lz4OutBegin);
+        if (memcpy_s(buf + done, len - done, lz4Out.data() + lz4OutBegin, size) != EOK) {
+            return -1;
+        }
+        lz4OutBegin += size;
+        done += size;
+    }
+    lz4FrameOffset += done;
+    return static_cast<int>(done);
+}
+
+// the next part of the frame, nothing when it is ended
+bool Compress::FillLz4()
+{
+#ifdef HARMONY_PROJECT
+    LZ4F_cctx *ctx = lz4Ctx;
+    lz4OutBegin = 0;
+    lz4OutEnd = 0;
+    // a chunk may all go to the block not full yet, then the next one is read
+    while (lz4OutEnd == 0 && !lz4Ended) {
+        size_t rc = 0;
+        if (lz4TarOffset >= offsets.back()) {
+            rc = LZ4F_compressEnd(ctx, lz4Out.data(), lz4Out.size(), nullptr);
+            lz4Ended = true;
+        } else {
+            int size = ReadPlain(lz4TarOffset, lz4In.data(), lz4In.size());
+            if (size <= 0) {
+                return false;
+            }
+            lz4TarOffset += static_cast<uint64_t>(size);
+            rc = LZ4F_compressUpdate(ctx, lz4Out.data(), lz4Out.size(), lz4In.data(), size, nullptr);
+        }
+        if (LZ4F_isError(rc)) {
+            WRITE_LOG(LOG_WARN, "lz4 tar compress failed:%s", LZ4F_getErrorName(rc));
+            return false;
+        }
+        lz4OutEnd = rc;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Compress::EndLz4()
+{
+#ifdef HARMONY_PROJECT
+    if (lz4Ctx != nullptr) {
+        LZ4F_freeCompressionContext(lz4Ctx);
+        lz4Ctx = nullptr;
+    }
+#endif
+    lz4In.clear();
+    lz4Out.clear();
+    lz4OutBegin = 0;
+    lz4OutEnd = 0;
+}
 }
@@ -19,22 +19,55 @@
 #include <string>
 
 #include "entry.h"
+#include "dir_walker.h"
+
+struct LZ4F_cctx_s;
 
 namespace Hdc {
 class Compress {
 public:
     Compress() {}
-    ~Compress() {}
+    ~Compress();
 
     bool AddPath(std::string path);
     bool AddEntry(std::string path);
+    bool AddEntry(std::string path, const uv_stat_t &st);
     bool SaveToFile(std::string localPath);
     void UpdataPrefix(std::string pathPrefix);
     void UpdataMaxCount(size_t maxCount);
+    // the tar of SaveToFile made as it is read, no file is written. Layout once the paths are added, it returns
+    // the size of the tar, then ReadTar returns the bytes read at offset, <0 on error
+    uint64_t Layout();
+    int ReadTar(uint64_t offset, uint8_t *buf, size_t len);
+    void CloseStream();
+    // after Layout, ReadTar gives one lz4 frame of the tar instead, read in order from offset 0, the end of it is a
+    // read of 0 bytes. Lz4Bound is the most the frame can be, it is known before the frame is made
+    bool StartLz4();
+    uint64_t Lz4Bound();
+    bool IsLz4()
+    {
+        return lz4Ctx != nullptr;
+    }
 private:
+    int ReadPlain(uint64_t offset, uint8_t *buf, size_t len);
+    int ReadLz4(uint64_t offset, uint8_t *buf, size_t len);
+    bool FillLz4();
+    void EndLz4();
+
     std::vector<Entry> entrys;
     std::string prefix;
-    size_t maxcount;
+    size_t maxcount = 0;
+    std::vector<uint64_t> offsets;  // of each entry in the tar, then the size of the tar
+    size_t streamIndex = 0;
+    uv_file streamFd = -1;  // of the file of entrys[streamIndex]
+    LZ4F_cctx_s *lz4Ctx = nullptr;
+    std::vector<uint8_t> lz4In;
+    std::vector<uint8_t> lz4Out;  // made, [lz4OutBegin, lz4OutEnd) is not read yet
+    size_t lz4OutBegin = 0;
+    size_t lz4OutEnd = 0;
+    uint64_t lz4TarOffset = 0;    // of the tar, all before it is in the frame
+    uint64_t lz4FrameOffset = 0;  // of the frame, all before it is read
+    bool lz4Ended = false;
 };
 }
 
@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "crc32c.h"
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "base.h"
+
+namespace Hdc {
+namespace Crc32c {
+    constexpr uint32_t POLY = 0x82F63B78;  // reflected 0x1EDC6F41
+    constexpr size_t SLICES = 8;
+    constexpr size_t BYTE_VALUES = 256;
+    constexpr uint32_t BYTE_MASK = 0xFF;
+    constexpr uint32_t BYTE_BITS = 8;
+
+    struct Table {
+        uint32_t slice[SLICES][BYTE_VALUES];
+    };
+
+    // slice[k][b]: crc of byte b followed by k zero bytes
+    constexpr Table MakeTable()
+    {
+        Table table = {};
+        for (uint32_t b = 0; b < BYTE_VALUES; ++b) {
+            uint32_t crc = b;
+            for (uint32_t bit = 0; bit < BYTE_BITS; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ POLY : crc >> 1;
+            }
+            table.slice[0][b] = crc;
+        }
+        for (size_t k = 1; k < SLICES; ++k) {
+            for (size_t b = 0; b < BYTE_VALUES; ++b) {
+                uint32_t prev = table.slice[k - 1][b];
+                table.slice[k][b] = (prev >> BYTE_BITS) ^ table.slice[0][prev & BYTE_MASK];
+            }
+        }
+        return table;
+    }
+    constexpr Table TABLE = MakeTable();
+
+    static inline uint32_t SliceWord(uint32_t crc, uint64_t word)
+    {
+        uint32_t lo = static_cast<uint32_t>(word) ^ crc;
+        uint32_t hi = static_cast<uint32_t>(word >> 32);  // 32: high half
+        // 7..0: the slice of each byte, the first byte has the most bytes behind it
+        return TABLE.slice[7][lo & BYTE_MASK] ^ TABLE.slice[6][(lo >> 8) & BYTE_MASK] ^
+               TABLE.slice[5][(lo >> 16) & BYTE_MASK] ^ TABLE.slice[4][lo >> 24] ^
+               TABLE.slice[3][hi & BYTE_MASK] ^ TABLE.slice[2][(hi >> 8) & BYTE_MASK] ^
+               TABLE.slice[1][(hi >> 16) & BYTE_MASK] ^ TABLE.slice[0][hi >> 24];
+    }
+
+    static inline uint32_t SliceByte(uint32_t crc, uint8_t byte)
+    {
+        return TABLE.slice[0][(crc ^ byte) & BYTE_MASK] ^ (crc >> BYTE_BITS);
+    }
+
+    uint32_t ExtendPortable(uint32_t crc, const uint8_t *data, size_t size)
+    {
+        crc = ~crc;
+        for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+            crc = SliceWord(crc, Base::LoadLe64(data));
+        }
+        for (; size > 0; --size) {
+            crc = SliceByte(crc, *data++);
+        }
+        return ~crc;
+    }
+
+    static uint32_t CopyAndExtendPortable(uint32_t crc, uint8_t *dst, const uint8_t *src, size_t size)
+    {
+        crc = ~crc;
+        for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), src += sizeof(uint64_t), dst += sizeof(uint64_t)) {
+            uint64_t word = Base::LoadLe64(src);
+            Base::StoreLe64(dst, word);
+            crc = SliceWord(crc, word);
+        }
+        for (; size > 0; --size) {
+            *dst++ = *src;
+            crc = SliceByte(crc, *src++);
+        }
+        return ~crc;
+    }
+
+#if defined(__x86_64__)
+#define HDC_CRC32C_HW_TARGET __attribute__((target("sse4.2")))
+#define HDC_CRC32C_HW_NAME "sse4.2"
+    HDC_CRC32C_HW_TARGET static inline uint32_t HwWord(uint32_t crc, uint64_t word)
+    {
+        return static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+    }
+    HDC_CRC32C_HW_TARGET static inline uint32_t HwByte(uint32_t crc, uint8_t byte)
+    {
+        return _mm_crc32_u8(crc, byte);
+    }
+    static bool HwSupported()
+    {
+        return __builtin_cpu_supports("sse4.2");
+    }
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define HDC_CRC32C_HW_TARGET
+#define HDC_CRC32C_HW_NAME "armv8-crc"
+    static inline uint32_t HwWord(uint32_t crc, uint64_t word)
+    {
+        return __crc32cd(crc, word);
+    }
+    static inline uint32_t HwByte(uint32_t crc, uint8_t byte)
+    {
+        return __crc32cb(crc, byte);
+    }
+    static bool HwSupported()
+    {
+        return true;
+    }
+#endif
+
+#ifdef HDC_CRC32C_HW_NAME
+    // The crc32 instruction has a latency of 3 and a throughput of 1, so three blocks are done side by side and
+    // their crcs joined with the 'append STRIDE zero bytes' operator, which is linear over GF(2) and applied by
+    // byte tables like the slices above.
+    constexpr size_t STRIDE_LONG = 8192;
+    constexpr size_t STRIDE_SHORT = 256;
+    constexpr size_t STREAMS = 3;
+    constexpr uint32_t CRC_BITS = 32;
+
+    struct Matrix {
+        uint32_t row[CRC_BITS];
+    };
+
+    constexpr uint32_t MatrixTimes(const Matrix &mat, uint32_t vec)
+    {
+        uint32_t sum = 0;
+        for (uint32_t i = 0; vec != 0; vec >>= 1, ++i) {
+            if (vec & 1) {
+                sum ^= mat.row[i];
+            }
+        }
+        return sum;
+    }
+
+    constexpr Matrix MatrixSquare(const Matrix &mat)
+    {
+        Matrix square = {};
+        for (uint32_t i = 0; i < CRC_BITS; ++i) {
+            square.row[i] = MatrixTimes(mat, mat.row[i]);
+        }
+        return square;
+    }
+
+    // operator of appending size zero bytes to a crc, size is a power of 2
+    constexpr Matrix ZerosOperator(size_t size)
+    {
+        Matrix op = {};  // one zero bit
+        op.row[0] = POLY;
+        for (uint32_t i = 1; i < CRC_BITS; ++i) {
+            op.row[i] = 1u << (i - 1);
+        }
+        for (size_t bits = size * BYTE_BITS; bits > 1; bits >>= 1) {
+            op = MatrixSquare(op);
+        }
+        return op;
+    }
+
+    struct ZerosTable {
+        uint32_t part[sizeof(uint32_t)][BYTE_VALUES];
+    };
+
+    constexpr ZerosTable MakeZerosTable(size_t size)
+    {
+        Matrix op = ZerosOperator(size);
+        ZerosTable table = {};
+        for (uint32_t i = 0; i < sizeof(uint32_t); ++i) {
+            for (uint32_t b = 0; b < BYTE_VALUES; ++b) {
+                table.part[i][b] = MatrixTimes(op, b << (i * BYTE_BITS));
+            }
+        }
+        return table;
+    }
+    constexpr ZerosTable ZEROS_LONG = MakeZerosTable(STRIDE_LONG);
+    constexpr ZerosTable ZEROS_SHORT = MakeZerosTable(STRIDE_SHORT);
+
+    static inline uint32_t Shift(const ZerosTable &zeros, uint32_t crc)
+    {
+        return zeros.part[0][crc & BYTE_MASK] ^ zeros.part[1][(crc >> 8) & BYTE_MASK] ^  // 8: byte 1
+               zeros.part[2][(crc >> 16) & BYTE_MASK] ^ zeros.part[3][crc >> 24];       // 16 24: byte 2 3
+    }
+
+    // dst is nullptr for no copy
+    HDC_CRC32C_HW_TARGET static inline uint32_t HwBlocks(uint32_t crc, uint8_t *&dst, const uint8_t *&src,
+                                                         size_t &size, size_t stride, const ZerosTable &zeros)
+    {
+        for (; size >= stride * STREAMS; size -= stride * STREAMS) {
+            uint32_t crc1 = 0;
+            uint32_t crc2 = 0;
+            for (size_t i = 0; i < stride; i += sizeof(uint64_t)) {
+                uint64_t word0 = Base::LoadLe64(src + i);
+                uint64_t word1 = Base::LoadLe64(src + stride + i);
+                uint64_t word2 = Base::LoadLe64(src + stride * 2 + i);  // 2: the third block
+                if (dst != nullptr) {
+                    Base::StoreLe64(dst + i, word0);
+                    Base::StoreLe64(dst + stride + i, word1);
+                    Base::StoreLe64(dst + stride * 2 + i, word2);  // 2: the third block
+                }
+                crc = HwWord(crc, word0);
+                crc1 = HwWord(crc1, word1);
+                crc2 = HwWord(crc2, word2);
+            }
+            crc = Shift(zeros, crc) ^ crc1;
+            crc = Shift(zeros, crc) ^ crc2;
+            src += stride * STREAMS;
+            if (dst != nullptr) {
+                dst += stride * STREAMS;
+            }
+        }
+        return crc;
+    }
+
+    HDC_CRC32C_HW_TARGET static uint32_t CopyAndExtendHw(uint32_t crc, uint8_t *dst, const uint8_t *src, size_t size)
+    {
+        crc = ~crc;
+        crc = HwBlocks(crc, dst, src, size, STRIDE_LONG, ZEROS_LONG);
+        crc = HwBlocks(crc, dst, src, size, STRIDE_SHORT, ZEROS_SHORT);
+        for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), src += sizeof(uint64_t)) {
+            uint64_t word = Base::LoadLe64(src);
+            if (dst != nullptr) {
+                Base::StoreLe64(dst, word);
+                dst += sizeof(uint64_t);
+            }
+            crc = HwWord(crc, word);
+        }
+        for (; size > 0; --size) {
+            if (dst != nullptr) {
+                *dst++ = *src;
+            }
+            crc = HwByte(crc, *src++);
+        }
+        return ~crc;
+    }
+
+    static uint32_t ExtendHw(uint32_t crc, const uint8_t *data, size_t size)
+    {
+        return CopyAndExtendHw(crc, nullptr, data, size);
+    }
+#endif
+
+    struct Implement {
+        uint32_t (*extend)(uint32_t crc, const uint8_t *data, size_t size);
+        uint32_t (*copyAndExtend)(uint32_t crc, uint8_t *dst, const uint8_t *src, size_t size);
+        const char *name;
+    };
+
+    static const Implement &GetImplement()
+    {
+        static const Implement implement = []() -> Implement {
+#ifdef HDC_CRC32C_HW_NAME
+            if (HwSupported()) {
+                return { ExtendHw, CopyAndExtendHw, HDC_CRC32C_HW_NAME };
+            }
+#endif
+            return { ExtendPortable, CopyAndExtendPortable, "slicing-by-8" };
+        }();
+        return implement;
+    }
+
+    uint32_t Extend(uint32_t crc, const uint8_t *data, size_t size)
+    {
+        return GetImplement().extend(crc, data, size);
+    }
+
+    uint32_t CopyAndExtend(uint32_t crc, uint8_t *dst, const uint8_t *src, size_t size)
+    {
+        return GetImplement().copyAndExtend(crc, dst, src, size);
+    }
+
+    const char *Implementation()
+    {
+        return GetImplement().name;
+    }
+}  // namespace Crc32c
+}  // namespace Hdc
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_CRC32C_H
+#define HDC_CRC32C_H
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli) of the FEATURE_CRC32C session packets. The crc32 instruction is used when the cpu has it
+// (SSE4.2, ARMv8 CRC), checked once at runtime, otherwise slicing-by-8 tables.
+namespace Hdc {
+namespace Crc32c {
+    // crc goes on from the previous one, 0 for the first bytes: Extend(Extend(0, a), b) == Extend(0, ab)
+    uint32_t Extend(uint32_t crc, const uint8_t *data, size_t size);
+    // copy size bytes from src to dst and return the crc of them, in one pass over the data
+    uint32_t CopyAndExtend(uint32_t crc, uint8_t *dst, const uint8_t *src, size_t size);
+    // the table version, whatever the cpu is
+    uint32_t ExtendPortable(uint32_t crc, const uint8_t *data, size_t size);
+    const char *Implementation();
+}  // namespace Crc32c
+}  // namespace Hdc
+
+#endif
@@ -18,38 +18,368 @@
 #include <fstream>
 #include <optional>
 #include <iostream>
+#include <thread>
+#ifdef HARMONY_PROJECT
+#include <lz4frame.h>
+#endif
 
 namespace Hdc {
-bool Decompress::DecompressToLocal(std::string decPath)
+constexpr size_t DECOMPRESS_MAX_WORKERS = 8;
+// of the index window and of the read of a batch, a file bigger than it is a batch of its own and is copied
+constexpr uint64_t DECOMPRESS_BUF_SIZE = 1024 * 1024;
+
+// the headers are read through a window of the tar, not a read of HEADER_LEN each
+bool Decompress::ReadIndex(uv_file fd, uint64_t tarSize)
 {
-    if (!CheckPath(decPath)) {
+    std::vector<uint8_t> window(DECOMPRESS_BUF_SIZE);
+    uint64_t windowBegin = 0;
+    uint64_t windowSize = 0;
+    uint64_t batchBegin = 0;
+    uint64_t offset = 0;
+    while (offset + HEADER_LEN <= tarSize) {
+        if (offset < windowBegin || offset + HEADER_LEN > windowBegin + windowSize) {
+            uv_fs_t req;
+            uv_buf_t rbf = uv_buf_init(reinterpret_cast<char *>(window.data()), window.size());
+            int rc = uv_fs_read(nullptr, &req, fd, &rbf, 1, offset, nullptr);
+            uv_fs_req_cleanup(&req);
+            if (rc < HEADER_LEN) {
+                WRITE_LOG(LOG_FATAL, "read file error rc:%d", rc);
+                return false;
+            }
+            windowBegin = offset;
+            windowSize = static_cast<uint64_t>(rc);
+        }
+        Entry entry(window.data() + (offset - windowBegin), HEADER_LEN);
+        TypeFlage type = entry.FileType();
+        // the end of the tar, or what CopyPayload did not take either
+        if (type != TypeFlage::ORDINARYFILE && type != TypeFlage::DIRECTORY) {
+            break;
+        }
+        uint64_t size = type == TypeFlage::ORDINARYFILE ? entry.Size() : 0;
+        uint64_t dataOffset = offset + HEADER_LEN;
+        if (dataOffset + size > tarSize) {
+            WRITE_LOG(LOG_FATAL, "tar is short for %s", entry.GetName().c_str());
+            return false;
+        }
+        if (batches.empty() || dataOffset + size - batchBegin > DECOMPRESS_BUF_SIZE) {
+            batches.push_back(entrys.size());
+            batchBegin = dataOffset;
+        }
+        entrys.push_back(entry);
+        spans.push_back({ dataOffset, size });
+        offset = dataOffset + (size + HEADER_LEN - 1) / HEADER_LEN * HEADER_LEN;
+    }
+    batches.push_back(entrys.size());
+    return true;
+}
+
+// in the order of the tar, a directory comes before what is in it
+bool Decompress::MakeDirs(const std::string &decPath)
+{
+    for (auto& entry : entrys) {
+        if (entry.FileType() != TypeFlage::DIRECTORY) {
+            continue;
+        }
+        std::string dirPath = decPath + entry.GetName();
+        std::string estr;
+        if (!Base::TryCreateDirectory(dirPath, estr)) {
+            WRITE_LOG(LOG_FATAL, "mkdir failed dirPath:%s estr:%s", dirPath.c_str(), estr.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// data is the content of the file read with its batch, or nullptr to copy it from the tar through buf
+bool Decompress::WriteFile(const std::string &decPath, uv_file fd, size_t index, const uint8_t *data,
+                           std::vector<uint8_t> &buf)
+{
+    std::string saveFile = decPath + entrys[index].GetName();
+    uv_fs_t req;
+    // 0666: permission, as ofstream did
+    uv_file outFd = uv_fs_open(nullptr, &req, saveFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666, nullptr);
+    uv_fs_req_cleanup(&req);
+    if (outFd < 0) {
+        WRITE_LOG(LOG_FATAL, "open %s fail rc:%d", saveFile.c_str(), outFd);
         return false;
     }
-    uint8_t buff[HEADER_LEN];
-    std::ifstream inFile(tarPath);
-    std::optional<Entry> entry = std::nullopt;
-    while (true) {
-        inFile.read(reinterpret_cast<char*>(buff), HEADER_LEN);
-        auto readcnt = inFile.gcount();
-        if (readcnt == 0) {
+    const Span &span = spans[index];
+    uint64_t done = 0;
+    if (data != nullptr && span.size > 0) {
+        uv_buf_t wbf = uv_buf_init(const_cast<char *>(reinterpret_cast<const char *>(data)), span.size);
+        int wc = uv_fs_write(nullptr, &req, outFd, &wbf, 1, 0, nullptr);
+        uv_fs_req_cleanup(&req);
+        done = wc > 0 ? static_cast<uint64_t>(wc) : 0;
+    }
+#if !defined(_WIN32) && !defined(HOST_MAC)
+    // in the kernel, no copy through buf, falls back to it where the file systems can not
+    while (data == nullptr && done < span.size) {
+        loff_t inOffset = static_cast<loff_t>(span.offset + done);
+        loff_t outOffset = static_cast<loff_t>(done);
+        ssize_t rc = copy_file_range(fd, &inOffset, outFd, &outOffset, span.size - done, 0);
+        if (rc <= 0) {
             break;
         }
-        if (inFile.fail() || readcnt != HEADER_LEN) {
-            WRITE_LOG(LOG_FATAL, "read file error");
+        done += static_cast<uint64_t>(rc);
+    }
+#endif
+    while (data == nullptr && done < span.size) {
+        uv_buf_t rbf = uv_buf_init(reinterpret_cast<char *>(buf.data()),
+                                   static_cast<unsigned int>(std::min(span.size - done, DECOMPRESS_BUF_SIZE)));
+        int rc = uv_fs_read(nullptr, &req, fd, &rbf, 1, span.offset + done, nullptr);
+        uv_fs_req_cleanup(&req);
+        if (rc <= 0) {
             break;
         }
-        entry = Entry(buff, HEADER_LEN);
-        if (!entry.value().CopyPayload(decPath, inFile)) {
-            entry = std::nullopt;
+        rbf.len = static_cast<size_t>(rc);
+        int wc = uv_fs_write(nullptr, &req, outFd, &rbf, 1, done, nullptr);
+        uv_fs_req_cleanup(&req);
+        if (wc != rc) {
             break;
         }
-        entry = std::nullopt;
-        continue;
+        done += static_cast<uint64_t>(rc);
+    }
+    uv_fs_close(nullptr, &req, outFd, nullptr);
+    uv_fs_req_cleanup(&req);
+    if (done < span.size) {
+        WRITE_LOG(LOG_FATAL, "write %s fail %" PRIu64 "/%" PRIu64, saveFile.c_str(), done, span.size);
+        return false;
     }
-    inFile.close();
     return true;
 }
 
+// a batch of small files is one read of the tar, then a write of each
+bool Decompress::WriteBatch(const std::string &decPath, uv_file fd, size_t batch, std::vector<uint8_t> &buf)
+{
+    size_t first = batches[batch];
+    size_t last = batches[batch + 1] - 1;
+    uint64_t begin = spans[first].offset;
+    uint64_t size = spans[last].offset + spans[last].size - begin;
+    if (size > DECOMPRESS_BUF_SIZE) {
+        return WriteFile(decPath, fd, first, nullptr, buf);
+    }
+    uint64_t done = 0;
+    while (done < size) {
+        uv_fs_t req;
+        uv_buf_t rbf = uv_buf_init(reinterpret_cast<char *>(buf.data() + done), size - done);
+        int rc = uv_fs_read(nullptr, &req, fd, &rbf, 1, begin + done, nullptr);
+        uv_fs_req_cleanup(&req);
+        if (rc <= 0) {
+            WRITE_LOG(LOG_FATAL, "read file error rc:%d", rc);
+            return false;
+        }
+        done += static_cast<uint64_t>(rc);
+    }
+    for (size_t i = first; i <= last; ++i) {
+        if (entrys[i].FileType() == TypeFlage::ORDINARYFILE &&
+            !WriteFile(decPath, fd, i, buf.data() + (spans[i].offset - begin), buf)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Decompress::WriteFiles(const std::string &decPath, uv_file fd)
+{
+    std::vector<uint8_t> buf(DECOMPRESS_BUF_SIZE);
+    while (!failed) {
+        size_t batch = nextBatch++;
+        if (batch + 1 >= batches.size()) {
+            break;
+        }
+        if (!WriteBatch(decPath, fd, batch, buf)) {
+            failed = true;
+        }
+    }
+}
+
+bool Decompress::DecompressToLocal(std::string decPath)
+{
+    if (!CheckPath(decPath)) {
+        return false;
+    }
+    uv_fs_t req;
+    uv_file fd = uv_fs_open(nullptr, &req, tarPath.c_str(), O_RDONLY, 0, nullptr);
+    uv_fs_req_cleanup(&req);
+    if (fd < 0) {
+        WRITE_LOG(LOG_FATAL, "open %s fail rc:%d", tarPath.c_str(), fd);
+        return false;
+    }
+    bool ret = false;
+    if (lz4Frame) {
+        ret = DecompressFrame(decPath, fd);
+    } else {
+        uv_fs_fstat(nullptr, &req, fd, nullptr);
+        uint64_t tarSize = req.statbuf.st_size;
+        uv_fs_req_cleanup(&req);
+        entrys.clear();
+        spans.clear();
+        batches.clear();
+        ret = ReadIndex(fd, tarSize) && MakeDirs(decPath);
+    }
+    if (ret && !lz4Frame) {
+        size_t workers = std::min({ batches.size() - 1, DECOMPRESS_MAX_WORKERS,
+                                    static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u)) });
+        WRITE_LOG(LOG_DEBUG, "DecompressToLocal entrys:%zu batches:%zu workers:%zu", entrys.size(),
+                  batches.size() - 1, workers);
+        nextBatch = 0;
+        failed = false;
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < workers; ++i) {
+            threads.emplace_back(&Decompress::WriteFiles, this, std::cref(decPath), fd);
+        }
+        WriteFiles(decPath, fd);
+        for (auto& t : threads) {
+            t.join();
+        }
+        ret = !failed;
+    }
+    uv_fs_close(nullptr, &req, fd, nullptr);
+    uv_fs_req_cleanup(&req);
+    return ret;
+}
+
+bool Decompress::IsLz4Frame()
+{
+    uv_fs_t req;
+    uv_file fd = uv_fs_open(nullptr, &req, tarPath.c_str(), O_RDONLY, 0, nullptr);
+    uv_fs_req_cleanup(&req);
+    if (fd < 0) {
+        return false;
+    }
+    uint8_t magic[sizeof(uint32_t)] = { 0 };
+    uv_buf_t rbf = uv_buf_init(reinterpret_cast<char *>(magic), sizeof(magic));
+    int rc = uv_fs_read(nullptr, &req, fd, &rbf, 1, 0, nullptr);
+    uv_fs_req_cleanup(&req);
+    uv_fs_close(nullptr, &req, fd, nullptr);
+    uv_fs_req_cleanup(&req);
+    return rc == sizeof(magic) && Base::LoadLe32(magic) == LZ4_MAGIC;
+}
+
+// what can be taken of the tar in data, in order, the rest is given again with more after it
+size_t Decompress::TakeTar(const std::string &decPath, uint8_t *data, size_t size)
+{
+    size_t taken = 0;
+    while (taken < size && !frameEnd && !failed) {
+        if (frameLeft > 0) {
+            uv_fs_t req;
+            size_t len = static_cast<size_t>(std::min(frameLeft, static_cast<uint64_t>(size - taken)));
+            uv_buf_t wbf = uv_buf_init(reinterpret_cast<char *>(data + taken), len);
+            int wc = uv_fs_write(nullptr, &req, frameOut, &wbf, 1, -1, nullptr);
+            uv_fs_req_cleanup(&req);
+            if (wc != static_cast<int>(len)) {
+                WRITE_LOG(LOG_FATAL, "write file error rc:%d", wc);
+                failed = true;
+                break;
+            }
+            taken += len;
+            frameLeft -= len;
+        } else if (frameSkip > 0) {
+            size_t len = static_cast<size_t>(std::min(frameSkip, static_cast<uint64_t>(size - taken)));
+            taken += len;
+            frameSkip -= len;
+        } else if (size - taken < HEADER_LEN) {
+            break;
+        } else {
+            Entry entry(data + taken, HEADER_LEN);
+            taken += HEADER_LEN;
+            TypeFlage type = entry.FileType();
+            std::string path = decPath + entry.GetName();
+            std::string estr;
+            if (type == TypeFlage::DIRECTORY) {
+                if (!Base::TryCreateDirectory(path, estr)) {
+                    WRITE_LOG(LOG_FATAL, "mkdir failed dirPath:%s estr:%s", path.c_str(), estr.c_str());
+                    failed = true;
+                }
+                continue;
+            }
+            if (type != TypeFlage::ORDINARYFILE) {
+                frameEnd = true;
+                break;
+            }
+            uv_fs_t req;
+            // 0666: permission, as ofstream did
+            frameOut = uv_fs_open(nullptr, &req, path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666, nullptr);
+            uv_fs_req_cleanup(&req);
+            if (frameOut < 0) {
+                WRITE_LOG(LOG_FATAL, "open %s fail rc:%d", path.c_str(), frameOut);
+                failed = true;
+                break;
+            }
+            frameLeft = entry.Size();
+            frameSkip = (HEADER_LEN - frameLeft % HEADER_LEN) % HEADER_LEN;
+        }
+        if (frameLeft == 0 && frameOut >= 0) {
+            uv_fs_t req;
+            uv_fs_close(nullptr, &req, frameOut, nullptr);
+            uv_fs_req_cleanup(&req);
+            frameOut = -1;
+        }
+    }
+    return taken;
+}
+
+// one read of the frame, what is decompressed is taken as it comes, the tar is never all in memory or on disk
+bool Decompress::DecompressFrame(const std::string &decPath, uv_file fd)
+{
+#ifdef HARMONY_PROJECT
+    LZ4F_dctx *ctx = nullptr;
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION))) {
+        WRITE_LOG(LOG_FATAL, "LZ4F_createDecompressionContext failed");
+        return false;
+    }
+    std::vector<uint8_t> in(DECOMPRESS_BUF_SIZE);
+    std::vector<uint8_t> out(DECOMPRESS_BUF_SIZE);
+    size_t pending = 0;  // of out, not taken yet
+    uint64_t offset = 0;
+    size_t hint = 1;     // 0 when the frame is ended
+    failed = false;
+    frameEnd = false;
+    frameLeft = 0;
+    frameSkip = 0;
+    while (hint != 0 && !frameEnd && !failed) {
+        uv_fs_t req;
+        uv_buf_t rbf = uv_buf_init(reinterpret_cast<char *>(in.data()), in.size());
+        int rc = uv_fs_read(nullptr, &req, fd, &rbf, 1, offset, nullptr);
+        uv_fs_req_cleanup(&req);
+        if (rc <= 0) {
+            WRITE_LOG(LOG_FATAL, "lz4 frame is short at %" PRIu64 " rc:%d", offset, rc);
+            break;
+        }
+        offset += static_cast<uint64_t>(rc);
+        size_t inPos = 0;
+        while (inPos < static_cast<size_t>(rc) && hint != 0 && !frameEnd && !failed) {
+            size_t outSize = out.size() - pending;
+            size_t inSize = static_cast<size_t>(rc) - inPos;
+            hint = LZ4F_decompress(ctx, out.data() + pending, &outSize, in.data() + inPos, &inSize, nullptr);
+            if (LZ4F_isError(hint)) {
+                WRITE_LOG(LOG_FATAL, "lz4 frame decompress failed:%s", LZ4F_getErrorName(hint));
+                failed = true;
+                break;
+            }
+            inPos += inSize;
+            pending += outSize;
+            size_t taken = TakeTar(decPath, out.data(), pending);
+            pending -= taken;
+            if (pending > 0 && taken > 0 && memmove_s(out.data(), out.size(), out.data() + taken, pending) != EOK) {
+                failed = true;
+            }
+        }
+    }
+    LZ4F_freeDecompressionContext(ctx);
+    if (frameOut >= 0) {
+        uv_fs_t req;
+        uv_fs_close(nullptr, &req, frameOut, nullptr);
+        uv_fs_req_cleanup(&req);
+        frameOut = -1;
+    }
+    return !failed && (hint == 0 || frameEnd) && frameLeft == 0;
+#else
+    WRITE_LOG(LOG_FATAL, "lz4 frame %s is not supported", tarPath.c_str());
+    return false;
+#endif
+}
+
 bool Decompress::CheckPath(std::string decPath)
 {
     uv_fs_t req;
@@ -60,7 +390,8 @@ bool Decompress::CheckPath(std::string decPath)
         return false;
     }
     auto fileSize = req.statbuf.st_size;
-    if (fileSize == 0 || fileSize % HEADER_LEN != 0) {
+    lz4Frame = IsLz4Frame();
+    if (fileSize == 0 || (!lz4Frame && fileSize % HEADER_LEN != 0)) {
         WRITE_LOG(LOG_FATAL, "file is not tar %s", tarPath.c_str());
         return false;
     }
@@ -23,15 +23,47 @@
 namespace Hdc {
 class Decompress {
 public:
+    static constexpr uint32_t LZ4_MAGIC = 0x184D2204;  // the first 4 bytes of an lz4 frame, little endian
+
     explicit Decompress(std::string tarPath) : tarPath(tarPath) {}
     ~Decompress() {}
 
+    // directories are made in the order of the tar first, then the files are written by up to
+    // DECOMPRESS_MAX_WORKERS threads. Small files go in batches, one read of the tar for many of them, a big one is
+    // copied from its offset in the tar. The tar in an lz4 frame, as Compress::StartLz4 makes it, is taken in order
+    // as it is decompressed
     bool DecompressToLocal(std::string decPath);
     bool CheckPath(std::string decPath);
 
 private:
+    bool ReadIndex(uv_file fd, uint64_t tarSize);
+    bool MakeDirs(const std::string &decPath);
+    void WriteFiles(const std::string &decPath, uv_file fd);
+    bool WriteBatch(const std::string &decPath, uv_file fd, size_t batch, std::vector<uint8_t> &buf);
+    bool WriteFile(const std::string &decPath, uv_file fd, size_t index, const uint8_t *data,
+                   std::vector<uint8_t> &buf);
+    bool IsLz4Frame();
+    bool DecompressFrame(const std::string &decPath, uv_file fd);
+    size_t TakeTar(const std::string &decPath, uint8_t *data, size_t size);
+
+    // where the data of an entry is in the tar
+    struct Span {
+        uint64_t offset;
+        uint64_t size;
+    };
+
     std::vector<Entry> entrys;
+    std::vector<Span> spans;  // of each of entrys
+    std::vector<size_t> batches;  // the first of entrys of each batch, then the size of entrys
     std::string tarPath;
+    std::atomic<size_t> nextBatch = 0;
+    std::atomic<bool> failed = false;
+    bool lz4Frame = false;
+    // of the entry of the frame being taken
+    uv_file frameOut = -1;
+    uint64_t frameLeft = 0;  // of the data
+    uint64_t frameSkip = 0;  // of the padding after the data
+    bool frameEnd = false;
 };
 
 }
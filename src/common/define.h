@@ -32,6 +32,8 @@ const string DEFAULT_SERVER_ADDR_IP = "::ffff:127.0.0.1";
 const string DEFAULT_SERVER_ADDR = "::ffff:127.0.0.1:8710";
 const string ENV_SERVER_PORT = "OHOS_HDC_SERVER_PORT";
 const string ENV_SERVER_LOG = "OHOS_HDC_LOG_LEVEL";
+const string ENV_SESSION_COMPRESS = "OHOS_HDC_SESSION_COMPRESS";  // 1: server offers FEATURE_LZ4
+const string ENV_LOCAL_CHANNEL = "OHOS_HDC_LOCAL_CHANNEL";        // 0: client to server over TCP only
 
 // ################################ macro define ###################################
 constexpr uint8_t MINOR_TIMEOUT = 5;
@@ -85,7 +87,9 @@ constexpr uint16_t MAX_DELETED_SESSION_ID_RECORD_COUNT = 32;
 #else
 constexpr uint16_t MAX_DELETED_SESSION_ID_RECORD_COUNT = 10;
 #endif
-constexpr uint16_t TCP_CONNECT_MAX_RETRY_COUNT = 6;
+// client to server, exponential backoff from TCP_CONNECT_RETRY_BASE_MS up to TCP_CONNECT_RETRY_TIME_MS, 3.75s at most
+constexpr uint16_t TCP_CONNECT_MAX_RETRY_COUNT = 10;
+constexpr uint16_t TCP_CONNECT_RETRY_BASE_MS = 50;
 constexpr uint16_t TCP_CONNECT_RETRY_TIME_MS = 500;
 constexpr uint16_t NEW_SESSION_DROP_USB_DATA_TIME_MS = 1000;
 
@@ -136,6 +140,11 @@ const string CMDSTR_LIST_TARGETS = "list targets";
 const string CMDSTR_CHECK_SERVER = "checkserver";
 const string CMDSTR_CHECK_DEVICE = "checkdevice";
 const string CMDSTR_WAIT_FOR = "wait";
+const string CMDSTR_SERVER_TRACE = "trace";
+const string CMDSTR_SERVER_STAT = "stat";
+const string CMDSTR_BENCH = "bench";
+const string CMDSTR_BATCH = "batch";
+const string CMDSTR_EACH = "each";
 const string CMDSTR_CONNECT_TARGET = "tconn";
 const string CMDSTR_CONNECT_ANY = "any";
 const string CMDSTR_SHELL = "shell";
@@ -183,7 +192,16 @@ const string TERMINAL_HDC_PROCESS_FAILED = "[E002101]:Terminal hdc process faile
     "please terminal the hdc process in the task manager first.";
 
 // ################################ Macro define ###################################
-#ifdef IS_RELEASE_VERSION
+#ifdef HDC_LOG_BINARY
+// fmt must be a string literal, it is kept in the static site and decoded by 'hdc -L'
+#define WRITE_LOG(level, fmt, ...)                                                    \
+    do {                                                                              \
+        if ((level) <= Base::g_logLevel) {                                            \
+            static BinaryLog::LogSite hdcLogSite = { __FILE_NAME__, __LINE__, fmt };  \
+            BinaryLog::Write(hdcLogSite, level, ##__VA_ARGS__);                       \
+        }                                                                             \
+    } while (0)
+#elif defined(IS_RELEASE_VERSION)
 #define WRITE_LOG(level, fmt, ...)   Base::PrintLogEx(__FUNCTION__, __LINE__, level, fmt, ##__VA_ARGS__)
 #else
 #define WRITE_LOG(level, fmt, ...)   Base::PrintLogEx(__FILE_NAME__, __LINE__, level, fmt, ##__VA_ARGS__)
@@ -65,6 +65,14 @@ enum ConnStatus { STATUS_UNKNOW = 0, STATUS_READY, STATUS_CONNECTED, STATUS_OFFL
 const string conStatusDetail[] = { "Unknown", "Ready", "Connected", "Offline", "Unauthorized" };
 
 enum AuthVerifyType { RSA_ENCRYPT = 0, RSA_3072_SHA512 = 1, UNKNOWN = 100 };
+// Session capabilities, offered by the server in handshake TAG_FEATURE and answered by the daemon with what it
+// accepts. Peers which do not know the tag answer nothing and stay on the old format.
+enum SessionFeature {
+    FEATURE_FIXED_HEAD = 1 << 0,  // PayloadProtect and TransferPayload in fixed layout
+    FEATURE_CRC32C = 1 << 1,      // crc32c of the data of every packet
+    FEATURE_LZ4 = 1 << 2,         // LZ4 stream of the data of all packets, offered by ENV_SESSION_COMPRESS
+    FEATURE_TICKET = 1 << 3,      // resumption ticket after a full auth, see SessionTicketStore
+};
 
 enum OperateID {
     OP_ADD,
@@ -155,6 +163,10 @@ enum HdcCommand {
     CMD_CHECK_SERVER,
     CMD_CHECK_DEVICE,
     CMD_WAIT_FOR,
+    CMD_SERVER_TRACE,
+    CMD_SERVER_STAT,
+    CMD_KERNEL_TARGET_CONNECT_BATCH,
+    CMD_KERNEL_TARGET_EACH,
     // One-pass simple commands
     CMD_UNITY_COMMAND_HEAD = 1000,  // not use
     CMD_UNITY_EXECUTE,
@@ -21,6 +21,10 @@
 #include "hitrace_meter.h"
 #endif
 #include "define_enum.h"
+#include "metrics.h"
+#include "channel_shm.h"
+#include "session_compress.h"
+#include "session_ticket.h"
 
 namespace Hdc {
     
@@ -53,6 +57,12 @@ static string MaskString(const string &str)
 #define StartTracePoint(value) StartTrace(HITRACE_TAG_HDCD, value)
 #define FinishTracePoint()     FinishTrace(HITRACE_TAG_HDCD)
 #define StartTraceScope(value) HITRACE_METER_NAME(HITRACE_TAG_HDCD, value)
+#elif defined(HDC_HOST)  // see trace.h, a not enabled scope costs one branch
+#define HDC_TRACE_CONCAT_IMPL(a, b) a##b
+#define HDC_TRACE_CONCAT(a, b) HDC_TRACE_CONCAT_IMPL(a, b)
+#define StartTracePoint(value) Hdc::Trace::BeginPoint(value)
+#define FinishTracePoint()     Hdc::Trace::FinishPoint()
+#define StartTraceScope(value) Hdc::Trace::Scope HDC_TRACE_CONCAT(hdcTraceScope, __LINE__)(value)
 #else
 #define StartTracePoint(value)
 #define FinishTracePoint()
@@ -96,6 +106,7 @@ struct TaskInformation {
     void *channelClass;
     uint8_t debugRelease; // 0:allApp 1:debugApp 2:releaseApp
     bool isStableBuf;
+    uint32_t sessionFeatures;  // SessionFeature of the session when the task is created
 };
 using HTaskInfo = TaskInformation *;
 
@@ -194,6 +205,39 @@ struct HdcSessionStat {
     std::atomic<uint64_t> dataSendBytes;
     // bytes successed read from hSession->dataPipe[STREAM_WORK]
     std::atomic<uint64_t> dataRecvBytes;
+    std::atomic<uint64_t> sendPackets;
+    std::atomic<uint64_t> recvPackets;
+    std::atomic<uint64_t> queuedSendBytes;  // packets waiting for or being in WriteUvTcpFd
+    Metrics::Histogram sendLatency;         // us, blocking write of one packet
+    Metrics::Histogram recvLatency;         // us, decode and dispatch of one packet
+    // handshake
+    uint64_t beginTime;                  // us, MallocSession
+    std::atomic<uint64_t> authBeginTime;  // us, first auth round from daemon
+    std::atomic<uint64_t> handshakeTime;  // us, from beginTime to handshakeOK
+    std::atomic<uint64_t> authTime;       // us, from authBeginTime to handshakeOK
+    // tasks
+    std::atomic<uint64_t> transferCount;
+    std::atomic<uint64_t> transferBytes;
+    std::atomic<uint64_t> transferTime;  // ms
+    std::atomic<uint32_t> forwardActive;
+    std::atomic<uint64_t> forwardTotal;
+    // FEATURE_LZ4, packet data before and after compression and the time spent on it
+    std::atomic<uint64_t> compressRawBytes;
+    std::atomic<uint64_t> compressBytes;
+    std::atomic<uint64_t> compressTime;  // us
+    std::atomic<uint64_t> decompressRawBytes;
+    std::atomic<uint64_t> decompressBytes;
+    std::atomic<uint64_t> decompressTime;  // us
+};
+
+struct HdcChannelStat {
+    // bytes and packets of channel protocol between client and server
+    std::atomic<uint64_t> dataSendBytes;
+    std::atomic<uint64_t> dataRecvBytes;
+    std::atomic<uint64_t> sendPackets;
+    std::atomic<uint64_t> recvPackets;
+    Metrics::Histogram recvLatency;  // us, ReadChannel of one packet
+    uint64_t beginTime;              // us, MallocChannel
 };
 
 struct HdcSession {
@@ -245,6 +289,10 @@ struct HdcSession {
     std::atomic<bool> isNeedDropData; // host: Whether to discard the USB data after it is read
     std::atomic<uint64_t> dropBytes;
     bool isSoftReset; // for daemon, Used to record whether a reset command has been received
+    // SessionFeature negotiated in handshake, what this side sends. Stored with release once compress is set up,
+    // a sender loads it with acquire before it uses compress
+    std::atomic<uint32_t> features = 0;
+    SessionCompress *compress = nullptr;  // FEATURE_LZ4
 
     HdcSessionStat stat;
     std::string ToDebugString()
@@ -305,6 +353,10 @@ struct HdcSession {
             delete listKey;
             listKey = nullptr;
         }
+        if (compress) {
+            delete compress;
+            compress = nullptr;
+        }
     }
 };
 using HSession = struct HdcSession *;
@@ -347,10 +399,18 @@ struct HdcChannel {
     bool fromClient = false;
     bool connectLocalDevice = false;
     bool isStableBuf = false;
+    ChannelShm *shm = nullptr;  // rings of a local channel
+    // the only thread and stream the ring frames go on, so their headers are in the order of the ring: the main
+    // stream until the channel is attached to a session, then its child stream
+    uv_thread_t ringThread;
+    std::atomic<uv_stream_t *> ringStream = nullptr;
+    bool sink = false;          // host 'each': no client stream, what is sent goes to SinkOutput
+    HdcChannelStat stat;
 };
 using HChannel = struct HdcChannel *;
 
 struct HdcDaemonInformation {
+    uint32_t deviceId;  // stable for a connectKey in the life of the server, set by the daemon map
     uint8_t connType;
     uint8_t connStatus;
     std::string connectKey;
@@ -363,6 +423,13 @@ struct HdcDaemonInformation {
 };
 using HDaemonInfo = struct HdcDaemonInformation *;
 
+// a change of the daemon map, see HdcServer::DaemonMapChanged
+struct HdcDaemonEvent {
+    uint64_t version;
+    std::string connectKey;
+    std::string line;  // as 'list targets -w' shows it
+};
+
 struct HdcForwardInformation {
     std::string taskString;
     bool forwardDirection;  // true for forward, false is reverse;
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dir_walker.h"
+
+namespace Hdc {
+// the walk waits on the disk or the network more than on the cpu
+constexpr size_t WALKER_THREADS = 8;
+// a big directory is handed out in parts while it is still stated
+constexpr size_t WALKER_FLUSH_ITEMS = 256;
+
+DirWalker::DirWalker(const string &rootIn, uint8_t flagsIn) : root(rootIn), flags(flagsIn)
+{
+}
+
+DirWalker::~DirWalker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        dirCond.notify_all();
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+void DirWalker::Start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!threads.empty()) {
+        return;
+    }
+    dirs.push_back("");
+    for (size_t i = 0; i < WALKER_THREADS; ++i) {
+        threads.emplace_back(&DirWalker::Worker, this);
+    }
+}
+
+bool DirWalker::Next(Item &item, bool wait)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wait) {
+        itemCond.wait(lock, [this]() { return !items.empty() || finished; });
+    }
+    if (items.empty()) {
+        return false;
+    }
+    item = std::move(items.front());
+    items.pop_front();
+    return true;
+}
+
+void DirWalker::Worker()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        dirCond.wait(lock, [this]() { return stopped || !dirs.empty() || scanning == 0; });
+        if (stopped || dirs.empty()) {
+            // nothing left and no one scanning, so nothing more can be found
+            finished = true;
+            dirCond.notify_all();
+            itemCond.notify_all();
+            return;
+        }
+        // the last found first, it is deep in the tree and near the one scanned before
+        string relative = std::move(dirs.back());
+        dirs.pop_back();
+        ++scanning;
+        lock.unlock();
+        Scan(relative);
+        lock.lock();
+        --scanning;
+        if (scanning == 0) {
+            dirCond.notify_all();
+        }
+    }
+}
+
+// lstat, and stat the target of a link, linked tells which
+bool DirWalker::StatEntry(const string &path, Item &item, bool &linked)
+{
+    uv_fs_t req = {};
+    int rc = uv_fs_lstat(nullptr, &req, path.c_str(), nullptr);
+    uv_fs_req_cleanup(&req);
+    linked = rc == 0 && (req.statbuf.st_mode & S_IFMT) == S_IFLNK;
+    if (linked) {
+        rc = uv_fs_stat(nullptr, &req, path.c_str(), nullptr);
+        uv_fs_req_cleanup(&req);
+    }
+    if (rc < 0) {
+        WRITE_LOG(LOG_DEBUG, "DirWalker stat failed path:%s rc:%d", path.c_str(), rc);
+        return false;
+    }
+    item.stat = req.statbuf;
+    item.isDir = (req.statbuf.st_mode & S_IFMT) == S_IFDIR;
+    return item.isDir || (req.statbuf.st_mode & S_IFMT) == S_IFREG;
+}
+
+void DirWalker::Scan(const string &relative)
+{
+    string path = relative.empty() ? root : root + Base::GetPathSep() + relative;
+    uv_fs_t req = {};
+    if (uv_fs_scandir(nullptr, &req, path.c_str(), 0, nullptr) < 0) {
+        WRITE_LOG(LOG_WARN, "DirWalker scandir failed dir:%s", path.c_str());
+        uv_fs_req_cleanup(&req);
+        failed = true;
+        return;
+    }
+    vector<Item> found;
+    vector<string> subdirs;
+    auto flush = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &item : found) {
+            items.push_back(std::move(item));
+        }
+        // with the items, so a directory is taken from Next before anything in it can be found
+        for (auto &dir : subdirs) {
+            dirs.push_back(std::move(dir));
+        }
+        if (!subdirs.empty()) {
+            dirCond.notify_all();
+        }
+        itemCond.notify_all();
+        found.clear();
+        subdirs.clear();
+    };
+    uv_dirent_t dent;
+    while (uv_fs_scandir_next(&req, &dent) != UV_EOF && !stopped) {
+        if (strcmp(dent.name, ".") == 0 || strcmp(dent.name, "..") == 0) {
+            continue;
+        }
+        if ((flags & SKIP_HIDDEN) && dent.name[0] == '.') {
+            continue;
+        }
+        Item item;
+        item.relative = relative.empty() ? dent.name : relative + Base::GetPathSep() + dent.name;
+        string sub = path + Base::GetPathSep() + dent.name;
+        bool linked = false;
+        if (dent.type == UV_DIRENT_FILE || dent.type == UV_DIRENT_DIR) {
+            item.isDir = dent.type == UV_DIRENT_DIR;
+            item.stat.st_mode = item.isDir ? S_IFDIR : S_IFREG;
+            if ((flags & (item.isDir ? STAT_DIRS : STAT_FILES)) && !StatEntry(sub, item, linked)) {
+                continue;
+            }
+        } else if (dent.type == UV_DIRENT_LINK || dent.type == UV_DIRENT_UNKNOWN) {
+            // some network filesystems give no type, and a link goes where its target is
+            if (!StatEntry(sub, item, linked)) {
+                continue;
+            }
+        } else {
+            continue;  // fifo, socket or device
+        }
+        if (linked && item.isDir) {
+            // it may lead back up the tree, 'loop -> ..' would be walked until ELOOP
+            WRITE_LOG(LOG_DEBUG, "DirWalker skip link to dir:%s", sub.c_str());
+            continue;
+        }
+        if (item.isDir) {
+            subdirs.push_back(item.relative);
+        }
+        found.push_back(std::move(item));
+        if (found.size() >= WALKER_FLUSH_ITEMS) {
+            flush();
+        }
+    }
+    uv_fs_req_cleanup(&req);
+    if (!found.empty()) {
+        flush();
+    }
+}
+}  // namespace Hdc
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_DIR_WALKER_H
+#define HDC_DIR_WALKER_H
+#include <thread>
+
+#include "common.h"
+
+namespace Hdc {
+// Walks the tree under a directory on a few threads, every idle thread takes the next directory not scanned yet,
+// and hands out the files and directories found while it goes on, so a user can begin on the first of them.
+// The type of an entry comes from scandir, a stat is only made when the type is unknown or a link, or when it is
+// asked for by the flags. Links to files are followed, links to directories are skipped, so a link cannot lead
+// the walk around a cycle. A directory is always handed out before the entries in it.
+class DirWalker {
+public:
+    static constexpr uint8_t STAT_DIRS = 1;
+    static constexpr uint8_t STAT_FILES = 2;
+    static constexpr uint8_t SKIP_HIDDEN = 4;  // the names beginning with '.', with all under them
+
+    struct Item {
+        string relative;  // to the root, the names joined by the path separator
+        bool isDir = false;
+        uv_stat_t stat = {};  // only the type of st_mode unless it is asked for by the flags
+    };
+
+    DirWalker(const string &rootIn, uint8_t flagsIn);
+    virtual ~DirWalker();
+    void Start();
+    // false when the walk is done and all items are taken, or with wait false when none is found yet
+    bool Next(Item &item, bool wait);
+    // a directory could not be scanned, the walk goes on without it
+    bool Failed()
+    {
+        return failed;
+    }
+
+private:
+    void Worker();
+    void Scan(const string &relative);
+    bool StatEntry(const string &path, Item &item, bool &linked);
+
+    string root;
+    uint8_t flags;
+    std::mutex mutex;
+    std::condition_variable dirCond;
+    std::condition_variable itemCond;
+    std::deque<string> dirs;  // found, not scanned yet
+    std::deque<Item> items;
+    size_t scanning = 0;
+    bool finished = false;
+    std::atomic<bool> stopped = false;
+    std::atomic<bool> failed = false;
+    vector<std::thread> threads;
+};
+}  // namespace Hdc
+#endif
@@ -39,27 +39,39 @@ Entry::Entry(std::string prefix, std::string path)
     int rc = uv_fs_lstat(nullptr, &req, path.c_str(), nullptr);
     uv_fs_req_cleanup(&req);
     if (rc == 0) {
-        if (req.statbuf.st_mode & S_IFDIR) {
-            header.UpdataFileType(TypeFlage::DIRECTORY);
-            header.UpdataSize(0);
-        } else if (req.statbuf.st_mode & S_IFREG) {
-            auto fileSize = req.statbuf.st_size;
-            if (fileSize < ENTRY_MAX_FILE_SIZE) { // max package size is 4GB
-                header.UpdataSize(fileSize);
-                needSize = fileSize;
-                header.UpdataFileType(TypeFlage::ORDINARYFILE);
-            } else {
+        UpdataStat(path, req.statbuf);
+    }
+    UpdataName(path);
+}
+
+Entry::Entry(std::string prefix, std::string path, const uv_stat_t &st)
+{
+    this->prefix = prefix + Base::GetPathSep();
+    UpdataStat(path, st);
+    UpdataName(path);
+}
+
+void Entry::UpdataStat(const std::string &path, const uv_stat_t &st)
+{
+    if (st.st_mode & S_IFDIR) {
+        header.UpdataFileType(TypeFlage::DIRECTORY);
+        header.UpdataSize(0);
+    } else if (st.st_mode & S_IFREG) {
+        auto fileSize = st.st_size;
+        if (fileSize < ENTRY_MAX_FILE_SIZE) { // max package size is 4GB
+            header.UpdataSize(fileSize);
+            needSize = fileSize;
+            header.UpdataFileType(TypeFlage::ORDINARYFILE);
+        } else {
 #ifdef HDC_HOST
-                Base::PrintMessage("[Warning]File: %s, size: %lldB, over the 4GB limit, ignored.",
-                    path.c_str(), fileSize);
+            Base::PrintMessage("[Warning]File: %s, size: %lldB, over the 4GB limit, ignored.",
+                path.c_str(), fileSize);
 #else
-                WRITE_LOG(LOG_WARN, "File: %s, size: %lldB, over the 4GB limit, ignored.",
-                    path.c_str(), fileSize);
+            WRITE_LOG(LOG_WARN, "File: %s, size: %lldB, over the 4GB limit, ignored.",
+                path.c_str(), fileSize);
 #endif
-            }
         }
     }
-    UpdataName(path);
 }
 
 Entry::Entry(uint8_t data[512], int dataLen)
@@ -224,4 +236,73 @@ bool Entry::WriteToTar(std::ofstream &file)
     }
     return true;
 }
+
+uint64_t Entry::TarSize()
+{
+    switch (header.FileType()) {
+        case TypeFlage::ORDINARYFILE:
+            return HEADER_LEN + (header.Size() + HEADER_LEN - 1) / HEADER_LEN * HEADER_LEN;
+        case TypeFlage::DIRECTORY:
+            return HEADER_LEN;
+        default:
+            return 0;
+    }
+}
+
+bool Entry::ReadTar(uint64_t offset, uint8_t *buf, size_t len, uv_file &fd)
+{
+    if (offset + len > TarSize()) {
+        return false;
+    }
+    if (offset < HEADER_LEN) {
+        uint8_t buff[HEADER_LEN] = {0};
+        header.GetBytes(buff, HEADER_LEN);
+        size_t size = std::min(len, static_cast<size_t>(HEADER_LEN - offset));
+        if (memcpy_s(buf, len, buff + offset, size) != EOK) {
+            return false;
+        }
+        offset += size;
+        buf += size;
+        len -= size;
+    }
+    uint64_t dataOffset = offset - HEADER_LEN;
+    uint64_t dataSize = header.Size();
+    if (len > 0 && dataOffset < dataSize) {
+        if (fd < 0) {
+            std::string name = Base::UnicodeToUtf8(GetName().c_str(), true);
+            uv_fs_t req;
+            fd = uv_fs_open(nullptr, &req, name.c_str(), O_RDONLY, 0, nullptr);
+            uv_fs_req_cleanup(&req);
+            if (fd < 0) {
+                WRITE_LOG(LOG_FATAL, "open %s fail", name.c_str());
+                return false;
+            }
+        }
+        size_t size = static_cast<size_t>(std::min(static_cast<uint64_t>(len), dataSize - dataOffset));
+        size_t done = 0;
+        while (done < size) {
+            uv_fs_t req;
+            uv_buf_t rbf = uv_buf_init(reinterpret_cast<char *>(buf + done), size - done);
+            int rc = uv_fs_read(nullptr, &req, fd, &rbf, 1, dataOffset + done, nullptr);
+            uv_fs_req_cleanup(&req);
+            if (rc < 0) {
+                WRITE_LOG(LOG_FATAL, "read %s fail rc:%d", GetName().c_str(), rc);
+                return false;
+            }
+            if (rc == 0) {
+                // the file is shorter than when it was added, the header has said the size
+                (void)memset_s(buf + done, size - done, 0, size - done);
+                break;
+            }
+            done += static_cast<size_t>(rc);
+        }
+        buf += size;
+        len -= size;
+    }
+    // padding
+    if (len > 0) {
+        (void)memset_s(buf, len, 0, len);
+    }
+    return true;
+}
 }
@@ -23,6 +23,8 @@ namespace Hdc {
 class Entry {
 public:
     Entry(std::string prefix, std::string path);
+    // st of path is known, it is not stated again
+    Entry(std::string prefix, std::string path, const uv_stat_t &st);
     Entry(uint8_t data[512], int dataLen);
     ~Entry() {}
 
@@ -42,17 +44,28 @@ public:
         return header.Size();
     }
 
+    TypeFlage FileType()
+    {
+        return header.FileType();
+    }
+
     bool CopyPayload(std::string prefixPath, std::ifstream &inFile);
     bool PayloadToFile(std::string prefixPath, std::ifstream &inFile);
     bool PayloadToDir(std::string prefixPath, std::ifstream &inFile);
     bool ReadAndWriteData(std::ifstream &inFile, std::ofstream &outFile, uint8_t *buffAppend,
         int readSize, int writeSize);
     bool WriteToTar(std::ofstream &file);
+    // header, data and padding to HEADER_LEN as WriteToTar writes them, 0 for what it skips
+    uint64_t TarSize();
+    // len bytes of the entry in a tar from offset, the data of a file is read from fd, opened here if it is < 0
+    bool ReadTar(uint64_t offset, uint8_t *buf, size_t len, uv_file &fd);
 
     std::string GetName();
     bool UpdataName(std::string name);
 
 private:
+    void UpdataStat(const std::string &path, const uv_stat_t &st);
+
     Header header;
     uint64_t needSize;
     std::string prefix;
@@ -22,10 +22,12 @@ HdcFile::HdcFile(HTaskInfo hTaskInfo)
     commandBegin = CMD_FILE_BEGIN;
     commandData = CMD_FILE_DATA;
     isStableBuf = hTaskInfo->isStableBuf;
+    walker = nullptr;
 }
 
 HdcFile::~HdcFile()
 {
+    delete walker;
     WRITE_LOG(LOG_DEBUG, "~HdcFile channelId:%u", taskInfo->channelId);
 };
 
@@ -127,14 +129,25 @@ bool HdcFile::SetMasterParameters(CtxFile *context, const char *command, int arg
     mode_t mode = mode_t(~S_IFMT);
     if (!Base::CheckDirectoryOrPath(context->localPath.c_str(), true, true, errStr, mode) && (mode & S_IFDIR)) {
         context->isDir = true;
-        GetSubFilesRecursively(context->localPath, context->localName, &context->taskQueue);
-        if (context->taskQueue.size() == 0) {
+        uv_fs_t fs = {};
+        if (uv_fs_stat(nullptr, &fs, context->localPath.c_str(), nullptr) == 0) {
+            AddDirMode(context->localPath, context->localName, fs.statbuf);
+        }
+        uv_fs_req_cleanup(&fs);
+        walker = new(std::nothrow) DirWalker(context->localPath, DirWalker::STAT_DIRS);
+        if (walker == nullptr) {
+            LogMsg(MSG_FAIL, "Operation failed, because of out of memory.");
+            return false;
+        }
+        walker->Start();
+        walkDirname = context->localName;
+        context->localDirName = Base::GetPathWithoutFilename(context->localPath);
+        if (!TakeWalked(context)) {
             LogMsg(MSG_FAIL, "Operation failed, because the source folder is empty.");
             return false;
         }
         context->fileCnt = 0;
         context->dirSize = 0;
-        context->localDirName = Base::GetPathWithoutFilename(context->localPath);
 
         WRITE_LOG(LOG_DEBUG, "localDirName = %s", context->localDirName.c_str());
 
@@ -175,6 +188,12 @@ void HdcFile::TransferSummary(CtxFile *context)
     uint64_t fSize = context->fileCnt > 1 ? context->dirSize : context->indexIO;
     double fRate = static_cast<double>(fSize) / nMSec; // / /1000 * 1000 = 0
     if (context->indexIO >= context->fileSize || context->lastErrno == 0) {
+        HdcSessionStat *stat = GetSessionStat();
+        if (stat != nullptr) {
+            ++stat->transferCount;
+            stat->transferBytes += fSize;
+            stat->transferTime += nMSec;
+        }
         LogMsg(MSG_OK, "FileTransfer finish, Size:%lld, File count = %d, time:%lldms rate:%.2lfkB/s",
                fSize, context->fileCnt, nMSec, fRate);
     } else {
@@ -292,6 +311,22 @@ bool HdcFile::SlaveCheck(uint8_t *payload, const int payloadSize)
     return ret;
 }
 
+// what the walker found since the last time, it waits when no file is left to send until one is found
+// or the walk is done. Every directory comes before the files in it, so its mode is sent before them
+bool HdcFile::TakeWalked(CtxFile *context)
+{
+    DirWalker::Item item;
+    while (walker->Next(item, context->taskQueue.empty())) {
+        if (item.isDir) {
+            AddDirMode(context->localDirName + walkDirname + Base::GetPathSep() + item.relative,
+                       walkDirname + Base::GetPathSep() + item.relative, item.stat);
+        } else {
+            context->taskQueue.push_back(walkDirname + Base::GetPathSep() + item.relative);
+        }
+    }
+    return context->taskQueue.size() > 0;
+}
+
 void HdcFile::TransferNext(CtxFile *context)
 {
     context->localName = context->taskQueue.back();
@@ -338,7 +373,7 @@ bool HdcFile::CommandDispatch(const uint16_t command, uint8_t *payload, const in
                     ctxNow.isFdOpen = false;
                 }
                 WRITE_LOG(LOG_DEBUG, "Dir = %d taskQueue size = %d", ctxNow.isDir, ctxNow.taskQueue.size());
-                if (ctxNow.isDir && (ctxNow.taskQueue.size() > 0)) {
+                if (ctxNow.isDir && walker != nullptr && TakeWalked(&ctxNow)) {
                     TransferNext(&ctxNow);
                 } else {
                     ctxNow.ioFinish = true;
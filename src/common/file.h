@@ -35,6 +35,11 @@ private:
     void TransferSummary(CtxFile *context);
     bool SetMasterParameters(CtxFile *context, const char *command, int argc, char **argv);
     bool FileModeSync(const uint16_t cmd, uint8_t *payload, const int payloadSize);
+    bool TakeWalked(CtxFile *context);
+
+    // of a directory sent, it is still walked while the first files go
+    DirWalker *walker;
+    string walkDirname;
 };
 }  // namespace Hdc
 
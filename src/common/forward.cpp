@@ -136,6 +136,10 @@ void HdcForwardBase::FreeContextCallBack(HCtxForward ctx)
         HCtxForward ctx = (HCtxForward)data;
         AdminContext(OP_REMOVE, ctx->id, nullptr);
         if (ctx != nullptr) {
+            HdcSessionStat *stat = ctx->counted ? GetSessionStat() : nullptr;
+            if (stat != nullptr) {
+                --stat->forwardActive;
+            }
             WRITE_LOG(LOG_DEBUG, "Finally to delete id:%u", ctx->id);
             delete ctx;
             ctx = nullptr;
@@ -688,6 +692,12 @@ bool HdcForwardBase::DoForwardBegin(HCtxForward ctx)
             break;
     }
     ctx->ready = true;
+    HdcSessionStat *stat = GetSessionStat();
+    if (stat != nullptr && !ctx->counted) {
+        ++stat->forwardTotal;
+        ++stat->forwardActive;
+        ctx->counted = true;
+    }
     return true;
 }
 
@@ -883,7 +893,7 @@ Finish:
             LogMsg(MSG_FAIL, "Forward parament failed");
         } else {
             LogMsg(MSG_FAIL, const_cast<char *>(sError.c_str()));
-            WRITE_LOG(LOG_WARN, const_cast<char *>(sError.c_str()));
+            WRITE_LOG(LOG_WARN, "%s", sError.c_str());
         }
     }
     return ret;
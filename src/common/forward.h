@@ -43,6 +43,7 @@ protected:
         bool checkPoint;
         bool ready;
         bool finish;
+        bool counted;  // in forwardActive of session stat
         int fd;
         uint32_t id;
         uv_tcp_t tcp;
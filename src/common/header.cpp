@@ -133,6 +133,8 @@ bool Header::IsInvalid()
 void Header::UpdataCheckSum()
 {
     uint64_t sum = 0;
+    // the field is counted as spaces, below, whatever it held
+    (void)memset_s(this->chksum, HEADER_CHKSUM_LEN, 0, HEADER_CHKSUM_LEN);
     uint8_t *tmp = reinterpret_cast<uint8_t*>(this);
     for (size_t i = 0; i < sizeof(struct Header); i++) {
         sum += tmp[i];
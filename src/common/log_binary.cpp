@@ -0,0 +1,461 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "log_binary.h"
+#include <chrono>
+#include <fstream>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+
+#include "base.h"
+
+using namespace std::chrono;
+
+namespace Hdc {
+namespace BinaryLog {
+    struct Sink {
+        std::mutex lock;
+        int fd = -1;
+        bool toCache = false;
+        uint64_t size = 0;
+        uint32_t generation = 0;  // bumped on every (re)open, so the sites are described again in the new file
+    };
+    static Sink g_sink;
+    static std::atomic<uint32_t> g_siteId = 0;
+    static thread_local bool g_inCommit = false;
+
+    uint16_t EncodeNumber(uint8_t *args, uint16_t offset, uint64_t value)
+    {
+        if (offset + sizeof(value) > MAX_RECORD_ARGS_SIZE) {
+            return offset;
+        }
+        if (memcpy_s(args + offset, MAX_RECORD_ARGS_SIZE - offset, &value, sizeof(value)) != EOK) {
+            return offset;
+        }
+        return offset + sizeof(value);
+    }
+
+    uint16_t EncodeString(uint8_t *args, uint16_t offset, const char *value)
+    {
+        uint16_t len = 0;
+        if (offset + sizeof(len) > MAX_RECORD_ARGS_SIZE) {
+            return offset;
+        }
+        size_t room = MAX_RECORD_ARGS_SIZE - offset - sizeof(len);
+        size_t valueSize = 0;
+        if (value == nullptr) {
+            len = STRING_NULL;
+        } else {
+            valueSize = std::min(strlen(value), room);
+            len = static_cast<uint16_t>(valueSize);
+        }
+        (void)memcpy_s(args + offset, MAX_RECORD_ARGS_SIZE - offset, &len, sizeof(len));
+        offset += sizeof(len);
+        if (valueSize > 0 && memcpy_s(args + offset, room, value, valueSize) != EOK) {
+            return offset;
+        }
+        return offset + valueSize;
+    }
+
+    static uint32_t GetThreadId()
+    {
+        static thread_local uint32_t threadId =
+            static_cast<uint32_t>(std::hash<std::thread::id> {}(std::this_thread::get_id()));
+        return threadId;
+    }
+
+    static bool WriteAll(int fd, const uint8_t *buf, size_t size)
+    {
+        while (size > 0) {
+            ssize_t rc = write(fd, buf, size);
+            if (rc < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            buf += rc;
+            size -= rc;
+        }
+        return true;
+    }
+
+    // call with g_sink.lock held
+    static bool OpenSink(bool toCache)
+    {
+        if (g_sink.fd >= 0) {
+            close(g_sink.fd);
+            g_sink.fd = -1;
+        }
+        string path = Base::GetTmpDir() + (toCache ? LOG_CACHE_NAME : LOG_FILE_NAME);
+        if (!toCache) {
+            Base::RollLogFile(path.c_str());
+        }
+        int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, S_IWUSR | S_IRUSR);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        g_sink.size = fstat(fd, &st) == 0 ? st.st_size : 0;
+        g_sink.fd = fd;
+        g_sink.toCache = toCache;
+        ++g_sink.generation;
+        return true;
+    }
+
+    // call with g_sink.lock held
+    static bool DescribeSite(LogSite &site, const char *types, uint8_t argCount)
+    {
+        SiteHead head = {};
+        head.magic = RECORD_MAGIC;
+        head.kind = RECORD_SITE;
+        head.id = site.id;
+        head.line = site.line;
+        head.fileSize = static_cast<uint16_t>(strlen(site.file));
+        head.fmtSize = static_cast<uint16_t>(strlen(site.fmt));
+        head.argCount = argCount;
+        string buf(reinterpret_cast<char *>(&head), sizeof(head));
+        buf.append(site.file, head.fileSize);
+        buf.append(site.fmt, head.fmtSize);
+        buf.append(types, argCount);
+        if (!WriteAll(g_sink.fd, reinterpret_cast<const uint8_t *>(buf.data()), buf.size())) {
+            return false;
+        }
+        g_sink.size += buf.size();
+        site.generation = g_sink.generation;
+        return true;
+    }
+
+    void Commit(LogSite &site, const char *types, uint8_t argCount, uint8_t level, const uint8_t *args,
+                uint16_t argSize)
+    {
+        // GetTmpDir or RollLogFile may log while the sink is locked, drop these instead of deadlock
+        if (g_inCommit) {
+            return;
+        }
+        if (site.id == 0) {
+            uint32_t expected = 0;
+            site.id.compare_exchange_strong(expected, ++g_siteId);
+        }
+        RecordHead head = {};
+        head.magic = RECORD_MAGIC;
+        head.kind = RECORD_LOG;
+        head.id = site.id;
+        head.level = level;
+        head.argSize = argSize;
+        head.timeUs = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+        head.threadId = GetThreadId();
+
+        g_inCommit = true;
+        std::unique_lock<std::mutex> lock(g_sink.lock);
+        bool toCache = Base::GetLogCache();
+        bool needRoll = !toCache && g_sink.size >= LOG_FILE_MAX_SIZE;
+        if ((g_sink.fd < 0 || g_sink.toCache != toCache || needRoll) && !OpenSink(toCache)) {
+            g_inCommit = false;
+            return;
+        }
+        if (site.generation != g_sink.generation && !DescribeSite(site, types, argCount)) {
+            g_inCommit = false;
+            return;
+        }
+        uint8_t record[sizeof(head) + MAX_RECORD_ARGS_SIZE];
+        (void)memcpy_s(record, sizeof(record), &head, sizeof(head));
+        if (argSize > 0) {
+            (void)memcpy_s(record + sizeof(head), sizeof(record) - sizeof(head), args, argSize);
+        }
+        if (WriteAll(g_sink.fd, record, sizeof(head) + argSize)) {
+            g_sink.size += sizeof(head) + argSize;
+        }
+        g_inCommit = false;
+    }
+
+    // ---------------------------------------- decoder ----------------------------------------
+    struct SiteInfo {
+        string file;
+        uint32_t line;
+        string fmt;
+        string types;
+    };
+
+    struct ArgReader {
+        const uint8_t *args;
+        uint16_t size;
+        uint16_t offset;
+        const string &types;
+        size_t index;
+
+        bool Next(char &type, uint64_t &number, string &str)
+        {
+            if (index >= types.size()) {
+                return false;
+            }
+            type = types[index++];
+            if (type == ARG_STRING) {
+                uint16_t len = 0;
+                if (offset + sizeof(len) > size) {
+                    return false;
+                }
+                (void)memcpy_s(&len, sizeof(len), args + offset, sizeof(len));
+                offset += sizeof(len);
+                if (len == STRING_NULL) {
+                    str = "(null)";
+                    return true;
+                }
+                len = std::min<uint16_t>(len, size - offset);
+                str.assign(reinterpret_cast<const char *>(args + offset), len);
+                offset += len;
+                return true;
+            }
+            if (offset + sizeof(number) > size) {
+                return false;
+            }
+            (void)memcpy_s(&number, sizeof(number), args + offset, sizeof(number));
+            offset += sizeof(number);
+            return true;
+        }
+    };
+
+    // format one conversion spec, like '%-08.3lu', with the raw argument
+    static void FormatSpec(string &out, string spec, char conv, const string &lengthMod, char type, uint64_t number,
+                           const string &str)
+    {
+        char buf[BUF_SIZE_DEFAULT] = { 0 };
+        int rc = -1;
+        double d = 0;
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                int64_t v = static_cast<int64_t>(number);
+                if (lengthMod.empty()) {
+                    v = static_cast<int>(v);
+                } else if (lengthMod == "h") {
+                    v = static_cast<short>(v);
+                } else if (lengthMod == "hh") {
+                    v = static_cast<signed char>(v);
+                }
+                spec += "ll";
+                spec += conv;
+                rc = snprintf_s(buf, sizeof(buf), sizeof(buf) - 1, spec.c_str(), static_cast<long long>(v));
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o': {
+                uint64_t v = number;
+                if (lengthMod.empty()) {
+                    v = static_cast<unsigned int>(v);
+                } else if (lengthMod == "h") {
+                    v = static_cast<unsigned short>(v);
+                } else if (lengthMod == "hh") {
+                    v = static_cast<unsigned char>(v);
+                }
+                spec += "ll";
+                spec += conv;
+                rc = snprintf_s(buf, sizeof(buf), sizeof(buf) - 1, spec.c_str(), static_cast<unsigned long long>(v));
+                break;
+            }
+            case 'c':
+                spec += conv;
+                rc = snprintf_s(buf, sizeof(buf), sizeof(buf) - 1, spec.c_str(), static_cast<int>(number));
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                (void)memcpy_s(&d, sizeof(d), &number, sizeof(number));
+                spec += conv;
+                rc = snprintf_s(buf, sizeof(buf), sizeof(buf) - 1, spec.c_str(), d);
+                break;
+            case 'p':
+                spec += conv;
+                rc = snprintf_s(buf, sizeof(buf), sizeof(buf) - 1, spec.c_str(), reinterpret_cast<void *>(number));
+                break;
+            case 's':
+                if (type != ARG_STRING) {
+                    out += "(?)";
+                    return;
+                }
+                spec += conv;
+                if (spec == "%s") {
+                    out += str;
+                    return;
+                }
+                rc = snprintf_s(buf, sizeof(buf), sizeof(buf) - 1, spec.c_str(), str.c_str());
+                break;
+            default:
+                break;
+        }
+        if (rc > 0) {
+            out.append(buf, rc);
+        }
+    }
+
+    static string FormatMessage(const SiteInfo &site, const uint8_t *args, uint16_t argSize)
+    {
+        const string &fmt = site.fmt;
+        ArgReader reader = { args, argSize, 0, site.types, 0 };
+        string out;
+        size_t i = 0;
+        while (i < fmt.size()) {
+            if (fmt[i] != '%') {
+                out += fmt[i++];
+                continue;
+            }
+            if (i + 1 < fmt.size() && fmt[i + 1] == '%') {
+                out += '%';
+                i += 2;
+                continue;
+            }
+            string spec = "%";
+            ++i;
+            while (i < fmt.size() && strchr("-+ #0123456789.*", fmt[i]) != nullptr) {
+                spec += fmt[i++];
+            }
+            string lengthMod;
+            while (i < fmt.size() && strchr("hljztLq", fmt[i]) != nullptr) {
+                lengthMod += fmt[i++];
+            }
+            if (i >= fmt.size()) {
+                break;
+            }
+            char conv = fmt[i++];
+            char type = 0;
+            uint64_t number = 0;
+            string str;
+            // '*' width and precision are not expanded, just skip their arguments
+            for (size_t n = std::count(spec.begin(), spec.end(), '*'); n > 0; --n) {
+                reader.Next(type, number, str);
+                spec.erase(spec.find('*'), 1);
+            }
+            if (!reader.Next(type, number, str)) {
+                out += "(?)";
+                continue;
+            }
+            FormatSpec(out, spec, conv, lengthMod, type, number, str);
+        }
+        return out;
+    }
+
+    static string FormatTime(uint64_t timeUs)
+    {
+        time_t seconds = static_cast<time_t>(timeUs / 1000000);
+        std::tm *tim = std::localtime(&seconds);
+        char buffer[TIME_BUF_SIZE] = { 0 };
+        if (tim == nullptr || strftime(buffer, TIME_BUF_SIZE, "%Y-%m-%d %H:%M:%S", tim) == 0) {
+            return std::to_string(timeUs);
+        }
+        return Base::StringFormat("%s.%03u", buffer, static_cast<uint32_t>(timeUs / 1000 % 1000));
+    }
+
+    static const char *LevelString(uint8_t level)
+    {
+        switch (level) {
+            case LOG_FATAL:
+                return "F";
+            case LOG_INFO:
+                return "I";
+            case LOG_WARN:
+                return "W";
+            case LOG_DEBUG:
+                return "D";
+            default:
+                return "A";
+        }
+    }
+
+    int DecodeFile(const std::string &path, FILE *out)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            Base::PrintMessage("Open log file %s failed", path.c_str());
+            return ERR_FILE_OPEN;
+        }
+        string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(data.data());
+        size_t size = data.size();
+        size_t pos = 0;
+        std::unordered_map<uint32_t, SiteInfo> sites;
+        while (pos < size) {
+            if (p[pos] != RECORD_MAGIC) {
+                // text record written by PrintLogEx, copy the line as it is
+                size_t end = pos;
+                while (end < size && p[end] != '\n' && p[end] != RECORD_MAGIC) {
+                    ++end;
+                }
+                end += (end < size && p[end] == '\n') ? 1 : 0;
+                fwrite(p + pos, 1, end - pos, out);
+                pos = end;
+                continue;
+            }
+            if (pos + 2 > size) {
+                break;
+            }
+            if (p[pos + 1] == RECORD_SITE) {
+                SiteHead head;
+                if (pos + sizeof(head) > size) {
+                    break;
+                }
+                (void)memcpy_s(&head, sizeof(head), p + pos, sizeof(head));
+                size_t total = sizeof(head) + head.fileSize + head.fmtSize + head.argCount;
+                if (pos + total > size) {
+                    break;
+                }
+                const char *body = reinterpret_cast<const char *>(p + pos + sizeof(head));
+                SiteInfo &site = sites[head.id];
+                site.file.assign(body, head.fileSize);
+                site.line = head.line;
+                site.fmt.assign(body + head.fileSize, head.fmtSize);
+                site.types.assign(body + head.fileSize + head.fmtSize, head.argCount);
+                pos += total;
+            } else if (p[pos + 1] == RECORD_LOG) {
+                RecordHead head;
+                if (pos + sizeof(head) > size) {
+                    break;
+                }
+                (void)memcpy_s(&head, sizeof(head), p + pos, sizeof(head));
+                if (pos + sizeof(head) + head.argSize > size) {
+                    break;
+                }
+                auto it = sites.find(head.id);
+                if (it == sites.end()) {
+                    fprintf(out, "[%s][%s][%x] <unknown site %u>\n", LevelString(head.level),
+                            FormatTime(head.timeUs).c_str(), head.threadId, head.id);
+                } else {
+                    string file = it->second.file;
+                    string msg = FormatMessage(it->second, p + pos + sizeof(head), head.argSize);
+                    const char *sep = (!msg.empty() && msg.back() == '\n') ? "" : "\n";
+                    fprintf(out, "[%s][%s][%x][%s:%u] %s%s", LevelString(head.level), FormatTime(head.timeUs).c_str(),
+                            head.threadId, Base::GetFileNameAny(file).c_str(), it->second.line, msg.c_str(), sep);
+                }
+                pos += sizeof(head) + head.argSize;
+            } else {
+                // not a record head, resync at the next byte
+                ++pos;
+            }
+        }
+        fflush(out);
+        if (pos < size) {
+            Base::PrintMessage("Log file %s is truncated at offset %zu", path.c_str(), pos);
+            return ERR_BUF_CHECK;
+        }
+        return RET_SUCCESS;
+    }
+}  // namespace BinaryLog
+}  // namespace Hdc
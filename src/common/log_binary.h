@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_LOG_BINARY_H
+#define HDC_LOG_BINARY_H
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <securec.h>
+#include <string>
+#include <type_traits>
+
+// Binary log mode (build with -DHDC_LOG_BINARY). WRITE_LOG keeps the format string, source position and argument
+// types in a static site at compile time, and at runtime only the raw arguments are appended to the log file.
+// A site is described once per log file (a 'D' record) and then referenced by id from every 'R' record, so the
+// file stays self-contained across roll and restart. Records start with 0xFF, which never appears in UTF-8 text,
+// so text and binary records can share one hdc.log and 'hdc -L hdc.log' decodes both back into text.
+namespace Hdc {
+namespace BinaryLog {
+    constexpr uint8_t RECORD_MAGIC = 0xFF;
+    constexpr uint8_t RECORD_SITE = 'D';
+    constexpr uint8_t RECORD_LOG = 'R';
+    constexpr uint16_t MAX_RECORD_ARGS_SIZE = 4096;  // the same as the text buf of PrintLogEx
+    constexpr uint16_t STRING_NULL = 0xFFFF;
+
+    constexpr char ARG_SIGNED = 'i';
+    constexpr char ARG_UNSIGNED = 'u';
+    constexpr char ARG_DOUBLE = 'f';
+    constexpr char ARG_STRING = 's';
+    constexpr char ARG_POINTER = 'p';
+
+#pragma pack(push)
+#pragma pack(1)
+    // followed by file name, format string, and argCount type codes
+    struct SiteHead {
+        uint8_t magic;
+        uint8_t kind;
+        uint32_t id;
+        uint32_t line;
+        uint16_t fileSize;
+        uint16_t fmtSize;
+        uint8_t argCount;
+    };
+    // followed by argSize bytes of arguments, 8 bytes for number, 2 bytes length + data for string
+    struct RecordHead {
+        uint8_t magic;
+        uint8_t kind;
+        uint32_t id;
+        uint8_t level;
+        uint16_t argSize;
+        uint64_t timeUs;
+        uint32_t threadId;
+    };
+#pragma pack(pop)
+
+    // one per WRITE_LOG call site, constant initialized, id is assigned at the first write
+    struct LogSite {
+        const char *file;
+        uint32_t line;
+        const char *fmt;
+        std::atomic<uint32_t> id;
+        std::atomic<uint32_t> generation;  // sink generation in which the site was last described
+    };
+
+    template<typename T>
+    constexpr char ArgCode()
+    {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, char *> || std::is_same_v<U, const char *>) {
+            return ARG_STRING;
+        } else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>) {
+            return ARG_POINTER;
+        } else if constexpr (std::is_floating_point_v<U>) {
+            return ARG_DOUBLE;
+        } else if constexpr (std::is_enum_v<U>) {
+            return std::is_signed_v<std::underlying_type_t<U>> ? ARG_SIGNED : ARG_UNSIGNED;
+        } else {
+            static_assert(std::is_integral_v<U>, "WRITE_LOG argument type is not supported by binary log");
+            return std::is_signed_v<U> ? ARG_SIGNED : ARG_UNSIGNED;
+        }
+    }
+
+    uint16_t EncodeString(uint8_t *args, uint16_t offset, const char *value);
+    uint16_t EncodeNumber(uint8_t *args, uint16_t offset, uint64_t value);
+    void Commit(LogSite &site, const char *types, uint8_t argCount, uint8_t level, const uint8_t *args,
+                uint16_t argSize);
+    // return 0 if the whole file is decoded, else RetErrCode
+    int DecodeFile(const std::string &path, FILE *out);
+
+    template<typename T>
+    uint16_t EncodeArg(uint8_t *args, uint16_t offset, T value)
+    {
+        constexpr char code = ArgCode<T>();
+        if constexpr (code == ARG_STRING) {
+            return EncodeString(args, offset, value);
+        } else if constexpr (code == ARG_POINTER) {
+            return EncodeNumber(args, offset, reinterpret_cast<uintptr_t>(value));
+        } else if constexpr (code == ARG_DOUBLE) {
+            double d = static_cast<double>(value);
+            uint64_t raw = 0;
+            static_assert(sizeof(raw) == sizeof(d), "double must be 8 bytes");
+            (void)memcpy_s(&raw, sizeof(raw), &d, sizeof(d));
+            return EncodeNumber(args, offset, raw);
+        } else if constexpr (code == ARG_SIGNED) {
+            return EncodeNumber(args, offset, static_cast<uint64_t>(static_cast<int64_t>(value)));
+        } else {
+            return EncodeNumber(args, offset, static_cast<uint64_t>(value));
+        }
+    }
+
+    template<typename... Args>
+    void Write(LogSite &site, uint8_t level, Args... values)
+    {
+        static constexpr char types[] = { ArgCode<Args>()..., '\0' };
+        uint8_t args[MAX_RECORD_ARGS_SIZE];
+        uint16_t size = 0;
+        (void)std::initializer_list<int> { (size = EncodeArg(args, size, values), 0)... };
+        Commit(site, types, sizeof...(Args), level, args, size);
+    }
+}  // namespace BinaryLog
+}  // namespace Hdc
+
+#endif  // HDC_LOG_BINARY_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "metrics.h"
+#include <chrono>
+
+#include "base.h"
+
+using namespace std::chrono;
+
+namespace Hdc {
+namespace Metrics {
+    constexpr double PERCENTILE_MID = 50.0;
+    constexpr double PERCENTILE_HIGH = 90.0;
+    constexpr double PERCENTILE_TAIL = 99.0;
+    constexpr double US_PER_MS = 1000.0;
+    constexpr double US_PER_SEC = 1000000.0;
+
+    uint64_t NowUs()
+    {
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint32_t Histogram::BucketIndex(uint64_t value)
+    {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<uint32_t>(value);
+        }
+        uint32_t msb = 63 - __builtin_clzll(value);  // 63: highest bit index of uint64_t
+        if (msb > MAX_MAGNITUDE) {
+            return BUCKET_COUNT - 1;
+        }
+        uint32_t shift = msb - SUB_BUCKET_BITS;
+        // sub is in [SUB_BUCKET_COUNT, 2 * SUB_BUCKET_COUNT)
+        uint32_t sub = static_cast<uint32_t>(value >> shift);
+        uint32_t index = (shift + 1) * SUB_BUCKET_COUNT + sub - SUB_BUCKET_COUNT;
+        return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+    }
+
+    uint64_t Histogram::BucketValue(uint32_t index)
+    {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        uint32_t shift = index / SUB_BUCKET_COUNT - 1;
+        uint64_t sub = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void Histogram::Record(uint64_t value)
+    {
+        counts[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t old = max.load(std::memory_order_relaxed);
+        while (value > old && !max.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Histogram::Mean() const
+    {
+        uint64_t n = Count();
+        return n > 0 ? sum.load(std::memory_order_relaxed) / n : 0;
+    }
+
+    uint64_t Histogram::Percentile(double percentile) const
+    {
+        uint64_t n = Count();
+        if (n == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * n + 0.5);  // 100: percent
+        if (rank == 0) {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(BucketValue(i), Max());
+            }
+        }
+        return Max();
+    }
+
+    static string HistogramToString(const Histogram &h, bool json)
+    {
+        if (json) {
+            return Base::StringFormat("{\"count\":%" PRIu64 ",\"mean\":%" PRIu64 ",\"p50\":%" PRIu64
+                                      ",\"p90\":%" PRIu64 ",\"p99\":%" PRIu64 ",\"max\":%" PRIu64 "}",
+                                      h.Count(), h.Mean(), h.Percentile(PERCENTILE_MID),
+                                      h.Percentile(PERCENTILE_HIGH), h.Percentile(PERCENTILE_TAIL), h.Max());
+        }
+        return Base::StringFormat("n:%" PRIu64 " mean:%" PRIu64 " p50:%" PRIu64 " p90:%" PRIu64 " p99:%" PRIu64
+                                  " max:%" PRIu64, h.Count(), h.Mean(), h.Percentile(PERCENTILE_MID),
+                                  h.Percentile(PERCENTILE_HIGH), h.Percentile(PERCENTILE_TAIL), h.Max());
+    }
+
+    static string JsonString(const string &s)
+    {
+        string ret = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                ret.push_back('\\');
+            } else if (static_cast<unsigned char>(c) < 0x20) {  // 0x20: first printable char
+                continue;
+            }
+            ret.push_back(c);
+        }
+        ret.push_back('"');
+        return ret;
+    }
+
+    // percent of part in total, 0 for no total
+    static double Ratio(uint64_t part, uint64_t total)
+    {
+        return total > 0 ? part * 100.0 / total : 0;  // 100.0: percent
+    }
+
+    string SessionToString(HSession hSession, bool json)
+    {
+        HdcSessionStat &stat = hSession->stat;
+        double upTime = (NowUs() - stat.beginTime) / US_PER_SEC;
+        uint64_t transferTime = stat.transferTime;
+        double transferRate = transferTime > 0 ? static_cast<double>(stat.transferBytes) / transferTime : 0;  // kB/s
+        const char *status = hSession->handshakeOK ? "Connected" : "Handshaking";
+        if (json) {
+            return Base::StringFormat("{\"sessionId\":%u,\"connectKey\":%s,\"status\":\"%s\",\"upTime\":%.3f,"
+                "\"sendBytes\":%" PRIu64 ",\"sendPackets\":%" PRIu64 ",\"recvBytes\":%" PRIu64
+                ",\"recvPackets\":%" PRIu64 ",\"queuedSendBytes\":%" PRIu64 ",\"handshakeMs\":%.3f,"
+                "\"authMs\":%.3f,\"sendLatencyUs\":%s,\"recvLatencyUs\":%s,\"transferCount\":%" PRIu64
+                ",\"transferBytes\":%" PRIu64 ",\"transferRateKBps\":%.2f,\"forwardActive\":%u,"
+                "\"forwardTotal\":%" PRIu64 ",\"features\":\"%s\",\"compressRawBytes\":%" PRIu64
+                ",\"compressBytes\":%" PRIu64 ",\"compressUs\":%" PRIu64 ",\"decompressRawBytes\":%" PRIu64
+                ",\"decompressBytes\":%" PRIu64 ",\"decompressUs\":%" PRIu64 "}",
+                hSession->sessionId, JsonString(hSession->connectKey).c_str(), status, upTime,
+                uint64_t(stat.dataSendBytes), uint64_t(stat.sendPackets), uint64_t(stat.dataRecvBytes),
+                uint64_t(stat.recvPackets), uint64_t(stat.queuedSendBytes), stat.handshakeTime / US_PER_MS,
+                stat.authTime / US_PER_MS, HistogramToString(stat.sendLatency, true).c_str(),
+                HistogramToString(stat.recvLatency, true).c_str(), uint64_t(stat.transferCount),
+                uint64_t(stat.transferBytes), transferRate, uint32_t(stat.forwardActive),
+                uint64_t(stat.forwardTotal), HdcSessionBase::FeatureToString(hSession->features).c_str(),
+                uint64_t(stat.compressRawBytes), uint64_t(stat.compressBytes), uint64_t(stat.compressTime),
+                uint64_t(stat.decompressRawBytes), uint64_t(stat.decompressBytes), uint64_t(stat.decompressTime));
+        }
+        string compress;
+        if (hSession->features & FEATURE_LZ4) {
+            compress = Base::StringFormat("    lz4 send:%" PRIu64 "B->%" PRIu64 "B %.1f%% %.1fms"
+                " recv:%" PRIu64 "B->%" PRIu64 "B %.1f%% %.1fms\n",
+                uint64_t(stat.compressRawBytes), uint64_t(stat.compressBytes),
+                Ratio(stat.compressBytes, stat.compressRawBytes), stat.compressTime / US_PER_MS,
+                uint64_t(stat.decompressBytes), uint64_t(stat.decompressRawBytes),
+                Ratio(stat.decompressBytes, stat.decompressRawBytes), stat.decompressTime / US_PER_MS);
+        }
+        return Base::StringFormat("Session %u %s %s up:%.1fs\n"
+            "    send:%" PRIu64 "B/%" PRIu64 "pkt recv:%" PRIu64 "B/%" PRIu64 "pkt queued:%" PRIu64 "B"
+            " handshake:%.1fms auth:%.1fms\n"
+            "    send latency(us) %s\n"
+            "    recv latency(us) %s\n"
+            "    transfer:%" PRIu64 " %" PRIu64 "B %.2fkB/s forward:%u/%" PRIu64 "\n%s",
+            hSession->sessionId, hSession->connectKey.c_str(), status, upTime,
+            uint64_t(stat.dataSendBytes), uint64_t(stat.sendPackets), uint64_t(stat.dataRecvBytes),
+            uint64_t(stat.recvPackets), uint64_t(stat.queuedSendBytes), stat.handshakeTime / US_PER_MS,
+            stat.authTime / US_PER_MS, HistogramToString(stat.sendLatency, false).c_str(),
+            HistogramToString(stat.recvLatency, false).c_str(), uint64_t(stat.transferCount),
+            uint64_t(stat.transferBytes), transferRate, uint32_t(stat.forwardActive), uint64_t(stat.forwardTotal),
+            compress.c_str());
+    }
+
+    string ChannelToString(HChannel hChannel, bool json)
+    {
+        HdcChannelStat &stat = hChannel->stat;
+        double upTime = (NowUs() - stat.beginTime) / US_PER_SEC;
+        // libuv write queue, the channel is written by the main loop or the session work thread
+        uint64_t queued = hChannel->hWorkTCP.write_queue_size + hChannel->hChildWorkTCP.write_queue_size;
+        if (json) {
+            return Base::StringFormat("{\"channelId\":%u,\"sessionId\":%u,\"connectKey\":%s,\"upTime\":%.3f,"
+                "\"sendBytes\":%" PRIu64 ",\"sendPackets\":%" PRIu64 ",\"recvBytes\":%" PRIu64
+                ",\"recvPackets\":%" PRIu64 ",\"queuedSendBytes\":%" PRIu64 ",\"recvLatencyUs\":%s}",
+                hChannel->channelId, hChannel->targetSessionId, JsonString(hChannel->connectKey).c_str(), upTime,
+                uint64_t(stat.dataSendBytes), uint64_t(stat.sendPackets), uint64_t(stat.dataRecvBytes),
+                uint64_t(stat.recvPackets), queued, HistogramToString(stat.recvLatency, true).c_str());
+        }
+        return Base::StringFormat("Channel %u session:%u %s up:%.1fs\n"
+            "    send:%" PRIu64 "B/%" PRIu64 "pkt recv:%" PRIu64 "B/%" PRIu64 "pkt queued:%" PRIu64 "B\n"
+            "    recv latency(us) %s\n",
+            hChannel->channelId, hChannel->targetSessionId, hChannel->connectKey.c_str(), upTime,
+            uint64_t(stat.dataSendBytes), uint64_t(stat.sendPackets), uint64_t(stat.dataRecvBytes),
+            uint64_t(stat.recvPackets), queued, HistogramToString(stat.recvLatency, false).c_str());
+    }
+}  // namespace Metrics
+}  // namespace Hdc
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_METRICS_H
+#define HDC_METRICS_H
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Per-session and per-channel counters of the server, read by 'hdc stat'. All counters are relaxed atomics updated
+// on the io path, a report is a snapshot and may be slightly inconsistent between fields.
+namespace Hdc {
+struct HdcSession;
+struct HdcChannel;
+
+namespace Metrics {
+    // HDR-style histogram: values below SUB_BUCKET_COUNT are exact, above that every power of two is split into
+    // SUB_BUCKET_COUNT linear buckets, so the relative error is less than 1/SUB_BUCKET_COUNT
+    constexpr uint8_t SUB_BUCKET_BITS = 4;
+    constexpr uint32_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    constexpr uint8_t MAX_MAGNITUDE = 40;  // values above 2^40 us (12 days) go to the last bucket
+    constexpr uint32_t BUCKET_COUNT = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 2) * SUB_BUCKET_COUNT;
+    const std::string ENV_STAT_DUMP = "OHOS_HDC_STAT_DUMP";  // file to dump the server stat to periodically
+    constexpr uint32_t DEFAULT_DUMP_INTERVAL = 10;           // seconds
+
+    uint64_t NowUs();
+
+    class Histogram {
+    public:
+        void Record(uint64_t value);
+        uint64_t Count() const
+        {
+            return total.load(std::memory_order_relaxed);
+        }
+        uint64_t Max() const
+        {
+            return max.load(std::memory_order_relaxed);
+        }
+        uint64_t Mean() const;
+        // highest value equivalent to the recorded value at the percentile, 0 < percentile <= 100
+        uint64_t Percentile(double percentile) const;
+        static uint32_t BucketIndex(uint64_t value);
+        static uint64_t BucketValue(uint32_t index);
+
+    private:
+        std::atomic<uint64_t> counts[BUCKET_COUNT] = {};
+        std::atomic<uint64_t> total = 0;
+        std::atomic<uint64_t> sum = 0;
+        std::atomic<uint64_t> max = 0;
+    };
+
+    // record the lifetime of the scope into histogram in microseconds
+    class LatencyScope {
+    public:
+        explicit LatencyScope(Histogram &histogramIn) : histogram(histogramIn), begin(NowUs())
+        {
+        }
+        ~LatencyScope()
+        {
+            histogram.Record(NowUs() - begin);
+        }
+
+    private:
+        Histogram &histogram;
+        uint64_t begin;
+    };
+
+    // text lines or a json object for one session/channel
+    std::string SessionToString(HdcSession *hSession, bool json);
+    std::string ChannelToString(HdcChannel *hChannel, bool json);
+}  // namespace Metrics
+}  // namespace Hdc
+
+#endif  // HDC_METRICS_H
@@ -20,6 +20,7 @@
 #include <map>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <variant>
 #include <vector>
@@ -716,6 +717,88 @@ namespace SerialStruct {
             }
             return true;
         }
+
+        // Upper bound of the encoded size, computed from the Descriptor at compile time. String, repeated, map and
+        // oneof fields are not bounded, so is a message containing any of them.
+        constexpr size_t UNBOUNDED_SIZE = SIZE_MAX;
+        constexpr size_t VARINT32_MAX_SIZE = 5;
+        constexpr size_t VARINT64_MAX_SIZE = 10;
+
+        constexpr size_t VarintSize(uint64_t value)
+        {
+            size_t size = 1;
+            while (value >= 0b1000'0000) {
+                value >>= 7;  // 7:varint bits per byte
+                ++size;
+            }
+            return size;
+        }
+
+        constexpr size_t AddSize(size_t a, size_t b)
+        {
+            return (a == UNBOUNDED_SIZE || b == UNBOUNDED_SIZE) ? UNBOUNDED_SIZE : a + b;
+        }
+
+        template<class Message> struct MessageMaxSize;
+
+        template<class T> struct ClassMaxSize {
+            // nested message, length delimited
+            static constexpr size_t value = AddSize(VARINT32_MAX_SIZE,
+                MessageMaxSize<std::decay_t<decltype(Descriptor<T>::type())>>::value);
+        };
+        template<> struct ClassMaxSize<std::string> {
+            static constexpr size_t value = UNBOUNDED_SIZE;
+        };
+        template<class T> struct ClassMaxSize<std::vector<T>> {
+            static constexpr size_t value = UNBOUNDED_SIZE;
+        };
+        template<class T> struct ClassMaxSize<std::optional<T>> {
+            static constexpr size_t value = UNBOUNDED_SIZE;
+        };
+        template<class Key, class Value> struct ClassMaxSize<std::map<Key, Value>> {
+            static constexpr size_t value = UNBOUNDED_SIZE;
+        };
+
+        template<class T, uint32_t Flags, class Enable = void> struct ValueMaxSize {
+            static constexpr size_t value = UNBOUNDED_SIZE;
+        };
+        // bool, uint8_t and uint16_t go as uint32_t, int32_t as its uint32_t bits
+        template<class T, uint32_t Flags>
+        struct ValueMaxSize<T, Flags, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>> {
+            static constexpr bool WIDE = sizeof(T) > sizeof(uint32_t);
+            static constexpr size_t value = (Flags & flags::f) ? (WIDE ? sizeof(uint64_t) : sizeof(uint32_t))
+                                                               : (WIDE ? VARINT64_MAX_SIZE : VARINT32_MAX_SIZE);
+        };
+        template<class T, uint32_t Flags>
+        struct ValueMaxSize<T, Flags, std::enable_if_t<std::is_floating_point_v<T>>> {
+            static constexpr size_t value = sizeof(T);
+        };
+        template<class T, uint32_t Flags> struct ValueMaxSize<T, Flags, std::enable_if_t<std::is_class_v<T>>> {
+            static constexpr size_t value = ClassMaxSize<T>::value;
+        };
+
+        template<class Field> struct FieldMaxSize {
+            // oneof and map
+            static constexpr size_t value = UNBOUNDED_SIZE;
+        };
+        template<uint32_t Tag, class MemPtrT, MemPtrT MemPtr, uint32_t Flags>
+        struct FieldMaxSize<FieldImpl<Tag, MemPtrT, MemPtr, Flags>> {
+            using MemberType = typename FieldImpl<Tag, MemPtrT, MemPtr, Flags>::MemberType;
+            // 3:tag type offset, 0b0111:largest wire type
+            static constexpr size_t value = AddSize(VarintSize((static_cast<uint64_t>(Tag) << 3) | 0b0111),
+                ValueMaxSize<MemberType, Flags>::value);
+        };
+
+        template<class... Field> constexpr size_t SumFieldMaxSize()
+        {
+            size_t size = 0;
+            ((size = AddSize(size, FieldMaxSize<Field>::value)), ...);
+            return size;
+        }
+
+        template<class... Field> struct MessageMaxSize<MessageImpl<Field...>> {
+            static constexpr size_t value = SumFieldMaxSize<Field...>();
+        };
     }
 
     template<class T, class Enable> struct Serializer {
@@ -1241,6 +1324,78 @@ namespace SerialStruct {
         const std::string &_in;
         size_t _pos;
     };
+
+    // write into a caller buffer, nothing more is written once it is full
+    struct BufferWriter : public Writer {
+        BufferWriter(uint8_t *buf, size_t size)
+            : _buf(buf), _size(size), _pos(0), _overflow(false)
+        {
+        }
+
+        void Write(const void *bytes, size_t size) override
+        {
+            if (_overflow || size > _size - _pos) {
+                _overflow = true;
+                return;
+            }
+            // tags and small varints are the most, not worth a memcpy_s call
+            if (size == 1) {
+                _buf[_pos++] = *reinterpret_cast<const uint8_t *>(bytes);
+                return;
+            }
+            if (memcpy_s(_buf + _pos, _size - _pos, bytes, size) != EOK) {
+                _overflow = true;
+                return;
+            }
+            _pos += size;
+        }
+
+        size_t Size() const
+        {
+            return _pos;
+        }
+
+        bool Overflow() const
+        {
+            return _overflow;
+        }
+
+    private:
+        uint8_t *_buf;
+        size_t _size;
+        size_t _pos;
+        bool _overflow;
+    };
+
+    struct StringViewReader : public reader {
+        StringViewReader(std::string_view in)
+            : _in(in), _pos(0)
+        {
+        }
+
+        size_t Read(void *bytes, size_t size) override
+        {
+            size_t readSize = std::min(size, _in.size() - _pos);
+            if (readSize == 0) {
+                return 0;
+            }
+            // varints are read byte by byte
+            if (readSize == 1) {
+                *reinterpret_cast<uint8_t *>(bytes) = static_cast<uint8_t>(_in[_pos++]);
+                return 1;
+            }
+            if (memcpy_s(bytes, size, _in.data() + _pos, readSize) != EOK) {
+                return 0;
+            }
+            _pos += readSize;
+            return readSize;
+        }
+
+    private:
+        std::string_view _in;
+        size_t _pos;
+    };
+
     // mytype begin, just support base type, but really use protobuf raw type(uint32)
     template<> struct Serializer<uint8_t> {
         static void Serialize(uint32_t tag, uint8_t value, FlagsType<>, Writer &out, bool force = false)
@@ -1319,6 +1474,27 @@ namespace SerialStruct {
         StringReader stringIn(in);
         return SerialDetail::ReadMessage(value, MessageType<T>(), stringIn);
     }
+
+    // no heap allocation but for the string and repeated fields of value
+    // return the encoded size, or -1 if bufSize is not enough
+    template<class T> int SerializeToBuffer(const T &value, uint8_t *buf, size_t bufSize)
+    {
+        BufferWriter bufferOut(buf, bufSize);
+        SerialDetail::WriteMessage(value, MessageType<T>(), bufferOut);
+        return bufferOut.Overflow() ? -1 : static_cast<int>(bufferOut.Size());
+    }
+
+    template<class T> bool ParseFromStringView(T &value, std::string_view in)
+    {
+        StringViewReader viewIn(in);
+        return SerialDetail::ReadMessage(value, MessageType<T>(), viewIn);
+    }
+
+    // upper bound of SerializeToBuffer for any value of T, UNBOUNDED_SIZE if T has a field of unbounded size
+    template<class T> constexpr size_t MaxSerializedSize()
+    {
+        return SerialDetail::MessageMaxSize<std::decay_t<decltype(Descriptor<T>::type())>>::value;
+    }
 }
 // clang-format on
 }  // Hdc
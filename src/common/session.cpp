@@ -17,8 +17,17 @@
 #include "hdc_hash_gen.h"
 #endif
 #include "serial_struct.h"
+#include "crc32c.h"
 
 namespace Hdc {
+// name of the SessionFeature bits in TAG_FEATURE
+static const std::pair<uint32_t, const char *> FEATURE_NAMES[] = {
+    { FEATURE_FIXED_HEAD, "fixhead" },
+    { FEATURE_CRC32C, "crc32c" },
+    { FEATURE_LZ4, "lz4" },
+    { FEATURE_TICKET, "ticket" },
+};
+
 HdcSessionBase::HdcSessionBase(bool serverOrDaemonIn, size_t uvThreadSize)
 {
     // print version pid
@@ -427,6 +436,7 @@ HSession HdcSessionBase::MallocSession(bool serverOrDaemon, const ConnType connT
     hSession->isDead = false;
     hSession->sessionId = ((sessionId == 0) ? GetSessionPseudoUid() : sessionId);
     hSession->serverOrDaemon = serverOrDaemon;
+    hSession->stat.beginTime = Metrics::NowUs();
     hSession->hWorkThread = uv_thread_self();
     hSession->mapTask = new(std::nothrow) map<uint32_t, HTaskInfo>();
     if (hSession->mapTask == nullptr) {
@@ -658,6 +668,28 @@ void HdcSessionBase::FreeSession(const uint32_t sessionId)
     } while (false);
 }
 
+void HdcSessionBase::EnumSession(const std::function<void(HSession hSession)> &callback)
+{
+    uv_rwlock_rdlock(&lockMapSession);
+    for (auto &v : mapSession) {
+        HSession hSession = v.second;
+        if (hSession != nullptr && !hSession->isDead) {
+            callback(hSession);
+        }
+    }
+    uv_rwlock_rdunlock(&lockMapSession);
+}
+
+bool HdcSessionBase::HasFreeSessionThread()
+{
+    // the fs and getaddrinfo requests of all loops go to the same pool
+    constexpr size_t reserveThreads = 2;
+    uv_rwlock_rdlock(&lockMapSession);
+    size_t sessions = mapSession.size();
+    uv_rwlock_rdunlock(&lockMapSession);
+    return sessions + reserveThreads < threadPoolCount;
+}
+
 HSession HdcSessionBase::AdminSession(const uint8_t op, const uint32_t sessionId, HSession hInput)
 {
     HSession hRet = nullptr;
@@ -807,15 +839,16 @@ HTaskInfo HdcSessionBase::AdminTask(const uint8_t op, HSession hSession, const u
     return hRet;
 }
 
-int HdcSessionBase::SendByProtocol(HSession hSession, uint8_t *bufPtr, const int bufLen, bool echo)
+int HdcSessionBase::SendByProtocol(HSession hSession, const uint8_t *bufPtr, const int bufLen, bool echo)
 {
     StartTraceScope("HdcSessionBase::SendByProtocol");
     if (hSession->isDead) {
-        delete[] bufPtr;
         WRITE_LOG(LOG_WARN, "SendByProtocol session dead error");
         return ERR_SESSION_NOFOUND;
     }
     int ret = 0;
+    Metrics::LatencyScope latency(hSession->stat.sendLatency);
+    hSession->stat.queuedSendBytes += bufLen;
     // switch (hSession->connType) {
     //     case CONN_TCP: {
     HdcTCPBase *pTCP = ((HdcTCPBase *)hSession->classModule);
@@ -847,11 +880,16 @@ int HdcSessionBase::SendByProtocol(HSession hSession, uint8_t *bufPtr, const int
 //         default:
 //             break;
 //     }
+    hSession->stat.queuedSendBytes -= bufLen;
+    if (ret > 0) {
+        hSession->stat.dataSendBytes += ret;
+        ++hSession->stat.sendPackets;
+    }
     return ret;
 }
 
 int HdcSessionBase::Send(const uint32_t sessionId, const uint32_t channelId, const uint16_t commandFlag,
-                         const uint8_t *data, const int dataSize)
+                         const uint8_t *data, const int dataSize, const bool compressed)
 {
     StartTraceScope("HdcSessionBase::Send");
     HSession hSession = AdminSession(OP_QUERY, sessionId, nullptr);
@@ -864,41 +902,92 @@ int HdcSessionBase::Send(const uint32_t sessionId, const uint32_t channelId, con
     protectBuf.commandFlag = commandFlag;
     protectBuf.checkSum = (ENABLE_IO_CHECKSUM && dataSize > 0) ? Base::CalcCheckSum(data, dataSize) : 0;
     protectBuf.vCode = payloadProtectStaticVcode;
-    string s = SerialStruct::SerializeToString(protectBuf);
+    PayloadHead payloadHead = {};  // need convert to big-endian
+    uint32_t features = hSession->features.load(std::memory_order_acquire);
+    uint8_t protectSerial[SerialStruct::MaxSerializedSize<PayloadProtect>()];
+    static_assert(sizeof(protectSerial) >= FIXED_PROTECT_SIZE);
+    int protectSize = FIXED_PROTECT_SIZE;
+    if (features & FEATURE_FIXED_HEAD) {
+        Base::StoreLe32(protectSerial, protectBuf.channelId);
+        Base::StoreLe32(protectSerial + sizeof(uint32_t), protectBuf.commandFlag);
+        protectSerial[sizeof(uint32_t) * 2] = protectBuf.checkSum;  // 2: after channelId and commandFlag
+        protectSerial[sizeof(uint32_t) * 2 + 1] = protectBuf.vCode;
+        payloadHead.reserve[0] |= PAYLOAD_OPTION_FIXED_PROTECT;
+    } else {
+        protectSize = SerialStruct::SerializeToBuffer(protectBuf, protectSerial, sizeof(protectSerial));
+    }
+    if (protectSize < 0) {
+        WRITE_LOG(LOG_WARN, "send serialize protect err");
+        return ERR_BUF_COPY;
+    }
     // reserve for encrypt here
     // xx-encrypt
+    bool crc32c = features & FEATURE_CRC32C;
+    int headSize = protectSize;
+    const uint8_t *wireData = data;
+    int wireSize = dataSize;
+    // held until the packet is written, so that the peer decompresses in the same order
+    std::unique_lock<std::mutex> compressLock;
+    if ((features & FEATURE_LZ4) && !compressed) {
+        compressLock = std::unique_lock<std::mutex>(hSession->compress->sendMutex);
+        int compressSize = CompressPayload(hSession, commandFlag, data, dataSize);
+        if (compressSize < 0) {
+            return ERR_BUF_COPY;
+        }
+        if (compressSize > 0) {
+            wireData = hSession->compress->sendBuf.data();
+            wireSize = compressSize;
+            headSize += RAW_SIZE_SIZE;
+            payloadHead.reserve[0] |= PAYLOAD_OPTION_LZ4;
+        }
+    }
+    if (crc32c) {
+        headSize += CRC32C_SIZE;
+        payloadHead.reserve[0] |= PAYLOAD_OPTION_CRC32C;
+    }
 
-    PayloadHead payloadHead = {};  // need convert to big-endian
     payloadHead.flag[0] = PACKET_FLAG.at(0);
     payloadHead.flag[1] = PACKET_FLAG.at(1);
     payloadHead.protocolVer = VER_PROTOCOL;
-    payloadHead.headSize = htons(s.size());
-    payloadHead.dataSize = htonl(dataSize);
-    int finalBufSize = sizeof(PayloadHead) + s.size() + dataSize;
-    uint8_t *finayBuf = new(std::nothrow) uint8_t[finalBufSize]();
-    if (finayBuf == nullptr) {
-        WRITE_LOG(LOG_WARN, "send allocmem err");
-        return ERR_BUF_ALLOC;
+    payloadHead.headSize = htons(headSize);
+    payloadHead.dataSize = htonl(wireSize);
+    int finalBufSize = sizeof(PayloadHead) + headSize + wireSize;
+    // the write is done when SendByProtocol returns, so a thread builds each packet in the same buffer, which only
+    // grows, to the largest packet it has sent. every byte is copied below, no need to zero it
+    static thread_local vector<uint8_t> packetBuf;
+    if (packetBuf.size() < static_cast<size_t>(finalBufSize)) {
+        packetBuf.resize(finalBufSize);
     }
+    uint8_t *finayBuf = packetBuf.data();
     bool bufRet = false;
     do {
         if (memcpy_s(finayBuf, sizeof(PayloadHead), reinterpret_cast<uint8_t *>(&payloadHead), sizeof(PayloadHead))) {
             WRITE_LOG(LOG_WARN, "send copyhead err for dataSize:%d", dataSize);
             break;
         }
-        if (memcpy_s(finayBuf + sizeof(PayloadHead), s.size(),
-                     reinterpret_cast<uint8_t *>(const_cast<char *>(s.c_str())), s.size())) {
+        if (memcpy_s(finayBuf + sizeof(PayloadHead), protectSize, protectSerial, protectSize)) {
             WRITE_LOG(LOG_WARN, "send copyProtbuf err for dataSize:%d", dataSize);
             break;
         }
-        if (dataSize > 0 && memcpy_s(finayBuf + sizeof(PayloadHead) + s.size(), dataSize, data, dataSize)) {
-            WRITE_LOG(LOG_WARN, "send copyDatabuf err for dataSize:%d", dataSize);
-            break;
+        if (wireData != data) {
+            Base::StoreLe32(finayBuf + sizeof(PayloadHead) + protectSize, dataSize);
+        }
+        uint8_t *dataBuf = finayBuf + sizeof(PayloadHead) + headSize;
+        if (crc32c && wireData == data) {
+            // computed while the data is copied in, no pass of its own
+            Base::StoreLe32(dataBuf - CRC32C_SIZE, Crc32c::CopyAndExtend(0, dataBuf, data, dataSize));
+        } else {
+            if (crc32c) {
+                Base::StoreLe32(dataBuf - CRC32C_SIZE, Crc32c::Extend(0, data, dataSize));
+            }
+            if (wireSize > 0 && memcpy_s(dataBuf, wireSize, wireData, wireSize)) {
+                WRITE_LOG(LOG_WARN, "send copyDatabuf err for dataSize:%d", dataSize);
+                break;
+            }
         }
         bufRet = true;
     } while (false);
     if (!bufRet) {
-        delete[] finayBuf;
         WRITE_LOG(LOG_WARN, "send copywholedata err for dataSize:%d", dataSize);
         return ERR_BUF_COPY;
     }
@@ -915,17 +1004,45 @@ int HdcSessionBase::DecryptPayload(HSession hSession, PayloadHead *payloadHeadBe
     PayloadProtect protectBuf = {};
     uint16_t headSize = ntohs(payloadHeadBe->headSize);
     int dataSize = ntohl(payloadHeadBe->dataSize);
-    string encString(reinterpret_cast<char *>(encBuf), headSize);
-    SerialStruct::ParseFromString(protectBuf, encString);
+    uint16_t protectSize = headSize;
+    bool crc32c = payloadHeadBe->reserve[0] & PAYLOAD_OPTION_CRC32C;
+    bool lz4 = payloadHeadBe->reserve[0] & PAYLOAD_OPTION_LZ4;
+    uint16_t optionSize = (crc32c ? CRC32C_SIZE : 0) + (lz4 ? RAW_SIZE_SIZE : 0);
+    if (headSize < optionSize) {
+        WRITE_LOG(LOG_FATAL, "Session recv head size:%u options:%x", headSize, payloadHeadBe->reserve[0]);
+        return ERR_BUF_CHECK;
+    }
+    protectSize -= optionSize;
+    if (payloadHeadBe->reserve[0] & PAYLOAD_OPTION_FIXED_PROTECT) {
+        if (protectSize != FIXED_PROTECT_SIZE) {
+            WRITE_LOG(LOG_FATAL, "Session recv fixed protect size:%u", protectSize);
+            return ERR_BUF_CHECK;
+        }
+        protectBuf.channelId = Base::LoadLe32(encBuf);
+        protectBuf.commandFlag = Base::LoadLe32(encBuf + sizeof(uint32_t));
+        protectBuf.checkSum = encBuf[sizeof(uint32_t) * 2];  // 2: after channelId and commandFlag
+        protectBuf.vCode = encBuf[sizeof(uint32_t) * 2 + 1];
+    } else {
+        SerialStruct::ParseFromStringView(protectBuf,
+            std::string_view(reinterpret_cast<char *>(encBuf), protectSize));
+    }
     if (protectBuf.vCode != payloadProtectStaticVcode) {
         WRITE_LOG(LOG_FATAL, "Session recv static vcode failed");
         return ERR_BUF_CHECK;
     }
     uint8_t *data = encBuf + headSize;
+    if (lz4 && !DecompressPayload(hSession, encBuf + protectSize, data, dataSize)) {
+        return ERR_BUF_CHECK;
+    }
     if (ENABLE_IO_CHECKSUM && protectBuf.checkSum != 0 && (protectBuf.checkSum != Base::CalcCheckSum(data, dataSize))) {
         WRITE_LOG(LOG_FATAL, "Session recv CalcCheckSum failed");
         return ERR_BUF_CHECK;
     }
+    if (crc32c && Base::LoadLe32(encBuf + headSize - CRC32C_SIZE) != Crc32c::Extend(0, data, dataSize)) {
+        WRITE_LOG(LOG_FATAL, "Session recv crc32c failed, channelId:%u commandFlag:%u dataSize:%d",
+                  protectBuf.channelId, protectBuf.commandFlag, dataSize);
+        return ERR_BUF_CHECK;
+    }
     if (!FetchCommand(hSession, protectBuf.channelId, protectBuf.commandFlag, data, dataSize)) {
         WRITE_LOG(LOG_WARN, "FetchCommand failed: channelId %x commandFlag %x",
                   protectBuf.channelId, protectBuf.commandFlag);
@@ -957,6 +1074,8 @@ int HdcSessionBase::OnRead(HSession hSession, uint8_t *bufPtr, const int bufLen)
     if (bufLen - packetHeadSize < tobeReadLen) {
         return 0;
     }
+    ++hSession->stat.recvPackets;
+    Metrics::LatencyScope latency(hSession->stat.recvLatency);
     if (DecryptPayload(hSession, payloadHead, bufPtr + packetHeadSize)) {
         WRITE_LOG(LOG_WARN, "decrypt plhead error");
         return ERR_BUF_CHECK;
@@ -1094,6 +1213,14 @@ void HdcSessionBase::WorkThreadInitSession(HSession hSession, SessionHandShake &
     handshake.authType = AUTH_NONE;
     // told daemon, we support RSA_3072_SHA512 auth
     Base::TlvAppend(handshake.buf, TAG_AUTH_TYPE, std::to_string(AuthVerifyType::RSA_3072_SHA512));
+    uint32_t features = GetSupportFeatures();
+    // compression costs cpu on both sides, only worth it on slow links
+    const char *env = getenv(ENV_SESSION_COMPRESS.c_str());
+    if (env == nullptr || atoi(env) == 0) {
+        features &= ~FEATURE_LZ4;
+    }
+    Base::TlvAppend(handshake.buf, TAG_FEATURE, FeatureToString(features));
+    AppendHandshakeTlv(hSession, handshake.buf);
 }
 
 bool HdcSessionBase::WorkThreadStartSession(HSession hSession)
@@ -1168,6 +1295,95 @@ vector<uint8_t> HdcSessionBase::BuildCtrlString(InnerCtrlCommand command, uint32
     return ret;
 }
 
+uint32_t HdcSessionBase::GetSupportFeatures()
+{
+    return FEATURE_FIXED_HEAD | FEATURE_CRC32C | FEATURE_LZ4 | FEATURE_TICKET;
+}
+
+string HdcSessionBase::FeatureToString(uint32_t features)
+{
+    string ret;
+    for (const auto &[feature, name] : FEATURE_NAMES) {
+        if (!(features & feature)) {
+            continue;
+        }
+        if (!ret.empty()) {
+            ret += ",";
+        }
+        ret += name;
+    }
+    return ret;
+}
+
+uint32_t HdcSessionBase::StringToFeature(const string &featureString)
+{
+    uint32_t ret = 0;
+    vector<string> names;
+    Base::SplitString(featureString, ",", names);
+    for (const auto &[feature, name] : FEATURE_NAMES) {
+        if (std::find(names.begin(), names.end(), name) != names.end()) {
+            ret |= feature;
+        }
+    }
+    return ret;
+}
+
+uint32_t HdcSessionBase::NegotiateFeatures(const string &tlv)
+{
+    std::map<string, string> tlvmap;
+    if (!Base::TlvToStringMap(tlv, tlvmap) || tlvmap.find(TAG_FEATURE) == tlvmap.end()) {
+        return 0;
+    }
+    return StringToFeature(tlvmap[TAG_FEATURE]) & GetSupportFeatures();
+}
+
+bool HdcSessionBase::SetSessionFeatures(HSession hSession, uint32_t features)
+{
+    if ((features & FEATURE_LZ4) && hSession->compress == nullptr) {
+        hSession->compress = new(std::nothrow) SessionCompress();
+        if (hSession->compress == nullptr || !hSession->compress->Initial()) {
+            WRITE_LOG(LOG_FATAL, "session %u compress init failed", hSession->sessionId);
+            return false;
+        }
+    }
+    hSession->features.store(features, std::memory_order_release);
+    WRITE_LOG(LOG_INFO, "session %u features:%s", hSession->sessionId, FeatureToString(features).c_str());
+    return true;
+}
+
+int HdcSessionBase::CompressPayload(HSession hSession, const uint16_t command, const uint8_t *data,
+                                    const int dataSize)
+{
+    uint64_t begin = Metrics::NowUs();
+    int ret = hSession->compress->Compress(command, data, dataSize);
+    if (ret > 0) {
+        hSession->stat.compressRawBytes += dataSize;
+        hSession->stat.compressBytes += ret;
+        hSession->stat.compressTime += Metrics::NowUs() - begin;
+    }
+    return ret;
+}
+
+bool HdcSessionBase::DecompressPayload(HSession hSession, const uint8_t *rawSizeBuf, uint8_t *&data, int &dataSize)
+{
+    uint32_t rawSize = Base::LoadLe32(rawSizeBuf);
+    if (hSession->compress == nullptr || rawSize > static_cast<uint32_t>(HDC_BUF_MAX_BYTES)) {
+        WRITE_LOG(LOG_FATAL, "Session recv lz4 packet, compress:%d rawSize:%u", hSession->compress != nullptr,
+                  rawSize);
+        return false;
+    }
+    uint64_t begin = Metrics::NowUs();
+    if (!hSession->compress->Decompress(data, dataSize, rawSize)) {
+        return false;
+    }
+    hSession->stat.decompressRawBytes += rawSize;
+    hSession->stat.decompressBytes += dataSize;
+    hSession->stat.decompressTime += Metrics::NowUs() - begin;
+    data = hSession->compress->recvBuf.data();
+    dataSize = static_cast<int>(rawSize);
+    return true;
+}
+
 bool HdcSessionBase::DispatchMainThreadCommand(HSession hSession, const CtrlStruct *ctrl)
 {
     bool ret = true;
@@ -1394,6 +1610,7 @@ bool HdcSessionBase::DispatchTaskData(HSession hSession, const uint32_t channelI
             hTaskInfo->masterSlave = masterTask;
             hTaskInfo->closeRetryCount = 0;
             hTaskInfo->channelTask = false;
+            hTaskInfo->sessionFeatures = hSession->features.load(std::memory_order_acquire);
 
             int addTaskRetry = 3; // try 3 time
             while (addTaskRetry > 0) {
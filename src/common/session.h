@@ -23,7 +23,7 @@ enum TaskType { TYPE_UNITY, TYPE_SHELL, TASK_FILE, TASK_FORWARD, TASK_APP, TASK_
 
 class HdcSessionBase {
 public:
-    enum AuthType { AUTH_NONE, AUTH_TOKEN, AUTH_SIGNATURE, AUTH_PUBLICKEY, AUTH_OK, AUTH_FAIL };
+    enum AuthType { AUTH_NONE, AUTH_TOKEN, AUTH_SIGNATURE, AUTH_PUBLICKEY, AUTH_OK, AUTH_FAIL, AUTH_TICKET };
     struct SessionHandShake {
         string banner; // must first index
         // auth none
@@ -58,6 +58,18 @@ public:
         uint8_t checkSum;  // enable it will be lose about 20% speed
         uint8_t vCode;
     };
+    // FEATURE_FIXED_HEAD: set in PayloadHead.reserve[0], the PayloadProtect is channelId(le32) commandFlag(le32)
+    // checkSum vCode instead of SerialStruct
+    static constexpr uint8_t PAYLOAD_OPTION_FIXED_PROTECT = 0x01;
+    static constexpr uint16_t FIXED_PROTECT_SIZE = 10;
+    // FEATURE_CRC32C: set in PayloadHead.reserve[0], the last CRC32C_SIZE bytes of the head are the crc32c(le32)
+    // of the data
+    static constexpr uint8_t PAYLOAD_OPTION_CRC32C = 0x02;
+    static constexpr uint16_t CRC32C_SIZE = 4;
+    // FEATURE_LZ4: set in PayloadHead.reserve[0], the data is in the LZ4 stream of the session and the RAW_SIZE_SIZE
+    // bytes after PayloadProtect are its size before compression(le32). Before the crc32c if both
+    static constexpr uint8_t PAYLOAD_OPTION_LZ4 = 0x04;
+    static constexpr uint16_t RAW_SIZE_SIZE = 4;
 
     HdcSessionBase(bool serverOrDaemonIn, size_t uvThreadSize = SIZE_THREAD_POOL);
     virtual ~HdcSessionBase();
@@ -75,6 +87,10 @@ public:
     {
         return true;
     }
+    // server, more tlv of the first handshake
+    virtual void AppendHandshakeTlv(HSession hSession, string &tlv)
+    {
+    }
     // Thread security interface for global stop programs
     void PostStopInstanceMessage(bool restart = false);
     void ReMainLoopForInstanceClear();
@@ -92,10 +108,15 @@ public:
     virtual void FreeSession(const uint32_t sessionId);
     void WorkerPendding();
     int OnRead(HSession hSession, uint8_t *bufPtr, const int bufLen);
+    // compressed: the data is compressed already, FEATURE_LZ4 sends it raw without trying
     int Send(const uint32_t sessionId, const uint32_t channelId, const uint16_t commandFlag, const uint8_t *data,
-             const int dataSize);
-    int SendByProtocol(HSession hSession, uint8_t *bufPtr, const int bufLen, bool echo = false);
+             const int dataSize, const bool compressed = false);
+    int SendByProtocol(HSession hSession, const uint8_t *bufPtr, const int bufLen, bool echo = false);
     virtual HSession AdminSession(const uint8_t op, const uint32_t sessionId, HSession hInput);
+    // callback under read lock of mapSession, for each alive session
+    void EnumSession(const std::function<void(HSession hSession)> &callback);
+    // a session holds a thread of the uv pool till it is freed, there must be one left for a new session
+    bool HasFreeSessionThread();
     void AddDeletedSessionId(uint32_t sessionId);
     bool IsSessionDeleted(uint32_t sessionId) const;
     virtual int FetchIOBuf(HSession hSession, uint8_t *ioBuf, int read);
@@ -128,6 +149,14 @@ public:
         return wantRestart;
     }
     static vector<uint8_t> BuildCtrlString(InnerCtrlCommand command, uint32_t channelId, uint8_t *data, int dataSize);
+    // SessionFeature of this side, and the ',' list in TAG_FEATURE
+    static uint32_t GetSupportFeatures();
+    static string FeatureToString(uint32_t features);
+    static uint32_t StringToFeature(const string &featureString);
+    // features of the handshake tlv which this side supports too
+    static uint32_t NegotiateFeatures(const string &tlv);
+    // take the features in use when the handshake is done
+    bool SetSessionFeatures(HSession hSession, uint32_t features);
     uv_loop_t loopMain;
     bool serverOrDaemon;
     uv_async_t asyncMainLoop;
@@ -194,6 +223,10 @@ private:
     {
     }
     int DecryptPayload(HSession hSession, PayloadHead *payloadHeadBe, uint8_t *encBuf);
+    // FEATURE_LZ4, with the stat of the session
+    int CompressPayload(HSession hSession, const uint16_t command, const uint8_t *data, const int dataSize);
+    // data and dataSize are changed to the decompressed ones
+    bool DecompressPayload(HSession hSession, const uint8_t *rawSizeBuf, uint8_t *&data, int &dataSize);
     bool DispatchMainThreadCommand(HSession hSession, const CtrlStruct *ctrl);
     bool DispatchSessionThreadCommand(HSession hSession, const uint8_t *baseBuf,
                                       const int bytesIO);
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "session_compress.h"
+#include <lz4frame.h>
+
+#include "base.h"
+
+namespace Hdc {
+// 15/16: what is not smaller than this after compression is taken as compressed already
+constexpr size_t INCOMPRESSIBLE_NUM = 15;
+constexpr size_t INCOMPRESSIBLE_DEN = 16;
+
+static LZ4F_preferences_t GetPreferences()
+{
+    LZ4F_preferences_t prefs;
+    (void)memset_s(&prefs, sizeof(prefs), 0, sizeof(prefs));
+    prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs.frameInfo.blockMode = LZ4F_blockLinked;
+    prefs.autoFlush = 1;  // every packet ends at a block boundary, the peer decodes it at once
+    return prefs;
+}
+
+SessionCompress::SessionCompress() : cctx(nullptr), dctx(nullptr), frameBegun(false)
+{
+}
+
+SessionCompress::~SessionCompress()
+{
+    if (cctx != nullptr) {
+        LZ4F_freeCompressionContext(cctx);
+    }
+    if (dctx != nullptr) {
+        LZ4F_freeDecompressionContext(dctx);
+    }
+}
+
+bool SessionCompress::Initial()
+{
+    size_t ret = LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
+    if (LZ4F_isError(ret)) {
+        WRITE_LOG(LOG_FATAL, "LZ4F_createCompressionContext failed:%s", LZ4F_getErrorName(ret));
+        return false;
+    }
+    ret = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    if (LZ4F_isError(ret)) {
+        WRITE_LOG(LOG_FATAL, "LZ4F_createDecompressionContext failed:%s", LZ4F_getErrorName(ret));
+        return false;
+    }
+    return true;
+}
+
+int SessionCompress::Compress(const uint16_t command, const uint8_t *data, const int dataSize)
+{
+    if (dataSize < MIN_COMPRESS_SIZE) {
+        return 0;
+    }
+    auto skip = skipPackets.find(command);
+    if (skip != skipPackets.end() && skip->second > 0) {
+        --skip->second;
+        return 0;
+    }
+    static const LZ4F_preferences_t prefs = GetPreferences();
+    size_t bound = LZ4F_compressBound(dataSize, &prefs) + LZ4F_HEADER_SIZE_MAX;
+    if (sendBuf.size() < bound) {
+        sendBuf.resize(bound);
+    }
+    size_t offset = 0;
+    size_t ret = 0;
+    if (!frameBegun) {
+        ret = LZ4F_compressBegin(cctx, sendBuf.data(), sendBuf.size(), &prefs);
+        if (LZ4F_isError(ret)) {
+            WRITE_LOG(LOG_FATAL, "LZ4F_compressBegin failed:%s", LZ4F_getErrorName(ret));
+            return ERR_GENERIC;
+        }
+        offset = ret;
+        frameBegun = true;
+    }
+    ret = LZ4F_compressUpdate(cctx, sendBuf.data() + offset, sendBuf.size() - offset, data, dataSize, nullptr);
+    if (LZ4F_isError(ret)) {
+        WRITE_LOG(LOG_FATAL, "LZ4F_compressUpdate failed:%s", LZ4F_getErrorName(ret));
+        return ERR_GENERIC;
+    }
+    // it is in the stream now and must be sent compressed, the next ones of the command go raw
+    if (ret * INCOMPRESSIBLE_DEN >= static_cast<size_t>(dataSize) * INCOMPRESSIBLE_NUM) {
+        skipPackets[command] = SKIP_PACKETS;
+    }
+    return static_cast<int>(offset + ret);
+}
+
+bool SessionCompress::Decompress(const uint8_t *data, const int dataSize, const uint32_t rawSize)
+{
+    if (recvBuf.size() < rawSize) {
+        recvBuf.resize(rawSize);
+    }
+    size_t consumed = 0;
+    size_t produced = 0;
+    while (consumed < static_cast<size_t>(dataSize)) {
+        size_t srcSize = dataSize - consumed;
+        size_t dstSize = rawSize - produced;
+        size_t ret = LZ4F_decompress(dctx, recvBuf.data() + produced, &dstSize, data + consumed, &srcSize, nullptr);
+        if (LZ4F_isError(ret)) {
+            WRITE_LOG(LOG_FATAL, "LZ4F_decompress failed:%s", LZ4F_getErrorName(ret));
+            return false;
+        }
+        if (srcSize == 0 && dstSize == 0) {
+            break;
+        }
+        consumed += srcSize;
+        produced += dstSize;
+    }
+    if (consumed != static_cast<size_t>(dataSize) || produced != rawSize) {
+        WRITE_LOG(LOG_FATAL, "LZ4F_decompress size mismatch, consumed:%zu/%d produced:%zu/%u", consumed, dataSize,
+                  produced, rawSize);
+        return false;
+    }
+    return true;
+}
+}  // namespace Hdc
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_SESSION_COMPRESS_H
+#define HDC_SESSION_COMPRESS_H
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+struct LZ4F_cctx_s;
+struct LZ4F_dctx_s;
+
+namespace Hdc {
+// FEATURE_LZ4 of a session: the data of every packet, whatever the channel, goes through one LZ4 frame per
+// direction with linked blocks, so a packet is compressed with the last 64KB sent before as dictionary. Data the
+// sender has compressed already, as the lz4 chunks of file transfer, does not come here. Other data which does not
+// compress turns its command off for a while and goes raw.
+class SessionCompress {
+public:
+    SessionCompress();
+    ~SessionCompress();
+    bool Initial();
+    // compress into sendBuf, return the compressed size, 0 if the data goes raw, <0 if the stream is broken
+    int Compress(const uint16_t command, const uint8_t *data, const int dataSize);
+    // decompress into recvBuf the rawSize bytes of one packet
+    bool Decompress(const uint8_t *data, const int dataSize, const uint32_t rawSize);
+
+    std::mutex sendMutex;  // the peer must read the packets in the order they are compressed
+    std::vector<uint8_t> sendBuf;
+    std::vector<uint8_t> recvBuf;
+
+private:
+    static constexpr int MIN_COMPRESS_SIZE = 32;  // smaller ones go raw
+    static constexpr uint16_t SKIP_PACKETS = 64;  // raw packets of a command after it does not compress
+
+    LZ4F_cctx_s *cctx;
+    LZ4F_dctx_s *dctx;
+    bool frameBegun;
+    std::map<uint16_t, uint16_t> skipPackets;  // command, raw packets to go
+};
+}  // namespace Hdc
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "session_ticket.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include "base.h"
+
+namespace Hdc {
+constexpr uint16_t TICKET_ID_SIZE = 16;
+constexpr uint64_t US_PER_SEC = 1000000;
+
+bool SessionTicketStore::Issue(const std::string &connectKey, Ticket &ticket)
+{
+    std::string id = RandomBytes(TICKET_ID_SIZE);
+    ticket.key = RandomBytes(TICKET_KEY_SIZE);
+    if (id.empty() || ticket.key.empty()) {
+        return false;
+    }
+    ticket.id = Base::Convert2HexStr(reinterpret_cast<uint8_t *>(id.data()), id.size());
+    ticket.connectKey = connectKey;
+    ticket.expireTime = ExpireTime(TICKET_LIFE);
+    Put(ticket.id, ticket);
+    return true;
+}
+
+void SessionTicketStore::Put(const std::string &name, const Ticket &ticket)
+{
+    uint64_t now = Metrics::NowUs();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = tickets.begin(); it != tickets.end();) {
+        if (it->second.expireTime <= now) {
+            it = tickets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    tickets[name] = ticket;
+}
+
+bool SessionTicketStore::Get(const std::string &name, Ticket &ticket)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = tickets.find(name);
+    if (it == tickets.end()) {
+        return false;
+    }
+    if (it->second.expireTime <= Metrics::NowUs()) {
+        tickets.erase(it);
+        return false;
+    }
+    ticket = it->second;
+    return true;
+}
+
+void SessionTicketStore::Remove(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    tickets.erase(name);
+}
+
+std::string SessionTicketStore::MakeProof(const Ticket &ticket, const std::string &challenge)
+{
+    // the separator keeps the fields apart, none of them has '\f'
+    std::string message = ticket.id + HDC_HOST_DAEMON_BUF_SEPARATOR + ticket.connectKey +
+                          HDC_HOST_DAEMON_BUF_SEPARATOR + challenge;
+    uint8_t mac[EVP_MAX_MD_SIZE];
+    unsigned int macSize = 0;
+    if (HMAC(EVP_sha256(), ticket.key.data(), ticket.key.size(), reinterpret_cast<const uint8_t *>(message.data()),
+             message.size(), mac, &macSize) == nullptr) {
+        WRITE_LOG(LOG_FATAL, "ticket hmac failed");
+        return "";
+    }
+    return Base::Convert2HexStr(mac, macSize);
+}
+
+bool SessionTicketStore::CheckProof(const Ticket &ticket, const std::string &challenge, const std::string &proof)
+{
+    std::string expected = MakeProof(ticket, challenge);
+    return !expected.empty() && expected.size() == proof.size() &&
+           CRYPTO_memcmp(expected.data(), proof.data(), proof.size()) == 0;
+}
+
+uint64_t SessionTicketStore::ExpireTime(uint32_t life)
+{
+    return Metrics::NowUs() + life * US_PER_SEC;
+}
+
+std::string SessionTicketStore::RandomBytes(uint16_t size)
+{
+    std::string bytes(size, '\0');
+    if (RAND_bytes(reinterpret_cast<uint8_t *>(bytes.data()), size) != 1) {
+        WRITE_LOG(LOG_FATAL, "RAND_bytes failed");
+        return "";
+    }
+    return bytes;
+}
+}  // namespace Hdc
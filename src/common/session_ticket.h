@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_SESSION_TICKET_H
+#define HDC_SESSION_TICKET_H
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace Hdc {
+// FEATURE_TICKET of a session, resumption without the RSA auth:
+//   1. at the AUTH_OK of a full auth the daemon gives a ticket, TAG_TICKET_ID and TAG_TICKET_KEY (a random key
+//      encrypted to the public key of the host), valid for TAG_TICKET_LIFE seconds
+//   2. the first handshake of a reconnect to the same connectKey has TAG_TICKET_ID
+//   3. the daemon answers AUTH_TICKET with a challenge, the host AUTH_TICKET with the proof, the HMAC-SHA256 of
+//      ticket id, connectKey and challenge with the key, then AUTH_OK. A ticket the daemon does not take or a wrong
+//      proof goes on with AUTH_PUBLICKEY as usual.
+// Tickets are kept in memory only, by connectKey on the host and by ticket id on the daemon.
+class SessionTicketStore {
+public:
+    struct Ticket {
+        std::string id;
+        std::string key;
+        std::string connectKey;
+        uint64_t expireTime;  // us, Metrics::NowUs
+    };
+    static constexpr uint32_t TICKET_LIFE = 3600;  // s, counted from the full auth, a resumption does not renew it
+    static constexpr uint16_t TICKET_KEY_SIZE = 32;
+
+    // daemon, a new ticket for connectKey, stored by its id
+    bool Issue(const std::string &connectKey, Ticket &ticket);
+    void Put(const std::string &name, const Ticket &ticket);
+    // false if there is none or it has expired
+    bool Get(const std::string &name, Ticket &ticket);
+    void Remove(const std::string &name);
+    static std::string MakeProof(const Ticket &ticket, const std::string &challenge);
+    static bool CheckProof(const Ticket &ticket, const std::string &challenge, const std::string &proof);
+    static std::string RandomBytes(uint16_t size);
+    static uint64_t ExpireTime(uint32_t life);
+
+private:
+    std::mutex mutex;
+    std::map<std::string, Ticket> tickets;
+};
+}  // namespace Hdc
+
+#endif
@@ -52,7 +52,7 @@ void HdcTaskBase::TaskFinish()
     WRITE_LOG(LOG_DEBUG, "HdcTaskBase::TaskFinish notify end channelId:%u", taskInfo->channelId);
 }
 
-bool HdcTaskBase::SendToAnother(const uint16_t command, uint8_t *bufPtr, const int size)
+bool HdcTaskBase::SendToAnother(const uint16_t command, uint8_t *bufPtr, const int size, const bool compressed)
 {
     StartTraceScope("HdcTaskBase::SendToAnother");
     if (singalStop) {
@@ -70,7 +70,7 @@ bool HdcTaskBase::SendToAnother(const uint16_t command, uint8_t *bufPtr, const i
                 taskInfo->channelId, command);
             return false;
         }
-        return sessionBase->Send(taskInfo->sessionId, taskInfo->channelId, command, bufPtr, size) > 0;
+        return sessionBase->Send(taskInfo->sessionId, taskInfo->channelId, command, bufPtr, size, compressed) > 0;
     }
 }
 
@@ -94,8 +94,8 @@ void HdcTaskBase::LogMsg(MessageLevel level, const char *msg, ...)
                 break;
         }
 
-        fprintf(stdout, "%s%s\n", logInfo.c_str(), log.c_str());
-        fflush(stdout);
+        string text = logInfo + log + "\n";
+        reinterpret_cast<HdcChannelBase *>(taskInfo->channelClass)->Output(text.c_str(), text.size());
     } else {
         HdcSessionBase *sessionBase = reinterpret_cast<HdcSessionBase *>(clsSession);
         sessionBase->LogMsg(taskInfo->sessionId, taskInfo->channelId, level, log.c_str());
@@ -120,4 +120,17 @@ int HdcTaskBase::ThreadCtrlCommunicate(const uint8_t *bufPtr, const int size)
     int fd = hSession->ctrlFd[STREAM_WORK];
     return Base::SendToPollFd(fd, bufPtr, size);
 }
+
+HdcSessionStat *HdcTaskBase::GetSessionStat()
+{
+    if (taskInfo->channelTask) {
+        return nullptr;  // the owner is the channel class of a client, there is no session
+    }
+    HdcSessionBase *sessionBase = (HdcSessionBase *)taskInfo->ownerSessionClass;
+    HSession hSession = sessionBase->AdminSession(OP_QUERY, taskInfo->sessionId, nullptr);
+    if (!hSession) {
+        return nullptr;
+    }
+    return &hSession->stat;
+}
 }
@@ -36,10 +36,12 @@ public:
     void TaskFinish();
 
 protected:                                                                        // D/S==daemon/server
-    bool SendToAnother(const uint16_t command, uint8_t *bufPtr, const int size);  // D / S corresponds to the Task class
+    // D / S corresponds to the Task class, compressed if the data is compressed already, for Send
+    bool SendToAnother(const uint16_t command, uint8_t *bufPtr, const int size, const bool compressed = false);
     void LogMsg(MessageLevel level, const char *msg, ...);                        // D / S log Send to Client
     bool ServerCommand(const uint16_t command, uint8_t *bufPtr, const int size);  // D / s command is sent to Server
     int ThreadCtrlCommunicate(const uint8_t *bufPtr, const int size);             // main thread and session thread
+    HdcSessionStat *GetSessionStat();                                             // nullptr if session is gone
 
     uv_loop_t *loopTask;  // childuv pointer
     void *clsSession;
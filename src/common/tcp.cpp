@@ -100,10 +100,10 @@ void HdcTCPBase::ReadStream(uv_stream_t *tcp, ssize_t nread, const uv_buf_t *buf
     }
 }
 
-int HdcTCPBase::WriteUvTcpFd(uv_tcp_t *tcp, uint8_t *buf, int size)
+int HdcTCPBase::WriteUvTcpFd(uv_tcp_t *tcp, const uint8_t *buf, int size)
 {
     std::lock_guard<std::mutex> lock(writeTCPMutex);
-    uint8_t *data = buf;
+    const uint8_t *data = buf;
     int cnt = size;
     uv_os_fd_t uvfd;
     uv_fileno(reinterpret_cast<uv_handle_t*>(tcp), &uvfd);
@@ -143,7 +143,6 @@ int HdcTCPBase::WriteUvTcpFd(uv_tcp_t *tcp, uint8_t *buf, int size)
         data += rc;
         cnt -= rc;
     }
-    delete[] buf;
     return cnt == 0 ? size : cnt;
 }
 }  // namespace Hdc
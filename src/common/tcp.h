@@ -22,7 +22,8 @@ public:
     HdcTCPBase(const bool serverOrDaemonIn, void *ptrMainBase);
     virtual ~HdcTCPBase();
     static void ReadStream(uv_stream_t *tcp, ssize_t nread, const uv_buf_t *buf);
-    int WriteUvTcpFd(uv_tcp_t *tcp, uint8_t *buf, int size);
+    // blocks till all of buf is sent, the caller keeps buf
+    int WriteUvTcpFd(uv_tcp_t *tcp, const uint8_t *buf, int size);
 
 protected:
     virtual void RecvUDPEntry(const sockaddr *addrSrc, uv_udp_t *handle, const uv_buf_t *rcvbuf)
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "base.h"
+
+using namespace std::chrono;
+
+namespace Hdc {
+namespace Trace {
+    std::atomic<bool> g_enabled = false;
+
+    constexpr char PHASE_COMPLETE = 'X';
+    constexpr char PHASE_BEGIN = 'B';
+    constexpr char PHASE_END = 'E';
+
+    struct Event {
+        const char *name;
+        uint64_t begin;
+        uint64_t end;
+        char phase;
+    };
+
+    // the epoch of Start in the high bits of the state of a buffer, the count of events since in the low ones
+    constexpr int EPOCH_SHIFT = 48;
+    constexpr uint64_t COUNT_MASK = (1ULL << EPOCH_SHIFT) - 1;
+
+    // written only by the owner thread, read by Stop. The owner starts it over at its first event of a new epoch,
+    // so Start never writes to the buffer of another thread. writing is up while the owner appends, Stop turns
+    // g_enabled off and waits for it to go down before it reads the ring
+    struct ThreadBuffer {
+        uint32_t threadId;
+        std::atomic<bool> writing;
+        bool retired;  // the owner has exited, the buffer is reused after its events are saved
+        std::atomic<uint64_t> state;
+        Event events[EVENTS_PER_THREAD];
+    };
+
+    static std::mutex g_buffersLock;
+    static vector<ThreadBuffer *> g_buffers;      // of live threads, and of exited ones until the next Stop
+    static vector<ThreadBuffer *> g_freeBuffers;  // of exited threads, for the next new thread
+    static std::mutex g_controlLock;
+    static std::atomic<uint64_t> g_epoch = 0;  // in the bits of EPOCH_SHIFT
+    static uint64_t g_startTick = 0;
+    static uint64_t g_startUs = 0;
+    static std::string g_envPath;
+
+    static uint64_t NowUs()
+    {
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // with g_buffersLock
+    static void RecycleBuffer(ThreadBuffer *buffer)
+    {
+        g_buffers.erase(std::remove(g_buffers.begin(), g_buffers.end(), buffer), g_buffers.end());
+        g_freeBuffers.push_back(buffer);
+    }
+
+    // at the exit of the owner thread. Events of a trace still running stay for Stop to save
+    static void ReleaseThreadBuffer(ThreadBuffer *buffer)
+    {
+        std::lock_guard<std::mutex> control(g_controlLock);
+        std::lock_guard<std::mutex> lock(g_buffersLock);
+        uint64_t state = buffer->state.load(std::memory_order_relaxed);
+        if (g_enabled && (state & ~COUNT_MASK) == g_epoch.load(std::memory_order_relaxed)) {
+            buffer->retired = true;
+            return;
+        }
+        RecycleBuffer(buffer);
+    }
+
+    struct ThreadBufferHolder {
+        ThreadBuffer *buffer = nullptr;
+        ~ThreadBufferHolder()
+        {
+            if (buffer != nullptr) {
+                ReleaseThreadBuffer(buffer);
+            }
+        }
+    };
+
+    static ThreadBuffer *GetThreadBuffer()
+    {
+        static thread_local ThreadBufferHolder holder;
+        if (holder.buffer != nullptr) {
+            return holder.buffer;
+        }
+        std::lock_guard<std::mutex> lock(g_buffersLock);
+        ThreadBuffer *buffer = nullptr;
+        if (!g_freeBuffers.empty()) {
+            buffer = g_freeBuffers.back();
+            g_freeBuffers.pop_back();
+        } else {
+            buffer = new(std::nothrow) ThreadBuffer();
+            if (buffer == nullptr) {
+                return nullptr;
+            }
+        }
+        // the same thread id as the log
+        buffer->threadId = static_cast<uint32_t>(std::hash<std::thread::id> {}(std::this_thread::get_id()));
+        buffer->writing = false;
+        buffer->retired = false;
+        buffer->state = 0;  // no epoch, Start has bumped g_epoch past 0
+        g_buffers.push_back(buffer);
+        holder.buffer = buffer;
+        return buffer;
+    }
+
+    static void Append(const char *name, uint64_t begin, uint64_t end, char phase)
+    {
+        ThreadBuffer *buffer = GetThreadBuffer();
+        if (buffer == nullptr) {
+            return;
+        }
+        // seq_cst with the store of g_enabled in Stop: either this sees it off, or Stop sees writing up
+        buffer->writing.store(true);
+        if (!g_enabled.load()) {
+            buffer->writing.store(false, std::memory_order_release);
+            return;
+        }
+        uint64_t epoch = g_epoch.load(std::memory_order_acquire);
+        uint64_t state = buffer->state.load(std::memory_order_relaxed);
+        if ((state & ~COUNT_MASK) != epoch) {
+            state = epoch;
+        }
+        Event &e = buffer->events[(state & COUNT_MASK) % EVENTS_PER_THREAD];
+        e.name = name;
+        e.begin = begin;
+        e.end = end;
+        e.phase = phase;
+        buffer->state.store(state + 1, std::memory_order_relaxed);
+        buffer->writing.store(false, std::memory_order_release);
+    }
+
+    void Record(const char *name, uint64_t begin, uint64_t end)
+    {
+        Append(name, begin, end, PHASE_COMPLETE);
+    }
+
+    void BeginPoint(const char *name)
+    {
+        if (g_enabled.load(std::memory_order_relaxed)) {
+            uint64_t now = Now();
+            Append(name, now, now, PHASE_BEGIN);
+        }
+    }
+
+    void FinishPoint()
+    {
+        if (g_enabled.load(std::memory_order_relaxed)) {
+            uint64_t now = Now();
+            Append("", now, now, PHASE_END);
+        }
+    }
+
+    void Start()
+    {
+        std::lock_guard<std::mutex> control(g_controlLock);
+        if (g_enabled) {
+            return;
+        }
+        g_epoch.fetch_add(1ULL << EPOCH_SHIFT, std::memory_order_release);
+        g_startUs = NowUs();
+        g_startTick = Now();
+        g_enabled = true;
+        WRITE_LOG(LOG_INFO, "trace start");
+    }
+
+    static void WriteEvent(FILE *fp, bool &first, const Event &e, uint32_t pid, uint32_t tid, double ticksPerUs)
+    {
+        if (e.begin < g_startTick) {
+            return;
+        }
+        double ts = (e.begin - g_startTick) / ticksPerUs;
+        fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"hdc\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u",
+                first ? "" : ",", e.name, e.phase, ts, pid, tid);
+        if (e.phase == PHASE_COMPLETE) {
+            fprintf(fp, ",\"dur\":%.3f", (e.end - e.begin) / ticksPerUs);
+        }
+        fprintf(fp, "}");
+        first = false;
+    }
+
+    int Stop(const std::string &path)
+    {
+        std::lock_guard<std::mutex> control(g_controlLock);
+        if (!g_enabled) {
+            return ERR_GENERIC;
+        }
+        g_enabled = false;
+        uint64_t spanTick = Now() - g_startTick;
+        uint64_t spanUs = NowUs() - g_startUs;
+        double ticksPerUs = (spanUs > 0 && spanTick > 0) ? static_cast<double>(spanTick) / spanUs : 1.0;
+        std::lock_guard<std::mutex> lock(g_buffersLock);
+        for (ThreadBuffer *buffer : g_buffers) {
+            while (buffer->writing.load()) {
+                std::this_thread::yield();
+            }
+        }
+        vector<ThreadBuffer *> retired;
+        for (ThreadBuffer *buffer : g_buffers) {
+            if (buffer->retired) {
+                retired.push_back(buffer);
+            }
+        }
+        FILE *fp = fopen(path.c_str(), "w");
+        if (fp == nullptr) {
+            WRITE_LOG(LOG_FATAL, "trace open %s failed errno:%d", path.c_str(), errno);
+            for (ThreadBuffer *buffer : retired) {
+                RecycleBuffer(buffer);
+            }
+            return ERR_FILE_OPEN;
+        }
+        uint32_t pid = static_cast<uint32_t>(uv_os_getpid());
+        int total = 0;
+        bool first = true;
+        fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        uint64_t epoch = g_epoch.load(std::memory_order_relaxed);
+        for (ThreadBuffer *buffer : g_buffers) {
+            uint64_t state = buffer->state.load(std::memory_order_relaxed);
+            if ((state & ~COUNT_MASK) != epoch) {
+                continue;  // nothing since Start
+            }
+            uint64_t count = state & COUNT_MASK;
+            uint64_t from = count > EVENTS_PER_THREAD ? count - EVENTS_PER_THREAD : 0;
+            for (uint64_t i = from; i < count; ++i) {
+                WriteEvent(fp, first, buffer->events[i % EVENTS_PER_THREAD], pid, buffer->threadId, ticksPerUs);
+                ++total;
+            }
+        }
+        fprintf(fp, "\n]}\n");
+        fclose(fp);
+        for (ThreadBuffer *buffer : retired) {
+            RecycleBuffer(buffer);
+        }
+        WRITE_LOG(LOG_INFO, "trace stop, %d events saved to %s", total, path.c_str());
+        return total;
+    }
+
+    void StartByEnv()
+    {
+        char *env = getenv(ENV_TRACE.c_str());
+        if (env == nullptr || strlen(env) == 0) {
+            return;
+        }
+        g_envPath = env;
+        Start();
+    }
+
+    void FinishByEnv()
+    {
+        if (g_envPath.empty()) {
+            return;
+        }
+        Stop(g_envPath);
+    }
+}  // namespace Trace
+}  // namespace Hdc
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_TRACE_H
+#define HDC_TRACE_H
+#include <atomic>
+#include <cstdint>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Host tracing backend behind StartTraceScope/StartTracePoint. Every thread appends complete events to its own
+// ring buffer without lock, timestamps are raw TSC ticks converted to microseconds at export. Export format is
+// Chrome trace json, open it with chrome://tracing or ui.perfetto.dev.
+// Enable by 'hdc trace start' / 'hdc trace stop [file]' on server, or OHOS_HDC_TRACE=file for the whole process.
+namespace Hdc {
+namespace Trace {
+    constexpr uint32_t EVENTS_PER_THREAD = 32768;  // ring size, the oldest events are overwritten
+    const std::string ENV_TRACE = "OHOS_HDC_TRACE";
+    const std::string TRACE_FILE_NAME = "hdc_trace.json";
+
+    extern std::atomic<bool> g_enabled;
+
+    inline uint64_t Now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    void Record(const char *name, uint64_t begin, uint64_t end);
+    void BeginPoint(const char *name);
+    void FinishPoint();
+    void Start();
+    // disable tracing and save buffered events to path, return the count of events or RetErrCode
+    int Stop(const std::string &path);
+    // start at process init if ENV_TRACE is set, and save to the file it names by FinishByEnv
+    void StartByEnv();
+    void FinishByEnv();
+
+    class Scope {
+    public:
+        explicit Scope(const char *nameIn)
+            : name(__builtin_expect(g_enabled.load(std::memory_order_relaxed), 0) ? nameIn : nullptr)
+        {
+            if (name != nullptr) {
+                begin = Now();
+            }
+        }
+        ~Scope()
+        {
+            if (name != nullptr) {
+                Record(name, begin, Now());
+            }
+        }
+
+    private:
+        const char *name;
+        uint64_t begin = 0;
+    };
+}  // namespace Trace
+}  // namespace Hdc
+
+#endif  // HDC_TRACE_H
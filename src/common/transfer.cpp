@@ -14,6 +14,8 @@
  */
 #include "transfer.h"
 #include "serial_struct.h"
+#include "compress.h"
+#include "decompress.h"
 #include <sys/stat.h>
 #ifdef HARMONY_PROJECT
 #include <lz4.h>
@@ -109,7 +111,13 @@ int HdcTransferBase::SimpleFileIO(CtxFile *context, uint64_t index, uint8_t *sen
         ioContext->context = context;
         req->data = ioContext;
         ++refCount;
-        if (context->master) {  // master just read, and slave just write.when master/read, sendBuf can be nullptr
+        if (context->master && context->tarStream != nullptr) {
+            // offset and size as uv_fs_read would have them, the result is set by the read
+            req->fs_type = UV_FS_READ;
+            req->off = static_cast<int64_t>(index);
+            req->result = bytes;
+            Base::StartWorkThread(context->loop, ReadTarStream, OnTarStreamRead, ioContext);
+        } else if (context->master) {  // master just read, slave just write. when master/read, sendBuf can be nullptr
             uv_buf_t iov = uv_buf_init(reinterpret_cast<char *>(ioContext->bufIO), bytes);
             uv_fs_read(context->loop, req, context->fsOpenReq.result, &iov, 1, index, context->cb);
         } else {
@@ -140,6 +148,22 @@ int HdcTransferBase::SimpleFileIO(CtxFile *context, uint64_t index, uint8_t *sen
     return bytes;
 }
 
+void HdcTransferBase::ReadTarStream(uv_work_t *req)
+{
+    CtxFileIO *contextIO = reinterpret_cast<CtxFileIO *>(req->data);
+    uv_fs_t *fs = &contextIO->fs;
+    int ret = contextIO->context->tarStream->ReadTar(static_cast<uint64_t>(fs->off), contextIO->bufIO,
+                                                     static_cast<size_t>(fs->result));
+    fs->result = ret < 0 ? UV_EIO : ret;
+}
+
+void HdcTransferBase::OnTarStreamRead(uv_work_t *req, int status)
+{
+    CtxFileIO *contextIO = reinterpret_cast<CtxFileIO *>(req->data);
+    delete req;
+    contextIO->context->cb(&contextIO->fs);
+}
+
 void HdcTransferBase::OnFileClose(uv_fs_t *req)
 {
     StartTraceScope("HdcTransferBase::OnFileClose");
@@ -151,6 +175,8 @@ void HdcTransferBase::OnFileClose(uv_fs_t *req)
         // close-step2
         // maybe successful finish or failed finish
         thisClass->WhenTransferFinish(context);
+    } else if (context->master) {
+        thisClass->WhenSendFinish(context);
     }
     --thisClass->refCount;
     return;
@@ -174,7 +200,7 @@ void HdcTransferBase::SetFileTime(CtxFile *context)
 bool HdcTransferBase::SendIOPayload(CtxFile *context, uint64_t index, uint8_t *data, int dataSize)
 {
     TransferPayload payloadHead;
-    string head;
+    int headSize = 0;
     int compressSize = 0;
     int sendBufSize = payloadPrefixReserve + dataSize;
     uint8_t *sendBuf = data - payloadPrefixReserve;
@@ -205,14 +231,24 @@ bool HdcTransferBase::SendIOPayload(CtxFile *context, uint64_t index, uint8_t *d
         }
     }
     payloadHead.compressSize = compressSize;
-    head = SerialStruct::SerializeToString(payloadHead);
-    if (head.size() + 1 > payloadPrefixReserve) {
-        goto out;
-    }
-    if (EOK != memcpy_s(sendBuf, sendBufSize, head.c_str(), head.size() + 1)) {
-        goto out;
+    if (taskInfo->sessionFeatures & FEATURE_FIXED_HEAD) {
+        sendBuf[0] = payloadFixedMark;
+        Base::StoreLe64(sendBuf + 1, payloadHead.index);
+        sendBuf[1 + sizeof(uint64_t)] = payloadHead.compressType;
+        Base::StoreLe32(sendBuf + 2 + sizeof(uint64_t), payloadHead.compressSize);  // 2: mark and compressType
+        Base::StoreLe32(sendBuf + 2 + sizeof(uint64_t) + sizeof(uint32_t), payloadHead.uncompressSize);
+    } else {
+        static_assert(SerialStruct::MaxSerializedSize<TransferPayload>() < payloadPrefixReserve);
+        // the head is '\0' ended in the reserve, as it was sent as a c string
+        headSize = SerialStruct::SerializeToBuffer(payloadHead, sendBuf, payloadPrefixReserve - 1);
+        if (headSize < 0) {
+            goto out;
+        }
+        sendBuf[headSize] = '\0';
     }
-    ret = SendToAnother(commandData, sendBuf, payloadPrefixReserve + compressSize) > 0;
+    // a chunk of a compressType is not tried again by the lz4 of the session
+    ret = SendToAnother(commandData, sendBuf, payloadPrefixReserve + compressSize,
+                        compressSize > 0 && payloadHead.compressType != COMPRESS_NONE);
 
 out:
     if (dataSize > 0 && payloadHead.compressType == COMPRESS_LZ4) {
@@ -257,6 +293,10 @@ void HdcTransferBase::OnFileIO(uv_fs_t *req)
                 context->ioFinish = true;
                 WRITE_LOG(LOG_DEBUG, "path:%s fd:%d eof",
                     context->localPath.c_str(), context->fsOpenReq.result);
+                if (context->tarStream != nullptr) {
+                    // a stream said the most it could be, it is all sent here
+                    context->fileSize = context->indexIO;
+                }
                 break;
             }
             if (context->indexIO < context->fileSize) {
@@ -291,7 +331,12 @@ void HdcTransferBase::OnFileIO(uv_fs_t *req)
         }
         WRITE_LOG(LOG_DEBUG, "channelId:%u result:%d, closeReqSubmitted:%d",
                   thisClass->taskInfo->channelId, context->fsOpenReq.result, context->closeReqSubmitted);
-        if (context->lastErrno == 0 && !context->closeReqSubmitted) {
+        if (context->lastErrno == 0 && !context->closeReqSubmitted && context->tarStream != nullptr) {
+            // no fd of its own, the file being read in the tar is closed
+            context->tarStream->CloseStream();
+            context->closeReqSubmitted = true;
+            OnFileClose(&context->fsCloseReq);
+        } else if (context->lastErrno == 0 && !context->closeReqSubmitted) {
             context->closeReqSubmitted = true;
             WRITE_LOG(LOG_DEBUG, "OnFileIO fs_close, channelId:%u", thisClass->taskInfo->channelId);
             uv_fs_close(thisClass->loopTask, &context->fsCloseReq, context->fsOpenReq.result, OnFileClose);
@@ -388,6 +433,7 @@ void HdcTransferBase::OnFileOpen(uv_fs_t *req)
             WRITE_LOG(LOG_FATAL, "AddFeatureFlag failed");
             thisClass->SendToAnother(thisClass->commandBegin, nullptr, 0);
         } else {
+            context->tarLz4 = f.bits.tarLz4;
             thisClass->SendToAnother(thisClass->commandBegin, f.raw, sizeof(f));
         }
     }
@@ -449,59 +495,51 @@ int HdcTransferBase::GetSubFiles(const char *path, string filter, vector<string>
 int HdcTransferBase::GetSubFilesRecursively(string path, string currentDirname, vector<string> *out)
 {
     int retNum = 0;
-    uv_fs_t req = {};
-    uv_dirent_t dent;
-
     WRITE_LOG(LOG_DEBUG, "GetSubFiles path = %s currentDirname = %s", path.c_str(), currentDirname.c_str());
 
     if (!path.size()) {
         return retNum;
     }
-
-    if (uv_fs_scandir(nullptr, &req, path.c_str(), 0, nullptr) < 0) {
-        uv_fs_req_cleanup(&req);
-        return retNum;
-    }
-
     uv_fs_t fs = {};
     int ret = uv_fs_stat(nullptr, &fs, path.c_str(), nullptr);
+    uv_fs_req_cleanup(&fs);
     if (ret == 0) {
-        FileMode mode;
-        mode.fullName = currentDirname;
-        mode.perm = fs.statbuf.st_mode;
-        mode.uId = fs.statbuf.st_uid;
-        mode.gId = fs.statbuf.st_gid;
-
-#if (!(defined(HOST_MINGW)||defined(HOST_MAC))) && defined(SURPPORT_SELINUX)
-        char *con = nullptr;
-        getfilecon(path.c_str(), &con);
-        if (con != nullptr) {
-            mode.context = con;
-            freecon(con);
-        }
-#endif
-        ctxNow.dirMode.push_back(mode);
-    }
-    while (uv_fs_scandir_next(&req, &dent) != UV_EOF) {
-        // Skip. File
-        if (strcmp(dent.name, ".") == 0 || strcmp(dent.name, "..") == 0) {
+        AddDirMode(path, currentDirname, fs.statbuf);
+    }
+    DirWalker walker(path, DirWalker::STAT_DIRS);
+    walker.Start();
+    DirWalker::Item item;
+    while (walker.Next(item, true)) {
+        if (item.isDir) {
+            AddDirMode(path + Base::GetPathSep() + item.relative,
+                currentDirname + Base::GetPathSep() + item.relative, item.stat);
             continue;
         }
-        if (!(static_cast<uint32_t>(dent.type) & UV_DIRENT_FILE)) {
-            WRITE_LOG(LOG_DEBUG, "subdir dent.name fileName = %s", dent.name);
-            GetSubFilesRecursively(path + Base::GetPathSep() + dent.name,
-                currentDirname + Base::GetPathSep() + dent.name, out);
-            continue;
-        }
-        string fileName = dent.name;
-        WRITE_LOG(LOG_DEBUG, "GetSubFiles fileName = %s", fileName.c_str());
-
-        out->push_back(currentDirname + Base::GetPathSep() + fileName);
+        out->push_back(currentDirname + Base::GetPathSep() + item.relative);
+        ++retNum;
     }
-    uv_fs_req_cleanup(&req);
     return retNum;
 }
 
+void HdcTransferBase::AddDirMode(const string &path, const string &currentDirname, const uv_stat_t &st)
+{
+    FileMode mode;
+    mode.fullName = currentDirname;
+    mode.perm = st.st_mode;
+    mode.uId = st.st_uid;
+    mode.gId = st.st_gid;
+
+#if (!(defined(HOST_MINGW)||defined(HOST_MAC))) && defined(SURPPORT_SELINUX)
+    char *con = nullptr;
+    getfilecon(path.c_str(), &con);
+    if (con != nullptr) {
+        mode.context = con;
+        freecon(con);
+    }
+#endif
+    ctxNow.dirMode.push_back(mode);
+}
+
 
 bool HdcTransferBase::CheckLocalPath(string &localPath, string &optName, string &errStr)
 {
@@ -657,11 +695,19 @@ bool HdcTransferBase::RecvIOPayload(CtxFile *context, uint8_t *data, int dataSiz
         return false;
     }
     uint8_t *clearBuf = nullptr;
-    string serialString(reinterpret_cast<char *>(data), payloadPrefixReserve);
     TransferPayload pld;
     Base::ZeroStruct(pld);
     bool ret = false;
-    SerialStruct::ParseFromString(pld, serialString);
+    if (data[0] == payloadFixedMark) {
+        static_assert(payloadFixedSize <= payloadPrefixReserve);
+        pld.index = Base::LoadLe64(data + 1);
+        pld.compressType = data[1 + sizeof(uint64_t)];
+        pld.compressSize = Base::LoadLe32(data + 2 + sizeof(uint64_t));  // 2: mark and compressType
+        pld.uncompressSize = Base::LoadLe32(data + 2 + sizeof(uint64_t) + sizeof(uint32_t));
+    } else {
+        SerialStruct::ParseFromStringView(pld,
+            std::string_view(reinterpret_cast<char *>(data), payloadPrefixReserve));
+    }
     int clearSize = 0;
     StartTraceScope("HdcTransferBase::RecvIOPayload");
     if (pld.compressSize > static_cast<uint32_t>(dataSize) || pld.uncompressSize > MAX_SIZE_IOBUF) {
@@ -694,6 +740,11 @@ bool HdcTransferBase::RecvIOPayload(CtxFile *context, uint8_t *data, int dataSiz
             WRITE_LOG(LOG_WARN, "invalid data size for fileIO: %d", clearSize);
             break;
         }
+        if (context->tarLz4 && pld.index == 0 && clearSize >= static_cast<int>(sizeof(uint32_t)) &&
+            Base::LoadLe32(clearBuf) == Decompress::LZ4_MAGIC) {
+            // a tar as one lz4 frame, it may be more than the size in the check, the read of 0 ends it
+            context->fileSize = UINT64_MAX;
+        }
         if (SimpleFileIO(context, pld.index, clearBuf, clearSize) < 0) {
             break;
         }
@@ -775,12 +826,24 @@ bool HdcTransferBase::CheckFeatures(CtxFile *context, uint8_t *payload, const in
             WRITE_LOG(LOG_FATAL, "CheckFeatures memcpy_s failed");
             return false;
         }
-        WRITE_LOG(LOG_DEBUG, "isStableBuf:%d, hugeBuf:%d", isStableBuf, feature.bits.hugeBuf);
+        WRITE_LOG(LOG_DEBUG, "isStableBuf:%d, hugeBuf:%d appPipeline:%d tarLz4:%d", isStableBuf,
+                  feature.bits.hugeBuf, feature.bits.appPipeline, feature.bits.tarLz4);
         context->isStableBufSize = isStableBuf ? true : (!feature.bits.hugeBuf);
+        context->pipeline = feature.bits.appPipeline;
+        context->tarLz4 = feature.bits.tarLz4;
+        if (context->tarLz4 && context->master && context->tarStream != nullptr) {
+            if (!context->tarStream->StartLz4()) {
+                WRITE_LOG(LOG_WARN, "CheckFeatures tar of %s goes without lz4", context->localPath.c_str());
+            }
+            // the slave ends the tar on the read of 0, the frame may be more than the size in the check
+            context->fileSize = context->tarStream->Lz4Bound();
+        }
         return true;
     } else if (payloadSize == 0) {
         WRITE_LOG(LOG_DEBUG, "FileBegin CheckFeatures payloadSize:%d, use default feature.", payloadSize);
         context->isStableBufSize = true;
+        context->pipeline = false;
+        context->tarLz4 = false;
         return true;
     } else {
         WRITE_LOG(LOG_FATAL, "CheckFeatures payloadSize:%d", payloadSize);
@@ -15,8 +15,10 @@
 #ifndef HDC_TRANSFER_H
 #define HDC_TRANSFER_H
 #include "common.h"
+#include "dir_walker.h"
 
 namespace Hdc {
+class Compress;
 class HdcTransferBase : public HdcTaskBase {
 public:
     enum CompressType { COMPRESS_NONE, COMPRESS_LZ4, COMPRESS_LZ77, COMPRESS_LZMA, COMPRESS_BROTLI };
@@ -54,7 +56,9 @@ public:
         struct {
             uint8_t hugeBuf : 1; // bit 1: enable huge buffer 512K
             uint8_t compressLz4 : 1; // bit 2: enable compress default is lz4
-            uint8_t reserveBits1 : 6; // bit 3-8: reserved
+            uint8_t appPipeline : 1; // bit 3: app slave takes the next package while it installs one
+            uint8_t tarLz4 : 1; // bit 4: app slave takes the tar of a directory as one lz4 frame
+            uint8_t reserveBits1 : 4; // bit 5-8: reserved
             uint8_t reserveBits2 : 8; // bit 9-16: reserved
             uint16_t reserveBits3 : 16; // bit 17-32: reserved
             uint32_t reserveBits4 : 32; // bit 33-64: reserved
@@ -92,6 +96,9 @@ protected:
         bool closeReqSubmitted;
         bool isStableBufSize; // USB IO buffer size set stable value, false: 512K, true: 61K
         bool isFdOpen;
+        bool pipeline;  // app mode, the slave said appPipeline in its begin
+        bool tarLz4;    // app mode, the slave said tarLz4 in its begin
+        Compress *tarStream;  // master reads the tar of a directory as it is made, no file is opened
         void *thisClass;
         uint32_t lastErrno;
         uv_loop_t *loop;
@@ -116,12 +123,18 @@ protected:
     static void OnFileClose(uv_fs_t *req);
     int GetSubFiles(const char *path, string filter, vector<string> *out);
     int GetSubFilesRecursively(string path, string currentDirname, vector<string> *out);
+    // the mode of the directory at path, currentDirname on the slave, to the dir modes of ctxNow
+    void AddDirMode(const string &path, const string &currentDirname, const uv_stat_t &st);
     virtual void CheckMaster(CtxFile *context)
     {
     }
     virtual void WhenTransferFinish(CtxFile *context)
     {
     }
+    // master, all of the file is read and sent, the slave may not have it all yet
+    virtual void WhenSendFinish(CtxFile *context)
+    {
+    }
     bool MatchPackageExtendName(string fileName, string extName);
     bool ResetCtx(CtxFile *context, bool full = false);
     bool SmartSlavePath(string &cwd, string &localPath, const char *optName);
@@ -129,7 +142,7 @@ protected:
     bool CheckFilename(string &localPath, string &optName, string &errStr);
     void SetFileTime(CtxFile *context);
     void ExtractRelativePath(string &cwd, string &path);
-    bool AddFeatures(FeatureFlagsUnion &feature);
+    virtual bool AddFeatures(FeatureFlagsUnion &feature);
     bool CheckFeatures(CtxFile *context, uint8_t *payload, const int payloadSize);
 
     CtxFile ctxNow;
@@ -149,7 +162,13 @@ private:
         CtxFile *context;
     };
     static const uint8_t payloadPrefixReserve = 64;
+    // FEATURE_FIXED_HEAD: payloadFixedMark index(le64) compressType compressSize(le32) uncompressSize(le32).
+    // The SerialStruct one starts with the tag of index, never 0
+    static const uint8_t payloadFixedMark = 0;
+    static const uint8_t payloadFixedSize = 18;
     static void OnFileIO(uv_fs_t *req);
+    static void ReadTarStream(uv_work_t *req);
+    static void OnTarStreamRead(uv_work_t *req, int status);
     int SimpleFileIO(CtxFile *context, uint64_t index, uint8_t *sendBuf, int bytes);
     bool SendIOPayload(CtxFile *context, uint64_t index, uint8_t *data, int dataSize);
     bool RecvIOPayload(CtxFile *context, uint8_t *data, int dataSize);
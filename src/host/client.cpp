@@ -19,17 +19,20 @@
 // #include "host_updater.h"
 #include "server.h"
 #include "file.h"
+#ifndef _WIN32
+#include <poll.h>
+#endif
 
 std::map<std::string, std::string> g_lists;
 bool g_show = true;
 
 namespace Hdc {
 bool g_terminalStateChange = false;
+constexpr uint32_t CONNECT_SERVER_TIMEOUT = 12000;  // ms
 HdcClient::HdcClient(const bool serverOrClient, const string &addrString, uv_loop_t *loopMainIn, bool checkVersion)
     : HdcChannelBase(serverOrClient, addrString, loopMainIn)
 {
     MallocChannel(&channel);  // free by logic
-    debugRetryCount = 0;
 #ifndef _WIN32
     Base::ZeroStruct(terminalState);
 #endif
@@ -181,6 +184,9 @@ string HdcClient::AutoConnectKey(string &doCommand, const string &preConnectKey)
     vecNoConnectKeyCommand.push_back(CMDSTR_CONNECT_TARGET);
     vecNoConnectKeyCommand.push_back(CMDSTR_CHECK_DEVICE);
     vecNoConnectKeyCommand.push_back(CMDSTR_WAIT_FOR);
+    vecNoConnectKeyCommand.push_back(CMDSTR_SERVER_TRACE);
+    vecNoConnectKeyCommand.push_back(CMDSTR_SERVER_STAT);
+    vecNoConnectKeyCommand.push_back(CMDSTR_EACH);
     vecNoConnectKeyCommand.push_back(CMDSTR_FORWARD_FPORT + " ls");
     vecNoConnectKeyCommand.push_back(CMDSTR_FORWARD_FPORT + " rm");
     for (string v : vecNoConnectKeyCommand) {
@@ -313,6 +319,27 @@ void HdcClient::RunExecuteCommand(const string& cmd)
 #endif
 }
 
+#ifndef _WIN32
+// stdout of a pipe is non-blocking once the tty handle of libuv has it, a full pipe is waited for, nothing is dropped
+static void WriteStdout(const char *data, size_t size)
+{
+    fflush(stdout);
+    while (size > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, size);
+        if (n > 0) {
+            data += n;
+            size -= static_cast<size_t>(n);
+        } else if (n < 0 && errno == EAGAIN) {
+            struct pollfd pfd = { STDOUT_FILENO, POLLOUT, 0 };
+            (void)poll(&pfd, 1, -1);
+        } else if (n < 0 && errno != EINTR) {
+            WRITE_LOG(LOG_WARN, "write stdout failed errno:%d", errno);
+            return;
+        }
+    }
+}
+#endif
+
 bool IsCaptureCommand(const string& cmd)
 {
     int index = string(CMDSTR_HILOG).length();
@@ -362,7 +389,7 @@ int HdcClient::ExecuteCommand(const string &commandIn)
     ConnectServerForClient(ip, port);
     uv_timer_init(loopMain, &waitTimeDoCmd);
     waitTimeDoCmd.data = this;
-    uv_timer_start(&waitTimeDoCmd, CommandWorker, UV_START_TIMEOUT, UV_START_REPEAT);
+    uv_timer_start(&waitTimeDoCmd, CommandTimeout, CONNECT_SERVER_TIMEOUT, 0);
     WorkerPendding();
     return 0;
 }
@@ -384,15 +411,20 @@ int HdcClient::ConnectServerForClient(const char *ip, uint16_t port)
         return ERR_SOCKET_FAIL;
     }
     WRITE_LOG(LOG_DEBUG, "Try to connect %s:%d", ip, port);
+    tcpConnectRetryCount = 0;
+    uv_timer_init(loopMain, &retryTcpConnTimer);
+    retryTcpConnTimer.data = this;
+#ifdef HOST_LINUX
+    if (ConnectLocalServer(ip, port)) {
+        return 0;
+    }
+#endif
     uv_connect_t *conn = new(std::nothrow) uv_connect_t();
     if (conn == nullptr) {
         WRITE_LOG(LOG_FATAL, "ConnectServerForClient new conn failed");
         return ERR_GENERIC;
     }
     conn->data = this;
-    tcpConnectRetryCount = 0;
-    uv_timer_init(loopMain, &retryTcpConnTimer);
-    retryTcpConnTimer.data = this;
     if (strchr(ip, '.')) {
         isIpV4 = true;
         std::string s = ip;
@@ -413,49 +445,59 @@ int HdcClient::ConnectServerForClient(const char *ip, uint16_t port)
     return 0;
 }
 
-void HdcClient::CommandWorker(uv_timer_t *handle)
+#ifdef HOST_LINUX
+// a server on this host: the local channel, see channel_shm.h, false to go on with TCP
+bool HdcClient::ConnectLocalServer(const char *ip, uint16_t port)
 {
-    const uint16_t maxWaitRetry = 1200; // client socket try 12s
-    HdcClient *thisClass = (HdcClient *)handle->data;
-    if (++thisClass->debugRetryCount > maxWaitRetry) {
-        uv_timer_stop(handle);
-        uv_stop(thisClass->loopMain);
-        WRITE_LOG(LOG_DEBUG, "Connect server failed");
-        fprintf(stderr, "Connect server failed\n");
-        return;
+    string host = ip;
+    if (host.find(IPV4_MAPPING_PREFIX) == 0) {
+        host = host.substr(IPV4_MAPPING_PREFIX.size());
     }
-    if (!thisClass->channel->handshakeOK) {
+    char *env = getenv(ENV_LOCAL_CHANNEL.c_str());
+    if ((env != nullptr && strcmp(env, "0") == 0) || (host.find("127.") != 0 && host != "::1")) {
+        return false;
+    }
+    int fd = ChannelShm::Connect(port);
+    if (fd < 0) {
+        return false;
+    }
+    int memfd = ChannelShm::RecvFd(fd, ChannelShm::RECV_FD_TIMEOUT);
+    ChannelShm *shm = memfd >= 0 ? ChannelShm::Attach(memfd) : nullptr;
+    if (memfd >= 0) {
+        close(memfd);
+    }
+    if (shm == nullptr || uv_tcp_open(&channel->hWorkTCP, fd) < 0) {
+        WRITE_LOG(LOG_WARN, "local channel %s failed, go on with TCP", ChannelShm::LocalName(port).c_str());
+        delete shm;
+        close(fd);
+        return false;
+    }
+    channel->shm = shm;
+    WRITE_LOG(LOG_DEBUG, "ConnectServerForClient local %s", ChannelShm::LocalName(port).c_str());
+    BindLocalStd(channel);
+    uv_read_start((uv_stream_t *)&channel->hWorkTCP, AllocCallback, ReadStream);
+    return true;
+}
+#endif
+
+// the command goes out at the end of the channel handshake, see PreHandshake, the timer only bounds the wait
+void HdcClient::CommandTimeout(uv_timer_t *handle)
+{
+    HdcClient *thisClass = (HdcClient *)handle->data;
+    if (thisClass->channel->handshakeOK) {
         return;
     }
-    uv_timer_stop(handle);
+    uv_stop(thisClass->loopMain);
+    WRITE_LOG(LOG_DEBUG, "Connect server failed");
+    fprintf(stderr, "Connect server failed\n");
+}
+
+void HdcClient::SendCommand()
+{
+    uv_timer_stop(&waitTimeDoCmd);
     WRITE_LOG(LOG_DEBUG, "Connect server successful");
-//     bool closeInput = false;
-//     if (!HostUpdater::ConfirmCommand(thisClass->command, closeInput)) {
-//         uv_timer_stop(handle);
-//         uv_stop(thisClass->loopMain);
-//         WRITE_LOG(LOG_DEBUG, "Cmd \'%s\' has been canceld", thisClass->command.c_str());
-//         return;
-//     }
-//     while (closeInput) {
-// #ifndef _WIN32
-//         if (tcgetattr(STDIN_FILENO, &thisClass->terminalState)) {
-//             break;
-//         }
-//         termios tio;
-//         if (tcgetattr(STDIN_FILENO, &tio)) {
-//             break;
-//         }
-//         cfmakeraw(&tio);
-//         tio.c_cc[VTIME] = 0;
-//         tio.c_cc[VMIN] = 1;
-//         tcsetattr(STDIN_FILENO, TCSAFLUSH, &tio);
-//         g_terminalStateChange = true;
-// #endif
-//         break;
-//     }
-    thisClass->Send(thisClass->channel->channelId,
-                    const_cast<uint8_t *>(reinterpret_cast<const uint8_t *>(thisClass->command.c_str())),
-                    thisClass->command.size() + 1);
+    Send(channel->channelId, const_cast<uint8_t *>(reinterpret_cast<const uint8_t *>(command.c_str())),
+         command.size() + 1);
 }
 
 void HdcClient::AllocStdbuf(uv_handle_t *handle, size_t sizeWanted, uv_buf_t *buf)
@@ -507,8 +549,25 @@ void HdcClient::ModifyTty(bool setOrRestore, uv_tty_t *tty)
     }
 }
 
+void HdcClient::SetOutput(std::function<void(const char *data, const int size)> callback)
+{
+    outputCallback = callback;
+}
+
+void HdcClient::Output(const char *data, const int size)
+{
+    if (outputCallback) {
+        outputCallback(data, size);
+        return;
+    }
+    HdcChannelBase::Output(data, size);
+}
+
 void HdcClient::BindLocalStd(HChannel hChannel)
 {
+    if (outputCallback) {
+        return;
+    }
     if (command == CMDSTR_SHELL) {
         bShellInteractive = true;
     }
@@ -562,8 +621,10 @@ void HdcClient::Connect(uv_connect_t *connection, int status)
         thisClass->FreeChannel(hChannel->channelId);
         return;
     }
+    uint32_t wait = Base::GetBackoffTime(thisClass->tcpConnectRetryCount, TCP_CONNECT_RETRY_BASE_MS,
+                                         TCP_CONNECT_RETRY_TIME_MS);
     thisClass->tcpConnectRetryCount++;
-    uv_timer_start(&(thisClass->retryTcpConnTimer), thisClass->RetryTcpConnectWorker, TCP_CONNECT_RETRY_TIME_MS, 0);
+    uv_timer_start(&(thisClass->retryTcpConnTimer), thisClass->RetryTcpConnectWorker, wait, 0);
 }
 
 void HdcClient::RetryTcpConnectWorker(uv_timer_t *handle)
@@ -634,12 +695,14 @@ int HdcClient::PreHandshake(HChannel hChannel, const uint8_t *buf)
     Send(hChannel->channelId, reinterpret_cast<uint8_t *>(hShake), offsetof(struct ChannelHandShake, version));
 #endif
     hChannel->handshakeOK = true;
+    connected = true;
 #ifdef HDC_CHANNEL_KEEP_ALIVE
     // Evaluation method, non long-term support
     Send(hChannel->channelId,
          reinterpret_cast<uint8_t *>(const_cast<char*>(CMDSTR_INNER_ENABLE_KEEPALIVE.c_str())),
          CMDSTR_INNER_ENABLE_KEEPALIVE.size());
 #endif
+    SendCommand();
     return RET_SUCCESS;
 }
 
@@ -664,8 +727,8 @@ int HdcClient::ReadChannel(HChannel hChannel, uint8_t *buf, const int bytesIO)
     if (cmd == CMD_CHECK_SERVER && isCheckVersionCmd) {
         WRITE_LOG(LOG_DEBUG, "recieve CMD_CHECK_VERSION command");
         string version(reinterpret_cast<char *>(buf + sizeof(uint16_t)), bytesIO - sizeof(uint16_t));
-        fprintf(stdout, "Client version:%s, server version:%s\n", Base::GetVersion().c_str(), version.c_str());
-        fflush(stdout);
+        string text = "Client version:" + Base::GetVersion() + ", server version:" + version + "\n";
+        Output(text.c_str(), text.size());
         return 0;
     }
     if (hChannel->remote > RemoteType::REMOTE_NONE && bOffset) {
@@ -698,25 +761,18 @@ int HdcClient::ReadChannel(HChannel hChannel, uint8_t *buf, const int bytesIO)
     if (WaitFor(s)) {
         return 0;
     }
+    if (outputCallback) {
+        outputCallback(s.c_str(), s.size());
+        return 0;
+    }
     s = ListTargetsAll(s);
     if (g_show) {
 #ifdef _WIN32
         fprintf(stdout, "%s", s.c_str());
         fflush(stdout);
 #else
-        constexpr int len = 512;
-        int size = s.size() / len;
-        int left = s.size() % len;
-        for (int i = 0; i <= size; i++) {
-            int cnt = len;
-            const char *p = reinterpret_cast<char *>(buf) + i * cnt;
-            if (i == size) {
-                cnt = left;
-            }
-            fprintf(stdout, "%.*s", cnt, p);
-            fflush(stdout);
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
+        // one write of the packet, a tail of the log is many of them
+        WriteStdout(s.c_str(), s.size());
 #endif
     }
     return 0;
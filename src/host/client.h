@@ -30,6 +30,14 @@ public:
     int Initial(const string &connectKeyIn);
     int ExecuteCommand(const string &commandIn);
     int CtrlServiceWork(const char *commandIn);
+    // the output of the command to callback instead of stdout, and no stdio of the terminal
+    void SetOutput(std::function<void(const char *data, const int size)> callback);
+    void Output(const char *data, const int size) override;
+    // the channel handshake with the server was done
+    bool Connected() const
+    {
+        return connected;
+    }
 
 protected:
 private:
@@ -37,9 +45,13 @@ private:
     static void Connect(uv_connect_t *connection, int status);
     static void AllocStdbuf(uv_handle_t *handle, size_t sizeWanted, uv_buf_t *buf);
     static void ReadStd(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf);
-    static void CommandWorker(uv_timer_t *handle);
+    static void CommandTimeout(uv_timer_t *handle);
+    void SendCommand();
     static void RetryTcpConnectWorker(uv_timer_t *handle);
     int ConnectServerForClient(const char *ip, uint16_t port);
+#ifdef HOST_LINUX
+    bool ConnectLocalServer(const char *ip, uint16_t port);
+#endif
     int ReadChannel(HChannel hChannel, uint8_t *buf, const int bytesIO) override;
     int PreHandshake(HChannel hChannel, const uint8_t *buf);
     string AutoConnectKey(string &doCommand, const string &preConnectKey) const;
@@ -69,7 +81,6 @@ private:
 #endif
     string connectKey;
     string command;
-    uint16_t debugRetryCount;
     bool bShellInteractive = false;
     uv_timer_t waitTimeDoCmd;
     uv_check_t ctrlServerWork;
@@ -82,6 +93,8 @@ private:
     struct sockaddr_in6 dest;
     uv_timer_t retryTcpConnTimer;
     uint16_t tcpConnectRetryCount = 0;
+    std::function<void(const char *data, const int size)> outputCallback;
+    bool connected = false;
 };
 }  // namespace Hdc
 #endif
@@ -21,32 +21,46 @@ HdcHostApp::HdcHostApp(HTaskInfo hTaskInfo)
 {
     commandBegin = CMD_APP_BEGIN;
     commandData = CMD_APP_DATA;
-    originLocalDir = "";
     isStableBuf = hTaskInfo->isStableBuf;
 }
 
 HdcHostApp::~HdcHostApp()
 {
+    delete tarStream;
 }
 
-string HdcHostApp::Dir2Tar(const char *dir)
+bool HdcHostApp::IsDir(const string &path)
 {
-    WRITE_LOG(LOG_DEBUG, "dir:%s", dir);
-    string tarpath;
     uv_fs_t req;
-    int r = uv_fs_lstat(nullptr, &req, dir, nullptr);
+    int r = uv_fs_lstat(nullptr, &req, path.c_str(), nullptr);
     uv_fs_req_cleanup(&req);
-    if (r == 0 && (req.statbuf.st_mode & S_IFDIR)) {  // is dir
-        string sdir = dir;
-        string tarname = Base::GetRandomString(EXPECTED_LEN) + ".tar";
-        tarpath = Base::GetTmpDir() + tarname;
-        WRITE_LOG(LOG_DEBUG, "tarpath:%s", tarpath.c_str());
-        Compress c;
-        c.UpdataPrefix(sdir);
-        c.AddPath(sdir);
-        c.SaveToFile(tarpath);
-    }
-    return tarpath;
+    return r == 0 && (req.statbuf.st_mode & S_IFDIR);
+}
+
+// the tar of the directory is made as it is sent, the size is known from the walk. The size in the check is the one
+// of the tar, or the most its lz4 frame can be once a begin of the daemon has said tarLz4 in this task
+bool HdcHostApp::OpenTarStream(CtxFile *context)
+{
+    delete tarStream;
+    context->tarStream = nullptr;
+    tarStream = new(std::nothrow) Compress();
+    if (tarStream == nullptr) {
+        return false;
+    }
+    tarStream->UpdataPrefix(context->localPath);
+    if (!tarStream->AddPath(context->localPath)) {
+        WRITE_LOG(LOG_WARN, "tar of dir:%s is not complete", context->localPath.c_str());
+    }
+    ResetCtx(context);
+    context->tarStream = tarStream;
+    uint64_t tarSize = tarStream->Layout();
+    context->fileSize = context->tarLz4 ? tarStream->Lz4Bound() : tarSize;
+    WRITE_LOG(LOG_DEBUG, "tar of dir:%s size:%" PRIu64 " bound:%" PRIu64, context->localPath.c_str(), tarSize,
+              context->fileSize);
+    context->fsOpenReq.result = -1;
+    context->master = true;
+    CheckMaster(context);
+    return true;
 }
 
 bool HdcHostApp::BeginInstall(CtxFile *context, const char *command)
@@ -73,14 +87,8 @@ bool HdcHostApp::BeginInstall(CtxFile *context, const char *command)
         } else {
             string path = argv[i];
             ExtractRelativePath(context->transferConfig.clientCwd, path);
-            if (MatchPackageExtendName(path, ".hap") || MatchPackageExtendName(path, ".hsp")) {
+            if (MatchPackageExtendName(path, ".hap") || MatchPackageExtendName(path, ".hsp") || IsDir(path)) {
                 context->taskQueue.push_back(path);
-            } else {
-                string tarpath = Dir2Tar(path.c_str());
-                if (!tarpath.empty()) {
-                    context->taskQueue.push_back(tarpath);
-                    originLocalDir = path;
-                }
             }
         }
     }
@@ -94,6 +102,7 @@ bool HdcHostApp::BeginInstall(CtxFile *context, const char *command)
 
     context->transferConfig.options = options;
     context->transferConfig.functionName = CMDSTR_APP_INSTALL;
+    installBegin = Base::GetRuntimeMSec();
     RunQueue(context);
     ret = true;
 Finish:
@@ -115,22 +124,54 @@ Finish:
 
 void HdcHostApp::RunQueue(CtxFile *context)
 {
-    ++refCount;
     context->localPath = context->taskQueue.back();
+    context->taskQueue.pop_back();
+    installing.push_back({ context->localPath, Base::GetRuntimeMSec(), 0, 0 });
+    if (IsDir(context->localPath)) {
+        if (!OpenTarStream(context)) {
+            LogMsg(MSG_FAIL, "Tar of %s failed", context->localPath.c_str());
+            TaskFinish();
+        }
+        return;
+    }
+    ++refCount;
+    context->tarStream = nullptr;
     uv_fs_open(loopTask, &context->fsOpenReq, context->localPath.c_str(), O_RDONLY, 0, OnFileOpen);
     context->master = true;
 }
 
+// one package at a time is sent, the next one goes when it is sent if the daemon takes it while installing
+void HdcHostApp::RunNext()
+{
+    if (singalStop || ctxNow.taskQueue.empty()) {
+        return;
+    }
+    if (!installing.empty() && installing.back().sendTime == 0) {
+        return;
+    }
+    size_t depth = ctxNow.pipeline ? APP_PIPELINE_DEPTH : 1;
+    if (installing.size() >= depth) {
+        return;
+    }
+    RunQueue(&ctxNow);
+}
+
 void HdcHostApp::CheckMaster(CtxFile *context)
 {
-    uv_fs_t fs = {};
-    uv_fs_fstat(nullptr, &fs, context->fsOpenReq.result, nullptr);
-    context->transferConfig.fileSize = fs.statbuf.st_size;
-    uv_fs_req_cleanup(&fs);
+    if (context->tarStream != nullptr) {
+        context->transferConfig.fileSize = context->fileSize;
+    } else {
+        uv_fs_t fs = {};
+        uv_fs_fstat(nullptr, &fs, context->fsOpenReq.result, nullptr);
+        context->transferConfig.fileSize = fs.statbuf.st_size;
+        uv_fs_req_cleanup(&fs);
+    }
 
     context->transferConfig.optionalName
         = Base::GetRandomString(EXPECTED_LEN);  // Prevent the name of illegal APP leads to pm unable to install
-    if (context->localPath.find(".hap") != static_cast<size_t>(-1)) {
+    if (context->tarStream != nullptr) {
+        context->transferConfig.optionalName += ".tar";
+    } else if (context->localPath.find(".hap") != static_cast<size_t>(-1)) {
         context->transferConfig.optionalName += ".hap";
     } else if (context->localPath.find(".hsp") != static_cast<size_t>(-1)) {
         context->transferConfig.optionalName += ".hsp";
@@ -161,29 +202,64 @@ bool HdcHostApp::CheckInstallContinue(AppModType mode, bool lastResult, const ch
             modeDesc = "Unknown";
             break;
     }
-    if (ctxNow.taskQueue.size() > 0) {
-        string path = ctxNow.taskQueue.back();
-        ctxNow.taskQueue.pop_back();
-        string::size_type pos = path.rfind(".tar");
-        if (mode == APPMOD_INSTALL && pos != string::npos) {
-            unlink(path.c_str());
-            WRITE_LOG(LOG_DEBUG, "unlink path:%s", path.c_str());
-        }
+    AppPackage package = {};
+    if (installing.size() > 0) {
+        package = installing.front();
+        installing.pop_front();
     }
-    string path = ctxNow.localPath;
-    if (!originLocalDir.empty()) {
-        path = originLocalDir;
-    }
-    LogMsg(MSG_INFO, "%s path:%s msg:%s", modeDesc.c_str(), path.c_str(), msg + printedMsgLen);
+    LogMsg(MSG_INFO, "%s path:%s msg:%s", modeDesc.c_str(), package.localPath.c_str(), msg + printedMsgLen);
     printedMsgLen = strlen(msg);
-    if (singalStop || !ctxNow.taskQueue.size()) {
+    if (mode == APPMOD_INSTALL) {
+        package.finishTime = Base::GetRuntimeMSec();
+        installed.push_back(package);
+    }
+    if (singalStop || (ctxNow.taskQueue.empty() && installing.empty())) {
+        if (installed.size() > 1) {
+            LogMsg(MSG_INFO, "%s", TimingReport().c_str());
+        }
         LogMsg(MSG_OK, "AppMod finish");
         return false;
     }
-    RunQueue(&ctxNow);
+    RunNext();
     return true;
 }
 
+void HdcHostApp::WhenSendFinish(CtxFile *context)
+{
+    if (installing.empty() || context->indexIO < context->fileSize) {
+        return;
+    }
+    installing.back().sendTime = Base::GetRuntimeMSec();
+    bool lz4 = context->tarStream != nullptr && context->tarStream->IsLz4();
+    WRITE_LOG(LOG_DEBUG, "app sent path:%s size:%" PRIu64 " lz4:%d pipeline:%d installing:%zu",
+              context->localPath.c_str(), context->indexIO, lz4, context->pipeline, installing.size());
+    RunNext();
+}
+
+// the install of a package is counted from when it is sent or the one before it is finished
+string HdcHostApp::TimingReport()
+{
+    uint64_t transferSum = 0;
+    uint64_t installSum = 0;
+    uint64_t lastFinish = 0;
+    string report;
+    for (const AppPackage &p : installed) {
+        uint64_t sendTime = p.sendTime ? p.sendTime : p.finishTime;
+        uint64_t transfer = sendTime - p.beginTime;
+        uint64_t install = p.finishTime - std::max(sendTime, lastFinish);
+        lastFinish = p.finishTime;
+        transferSum += transfer;
+        installSum += install;
+        string name = p.localPath;
+        report += Base::StringFormat("\n  %s transfer:%" PRIu64 "ms install:%" PRIu64 "ms",
+                                     Base::GetFileNameAny(name).c_str(), transfer, install);
+    }
+    uint64_t total = lastFinish - installBegin;
+    return Base::StringFormat("App install %zu packages %" PRIu64 "ms, transfer:%" PRIu64 "ms install:%" PRIu64
+                              "ms%s", installed.size(), total, transferSum, installSum,
+                              ctxNow.pipeline ? " pipelined" : "") + report;
+}
+
 bool HdcHostApp::CommandDispatch(const uint16_t command, uint8_t *payload, const int payloadSize)
 {
     if (!HdcTransferBase::CommandDispatch(command, payload, payloadSize)) {
@@ -205,7 +281,7 @@ bool HdcHostApp::CommandDispatch(const uint16_t command, uint8_t *payload, const
         }
         case CMD_APP_UNINSTALL: {
             SendToAnother(CMD_APP_UNINSTALL, payload, payloadSize);
-            ctxNow.taskQueue.push_back(reinterpret_cast<char *>(payload));  // just compatible
+            installing.push_back({ "", Base::GetRuntimeMSec(), 0, 0 });  // just compatible
             break;
         }
         // case CMD_APP_SIDELOAD: {
@@ -24,14 +24,31 @@ public:
     bool CommandDispatch(const uint16_t command, uint8_t *payload, const int payloadSize) override;
 
 private:
+    // a package sent to the daemon and not finished yet, times in ms
+    struct AppPackage {
+        string localPath;
+        uint64_t beginTime;
+        uint64_t sendTime;  // 0 while it is sent
+        uint64_t finishTime;
+    };
+    // packages a daemon with appPipeline holds at once, the one it installs and the next ones it is sent
+    static constexpr size_t APP_PIPELINE_DEPTH = 2;
+
     bool BeginInstall(CtxFile *context, const char *command);
     void CheckMaster(CtxFile *context) override;
+    void WhenSendFinish(CtxFile *context) override;
     bool CheckInstallContinue(AppModType mode, bool lastResult, const char *msg);
     void RunQueue(CtxFile *context);
+    void RunNext();
+    string TimingReport();
     // bool BeginSideload(CtxFile *context, const char *localPath);
-    string Dir2Tar(const char *dir);
+    bool IsDir(const string &path);
+    bool OpenTarStream(CtxFile *context);
     size_t printedMsgLen = 0;
-    string originLocalDir = "";
+    Compress *tarStream = nullptr;
+    std::deque<AppPackage> installing;
+    vector<AppPackage> installed;
+    uint64_t installBegin = 0;
 };
 }
 #endif
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "host_batch.h"
+#include <fstream>
+#include <iostream>
+
+namespace Hdc {
+const string HdcHostBatch::FRAME_TAG = "hdcbatch";
+// they own the terminal, the server process or the client process, not one command of many
+static const vector<string> BATCH_REFUSED = { CMDSTR_WAIT_FOR, CMDSTR_BENCH, CMDSTR_BATCH, CMDSTR_SERVICE_START,
+                                              CMDSTR_SERVICE_KILL, CMDSTR_GENERATE_KEY };
+
+HdcHostBatch::HdcHostBatch(const string &serverListenStringIn, const string &connectKeyIn)
+    : serverListenString(serverListenStringIn), connectKey(connectKeyIn)
+{
+    workers = 1;
+    inputEnd = false;
+    failed = 0;
+}
+
+HdcHostBatch::~HdcHostBatch()
+{
+}
+
+bool HdcHostBatch::ParseOption(const string &command)
+{
+    int argc = 0;
+    char **argv = Base::SplitCommandToArgs(command.c_str(), &argc);
+    if (argv == nullptr) {
+        return false;
+    }
+    bool ret = true;
+    // argv[0] is 'batch'
+    for (int i = 1; i < argc && ret; ++i) {
+        string option = argv[i];
+        if (option == "-j" && i + 1 < argc) {
+            int value = atoi(argv[++i]);
+            ret = value > 0 && value <= MAX_WORKERS;
+            workers = static_cast<uint16_t>(value);
+        } else if (inputFile.empty() && (option == "-" || option[0] != '-')) {
+            inputFile = option;
+        } else {
+            ret = false;
+        }
+    }
+    delete[](reinterpret_cast<char *>(argv));
+    return ret;
+}
+
+bool HdcHostBatch::ParseLine(const string &line, Command &cmd)
+{
+    string s = line;
+    Base::Trim(s);
+    if (s.empty() || s[0] == '#') {
+        return false;
+    }
+    cmd.connectKey = connectKey;
+    if (!s.compare(0, strlen("-t "), "-t ")) {
+        s = s.substr(strlen("-t "));
+        Base::Trim(s);
+        size_t pos = s.find(' ');
+        cmd.connectKey = s.substr(0, pos);
+        s = pos == string::npos ? "" : s.substr(pos + 1);
+        Base::Trim(s);
+    }
+    cmd.command = s;
+    return true;
+}
+
+int HdcHostBatch::Execute(const Command &cmd, string &output)
+{
+    if (cmd.command.empty() || cmd.command == CMDSTR_SHELL) {
+        output = MESSAGE_FAIL + "Not a batch command\n";
+        return STATUS_ERROR;
+    }
+    for (const string &refused : BATCH_REFUSED) {
+        if (!cmd.command.compare(0, refused.size(), refused)) {
+            output = MESSAGE_FAIL + "Not a batch command\n";
+            return STATUS_ERROR;
+        }
+    }
+    bool connected = false;
+    {
+        uv_loop_t loop;
+        uv_loop_init(&loop);
+        HdcClient client(false, serverListenString, &loop, cmd.command == CMDSTR_CHECK_SERVER);
+        client.SetOutput([&output](const char *data, const int size) { output.append(data, size); });
+        client.Initial(cmd.connectKey);
+        client.ExecuteCommand(cmd.command);
+        connected = client.Connected();
+    }
+    if (!connected) {
+        output += MESSAGE_FAIL + "Connect server failed\n";
+        return STATUS_ERROR;
+    }
+    if (!output.compare(0, MESSAGE_FAIL.size(), MESSAGE_FAIL) || output.find("\n" + MESSAGE_FAIL) != string::npos) {
+        return STATUS_FAIL;
+    }
+    return STATUS_OK;
+}
+
+void HdcHostBatch::WriteFrame(uint32_t seq, int status, const string &output)
+{
+    std::lock_guard<std::mutex> lock(outputMutex);
+    fprintf(stdout, "%s %u %d %zu\n", FRAME_TAG.c_str(), seq, status, output.size());
+    fwrite(output.data(), 1, output.size(), stdout);
+    fflush(stdout);
+    if (status != STATUS_OK) {
+        ++failed;
+    }
+}
+
+void HdcHostBatch::Worker()
+{
+    while (true) {
+        Command cmd;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCond.wait(lock, [this]() { return !commands.empty() || inputEnd; });
+            if (commands.empty()) {
+                return;
+            }
+            cmd = commands.front();
+            commands.pop();
+        }
+        string output;
+        uint64_t begin = Metrics::NowUs();
+        int status = Execute(cmd, output);
+        WRITE_LOG(LOG_DEBUG, "batch seq:%u status:%d time:%" PRIu64 "us command:%s", cmd.seq, status,
+                  Metrics::NowUs() - begin, cmd.command.c_str());
+        WriteFrame(cmd.seq, status, output);
+    }
+}
+
+int HdcHostBatch::Run(const string &command)
+{
+    if (!ParseOption(command)) {
+        Base::PrintMessage("Error batch command, use 'batch [-j N] [FILE]'");
+        return ERR_PARM_FAIL;
+    }
+    std::ifstream file;
+    if (!inputFile.empty() && inputFile != "-") {
+        file.open(inputFile);
+        if (!file.is_open()) {
+            Base::PrintMessage("Open %s failed", inputFile.c_str());
+            return ERR_FILE_OPEN;
+        }
+    }
+    std::istream &input = file.is_open() ? static_cast<std::istream &>(file) : std::cin;
+    vector<std::thread> threads;
+    for (uint16_t i = 0; i < workers; ++i) {
+        threads.emplace_back(&HdcHostBatch::Worker, this);
+    }
+    // the commands go as soon as they are read, a harness may write the next one after a frame
+    string line;
+    uint32_t seq = 0;
+    while (std::getline(input, line)) {
+        Command cmd;
+        if (!ParseLine(line, cmd)) {
+            continue;
+        }
+        cmd.seq = ++seq;
+        std::lock_guard<std::mutex> lock(queueMutex);
+        commands.push(cmd);
+        queueCond.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        inputEnd = true;
+        queueCond.notify_all();
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    return failed == 0 ? RET_SUCCESS : ERR_GENERIC;
+}
+}  // namespace Hdc
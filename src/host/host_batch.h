@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_HOST_BATCH_H
+#define HDC_HOST_BATCH_H
+#include "host_common.h"
+
+namespace Hdc {
+// 'hdc batch [-j N] [FILE]': the commands of FILE, or of stdin without it or with '-', one per line as
+// '[-t KEY] command', run by one process. Empty lines and lines beginning with '#' are skipped.
+// N workers (1) take the commands in order as they are read, each runs one at a time as a normal client command on
+// its own loop, so a command costs a channel connect and handshake to the server, not a new process.
+// The output of a command is written when it is done, as one frame:
+//   "hdcbatch SEQ STATUS LENGTH\n" then LENGTH bytes
+// SEQ is the number of the command from 1, in the order of reading. STATUS is STATUS_OK, STATUS_FAIL if the server
+// or the daemon said [Fail], STATUS_ERROR if the command did not run. With N > 1 frames come in the order of ending.
+class HdcHostBatch {
+public:
+    static constexpr int STATUS_OK = 0;
+    static constexpr int STATUS_FAIL = 1;
+    static constexpr int STATUS_ERROR = 2;
+    static const string FRAME_TAG;
+
+    HdcHostBatch(const string &serverListenStringIn, const string &connectKeyIn);
+    virtual ~HdcHostBatch();
+    // RET_SUCCESS when every command is STATUS_OK, a RetErrCode when one is not or the batch cannot run
+    int Run(const string &command);
+
+private:
+    struct Command {
+        uint32_t seq;
+        string connectKey;
+        string command;
+    };
+    static constexpr uint16_t MAX_WORKERS = 64;
+
+    bool ParseOption(const string &command);
+    bool ParseLine(const string &line, Command &cmd);
+    void Worker();
+    int Execute(const Command &cmd, string &output);
+    void WriteFrame(uint32_t seq, int status, const string &output);
+
+    string serverListenString;
+    string connectKey;
+    string inputFile;
+    uint16_t workers;
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::queue<Command> commands;
+    bool inputEnd;
+    std::mutex outputMutex;
+    uint32_t failed;
+};
+}  // namespace Hdc
+
+#endif
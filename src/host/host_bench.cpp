@@ -0,0 +1,853 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "host_bench.h"
+#include "compress.h"
+#include "decompress.h"
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+namespace Hdc {
+constexpr uint32_t BENCH_DEFAULT_SIZE_MB = 64;
+constexpr uint32_t BENCH_DEFAULT_COUNT = 100;
+constexpr uint32_t BENCH_MAX_SIZE_MB = 4096;
+constexpr uint32_t BENCH_MAX_COUNT = 100000;
+constexpr uint32_t BENCH_IO_SIZE = 64 * 1024;
+constexpr uint16_t BENCH_CONNECT_RETRY = 50;
+constexpr uint16_t BENCH_CONNECT_INTERVAL = 100;  // ms
+// devices coming back at once after a network blip, each session takes a thread of the uv pool on both sides
+constexpr uint32_t BENCH_STORM_TARGETS = 8;
+// a hap directory of resources, many small files
+constexpr uint32_t BENCH_UNTAR_FILES = 20000;
+constexpr uint32_t BENCH_UNTAR_FILE_SIZE = 2048;
+constexpr uint32_t BENCH_INSTALL_FILES = 64;
+constexpr uint32_t BENCH_INSTALL_PACKAGES = 4;
+constexpr double BENCH_US_PER_MS = 1000.0;
+constexpr double BENCH_US_PER_SEC = 1000000.0;
+constexpr double BENCH_BYTES_PER_MB = 1024.0 * 1024.0;
+static const string BENCH_ECHO = "hdcbench";
+static const string BENCH_REMOTE_DIR = "/data/local/tmp/";
+
+HdcHostBench::HdcHostBench(const string &serverListenStringIn, const string &connectKeyIn)
+    : serverListenString(serverListenStringIn), connectKey(connectKeyIn)
+{
+    sizeMB = BENCH_DEFAULT_SIZE_MB;
+    count = BENCH_DEFAULT_COUNT;
+    daemon = nullptr;
+}
+
+HdcHostBench::~HdcHostBench()
+{
+    Finish();
+}
+
+bool HdcHostBench::ParseOption(const string &command)
+{
+    int argc = 0;
+    char **argv = Base::SplitCommandToArgs(command.c_str(), &argc);
+    if (argv == nullptr) {
+        return false;
+    }
+    bool ret = true;
+    // argv[0] is 'bench'
+    for (int i = 1; i < argc && ret; ++i) {
+        string option = argv[i];
+        if ((option != "-s" && option != "-n") || i + 1 >= argc) {
+            ret = false;
+            break;
+        }
+        int value = atoi(argv[++i]);
+        if (option == "-s") {
+            ret = value > 0 && static_cast<uint32_t>(value) <= BENCH_MAX_SIZE_MB;
+            sizeMB = static_cast<uint32_t>(value);
+        } else {
+            ret = value > 0 && static_cast<uint32_t>(value) <= BENCH_MAX_COUNT;
+            count = static_cast<uint32_t>(value);
+        }
+    }
+    delete[](reinterpret_cast<char *>(argv));
+    return ret;
+}
+
+bool HdcHostBench::RunCommand(const string &command, string &output)
+{
+    output.clear();
+    string capture = Base::GetTmpDir() + "hdc_bench_" + std::to_string(getpid()) + ".out";
+    FILE *fp = fopen(capture.c_str(), "w+");
+    if (fp == nullptr) {
+        WRITE_LOG(LOG_FATAL, "bench open %s failed errno:%d", capture.c_str(), errno);
+        return false;
+    }
+    fflush(stdout);
+    int stdoutSave = dup(STDOUT_FILENO);
+    dup2(fileno(fp), STDOUT_FILENO);
+    {
+        uv_loop_t loop;
+        uv_loop_init(&loop);
+        HdcClient client(false, serverListenString, &loop);
+        client.Initial(connectKey);
+        client.ExecuteCommand(command);
+    }
+    fflush(stdout);
+    dup2(stdoutSave, STDOUT_FILENO);
+    close(stdoutSave);
+    fseek(fp, 0, SEEK_SET);
+    char buf[BUF_SIZE_DEFAULT];
+    size_t n = 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        output.append(buf, n);
+    }
+    fclose(fp);
+    unlink(capture.c_str());
+    WRITE_LOG(LOG_DEBUG, "bench command:%s output:%s", command.c_str(), output.c_str());
+    return true;
+}
+
+uint64_t HdcHostBench::GetDaemonPackets()
+{
+    uint64_t packets = 0;
+    if (daemon != nullptr) {
+        daemon->EnumSession([&packets](HSession hSession) {
+            packets += hSession->stat.sendPackets + hSession->stat.recvPackets;
+        });
+    }
+    return packets;
+}
+
+bool HdcHostBench::Prepare()
+{
+    string output;
+    if (!connectKey.empty()) {
+        localFile = Base::GetTmpDir() + "hdc_bench_local.bin";
+        remoteFile = BENCH_REMOTE_DIR + "hdc_bench.bin";
+        return true;
+    }
+    int port = HdcLoopbackDaemon::Start(&daemon, daemonThread);
+    if (port <= 0) {
+        Base::PrintMessage("Start loopback daemon failed");
+        return false;
+    }
+    connectKey = "127.0.0.1:" + std::to_string(port);
+    localFile = Base::GetTmpDir() + "hdc_bench_local.bin";
+    remoteFile = Base::GetTmpDir() + "hdc_bench_remote.bin";
+    // tconn returns before the handshake, wait for the target to be listed as connected
+    string key = connectKey;
+    connectKey = "";
+    RunCommand(CMDSTR_CONNECT_TARGET + " " + key, output);
+    for (uint16_t i = 0; i < BENCH_CONNECT_RETRY; ++i) {
+        RunCommand(CMDSTR_LIST_TARGETS, output);
+        if (output.find(key) != string::npos) {
+            connectKey = key;
+            return true;
+        }
+        uv_sleep(BENCH_CONNECT_INTERVAL);
+    }
+    Base::PrintMessage("Connect loopback daemon %s failed", key.c_str());
+    return false;
+}
+
+void HdcHostBench::Finish()
+{
+    if (daemon == nullptr && !daemonThread.joinable()) {
+        return;
+    }
+    string output;
+    if (!connectKey.empty()) {
+        string key = connectKey;
+        connectKey = "";
+        RunCommand(CMDSTR_CONNECT_TARGET + " " + key + " -remove", output);
+    }
+    HdcLoopbackDaemon::Stop(daemon, daemonThread);
+    daemon = nullptr;
+}
+
+void HdcHostBench::PrintTransfer(const char *name, uint64_t bytes, uint64_t timeUs, uint64_t packets)
+{
+    double seconds = timeUs > 0 ? timeUs / BENCH_US_PER_SEC : 1;
+    string pps = daemon != nullptr ? Base::StringFormat("%.0f", packets / seconds) : "-";
+    fprintf(stdout, "%-12s %10.2fMB %10.1fms %10.2fMB/s %12s pkt/s\n", name, bytes / BENCH_BYTES_PER_MB,
+            timeUs / BENCH_US_PER_MS, bytes / BENCH_BYTES_PER_MB / seconds, pps.c_str());
+}
+
+bool HdcHostBench::BenchFile(bool sendOrRecv, const char *name)
+{
+    string output;
+    string command = sendOrRecv ? CMDSTR_FILE_SEND + " " + localFile + " " + remoteFile
+                                : CMDSTR_FILE_RECV + " " + remoteFile + " " + localFile;
+    uint64_t packets = GetDaemonPackets();
+    uint64_t begin = Metrics::NowUs();
+    RunCommand(command, output);
+    uint64_t timeUs = Metrics::NowUs() - begin;
+    if (output.find("FileTransfer finish") == string::npos) {
+        Base::PrintMessage("%s failed: %s", command.c_str(), output.c_str());
+        return false;
+    }
+    if (name == nullptr) {
+        name = sendOrRecv ? "file send" : "file recv";
+    }
+    PrintTransfer(name, static_cast<uint64_t>(sizeMB) * BENCH_BYTES_PER_MB,
+                  timeUs, GetDaemonPackets() - packets);
+    return true;
+}
+
+bool HdcHostBench::BenchShell()
+{
+    string output;
+    string command = CMDSTR_SHELL + " echo " + BENCH_ECHO;
+    Metrics::Histogram latency;
+    uint64_t begin = Metrics::NowUs();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t start = Metrics::NowUs();
+        RunCommand(command, output);
+        latency.Record(Metrics::NowUs() - start);
+        if (output.find(BENCH_ECHO) == string::npos) {
+            Base::PrintMessage("%s failed: %s", command.c_str(), output.c_str());
+            return false;
+        }
+    }
+    double seconds = (Metrics::NowUs() - begin) / BENCH_US_PER_SEC;
+    fprintf(stdout, "%-12s %10u   p50:%.2fms p99:%.2fms max:%.2fms %10.1f cmd/s\n", "shell echo", count,
+            latency.Percentile(50) / BENCH_US_PER_MS, latency.Percentile(99) / BENCH_US_PER_MS,  // 50 99: percentile
+            latency.Max() / BENCH_US_PER_MS, seconds > 0 ? count / seconds : 0);
+    return true;
+}
+
+#ifndef _WIN32
+// a new hdc process for each short command, the time is from the fork to the exit of the process, what a script
+// calling hdc in a loop sees
+bool HdcHostBench::BenchExec()
+{
+    char path[BUF_SIZE_SMALL] = "";
+    size_t pathSize = sizeof(path);
+    if (uv_exepath(path, &pathSize) < 0) {
+        Base::PrintMessage("exec bench exepath failed");
+        return false;
+    }
+    Metrics::Histogram latency;
+    uint64_t begin = Metrics::NowUs();
+    for (uint32_t i = 0; i < count; ++i) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            Base::PrintMessage("exec bench pipe failed errno:%d", errno);
+            return false;
+        }
+        fflush(stdout);
+        uint64_t start = Metrics::NowUs();
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            Base::PrintMessage("exec bench fork failed errno:%d", errno);
+            return false;
+        } else if (pid == 0) {
+            dup2(fds[1], STDOUT_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+            execl(path, "hdc", "-s", serverListenString.c_str(), "-t", connectKey.c_str(), CMDSTR_SHELL.c_str(),
+                  "echo", BENCH_ECHO.c_str(), nullptr);
+            _exit(1);
+        }
+        close(fds[1]);
+        string output;
+        char buf[BUF_SIZE_DEFAULT];
+        ssize_t n = 0;
+        while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+            output.append(buf, n);
+        }
+        close(fds[0]);
+        waitpid(pid, nullptr, 0);
+        latency.Record(Metrics::NowUs() - start);
+        if (output.find(BENCH_ECHO) == string::npos) {
+            Base::PrintMessage("exec shell echo failed: %s", output.c_str());
+            return false;
+        }
+    }
+    double seconds = (Metrics::NowUs() - begin) / BENCH_US_PER_SEC;
+    fprintf(stdout, "%-12s %10u   p50:%.2fms p99:%.2fms max:%.2fms %10.1f cmd/s\n", "exec shell", count,
+            latency.Percentile(50) / BENCH_US_PER_MS, latency.Percentile(99) / BENCH_US_PER_MS,  // 50 99: percentile
+            latency.Max() / BENCH_US_PER_MS, seconds > 0 ? count / seconds : 0);
+    return true;
+}
+
+// the same short command through one 'hdc batch' process, each line written after the frame of the last one
+bool HdcHostBench::BenchBatch()
+{
+    char path[BUF_SIZE_SMALL] = "";
+    size_t pathSize = sizeof(path);
+    int in[2];
+    int out[2];
+    if (uv_exepath(path, &pathSize) < 0 || pipe(in) < 0) {
+        Base::PrintMessage("batch bench failed errno:%d", errno);
+        return false;
+    }
+    if (pipe(out) < 0) {
+        close(in[0]);
+        close(in[1]);
+        Base::PrintMessage("batch bench pipe failed errno:%d", errno);
+        return false;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        execl(path, "hdc", "-s", serverListenString.c_str(), CMDSTR_BATCH.c_str(), nullptr);
+        _exit(1);
+    }
+    close(in[0]);
+    close(out[1]);
+    FILE *fpIn = pid > 0 ? fdopen(in[1], "w") : nullptr;
+    FILE *fpOut = pid > 0 ? fdopen(out[0], "r") : nullptr;
+    bool ret = fpIn != nullptr && fpOut != nullptr;
+    Metrics::Histogram latency;
+    uint64_t begin = Metrics::NowUs();
+    for (uint32_t i = 0; i < count && ret; ++i) {
+        uint64_t start = Metrics::NowUs();
+        fprintf(fpIn, "-t %s %s echo %s\n", connectKey.c_str(), CMDSTR_SHELL.c_str(), BENCH_ECHO.c_str());
+        fflush(fpIn);
+        // "hdcbatch SEQ STATUS LENGTH\n" then the output
+        uint32_t seq = 0;
+        int status = -1;
+        size_t length = 0;
+        ret = fscanf(fpOut, "hdcbatch %u %d %zu", &seq, &status, &length) == 3 && fgetc(fpOut) == '\n';  // 3 fields
+        string output(length, '\0');
+        ret = ret && fread(&output[0], 1, length, fpOut) == length;
+        latency.Record(Metrics::NowUs() - start);
+        if (!ret || status != HdcHostBatch::STATUS_OK || output.find(BENCH_ECHO) == string::npos) {
+            Base::PrintMessage("batch shell echo failed: %s", output.c_str());
+            ret = false;
+        }
+    }
+    double seconds = (Metrics::NowUs() - begin) / BENCH_US_PER_SEC;
+    if (fpIn != nullptr) {
+        fclose(fpIn);
+    } else {
+        close(in[1]);
+    }
+    if (fpOut != nullptr) {
+        fclose(fpOut);
+    } else {
+        close(out[0]);
+    }
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    if (!ret) {
+        return false;
+    }
+    fprintf(stdout, "%-12s %10u   p50:%.2fms p99:%.2fms max:%.2fms %10.1f cmd/s\n", "batch shell", count,
+            latency.Percentile(50) / BENCH_US_PER_MS, latency.Percentile(99) / BENCH_US_PER_MS,  // 50 99: percentile
+            latency.Max() / BENCH_US_PER_MS, seconds > 0 ? count / seconds : 0);
+    return true;
+}
+
+static int ListenLoopback(uint16_t &port)
+{
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) < 0) {
+        close(fd);
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// data goes bench -> fport local port -> server -> session -> daemon -> sink
+bool HdcHostBench::BenchForward()
+{
+    uint16_t sinkPort = 0;
+    uint16_t localPort = 0;
+    int sinkFd = ListenLoopback(sinkPort);
+    int probeFd = ListenLoopback(localPort);  // just take a free port
+    if (probeFd >= 0) {
+        close(probeFd);
+    }
+    if (sinkFd < 0 || probeFd < 0) {
+        Base::PrintMessage("fport bench listen failed errno:%d", errno);
+        if (sinkFd >= 0) {
+            close(sinkFd);
+        }
+        return false;
+    }
+    string output;
+    string rule = "tcp:" + std::to_string(localPort) + " tcp:" + std::to_string(sinkPort);
+    RunCommand(CMDSTR_FORWARD_FPORT + " " + rule, output);
+    if (output.find("OK") == string::npos) {
+        Base::PrintMessage("fport %s failed: %s", rule.c_str(), output.c_str());
+        close(sinkFd);
+        return false;
+    }
+    uint64_t total = static_cast<uint64_t>(sizeMB) * BENCH_BYTES_PER_MB;
+    uint64_t received = 0;
+    uint64_t end = 0;
+    std::thread sink([sinkFd, &received, &end]() {
+        int fd = accept(sinkFd, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        char buf[BENCH_IO_SIZE];
+        ssize_t n = 0;
+        while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            received += static_cast<uint64_t>(n);
+        }
+        end = Metrics::NowUs();
+        close(fd);
+    });
+    uint64_t packets = GetDaemonPackets();
+    uint64_t begin = Metrics::NowUs();
+    uint64_t sent = 0;
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(localPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        char buf[BENCH_IO_SIZE] = {};
+        while (sent < total) {
+            ssize_t n = send(fd, buf, std::min<uint64_t>(sizeof(buf), total - sent), 0);
+            if (n <= 0) {
+                break;
+            }
+            sent += static_cast<uint64_t>(n);
+        }
+        shutdown(fd, SHUT_WR);
+    }
+    if (sent < total) {
+        // nothing arrives at the sink, wake it up
+        shutdown(sinkFd, SHUT_RDWR);
+    }
+    sink.join();
+    if (fd >= 0) {
+        close(fd);
+    }
+    close(sinkFd);
+    RunCommand(CMDSTR_FORWARD_FPORT + " rm " + rule, output);
+    if (received < total) {
+        Base::PrintMessage("fport bench sent %" PRIu64 " received %" PRIu64 " of %" PRIu64, sent, received, total);
+        return false;
+    }
+    PrintTransfer("fport", total, end - begin, GetDaemonPackets() - packets);
+    return true;
+}
+#else
+bool HdcHostBench::BenchExec()
+{
+    Base::PrintMessage("exec bench is not supported on this platform");
+    return false;
+}
+
+bool HdcHostBench::BenchBatch()
+{
+    Base::PrintMessage("batch bench is not supported on this platform");
+    return false;
+}
+
+bool HdcHostBench::BenchForward()
+{
+    Base::PrintMessage("fport bench is not supported on this platform");
+    return false;
+}
+#endif
+
+#ifdef HOST_LINUX
+// the client to server hop over TCP and over the local channel: 'list targets', which the server answers itself,
+// and a file send, whose data goes through the ring of the local channel
+bool HdcHostBench::BenchChannel()
+{
+    const char *envSave = getenv(ENV_LOCAL_CHANNEL.c_str());
+    string save = envSave != nullptr ? envSave : "";
+    bool ret = true;
+    for (bool local : { false, true }) {
+        setenv(ENV_LOCAL_CHANNEL.c_str(), local ? "1" : "0", 1);
+        string output;
+        Metrics::Histogram latency;
+        uint64_t begin = Metrics::NowUs();
+        for (uint32_t i = 0; i < count; ++i) {
+            uint64_t start = Metrics::NowUs();
+            RunCommand(CMDSTR_LIST_TARGETS, output);
+            latency.Record(Metrics::NowUs() - start);
+        }
+        double seconds = (Metrics::NowUs() - begin) / BENCH_US_PER_SEC;
+        fprintf(stdout, "%-12s %10u   p50:%.2fms p99:%.2fms max:%.2fms %10.1f cmd/s\n",
+                local ? "local list" : "tcp list", count, latency.Percentile(50) / BENCH_US_PER_MS,  // 50: percentile
+                latency.Percentile(99) / BENCH_US_PER_MS, latency.Max() / BENCH_US_PER_MS,  // 99: percentile
+                seconds > 0 ? count / seconds : 0);
+        ret = BenchFile(true, local ? "local send" : "tcp send") && ret;
+    }
+    if (envSave != nullptr) {
+        setenv(ENV_LOCAL_CHANNEL.c_str(), save.c_str(), 1);
+    } else {
+        unsetenv(ENV_LOCAL_CHANNEL.c_str());
+    }
+    return ret;
+}
+#else
+bool HdcHostBench::BenchChannel()
+{
+    Base::PrintMessage("local channel bench is not supported on this platform");
+    return false;
+}
+#endif
+
+// the shell echo on every target by one 'each' a round, the latency is of a round, the rate of the target commands
+bool HdcHostBench::BenchEach()
+{
+    HdcLoopbackDaemon *daemons[BENCH_STORM_TARGETS] = {};
+    std::thread threads[BENCH_STORM_TARGETS];
+    vector<string> keys;
+    string output;
+    string targets = connectKey;
+    if (daemon != nullptr) {
+        // the bench daemon and some more, one tconn returns when every target is done
+        string command = CMDSTR_CONNECT_TARGET + " -c " + std::to_string(BENCH_STORM_TARGETS);
+        for (uint32_t i = 0; i < BENCH_STORM_TARGETS; ++i) {
+            int port = HdcLoopbackDaemon::Start(&daemons[i], threads[i]);
+            if (port <= 0) {
+                break;
+            }
+            keys.push_back("127.0.0.1:" + std::to_string(port));
+            command += " " + keys.back();
+            targets += "," + keys.back();
+        }
+        RunCommand(command, output);
+    }
+    uint32_t targetCount = keys.size() + 1;
+    uint32_t rounds = std::max(count / targetCount, 1u);
+    string command = CMDSTR_EACH + " -j " + std::to_string(targetCount) + " " + targets + " " + CMDSTR_SHELL +
+                     " echo " + BENCH_ECHO;
+    Metrics::Histogram latency;
+    bool ret = true;
+    uint64_t begin = Metrics::NowUs();
+    for (uint32_t i = 0; i < rounds && ret; ++i) {
+        uint64_t start = Metrics::NowUs();
+        RunCommand(command, output);
+        latency.Record(Metrics::NowUs() - start);
+        // a frame for each target, then "hdceach-end TOTAL FAILED MS"
+        uint32_t total = 0;
+        uint32_t failed = 0;
+        size_t pos = output.rfind("hdceach-end ");
+        ret = pos != string::npos && sscanf(output.c_str() + pos, "hdceach-end %u %u", &total, &failed) == 2 &&
+              total == targetCount && failed == 0;  // 2 fields
+        if (!ret) {
+            Base::PrintMessage("each shell echo failed: %s", output.c_str());
+        }
+    }
+    double seconds = (Metrics::NowUs() - begin) / BENCH_US_PER_SEC;
+    for (uint32_t i = 0; i < keys.size(); ++i) {
+        RunCommand(CMDSTR_CONNECT_TARGET + " " + keys[i] + " -remove", output);
+        HdcLoopbackDaemon::Stop(daemons[i], threads[i]);
+    }
+    if (!ret) {
+        return false;
+    }
+    fprintf(stdout, "%-12s %10u   p50:%.2fms p99:%.2fms max:%.2fms %10.1f cmd/s\n", "each shell",
+            rounds * targetCount, latency.Percentile(50) / BENCH_US_PER_MS,  // 50: percentile
+            latency.Percentile(99) / BENCH_US_PER_MS, latency.Max() / BENCH_US_PER_MS,  // 99: percentile
+            seconds > 0 ? rounds * targetCount / seconds : 0);
+    return true;
+}
+
+// connect all the keys at once, print the handshake time of the daemon sessions
+bool HdcHostBench::StormConnect(const char *name, const vector<string> &keys, HdcLoopbackDaemon **daemons)
+{
+    // one batch tconn of all, it returns when every target is done
+    string command = CMDSTR_CONNECT_TARGET + " -c " + std::to_string(keys.size());
+    for (const string &key : keys) {
+        command += " " + key;
+    }
+    string output;
+    uint64_t begin = Metrics::NowUs();
+    RunCommand(command, output);
+    uint32_t connected = 0;
+    for (size_t pos = output.find("\tOK\t"); pos != string::npos; pos = output.find("\tOK\t", pos + 1)) {
+        ++connected;
+    }
+    double seconds = (Metrics::NowUs() - begin) / BENCH_US_PER_SEC;
+    Metrics::Histogram latency;
+    for (uint32_t i = 0; i < keys.size(); ++i) {
+        daemons[i]->EnumSession([&latency, begin](HSession hSession) {
+            if (hSession->handshakeOK && hSession->stat.beginTime >= begin) {
+                latency.Record(hSession->stat.handshakeTime);
+            }
+        });
+        RunCommand(CMDSTR_CONNECT_TARGET + " " + keys[i] + " -remove", output);
+    }
+    if (connected < keys.size()) {
+        Base::PrintMessage("%s bench connected %u of %zu", name, connected, keys.size());
+        return false;
+    }
+    fprintf(stdout, "%-12s %10u   p50:%.2fms p99:%.2fms max:%.2fms %10.1f hs/s\n", name, connected,
+            latency.Percentile(50) / BENCH_US_PER_MS, latency.Percentile(99) / BENCH_US_PER_MS,  // 50 99: percentile
+            latency.Max() / BENCH_US_PER_MS, connected / seconds);
+    return true;
+}
+
+// the tar is made by Compress as install does and extracted by Decompress as the daemon does, the time is of the
+// extraction only. Small files are BENCH_UNTAR_FILES of BENCH_UNTAR_FILE_SIZE, big is one file of the size of -s
+bool HdcHostBench::BenchUntar(const char *name, uint32_t files, uint64_t fileSize)
+{
+    string dir = Base::GetTmpDir() + "hdc_bench_untar";
+    string srcDir = dir + Base::GetPathSep() + "src";
+    string dstDir = dir + Base::GetPathSep() + "dst";
+    string tarFile = dir + ".tar";
+    string estr;
+    if (!Base::TryCreateDirectory(dir, estr) || !Base::TryCreateDirectory(srcDir, estr)) {
+        Base::PrintMessage("%s bench mkdir %s failed: %s", name, srcDir.c_str(), estr.c_str());
+        return false;
+    }
+    bool ret = true;
+    vector<char> buf(BENCH_IO_SIZE, 'u');
+    for (uint32_t i = 0; i < files && ret; ++i) {
+        FILE *fp = fopen((srcDir + Base::GetPathSep() + std::to_string(i)).c_str(), "w");
+        if (fp == nullptr) {
+            ret = false;
+            break;
+        }
+        for (uint64_t left = fileSize; left > 0;) {
+            size_t n = static_cast<size_t>(std::min(left, static_cast<uint64_t>(buf.size())));
+            fwrite(buf.data(), 1, n, fp);
+            left -= n;
+        }
+        fclose(fp);
+    }
+    if (ret) {
+        Compress c;
+        c.UpdataPrefix(srcDir);
+        ret = c.AddPath(srcDir) && c.SaveToFile(tarFile);
+    }
+    uint64_t begin = Metrics::NowUs();
+    if (ret) {
+        Decompress d(tarFile);
+        ret = d.DecompressToLocal(dstDir + Base::GetPathSep());
+    }
+    uint64_t timeUs = Metrics::NowUs() - begin;
+    for (uint32_t i = 0; i < files; ++i) {
+        string file = Base::GetPathSep() + std::to_string(i);
+        unlink((srcDir + file).c_str());
+        ret = unlink((dstDir + file).c_str()) == 0 && ret;
+    }
+    rmdir(srcDir.c_str());
+    rmdir(dstDir.c_str());
+    rmdir(dir.c_str());
+    unlink(tarFile.c_str());
+    if (!ret) {
+        Base::PrintMessage("%s bench failed", name);
+        return false;
+    }
+    double seconds = timeUs > 0 ? timeUs / BENCH_US_PER_SEC : 1;
+    double bytes = static_cast<double>(files) * fileSize;
+    fprintf(stdout, "%-12s %10.2fMB %10.1fms %10.2fMB/s %12.0f file/s\n", name, bytes / BENCH_BYTES_PER_MB,
+            timeUs / BENCH_US_PER_MS, bytes / BENCH_BYTES_PER_MB / seconds, files / seconds);
+    return true;
+}
+
+// packages directories of files as compressible as the resources of a hap, the size of -s in all. With more than
+// one package the daemon says appPipeline or not, pipelined the next one is sent while the one before is extracted
+bool HdcHostBench::BenchInstall(const char *name, uint32_t packages, uint32_t files, bool pipeline)
+{
+    string dir = Base::GetTmpDir() + "hdc_bench_install";
+    string estr;
+    string command = CMDSTR_APP_INSTALL;
+    bool ret = Base::TryCreateDirectory(dir, estr);
+    for (uint32_t p = 0; p < packages && ret; ++p) {
+        string package = dir + Base::GetPathSep() + std::to_string(p);
+        ret = Base::TryCreateDirectory(package, estr);
+        command += " " + package;
+    }
+    if (!ret) {
+        Base::PrintMessage("install bench mkdir %s failed: %s", dir.c_str(), estr.c_str());
+        return false;
+    }
+    uint64_t fileSize = static_cast<uint64_t>(sizeMB) * BENCH_BYTES_PER_MB / packages / files;
+    for (uint32_t i = 0; i < packages * files && ret; ++i) {
+        string path = dir + Base::GetPathSep() + std::to_string(i % packages) + Base::GetPathSep() +
+                      std::to_string(i) + ".json";
+        FILE *fp = fopen(path.c_str(), "w");
+        if (fp == nullptr) {
+            ret = false;
+            break;
+        }
+        for (uint64_t written = 0, line = 0; written < fileSize; ++line) {
+            int n = fprintf(fp, "{\"id\": %" PRIu64 ", \"name\": \"string_%" PRIu64 "\", \"value\": \"%08" PRIx64
+                            "\"},\n", line, line % 97, line * 2654435761u);  // 97, 2654435761: vary the lines
+            written += n > 0 ? static_cast<uint64_t>(n) : fileSize;
+        }
+        fclose(fp);
+    }
+    string output;
+    daemon->SetAppPipeline(pipeline);
+    uint64_t begin = Metrics::NowUs();
+    uint64_t packets = GetDaemonPackets();
+    if (ret) {
+        RunCommand(command, output);
+        ret = output.find("AppMod finish") != string::npos && output.find("[Fail]") == string::npos &&
+              (packages == 1 || (output.find(" pipelined") != string::npos) == pipeline);
+    }
+    uint64_t timeUs = Metrics::NowUs() - begin;
+    packets = GetDaemonPackets() - packets;
+    daemon->SetAppPipeline(true);
+    for (uint32_t i = 0; i < packages * files; ++i) {
+        unlink((dir + Base::GetPathSep() + std::to_string(i % packages) + Base::GetPathSep() + std::to_string(i) +
+                ".json").c_str());
+    }
+    for (uint32_t p = 0; p < packages; ++p) {
+        rmdir((dir + Base::GetPathSep() + std::to_string(p)).c_str());
+    }
+    rmdir(dir.c_str());
+    if (!ret) {
+        Base::PrintMessage("%s bench failed: %s", name, output.c_str());
+        return false;
+    }
+    PrintTransfer(name, static_cast<uint64_t>(sizeMB) * BENCH_BYTES_PER_MB, timeUs, packets);
+    return true;
+}
+
+// the loopback daemon sends a bugreport of text lines in packets of a page, the rate is of what it sent
+bool HdcHostBench::BenchBugreport(const char *name, const string &suffix)
+{
+    string path = Base::GetTmpDir() + "hdc_bench_bugreport" + suffix;
+    string output;
+    uint64_t begin = Metrics::NowUs();
+    uint64_t packets = GetDaemonPackets();
+    RunCommand(CMDSTR_BUGREPORT + " " + path, output);
+    uint64_t timeUs = Metrics::NowUs() - begin;
+    packets = GetDaemonPackets() - packets;
+    unlink(path.c_str());
+    const string sizeTag = "Size:";
+    size_t pos = output.find("Bugreport finish, " + sizeTag);
+    if (pos == string::npos) {
+        Base::PrintMessage("bugreport bench failed: %s", output.c_str());
+        return false;
+    }
+    uint64_t bytes = strtoull(output.c_str() + output.find(sizeTag, pos) + sizeTag.size(), nullptr, 10);
+    PrintTransfer(name, bytes, timeUs, packets);
+    return true;
+}
+
+// the rate is of the log the loopback daemon sent, what the client is given is all of it or the lines passing options
+bool HdcHostBench::BenchHilog(const char *name, const string &options, bool all)
+{
+    string output;
+    uint64_t begin = Metrics::NowUs();
+    uint64_t packets = GetDaemonPackets();
+    RunCommand(CMDSTR_HILOG + options, output);
+    uint64_t timeUs = Metrics::NowUs() - begin;
+    packets = GetDaemonPackets() - packets;
+    size_t size = HdcLoopbackDaemon::HILOG_SIZE;
+    // the daemon ends on a whole line, a little after size
+    if (all ? output.size() < size : (output.empty() || output.size() > size / 2)) {  // 2: a filter drops most
+        Base::PrintMessage("hilog bench%s got %zu bytes", options.c_str(), output.size());
+        return false;
+    }
+    PrintTransfer(name, size, timeUs, packets);
+    return true;
+}
+
+// every target asks for the signature of the host like a device which knows it, handshakes run side by side, then
+// they all come back again with the ticket of the first time
+bool HdcHostBench::BenchHandshake()
+{
+    HdcLoopbackDaemon *daemons[BENCH_STORM_TARGETS] = {};
+    std::thread threads[BENCH_STORM_TARGETS];
+    vector<string> keys;
+    for (uint32_t i = 0; i < BENCH_STORM_TARGETS; ++i) {
+        int port = HdcLoopbackDaemon::Start(&daemons[i], threads[i], 0, true);
+        if (port <= 0) {
+            Base::PrintMessage("Start loopback daemon failed");
+            break;
+        }
+        keys.push_back("127.0.0.1:" + std::to_string(port));
+    }
+    bool ret = keys.size() == BENCH_STORM_TARGETS && StormConnect("handshake", keys, daemons);
+    if (ret) {
+        // the daemon sessions of the first round are freed in the background
+        uv_sleep(BENCH_CONNECT_INTERVAL);
+        ret = StormConnect("resume", keys, daemons);
+    }
+    for (uint32_t i = 0; i < BENCH_STORM_TARGETS; ++i) {
+        HdcLoopbackDaemon::Stop(daemons[i], threads[i]);
+    }
+    return ret;
+}
+
+int HdcHostBench::Run(const string &command)
+{
+    if (!ParseOption(command)) {
+        Base::PrintMessage("Error bench command, use 'bench [-s MB] [-n COUNT]'");
+        return ERR_PARM_FAIL;
+    }
+    if (!Prepare()) {
+        return ERR_GENERIC;
+    }
+    // the file to send, content does not matter
+    FILE *fp = fopen(localFile.c_str(), "w");
+    if (fp == nullptr) {
+        Base::PrintMessage("Create %s failed errno:%d", localFile.c_str(), errno);
+        return ERR_FILE_OPEN;
+    }
+    vector<char> buf(BENCH_IO_SIZE, 'h');
+    for (uint64_t i = 0; i < static_cast<uint64_t>(sizeMB) * BENCH_BYTES_PER_MB / BENCH_IO_SIZE; ++i) {
+        fwrite(buf.data(), 1, buf.size(), fp);
+    }
+    fclose(fp);
+    fprintf(stdout, "hdc bench %s%s, size:%uMB count:%u\n", connectKey.c_str(),
+            daemon != nullptr ? " (loopback daemon)" : "", sizeMB, count);
+    bool ret = BenchFile(true);
+    ret = BenchFile(false) && ret;
+    ret = BenchShell() && ret;
+    ret = BenchExec() && ret;
+    ret = BenchBatch() && ret;
+    ret = BenchEach() && ret;
+    ret = BenchForward() && ret;
+    ret = BenchChannel() && ret;
+    ret = BenchUntar("untar small", BENCH_UNTAR_FILES, BENCH_UNTAR_FILE_SIZE) && ret;
+    ret = BenchUntar("untar big", 1, static_cast<uint64_t>(sizeMB) * BENCH_BYTES_PER_MB) && ret;
+    if (daemon != nullptr) {
+        ret = BenchInstall("install dir", 1, BENCH_INSTALL_FILES, true) && ret;
+        ret = BenchInstall("install serial", BENCH_INSTALL_PACKAGES, BENCH_INSTALL_FILES, false) && ret;
+        ret = BenchInstall("install pipe", BENCH_INSTALL_PACKAGES, BENCH_INSTALL_FILES, true) && ret;
+        ret = BenchBugreport("bugreport", ".txt") && ret;
+        ret = BenchBugreport("bugreport lz4", ".txt.lz4") && ret;
+        ret = BenchHilog("hilog", "", true) && ret;
+        ret = BenchHilog("hilog -e", " -e \"event 4242\"", false) && ret;
+        ret = BenchHilog("hilog -L -T", " -L E -T Bluetooth", false) && ret;
+        ret = BenchHandshake() && ret;
+    }
+    unlink(localFile.c_str());
+    string output;
+    if (daemon != nullptr) {
+        unlink(remoteFile.c_str());
+    } else {
+        RunCommand(CMDSTR_SHELL + " rm -f " + remoteFile, output);
+    }
+    Finish();
+    return ret ? RET_SUCCESS : ERR_GENERIC;
+}
+}  // namespace Hdc
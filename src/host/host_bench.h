@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_HOST_BENCH_H
+#define HDC_HOST_BENCH_H
+#include "host_common.h"
+#include "host_batch.h"
+#include "loopback_daemon.h"
+
+namespace Hdc {
+// 'hdc bench [-s MB] [-n COUNT]': file send/recv, shell echo round trip in process, as a new hdc process each
+// time and through one 'hdc batch' process, on many targets by one 'hdc each', fport throughput through the server,
+// the client to server hop over TCP and over the local channel, the extraction of an install tar, and with the
+// loopback daemon the install of a directory, which goes as the lz4 frame of its tar, and of a few directories one
+// after the other and pipelined, a bugreport saved to a file as it is and as lz4, and a hilog in full and filtered
+// by the server.
+// Without -t a HdcLoopbackDaemon is started in process and connected by 'tconn', so the numbers are the cost of
+// client, server and session protocol only, and a reconnect storm of signing loopback daemons gives the rate of
+// full and resumed handshakes. Every step is a normal client command with its stdout captured.
+class HdcHostBench {
+public:
+    HdcHostBench(const string &serverListenStringIn, const string &connectKeyIn);
+    virtual ~HdcHostBench();
+    int Run(const string &command);
+
+private:
+    bool ParseOption(const string &command);
+    bool Prepare();
+    void Finish();
+    // run one client command, output is what it prints to stdout
+    bool RunCommand(const string &command, string &output);
+    uint64_t GetDaemonPackets();
+    void PrintTransfer(const char *name, uint64_t bytes, uint64_t timeUs, uint64_t packets);
+    bool BenchFile(bool sendOrRecv, const char *name = nullptr);
+    bool BenchShell();
+    bool BenchExec();
+    bool BenchBatch();
+    bool BenchEach();
+    bool BenchForward();
+    bool BenchChannel();
+    bool BenchUntar(const char *name, uint32_t files, uint64_t fileSize);
+    bool BenchInstall(const char *name, uint32_t packages, uint32_t files, bool pipeline);
+    bool BenchBugreport(const char *name, const string &suffix);
+    bool BenchHilog(const char *name, const string &options, bool all);
+    bool StormConnect(const char *name, const vector<string> &keys, HdcLoopbackDaemon **daemons);
+    bool BenchHandshake();
+
+    string serverListenString;
+    string connectKey;
+    uint32_t sizeMB;
+    uint32_t count;
+    string localFile;
+    string remoteFile;
+    HdcLoopbackDaemon *daemon;
+    std::thread daemonThread;
+};
+}  // namespace Hdc
+
+#endif
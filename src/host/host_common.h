@@ -24,6 +24,7 @@
 #include "serial_struct.h"
 
 #include "host_tcp.h"
+#include "host_connect.h"
 // #include "host_usb.h"
 #ifdef HDC_SUPPORT_UART
 // #include "host_uart.h"
@@ -0,0 +1,553 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "host_connect.h"
+#include "server.h"
+
+namespace Hdc {
+constexpr double US_PER_MS = 1000.0;
+constexpr double US_PER_SEC = 1000000.0;
+
+enum TargetState { TARGET_QUEUED, TARGET_RESOLVING, TARGET_DIALING, TARGET_HANDSHAKE, TARGET_BACKOFF, TARGET_DONE };
+
+struct HdcConnectEngine::Batch {
+    HdcConnectEngine *engine;
+    Options options;
+    ReportCallback report;
+    list<Target *> queue;  // waiting for a slot of concurrency
+    uint32_t total = 0;
+    uint32_t running = 0;
+    uint32_t done = 0;
+    uint32_t connected = 0;
+    uint32_t alive = 0;  // targets not freed yet
+    uint64_t beginTime = 0;
+};
+
+struct HdcConnectEngine::Attempt {
+    uv_tcp_t tcp;
+    uv_connect_t req;
+    Target *target;
+    uint64_t beginTime;
+    bool ipv6;
+};
+
+struct HdcConnectEngine::Target {
+    Batch *batch;
+    string connectKey;
+    string host;
+    uint16_t port = 0;
+    TargetState state = TARGET_QUEUED;
+    uv_timer_t timer;      // timeout of the try, or the backoff
+    uv_timer_t stepTimer;  // next address to dial
+    uv_getaddrinfo_t *resolver = nullptr;  // of this try, a late one of an old try is dropped
+    vector<sockaddr_storage> addrs;        // in dial order
+    size_t nextAddr = 0;
+    list<Attempt *> attempts;              // dialing
+    uint32_t refs = 0;                     // open handles and pending requests, freed at 0 when done
+    uint16_t tries = 0;
+    uint32_t sessionId = 0;
+    uint64_t tryTime = 0;
+    uint64_t connectTime = 0;  // us, of the address which won
+    bool ipv6 = false;
+    string error;  // of the last address failed
+};
+
+HdcConnectEngine::HdcConnectEngine(HdcServer *serverIn, uv_loop_t *loopIn) : server(serverIn), loop(loopIn)
+{
+}
+
+bool HdcConnectEngine::SplitKey(const string &connectKey, string &host, uint16_t &port)
+{
+    size_t pos = connectKey.rfind(':');
+    if (pos == string::npos || pos == 0 || pos + 1 == connectKey.size() || pos + 1 + PORT_MAX_LEN < connectKey.size()) {
+        return false;
+    }
+    string sport = connectKey.substr(pos + 1);
+    if (sport.find_first_not_of("0123456789") != string::npos) {
+        return false;
+    }
+    int value = atoi(sport.c_str());
+    if (value <= 0 || value > MAX_IP_PORT) {
+        return false;
+    }
+    port = static_cast<uint16_t>(value);
+    host = connectKey.substr(0, pos);
+    // [v6]:port
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {  // 2: []
+        host = host.substr(1, host.size() - 2);                           // 2: []
+    }
+    return !host.empty();
+}
+
+string HdcConnectEngine::ParseParameters(const string &parameters, Options &options, vector<string> &keys)
+{
+    vector<string> args;
+    Base::SplitString(parameters, " ", args);
+    for (size_t i = 0; i < args.size(); ++i) {
+        const string &arg = args[i];
+        if (arg == "-c" || arg == "-r" || arg == "-w") {
+            if (i + 1 == args.size() || args[i + 1].empty() ||
+                args[i + 1].find_first_not_of("0123456789") != string::npos || args[i + 1].size() > PORT_MAX_LEN + 1) {
+                return "Option " + arg + " needs a number";
+            }
+            uint32_t value = static_cast<uint32_t>(atoi(args[++i].c_str()));
+            if (arg == "-c" && value >= 1 && value <= MAX_CONCURRENCY) {
+                options.concurrency = static_cast<uint16_t>(value);
+            } else if (arg == "-r" && value <= MAX_RETRIES) {
+                options.retries = static_cast<uint16_t>(value);
+            } else if (arg == "-w" && value >= MIN_TIMEOUT && value <= MAX_TIMEOUT) {
+                options.timeout = value;
+            } else {
+                return Base::StringFormat("Option %s out of range, -c 1-%u -r 0-%u -w %u-%u", arg.c_str(),
+                                          MAX_CONCURRENCY, MAX_RETRIES, MIN_TIMEOUT, MAX_TIMEOUT);
+            }
+            continue;
+        }
+        if (arg[0] == '-') {
+            return "Unknown option " + arg;
+        }
+        string host;
+        uint16_t port = 0;
+        if (!SplitKey(arg, host, port)) {
+            return "IP:Port incorrect " + arg;
+        }
+        if (std::find(keys.begin(), keys.end(), arg) == keys.end()) {
+            keys.push_back(arg);
+        }
+    }
+    if (keys.empty()) {
+        return "No target to connect";
+    }
+    if (keys.size() > MAX_TARGETS) {
+        return Base::StringFormat("Too many targets, %u at most", MAX_TARGETS);
+    }
+    return "";
+}
+
+void HdcConnectEngine::Start(const vector<string> &keys, const Options &options, ReportCallback report)
+{
+    Batch *batch = new(std::nothrow) Batch();
+    if (batch == nullptr) {
+        WRITE_LOG(LOG_FATAL, "HdcConnectEngine new batch failed");
+        report("Connect failed, out of memory", true);
+        return;
+    }
+    batch->engine = this;
+    batch->options = options;
+    batch->report = report;
+    batch->beginTime = Metrics::NowUs();
+    for (auto &key : keys) {
+        Target *target = new(std::nothrow) Target();
+        if (target == nullptr) {
+            WRITE_LOG(LOG_FATAL, "HdcConnectEngine new target failed");
+            break;
+        }
+        target->batch = batch;
+        target->connectKey = key;
+        SplitKey(key, target->host, target->port);
+        batch->queue.push_back(target);
+        ++batch->alive;
+    }
+    batch->total = batch->alive;
+    if (batch->total == 0) {
+        report("Connect failed, out of memory", true);
+        delete batch;
+        return;
+    }
+    WRITE_LOG(LOG_INFO, "HdcConnectEngine start targets:%u concurrency:%u retries:%u timeout:%u", batch->total,
+              options.concurrency, options.retries, options.timeout);
+    Pump(batch);
+}
+
+void HdcConnectEngine::Pump(Batch *batch)
+{
+    while (batch->running < batch->options.concurrency && !batch->queue.empty()) {
+        Target *target = batch->queue.front();
+        batch->queue.pop_front();
+        ++batch->running;
+        StartTry(target);
+    }
+}
+
+void HdcConnectEngine::StartTry(Target *target)
+{
+    if (target->tries == 0) {
+        uv_timer_init(loop, &target->timer);
+        uv_timer_init(loop, &target->stepTimer);
+        target->timer.data = target;
+        target->stepTimer.data = target;
+        target->refs += 2;  // 2: timers
+    }
+    ++target->tries;
+    target->tryTime = Metrics::NowUs();
+    target->addrs.clear();
+    target->nextAddr = 0;
+    target->error.clear();
+    HDaemonInfo hdi = nullptr;
+    server->AdminDaemonMap(OP_QUERY, target->connectKey, hdi);
+    if (hdi && hdi->connStatus == STATUS_CONNECTED) {
+        Finish(target, true, "connected already");
+        return;
+    }
+    if (!server->HasFreeSessionThread()) {
+        Finish(target, false, "no free session thread");
+        return;
+    }
+    uv_timer_start(&target->timer, OnTimer, target->batch->options.timeout, 0);
+    Resolve(target);
+}
+
+void HdcConnectEngine::Resolve(Target *target)
+{
+    sockaddr_storage addr;
+    Base::ZeroStruct(addr);
+    if (uv_ip4_addr(target->host.c_str(), target->port, reinterpret_cast<sockaddr_in *>(&addr)) == 0 ||
+        uv_ip6_addr(target->host.c_str(), target->port, reinterpret_cast<sockaddr_in6 *>(&addr)) == 0) {
+        target->addrs.push_back(addr);
+        Dial(target);
+        return;
+    }
+    uv_getaddrinfo_t *req = new(std::nothrow) uv_getaddrinfo_t();
+    if (req == nullptr) {
+        TryFailed(target, "out of memory");
+        return;
+    }
+    req->data = target;
+    struct addrinfo hints;
+    Base::ZeroStruct(hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    string port = std::to_string(target->port);
+    // in the uv pool, as the sessions, HasFreeSessionThread leaves some for it
+    int rc = uv_getaddrinfo(loop, req, OnResolve, target->host.c_str(), port.c_str(), &hints);
+    if (rc < 0) {
+        delete req;
+        TryFailed(target, string("resolve ") + uv_strerror(rc));
+        return;
+    }
+    ++target->refs;
+    target->resolver = req;
+    target->state = TARGET_RESOLVING;
+}
+
+void HdcConnectEngine::OnResolve(uv_getaddrinfo_t *req, int status, struct addrinfo *res)
+{
+    Target *target = (Target *)req->data;
+    HdcConnectEngine *thisClass = target->batch->engine;
+    bool current = target->resolver == req && target->state == TARGET_RESOLVING;
+    delete req;
+    if (current) {
+        target->resolver = nullptr;
+        if (status < 0) {
+            thisClass->TryFailed(target, string("resolve ") + uv_strerror(status));
+        } else {
+            SortAddresses(res, target->addrs);
+            thisClass->Dial(target);
+        }
+    }
+    uv_freeaddrinfo(res);
+    Release(target);
+}
+
+// RFC 8305: the family of the first address first, then the families interleaved
+void HdcConnectEngine::SortAddresses(const struct addrinfo *res, vector<sockaddr_storage> &addrs)
+{
+    vector<sockaddr_storage> first;
+    vector<sockaddr_storage> second;
+    int firstFamily = AF_UNSPEC;
+    for (const struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next) {
+        if ((ai->ai_family != AF_INET && ai->ai_family != AF_INET6) || ai->ai_addrlen > sizeof(sockaddr_storage)) {
+            continue;
+        }
+        if (firstFamily == AF_UNSPEC) {
+            firstFamily = ai->ai_family;
+        }
+        sockaddr_storage addr;
+        Base::ZeroStruct(addr);
+        if (memcpy_s(&addr, sizeof(addr), ai->ai_addr, ai->ai_addrlen) != EOK) {
+            continue;
+        }
+        (ai->ai_family == firstFamily ? first : second).push_back(addr);
+    }
+    for (size_t i = 0; i < first.size() || i < second.size(); ++i) {
+        if (i < first.size()) {
+            addrs.push_back(first[i]);
+        }
+        if (i < second.size()) {
+            addrs.push_back(second[i]);
+        }
+    }
+}
+
+void HdcConnectEngine::Dial(Target *target)
+{
+    target->state = TARGET_DIALING;
+    uv_timer_stop(&target->stepTimer);
+    while (target->nextAddr < target->addrs.size()) {
+        const sockaddr_storage &addr = target->addrs[target->nextAddr++];
+        Attempt *attempt = new(std::nothrow) Attempt();
+        if (attempt == nullptr) {
+            target->error = "out of memory";
+            break;
+        }
+        attempt->target = target;
+        attempt->beginTime = Metrics::NowUs();
+        attempt->ipv6 = addr.ss_family == AF_INET6;
+        attempt->req.data = attempt;
+        uv_tcp_init(loop, &attempt->tcp);
+        attempt->tcp.data = attempt;
+        ++target->refs;
+        target->attempts.push_back(attempt);
+        int rc = uv_tcp_connect(&attempt->req, &attempt->tcp, reinterpret_cast<const sockaddr *>(&addr), OnConnect);
+        if (rc < 0) {
+            target->error = uv_strerror(rc);
+            target->attempts.remove(attempt);
+            uv_close((uv_handle_t *)&attempt->tcp, OnAttemptClose);
+            continue;
+        }
+        if (target->nextAddr < target->addrs.size()) {
+            uv_timer_start(&target->stepTimer, OnStepTimer, CONNECT_STAGGER, 0);
+        }
+        return;
+    }
+    if (target->attempts.empty()) {
+        TryFailed(target, target->error.empty() ? "no address" : target->error);
+    }
+}
+
+void HdcConnectEngine::OnConnect(uv_connect_t *req, int status)
+{
+    Attempt *attempt = (Attempt *)req->data;
+    if (status == UV_ECANCELED) {  // closed by the winner or the timeout
+        return;
+    }
+    Target *target = attempt->target;
+    HdcConnectEngine *thisClass = target->batch->engine;
+    if (status == 0) {
+        thisClass->Connected(target, attempt);
+        return;
+    }
+    target->error = uv_strerror(status);
+    target->attempts.remove(attempt);
+    uv_close((uv_handle_t *)&attempt->tcp, OnAttemptClose);
+    if (target->nextAddr < target->addrs.size()) {
+        thisClass->Dial(target);  // at once, not to wait for the stagger
+    } else if (target->attempts.empty()) {
+        thisClass->TryFailed(target, target->error);
+    }
+}
+
+void HdcConnectEngine::Connected(Target *target, Attempt *attempt)
+{
+    target->connectTime = Metrics::NowUs() - attempt->beginTime;
+    target->ipv6 = attempt->ipv6;
+    uv_timer_stop(&target->stepTimer);
+    if (!server->HasFreeSessionThread()) {
+        CloseAttempts(target);
+        Finish(target, false, "no free session thread");
+        return;
+    }
+    uv_os_sock_t fd = Base::DuplicateUvSocket(&attempt->tcp);
+    CloseAttempts(target);
+    if (fd < 0) {
+        TryFailed(target, "duplicate socket failed");
+        return;
+    }
+    // followed before the session can change the map
+    server->TrackDaemonMap(true);
+    HSession hSession = server->AttachConnect(target->connectKey, fd);
+    if (hSession == nullptr) {
+        server->TrackDaemonMap(false);
+        TryFailed(target, "start session failed");
+        return;
+    }
+    target->sessionId = hSession->sessionId;
+    target->state = TARGET_HANDSHAKE;
+    handshakes.push_back(target);
+}
+
+void HdcConnectEngine::NotifyDaemonEvents(const list<HdcDaemonEvent> &events)
+{
+    list<Target *> targets = handshakes;  // a done one leaves the list
+    for (Target *target : targets) {
+        for (auto &event : events) {
+            if (event.connectKey == target->connectKey) {
+                CheckHandshake(target);
+                break;
+            }
+        }
+    }
+}
+
+// AttachConnect has put the daemon to unknown, the session ends it as connected, unauthorized or offline
+void HdcConnectEngine::CheckHandshake(Target *target)
+{
+    if (target->state != TARGET_HANDSHAKE) {
+        return;
+    }
+    HSession hSession = server->AdminSession(OP_QUERY, target->sessionId, nullptr);
+    HDaemonInfo hdi = nullptr;
+    server->AdminDaemonMap(OP_QUERY, target->connectKey, hdi);
+    if (hSession == nullptr || hSession->isDead || (hdi && hdi->connStatus == STATUS_OFFLINE)) {
+        TryFailed(target, "handshake failed");
+        return;
+    }
+    if (hdi && hdi->connStatus == STATUS_CONNECTED && hdi->hSession == hSession) {
+        uint64_t handshakeTime = Metrics::NowUs() - target->tryTime - target->connectTime;
+        Finish(target, true,
+               Base::StringFormat("connect %.1fms\thandshake %.1fms\t%s", target->connectTime / US_PER_MS,
+                                  handshakeTime / US_PER_MS, target->ipv6 ? "ipv6" : "ipv4"));
+    }
+}
+
+void HdcConnectEngine::Timeout(Target *target)
+{
+    switch (target->state) {
+        case TARGET_BACKOFF:
+            target->state = TARGET_QUEUED;
+            // it has waited already, before the first tries
+            target->batch->queue.push_front(target);
+            Pump(target->batch);
+            break;
+        case TARGET_RESOLVING:
+            // the pool may be busy, a result after is dropped
+            uv_cancel((uv_req_t *)target->resolver);
+            target->resolver = nullptr;
+            TryFailed(target, "resolve timeout");
+            break;
+        case TARGET_DIALING:
+            TryFailed(target, "connect timeout");
+            break;
+        case TARGET_HANDSHAKE: {
+            HDaemonInfo hdi = nullptr;
+            server->AdminDaemonMap(OP_QUERY, target->connectKey, hdi);
+            if (hdi && hdi->connStatus == STATUS_UNAUTH) {
+                // waits for the user of the device, a new session would wait again
+                Finish(target, false, "unauthorized, confirm it on the device");
+                break;
+            }
+            server->FreeSession(target->sessionId);
+            TryFailed(target, "handshake timeout");
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void HdcConnectEngine::OnTimer(uv_timer_t *handle)
+{
+    Target *target = (Target *)handle->data;
+    target->batch->engine->Timeout(target);
+}
+
+void HdcConnectEngine::OnStepTimer(uv_timer_t *handle)
+{
+    Target *target = (Target *)handle->data;
+    if (target->state == TARGET_DIALING) {
+        target->batch->engine->Dial(target);
+    }
+}
+
+void HdcConnectEngine::EndHandshake(Target *target)
+{
+    if (target->state != TARGET_HANDSHAKE) {
+        return;
+    }
+    handshakes.remove(target);
+    server->TrackDaemonMap(false);
+}
+
+void HdcConnectEngine::CloseAttempts(Target *target)
+{
+    for (auto attempt : target->attempts) {
+        uv_close((uv_handle_t *)&attempt->tcp, OnAttemptClose);
+    }
+    target->attempts.clear();
+}
+
+void HdcConnectEngine::OnAttemptClose(uv_handle_t *handle)
+{
+    Attempt *attempt = (Attempt *)handle->data;
+    Target *target = attempt->target;
+    delete attempt;
+    Release(target);
+}
+
+void HdcConnectEngine::TryFailed(Target *target, const string &error)
+{
+    Batch *batch = target->batch;
+    if (target->tries > batch->options.retries) {
+        Finish(target, false, error);
+        return;
+    }
+    WRITE_LOG(LOG_DEBUG, "HdcConnectEngine %s try:%u failed:%s", Hdc::MaskString(target->connectKey).c_str(),
+              target->tries, error.c_str());
+    EndHandshake(target);
+    uv_timer_stop(&target->stepTimer);
+    CloseAttempts(target);
+    target->resolver = nullptr;
+    target->state = TARGET_BACKOFF;
+    uv_timer_start(&target->timer, OnTimer, Base::GetBackoffTime(target->tries - 1, BACKOFF_BASE, BACKOFF_MAX), 0);
+    --batch->running;
+    Pump(batch);
+}
+
+void HdcConnectEngine::Finish(Target *target, bool ok, const string &detail)
+{
+    Batch *batch = target->batch;
+    EndHandshake(target);
+    uv_timer_stop(&target->timer);
+    uv_timer_stop(&target->stepTimer);
+    CloseAttempts(target);
+    target->resolver = nullptr;
+    target->state = TARGET_DONE;
+    --batch->running;
+    ++batch->done;
+    if (ok) {
+        ++batch->connected;
+    }
+    WRITE_LOG(ok ? LOG_INFO : LOG_WARN, "HdcConnectEngine %s %s tries:%u %s",
+              Hdc::MaskString(target->connectKey).c_str(), ok ? "OK" : "FAIL", target->tries, detail.c_str());
+    batch->report(Base::StringFormat("%s\t%s\t%s\ttries %u", target->connectKey.c_str(), ok ? "OK" : "FAIL",
+                                     detail.c_str(), target->tries),
+                  false);
+    if (batch->done == batch->total) {
+        batch->report(Base::StringFormat("Connected %u/%u targets in %.1fs", batch->connected, batch->total,
+                                         (Metrics::NowUs() - batch->beginTime) / US_PER_SEC),
+                      true);
+    }
+    uv_close((uv_handle_t *)&target->timer, OnHandleClose);
+    uv_close((uv_handle_t *)&target->stepTimer, OnHandleClose);
+    Pump(batch);
+}
+
+void HdcConnectEngine::OnHandleClose(uv_handle_t *handle)
+{
+    Release((Target *)handle->data);
+}
+
+void HdcConnectEngine::Release(Target *target)
+{
+    if (--target->refs > 0 || target->state != TARGET_DONE) {
+        return;
+    }
+    Batch *batch = target->batch;
+    delete target;
+    if (--batch->alive == 0) {
+        delete batch;
+    }
+}
+}  // namespace Hdc
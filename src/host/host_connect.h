@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_HOST_CONNECT_H
+#define HDC_HOST_CONNECT_H
+#include "host_common.h"
+
+namespace Hdc {
+class HdcServer;
+// 'tconn' of many TCP targets, on the main loop of the server:
+//   at most concurrency targets are in progress, the others wait in order
+//   a try resolves the host, then dials its addresses IPv6 and IPv4 interleaved, the next one CONNECT_STAGGER
+//   after the last or at once if it fails (happy eyeballs, RFC 8305), the first connected goes on as the session
+//   a try has timeout ms to connect and finish the handshake, a failed one retries after an exponential backoff with
+//   jitter, up to retries times
+//   the handshake is done by the changes of the daemon map, HdcServer tracks it while a target waits for one
+// A line is reported for each target when it is done, with its connect and handshake latency.
+class HdcConnectEngine {
+public:
+    static constexpr uint16_t DEFAULT_CONCURRENCY = 8;
+    static constexpr uint16_t DEFAULT_RETRIES = 3;
+    static constexpr uint32_t DEFAULT_TIMEOUT = 5000;
+    struct Options {
+        uint16_t concurrency = DEFAULT_CONCURRENCY;
+        uint16_t retries = DEFAULT_RETRIES;
+        uint32_t timeout = DEFAULT_TIMEOUT;  // ms, of one try
+    };
+    // the line of a target, or the summary if finish and then the batch is over
+    using ReportCallback = std::function<void(const string &line, bool finish)>;
+
+    HdcConnectEngine(HdcServer *serverIn, uv_loop_t *loopIn);
+    // "[-c CONCURRENCY] [-r RETRIES] [-w TIMEOUT_MS] key...", return the error message if any
+    static string ParseParameters(const string &parameters, Options &options, vector<string> &keys);
+    void Start(const vector<string> &keys, const Options &options, ReportCallback report);
+    // the changes of the daemon map, on the main loop
+    void NotifyDaemonEvents(const list<HdcDaemonEvent> &events);
+    bool Handshaking() const
+    {
+        return !handshakes.empty();
+    }
+
+private:
+    struct Batch;
+    struct Target;
+    struct Attempt;
+    static constexpr uint16_t MAX_CONCURRENCY = 64;
+    static constexpr uint16_t MAX_RETRIES = 16;
+    static constexpr uint32_t MIN_TIMEOUT = 100;
+    static constexpr uint32_t MAX_TIMEOUT = 600000;
+    static constexpr uint32_t MAX_TARGETS = 4096;
+    static constexpr uint32_t CONNECT_STAGGER = 250;  // ms, RFC 8305 connection attempt delay
+    static constexpr uint32_t BACKOFF_BASE = 200;     // ms
+    static constexpr uint32_t BACKOFF_MAX = 5000;     // ms
+
+    static bool SplitKey(const string &connectKey, string &host, uint16_t &port);
+    static void SortAddresses(const struct addrinfo *res, vector<sockaddr_storage> &addrs);
+    static void OnResolve(uv_getaddrinfo_t *req, int status, struct addrinfo *res);
+    static void OnConnect(uv_connect_t *req, int status);
+    static void OnTimer(uv_timer_t *handle);
+    static void OnStepTimer(uv_timer_t *handle);
+    static void OnHandleClose(uv_handle_t *handle);
+    static void OnAttemptClose(uv_handle_t *handle);
+    void Pump(Batch *batch);
+    void StartTry(Target *target);
+    void Resolve(Target *target);
+    void Dial(Target *target);
+    void Connected(Target *target, Attempt *attempt);
+    void CheckHandshake(Target *target);
+    void EndHandshake(Target *target);
+    void Timeout(Target *target);
+    void CloseAttempts(Target *target);
+    void TryFailed(Target *target, const string &error);
+    void Finish(Target *target, bool ok, const string &detail);
+    static void Release(Target *target);
+
+    HdcServer *server;
+    uv_loop_t *loop;
+    list<Target *> handshakes;  // of all batches, in TARGET_HANDSHAKE
+};
+}  // namespace Hdc
+#endif
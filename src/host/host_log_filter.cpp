@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "host_log_filter.h"
+#include <functional>
+
+namespace Hdc {
+static const string LOG_LEVELS = "DIWEF";
+static const string REGEX_SPECIAL = ".^$|()[]{}*+?\\";
+// date, time, pid and tid come before the level
+constexpr int LOG_HEAD_FIELDS = 4;
+
+bool HdcLogFilter::Parse(const string &parameters, string &error)
+{
+    if (parameters.empty()) {
+        return true;
+    }
+    int argc = 0;
+    char **argv = Base::SplitCommandToArgs(parameters.c_str(), &argc);
+    if (argv == nullptr) {
+        error = "Error hilog options";
+        return false;
+    }
+    bool ret = true;
+    for (int i = 0; i < argc && ret; ++i) {
+        string option = argv[i];
+        if (option != "-L" && option != "-T" && option != "-e") {
+            // the other options of hilog were never sent to the daemon, they are still left out
+            WRITE_LOG(LOG_WARN, "hilog option %s ignored", option.c_str());
+            continue;
+        }
+        if (i + 1 >= argc) {
+            error = "Error hilog option " + option + ", it takes a value";
+            ret = false;
+            break;
+        }
+        string value = argv[++i];
+        vector<string> items;
+        if (option == "-L") {
+            Base::SplitString(value, ",", items);
+            for (string &level : items) {
+                if (level.size() != 1 || LOG_LEVELS.find(toupper(level[0])) == string::npos) {
+                    error = "Error hilog level " + level + ", one of D I W E F";
+                    ret = false;
+                    break;
+                }
+                levels.push_back(toupper(level[0]));
+            }
+        } else if (option == "-T") {
+            Base::SplitString(value, ",", items);
+            tags.insert(tags.end(), items.begin(), items.end());
+        } else {
+            pattern = value;
+            literal = pattern.find_first_of(REGEX_SPECIAL) == string::npos;
+            try {
+                if (!literal) {
+                    regex = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+                }
+            } catch (std::regex_error &e) {
+                error = "Error hilog regex " + pattern + ": " + e.what();
+                ret = false;
+            }
+        }
+    }
+    delete[](reinterpret_cast<char *>(argv));
+    return ret;
+}
+
+void HdcLogFilter::Filter(const uint8_t *data, size_t size, string &out)
+{
+    const char *begin = reinterpret_cast<const char *>(data);
+    const char *end = begin + size;
+    if (Empty()) {
+        out.append(begin, size);
+        return;
+    }
+    if (!partial.empty()) {
+        const char *eol = static_cast<const char *>(memchr(begin, '\n', size));
+        if (eol == nullptr && partial.size() + size < MAX_LINE) {
+            partial.append(begin, size);
+            return;
+        }
+        const char *next = eol != nullptr ? eol + 1 : end;
+        partial.append(begin, next - begin);
+        if (MatchLine(partial.data(), partial.size())) {
+            out += partial;
+        }
+        partial.clear();
+        begin = next;
+    }
+    const char *tail = end;
+    while (tail > begin && tail[-1] != '\n') {
+        --tail;
+    }
+    if (static_cast<size_t>(end - tail) >= MAX_LINE) {
+        tail = end;
+    }
+    partial.assign(tail, end - tail);
+    if (literal) {
+        FindLiteral(begin, tail - begin, out);
+    } else {
+        FilterLines(begin, tail - begin, out);
+    }
+}
+
+void HdcLogFilter::Flush(string &out)
+{
+    if (!partial.empty() && MatchLine(partial.data(), partial.size())) {
+        out += partial;
+    }
+    partial.clear();
+}
+
+void HdcLogFilter::FilterLines(const char *data, size_t size, string &out)
+{
+    const char *end = data + size;
+    for (const char *line = data; line < end;) {
+        const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+        const char *next = eol != nullptr ? eol + 1 : end;
+        if (MatchLine(line, next - line)) {
+            out.append(line, next - line);
+        }
+        line = next;
+    }
+}
+
+// the pattern is looked for in all of data, a line is only looked at when it has it
+void HdcLogFilter::FindLiteral(const char *data, size_t size, string &out)
+{
+    std::boyer_moore_horspool_searcher<string::const_iterator> searcher(pattern.begin(), pattern.end());
+    const char *end = data + size;
+    for (const char *pos = data; pos < end;) {
+        const char *found = searcher(pos, end).first;
+        if (found == end) {
+            break;
+        }
+        const char *line = found;
+        while (line > pos && line[-1] != '\n') {
+            --line;
+        }
+        const char *eol = static_cast<const char *>(memchr(found, '\n', end - found));
+        const char *next = eol != nullptr ? eol + 1 : end;
+        if (MatchHead(line, next - line)) {
+            out.append(line, next - line);
+        }
+        pos = next;
+    }
+}
+
+bool HdcLogFilter::MatchLine(const char *line, size_t size)
+{
+    if (!MatchHead(line, size)) {
+        return false;
+    }
+    if (pattern.empty()) {
+        return true;
+    }
+    if (literal) {
+        return std::search(line, line + size, pattern.begin(), pattern.end()) != line + size;
+    }
+    // without the '\n', so $ is the end of the line
+    if (size > 0 && line[size - 1] == '\n') {
+        --size;
+    }
+    return std::regex_search(line, line + size, regex);
+}
+
+bool HdcLogFilter::MatchHead(const char *line, size_t size)
+{
+    if (levels.empty() && tags.empty()) {
+        return true;
+    }
+    const char *pos = line;
+    const char *end = line + size;
+    auto nextField = [&pos, end](const char *&field) -> size_t {
+        while (pos < end && *pos == ' ') {
+            ++pos;
+        }
+        field = pos;
+        while (pos < end && *pos != ' ' && *pos != '\n') {
+            ++pos;
+        }
+        return pos - field;
+    };
+    const char *field = nullptr;
+    for (int i = 0; i < LOG_HEAD_FIELDS; ++i) {
+        if (nextField(field) == 0) {
+            return false;
+        }
+    }
+    if (nextField(field) != 1 || (!levels.empty() && levels.find(*field) == string::npos)) {
+        return false;
+    }
+    if (tags.empty()) {
+        return true;
+    }
+    size_t fieldSize = nextField(field);
+    const char *slash = static_cast<const char *>(memchr(field, '/', fieldSize));
+    if (slash == nullptr) {
+        return false;
+    }
+    size_t tagSize = field + fieldSize - slash - 1;
+    if (tagSize > 0 && slash[tagSize] == ':') {
+        --tagSize;
+    }
+    for (const string &tag : tags) {
+        if (tag.size() == tagSize && !memcmp(tag.data(), slash + 1, tagSize)) {
+            return true;
+        }
+    }
+    return false;
+}
+}  // namespace Hdc
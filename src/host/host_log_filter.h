@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_HOST_LOG_FILTER_H
+#define HDC_HOST_LOG_FILTER_H
+#include <regex>
+
+#include "common.h"
+
+namespace Hdc {
+// The lines of a hilog stream which the client asked for, chosen in the server with the options hilog has on the
+// device: -L LEVEL[,LEVEL..] (D I W E F), -T TAG[,TAG..] and -e REGEX. A line of hilog is
+//   "MM-DD HH:MM:SS.mmm  PID  TID L DOMAIN/TAG: message"
+// A REGEX without special characters is found as it is, over the whole packet and not line by line, so the lines
+// which do not have it are not looked at. A line not ended at the end of a packet waits for the next one.
+class HdcLogFilter {
+public:
+    HdcLogFilter() {}
+    ~HdcLogFilter() {}
+    // the hilog options after 'hilog', error is why they are wrong
+    bool Parse(const string &parameters, string &error);
+    // no option, every byte passes as it came
+    bool Empty()
+    {
+        return levels.empty() && tags.empty() && pattern.empty();
+    }
+    // the passing lines of data to out, after what is in out
+    void Filter(const uint8_t *data, size_t size, string &out);
+    // the line not ended yet, when the stream ends
+    void Flush(string &out);
+
+private:
+    // a line longer than that is taken as it is at this size
+    static constexpr size_t MAX_LINE = 64 * 1024;
+
+    void FilterLines(const char *data, size_t size, string &out);
+    void FindLiteral(const char *data, size_t size, string &out);
+    bool MatchLine(const char *line, size_t size);
+    bool MatchHead(const char *line, size_t size);
+
+    string levels;  // the letters
+    vector<string> tags;
+    string pattern;
+    bool literal = false;
+    std::regex regex;
+    string partial;
+};
+}  // namespace Hdc
+#endif
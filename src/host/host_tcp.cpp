@@ -19,7 +19,9 @@ namespace Hdc {
 HdcHostTCP::HdcHostTCP(const bool serverOrDaemonIn, void *ptrMainBase)
     : HdcTCPBase(serverOrDaemonIn, ptrMainBase)
 {
-    broadcastFindWorking = false;
+    discoverReady = false;
+    discoverClosing = 0;
+    lastProbeTime = 0;
 }
 
 HdcHostTCP::~HdcHostTCP()
@@ -29,83 +31,155 @@ HdcHostTCP::~HdcHostTCP()
 
 void HdcHostTCP::Stop()
 {
+    if (!discoverReady) {
+        return;
+    }
+    discoverReady = false;
+    CloseDiscoverHandle((uv_handle_t *)&timerDiscover);
+    CloseDiscoverHandle((uv_handle_t *)&udpDiscover);
+}
+
+// the handles are members, they are not inited again until libuv has let go of them
+void HdcHostTCP::CloseDiscoverHandle(uv_handle_t *handle)
+{
+    if (uv_is_closing(handle)) {
+        return;
+    }
+    ++discoverClosing;
+    handle->data = this;
+    uv_close(handle, [](uv_handle_t *handle) -> void {
+        HdcHostTCP *thisClass = (HdcHostTCP *)handle->data;
+        --thisClass->discoverClosing;
+    });
+}
+
+// the replies to the probes come back to DEFAULT_PORT, one socket for the life of the server sends and hears them
+bool HdcHostTCP::InitialDiscover()
+{
+    if (discoverReady) {
+        return true;
+    }
+    if (discoverClosing > 0) {
+        WRITE_LOG(LOG_WARN, "InitialDiscover the last udp socket is still closing");
+        return false;
+    }
+    uv_loop_t *loop = &((HdcSessionBase *)clsMainBase)->loopMain;
+    struct sockaddr_in addr;
+    uv_ip4_addr("0.0.0.0", DEFAULT_PORT, &addr);
+    uv_udp_init(loop, &udpDiscover);
+    udpDiscover.data = this;
+    int rc = uv_udp_bind(&udpDiscover, (const struct sockaddr *)&addr, UV_UDP_REUSEADDR);
+    if (rc == 0) {
+        rc = uv_udp_set_broadcast(&udpDiscover, 1);
+    }
+    if (rc == 0) {
+        rc = uv_udp_recv_start(&udpDiscover, AllocStreamUDP, RecvUDP);
+    }
+    if (rc < 0) {
+        WRITE_LOG(LOG_FATAL, "InitialDiscover udp port:%d failed:%s", DEFAULT_PORT, uv_strerror(rc));
+        CloseDiscoverHandle((uv_handle_t *)&udpDiscover);
+        return false;
+    }
+    uv_timer_init(loop, &timerDiscover);
+    timerDiscover.data = this;
+    discoverReady = true;
+    return true;
 }
 
 void HdcHostTCP::RecvUDPEntry(const sockaddr *addrSrc, uv_udp_t *handle, const uv_buf_t *rcvbuf)
 {
     char bufString[BUF_SIZE_TINY];
     int port = 0;
+    // our own probe comes back too, it has no port
     char *p = strstr(rcvbuf->base, "-");
-    if (!p) {
+    if (!p || addrSrc == nullptr || addrSrc->sa_family != AF_INET) {
         return;
     }
     port = atoi(p + 1);
-    if (!port) {
+    if (port <= 0 || port > UINT16_MAX) {
         return;
     }
-    uv_ip6_name((sockaddr_in6 *)addrSrc, bufString, sizeof(bufString));
+    uv_ip4_name((const sockaddr_in *)addrSrc, bufString, sizeof(bufString));
     string addrPort = string(bufString);
     addrPort += string(":") + std::to_string(port);
-    lstDaemonResult.push_back(addrPort);
+    bool fresh = lanDaemons.find(addrPort) == lanDaemons.end();
+    lanDaemons[addrPort] = Metrics::NowUs();
+    HdcServer *ptrServer = (HdcServer *)clsMainBase;
+    HDaemonInfo hdi = nullptr;
+    ptrServer->AdminDaemonMap(OP_QUERY, addrPort, hdi);
+    if (hdi == nullptr) {
+        HdcDaemonInformation di = {};
+        di.connectKey = addrPort;
+        di.connType = CONN_TCP;
+        di.connStatus = STATUS_READY;
+        HDaemonInfo pDi = reinterpret_cast<HDaemonInfo>(&di);
+        ptrServer->AdminDaemonMap(OP_ADD, STRING_EMPTY, pDi);
+    } else if (hdi->connStatus == STATUS_OFFLINE && hdi->hSession == nullptr) {
+        ptrServer->UpdateDaemonStatus(addrPort, STATUS_READY);
+    }
+    if (fresh) {
+        WRITE_LOG(LOG_INFO, "Discover daemon %s", Hdc::MaskString(addrPort).c_str());
+    }
+}
+
+// a daemon not heard within DISCOVER_TTL leaves the cache and goes offline in the daemon map if nothing has
+// connected to it. the entry stays, sessions and the connect engine hold HDaemonInfo without the map lock
+void HdcHostTCP::ExpireLanDaemons()
+{
+    uint64_t now = Metrics::NowUs();
+    uint64_t ttl = static_cast<uint64_t>(DISCOVER_TTL) * TIME_BASE * TIME_BASE;
+    HdcServer *ptrServer = (HdcServer *)clsMainBase;
+    for (auto it = lanDaemons.begin(); it != lanDaemons.end();) {
+        if (now - it->second < ttl) {
+            ++it;
+            continue;
+        }
+        HDaemonInfo hdi = nullptr;
+        ptrServer->AdminDaemonMap(OP_QUERY, it->first, hdi);
+        if (hdi != nullptr && hdi->connStatus == STATUS_READY && hdi->hSession == nullptr) {
+            ptrServer->UpdateDaemonStatus(it->first, STATUS_OFFLINE);
+        }
+        WRITE_LOG(LOG_INFO, "Discover daemon %s expired", Hdc::MaskString(it->first).c_str());
+        it = lanDaemons.erase(it);
+    }
 }
 
-void HdcHostTCP::BroadcastTimer(uv_idle_t *handle)
+vector<string> HdcHostTCP::GetLanDaemons()
 {
-    uv_stop(handle->loop);
+    ExpireLanDaemons();
+    vector<string> keys;
+    for (auto &item : lanDaemons) {
+        keys.push_back(item.first);
+    }
+    return keys;
+}
+
+void HdcHostTCP::DiscoverTimer(uv_timer_t *handle)
+{
+    HdcHostTCP *thisClass = (HdcHostTCP *)handle->data;
+    thisClass->ExpireLanDaemons();
+    thisClass->FindLanDaemon();
 }
 
-// Executive Administration Network Broadcast Discovery, broadcastLanIP==which interface to broadcast
-void HdcHostTCP::BroadcastFindDaemon(const char *broadcastLanIP)
+void HdcHostTCP::SetDiscoverInterval(uint32_t interval)
 {
-    if (broadcastFindWorking) {
+    if (!InitialDiscover()) {
         return;
     }
-    broadcastFindWorking = true;
-    lstDaemonResult.clear();
-
-    uv_loop_t loopBroadcast;
-    uv_loop_init(&loopBroadcast);
-    struct sockaddr_in6 addr;
-    uv_udp_send_t req;
-    uv_udp_t client;
-    // send
-    uv_ip6_addr(broadcastLanIP, 0, &addr);
-    uv_udp_init(&loopBroadcast, &client);
-    uv_udp_bind(&client, (const struct sockaddr *)&addr, 0);
-    uv_udp_set_broadcast(&client, 1);
-    uv_ip6_addr("FFFF:FFFF:FFFF", DEFAULT_PORT, &addr);
-    uv_buf_t buf = uv_buf_init((char *)HANDSHAKE_MESSAGE.c_str(), HANDSHAKE_MESSAGE.size());
-    uv_udp_send(&req, &client, &buf, 1, (const struct sockaddr *)&addr, nullptr);
-    // recv
-    uv_udp_t server;
-    server.data = this;
-    uv_ip6_addr(broadcastLanIP, DEFAULT_PORT, &addr);
-    uv_udp_init(&loopBroadcast, &server);
-    uv_udp_bind(&server, (const struct sockaddr *)&addr, UV_UDP_REUSEADDR);
-    uv_udp_recv_start(&server, AllocStreamUDP, RecvUDP);
-    // find timeout
-    uv_timer_t tLastCheck;
-    uv_timer_init(&loopBroadcast, &tLastCheck);
-    uv_timer_start(&tLastCheck, (uv_timer_cb)BroadcastTimer, TIME_BASE, 0);  // timeout debug 1s
-
-    uv_run(&loopBroadcast, UV_RUN_DEFAULT);
-    uv_loop_close(&loopBroadcast);
-    broadcastFindWorking = false;
+    uv_timer_stop(&timerDiscover);
+    if (interval > 0) {
+        uint64_t ms = static_cast<uint64_t>(interval) * TIME_BASE;
+        uv_timer_start(&timerDiscover, DiscoverTimer, ms, ms);
+    }
 }
 
-void HdcHostTCP::Connect(uv_connect_t *connection, int status)
+bool HdcHostTCP::StartSession(HSession hSession)
 {
-    HSession hSession = (HSession)connection->data;
-    delete connection;
     HdcSessionBase *ptrConnect = (HdcSessionBase *)hSession->classInstance;
     auto ctrl = ptrConnect->BuildCtrlString(SP_START_SESSION, 0, nullptr, 0);
-    if (status < 0) {
-        WRITE_LOG(LOG_FATAL, "Connect status:%d", status);
-        goto Finish;
-    }
     if ((hSession->fdChildWorkTCP = Base::DuplicateUvSocket(&hSession->hWorkTCP)) < 0) {
         WRITE_LOG(LOG_FATAL, "Connect fdChildWorkTCP:%d", hSession->fdChildWorkTCP);
-        goto Finish;
+        return false;
     }
     uv_read_stop((uv_stream_t *)&hSession->hWorkTCP);
     Base::SetTcpOptions((uv_tcp_t *)&hSession->hWorkTCP);
@@ -116,8 +190,19 @@ void HdcHostTCP::Connect(uv_connect_t *connection, int status)
         uv_sleep(MINOR_TIMEOUT);
     }
     Base::SendToPollFd(hSession->ctrlFd[STREAM_MAIN], ctrl.data(), ctrl.size());
-    return;
-Finish:
+    return true;
+}
+
+void HdcHostTCP::Connect(uv_connect_t *connection, int status)
+{
+    HSession hSession = (HSession)connection->data;
+    delete connection;
+    HdcSessionBase *ptrConnect = (HdcSessionBase *)hSession->classInstance;
+    if (status < 0) {
+        WRITE_LOG(LOG_FATAL, "Connect status:%d", status);
+    } else if (StartSession(hSession)) {
+        return;
+    }
     WRITE_LOG(LOG_FATAL, "Connect failed sessionId:%u", hSession->sessionId);
     ptrConnect->FreeSession(hSession->sessionId);
 }
@@ -153,25 +238,65 @@ HSession HdcHostTCP::ConnectDaemon(const string &connectKey, bool isCheck)
     return hSession;
 }
 
+HSession HdcHostTCP::AttachDaemon(const string &connectKey, uv_os_sock_t fd)
+{
+    HdcSessionBase *ptrConnect = (HdcSessionBase *)clsMainBase;
+    HSession hSession = ptrConnect->MallocSession(true, CONN_TCP, this);
+    if (!hSession) {
+        WRITE_LOG(LOG_FATAL, "hSession nullptr connectKey:%s", Hdc::MaskString(connectKey).c_str());
+#ifdef _WIN32
+        closesocket(fd);
+#else
+        Base::CloseFd(fd);
+#endif
+        return nullptr;
+    }
+    hSession->connectKey = connectKey;
+    int rc = uv_tcp_open(&hSession->hWorkTCP, fd);
+    if (rc < 0) {
+        WRITE_LOG(LOG_FATAL, "AttachDaemon uv_tcp_open failed:%s", uv_strerror(rc));
+#ifdef _WIN32
+        closesocket(fd);
+#else
+        Base::CloseFd(fd);
+#endif
+        ptrConnect->FreeSession(hSession->sessionId);
+        return nullptr;
+    }
+    if (!StartSession(hSession)) {
+        ptrConnect->FreeSession(hSession->sessionId);
+        return nullptr;
+    }
+    return hSession;
+}
+
+// a probe to the broadcast address of each IPv4 interface, RecvUDPEntry takes the replies as they come
 void HdcHostTCP::FindLanDaemon()
 {
-    uv_interface_address_t *info;
-    int count;
-    int i;
-    char ipAddr[BUF_SIZE_TINY] = "";
-    if (broadcastFindWorking) {
+    uv_interface_address_t *info = nullptr;
+    int count = 0;
+    if (!InitialDiscover() || uv_interface_addresses(&info, &count) < 0) {
         return;
     }
-    lstDaemonResult.clear();
-    uv_interface_addresses(&info, &count);
-    i = count;
-    while (--i) {
-        uv_interface_address_t interface = info[i];
-        if (interface.address.address6.sin6_family == AF_INET6) {
+    lastProbeTime = Metrics::NowUs();
+    for (int i = 0; i < count; ++i) {
+        uv_interface_address_t &interface = info[i];
+        if (interface.is_internal || interface.address.address4.sin_family != AF_INET) {
             continue;
         }
-        uv_ip6_name(&interface.address.address6, ipAddr, sizeof(ipAddr));
-        BroadcastFindDaemon(ipAddr);
+        struct sockaddr_in addr = interface.address.address4;
+        addr.sin_addr.s_addr |= ~interface.netmask.netmask4.sin_addr.s_addr;
+        addr.sin_port = htons(DEFAULT_PORT);
+        uv_udp_send_t *req = new(std::nothrow) uv_udp_send_t();
+        if (req == nullptr) {
+            break;
+        }
+        uv_buf_t buf = uv_buf_init((char *)HANDSHAKE_MESSAGE.c_str(), HANDSHAKE_MESSAGE.size());
+        int rc = uv_udp_send(req, &udpDiscover, &buf, 1, (const struct sockaddr *)&addr, SendUDPFinish);
+        if (rc < 0) {
+            WRITE_LOG(LOG_WARN, "FindLanDaemon send %s failed:%s", interface.name, uv_strerror(rc));
+            delete req;
+        }
     }
     uv_free_interface_addresses(info, count);
 }
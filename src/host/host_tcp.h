@@ -21,18 +21,38 @@ class HdcHostTCP : public HdcTCPBase {
 public:
     HdcHostTCP(const bool serverOrDaemonIn, void *ptrMainBase);
     virtual ~HdcHostTCP();
+    // LAN discovery, on the server loop: a round of broadcast probes, the replies come in later
     void FindLanDaemon();
+    // probe every interval seconds, 0 to stop
+    void SetDiscoverInterval(uint32_t interval);
+    // the daemons heard within DISCOVER_TTL, they are in the daemon map as STATUS_READY or connected
+    vector<string> GetLanDaemons();
+    bool LanDaemonProbed()
+    {
+        return lastProbeTime != 0;
+    }
     HSession ConnectDaemon(const string &connectKey, bool isCheck = false);
+    // a session on fd, connected to the daemon already, it owns fd even if it fails
+    HSession AttachDaemon(const string &connectKey, uv_os_sock_t fd);
     void Stop();
-    list<string> lstDaemonResult;
+
+    static constexpr uint32_t DISCOVER_TTL = 60;  // s
 
 private:
-    static void BroadcastTimer(uv_idle_t *handle);
+    static void DiscoverTimer(uv_timer_t *handle);
     static void Connect(uv_connect_t *connection, int status);
-    void BroadcastFindDaemon(const char *broadcastLanIP);
+    static bool StartSession(HSession hSession);
+    bool InitialDiscover();
+    void CloseDiscoverHandle(uv_handle_t *handle);
+    void ExpireLanDaemons();
     void RecvUDPEntry(const sockaddr *addrSrc, uv_udp_t *handle, const uv_buf_t *rcvbuf) override;
 
-    bool broadcastFindWorking;
+    bool discoverReady;
+    uint8_t discoverClosing;  // handles closed and not called back yet
+    uv_udp_t udpDiscover;  // probes out and replies in, DEFAULT_PORT
+    uv_timer_t timerDiscover;
+    uint64_t lastProbeTime;           // us, 0 for never
+    map<string, uint64_t> lanDaemons;  // connectKey, us of the last reply
 };
 }  // namespace Hdc
 #endif
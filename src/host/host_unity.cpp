@@ -13,8 +13,32 @@
  * limitations under the License.
  */
 #include "host_unity.h"
+#include "server.h"
+#ifdef HARMONY_PROJECT
+#include <lz4frame.h>
+#endif
 
 namespace Hdc {
+// a report comes in packets of a few KB, they are saved in writes of this size
+constexpr size_t UNITY_LOG_BUF_SIZE = 1024 * 1024;
+// more full buffers are written at once in the loop, which holds the session until the disk takes them
+constexpr uint16_t UNITY_LOG_WRITE_BEHIND = 4;
+// of a payload compressed at a time, so the bound of it fits in a buffer
+constexpr size_t UNITY_LOG_LZ4_CHUNK = 64 * 1024;
+const string UNITY_LOG_LZ4_SUFFIX = ".lz4";
+
+#ifdef HARMONY_PROJECT
+static LZ4F_preferences_t Lz4Preferences()
+{
+    LZ4F_preferences_t prefs;
+    (void)memset_s(&prefs, sizeof(prefs), 0, sizeof(prefs));
+    prefs.frameInfo.blockSizeID = LZ4F_max256KB;
+    prefs.frameInfo.blockMode = LZ4F_blockLinked;
+    prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+    return prefs;
+}
+#endif
+
 HdcHostUnity::HdcHostUnity(HTaskInfo hTaskInfo)
     : HdcTaskBase(hTaskInfo)
 {
@@ -24,6 +48,15 @@ HdcHostUnity::HdcHostUnity(HTaskInfo hTaskInfo)
 HdcHostUnity::~HdcHostUnity()
 {
     WRITE_LOG(LOG_DEBUG, "~HdcHostUnity channelId:%u", taskInfo->channelId);
+    delete[] opContext.bufLog;
+    for (uint8_t *buf : opContext.bufPool) {
+        delete[] buf;
+    }
+#ifdef HARMONY_PROJECT
+    if (opContext.lz4Ctx != nullptr) {
+        LZ4F_freeCompressionContext(opContext.lz4Ctx);
+    }
+#endif
 }
 
 bool HdcHostUnity::ReadyForRelease()
@@ -42,23 +75,71 @@ bool HdcHostUnity::ReadyForRelease()
 void HdcHostUnity::StopTask()
 {
     // Do not detect RunningProtect, force to close
-    if (opContext.hasFilelogClosed) {
+    if (opContext.hasFilelogClosed || opContext.closing) {
         WRITE_LOG(LOG_WARN, "StopTask hasFilelogClosed true channelId:%u", taskInfo->channelId);
         return;
     }
     if (opContext.enableLog) {
-        ++refCount;
-        opContext.fsClose.data = &opContext;
-        WRITE_LOG(LOG_DEBUG, "taskInfo->channelId:%u fileLog:%d", taskInfo->channelId, opContext.fileLog);
-        uv_fs_close(loopTask, &opContext.fsClose, opContext.fileLog, OnFileClose);
+        // all is received, the summary is told when the last write is done and the file is closed. The server frees
+        // the channel after this, a ref keeps it until then
+        HdcServerForClient *sfc = static_cast<HdcServerForClient *>(
+            reinterpret_cast<HdcServer *>(clsSession)->clsServerForClient);
+        opContext.channel = sfc->AdminChannel(OP_QUERY_REF, taskInfo->channelId, nullptr);
+        if (opContext.channel != nullptr && opContext.channel->isDead) {
+            --opContext.channel->ref;  // the client is gone
+            opContext.channel = nullptr;
+        }
+        if (!EndLz4() || !FlushLocalLog()) {
+            opContext.lastErrno = opContext.lastErrno != 0 ? opContext.lastErrno : UV_ENOMEM;
+        }
+        opContext.closing = true;
+        if (opContext.writing == 0) {
+            CloseLocalLog();
+        }
     }
 };
 
+void HdcHostUnity::ReportLocalLog()
+{
+    HChannel hChannel = opContext.channel;
+    opContext.channel = nullptr;
+    if (hChannel == nullptr) {
+        WRITE_LOG(LOG_WARN, "ReportLocalLog no channel channelId:%u", taskInfo->channelId);
+        return;
+    }
+    HdcServerForClient *sfc = reinterpret_cast<HdcServerForClient *>(hChannel->clsChannel);
+    uint64_t nMSec = Base::GetRuntimeMSec() - opContext.beginMSec;
+    if (opContext.lastErrno == 0) {
+        double fRate = static_cast<double>(opContext.logSize) / (nMSec > 0 ? nMSec : 1);  // B/ms is kB/s
+        sfc->EchoClient(hChannel, MSG_OK, "Bugreport finish, Size:%" PRIu64 ", Saved:%" PRIu64 ", time:%" PRIu64
+                        "ms rate:%.2lfkB/s", opContext.logSize, opContext.fileIOIndex, nMSec, fRate);
+    } else {
+        constexpr int bufSize = 1024;
+        char buf[bufSize] = { 0 };
+        uv_strerror_r(opContext.lastErrno, buf, bufSize);
+        sfc->EchoClient(hChannel, MSG_FAIL, "Bugreport save failed, Saved:%" PRIu64 ", Reason: %s",
+                        opContext.fileIOIndex, buf);
+    }
+    --hChannel->ref;
+}
+
+void HdcHostUnity::CloseLocalLog()
+{
+    ++refCount;
+    opContext.fsClose.data = &opContext;
+    WRITE_LOG(LOG_DEBUG, "taskInfo->channelId:%u fileLog:%d", taskInfo->channelId, opContext.fileLog);
+    uv_fs_close(loopTask, &opContext.fsClose, opContext.fileLog, OnFileClose);
+}
+
 void HdcHostUnity::OnFileClose(uv_fs_t *req)
 {
     uv_fs_req_cleanup(req);
     ContextUnity *context = reinterpret_cast<ContextUnity *>(req->data);
     HdcHostUnity *thisClass = reinterpret_cast<HdcHostUnity *>(context->thisClass);
+    if (req->result < 0 && context->lastErrno == 0) {
+        context->lastErrno = static_cast<int>(req->result);
+    }
+    thisClass->ReportLocalLog();
     context->hasFilelogClosed = true;
     --thisClass->refCount;
     return;
@@ -75,6 +156,62 @@ bool HdcHostUnity::InitLocalLog(const char *path)
     }
     uv_fs_req_cleanup(&reqFs);
     opContext.fileLog = reqFs.result;
+    opContext.beginMSec = Base::GetRuntimeMSec();
+    string localPath = path;
+    if (localPath.size() > UNITY_LOG_LZ4_SUFFIX.size() &&
+        !localPath.compare(localPath.size() - UNITY_LOG_LZ4_SUFFIX.size(), string::npos, UNITY_LOG_LZ4_SUFFIX) &&
+        !StartLz4()) {
+        uv_fs_close(nullptr, &reqFs, opContext.fileLog, nullptr);
+        uv_fs_req_cleanup(&reqFs);
+        return false;
+    }
+    return true;
+}
+
+bool HdcHostUnity::StartLz4()
+{
+#ifdef HARMONY_PROJECT
+    LZ4F_cctx *ctx = nullptr;
+    if (LZ4F_isError(LZ4F_createCompressionContext(&ctx, LZ4F_VERSION))) {
+        WRITE_LOG(LOG_WARN, "LZ4F_createCompressionContext failed");
+        return false;
+    }
+    opContext.lz4Ctx = ctx;
+    LZ4F_preferences_t prefs = Lz4Preferences();
+    if (!ReserveLocalLog(LZ4F_HEADER_SIZE_MAX)) {
+        return false;
+    }
+    size_t rc = LZ4F_compressBegin(ctx, opContext.bufLog + opContext.bufLogSize,
+                                   UNITY_LOG_BUF_SIZE - opContext.bufLogSize, &prefs);
+    if (LZ4F_isError(rc)) {
+        WRITE_LOG(LOG_WARN, "LZ4F_compressBegin failed:%s", LZ4F_getErrorName(rc));
+        return false;
+    }
+    opContext.bufLogSize += rc;
+#else
+    WRITE_LOG(LOG_WARN, "bugreport is saved as it is, lz4 is not built in");
+#endif
+    return true;
+}
+
+bool HdcHostUnity::EndLz4()
+{
+#ifdef HARMONY_PROJECT
+    if (opContext.lz4Ctx == nullptr) {
+        return true;
+    }
+    LZ4F_preferences_t prefs = Lz4Preferences();
+    if (!ReserveLocalLog(LZ4F_compressBound(0, &prefs))) {
+        return false;
+    }
+    size_t rc = LZ4F_compressEnd(opContext.lz4Ctx, opContext.bufLog + opContext.bufLogSize,
+                                 UNITY_LOG_BUF_SIZE - opContext.bufLogSize, nullptr);
+    if (LZ4F_isError(rc)) {
+        WRITE_LOG(LOG_WARN, "LZ4F_compressEnd failed:%s", LZ4F_getErrorName(rc));
+        return false;
+    }
+    opContext.bufLogSize += rc;
+#endif
     return true;
 }
 
@@ -86,6 +223,7 @@ void HdcHostUnity::OnFileIO(uv_fs_t *req)
     uint8_t *bufIO = contextIO->bufIO;
     uv_fs_req_cleanup(req);
     --thisClass->refCount;
+    --context->writing;
     while (true) {
         if (req->result <= 0) {
             if (req->result < 0) {
@@ -93,40 +231,116 @@ void HdcHostUnity::OnFileIO(uv_fs_t *req)
                 char buf[bufSize] = { 0 };
                 uv_strerror_r((int)req->result, buf, bufSize);
                 WRITE_LOG(LOG_DEBUG, "Error OnFileIO: %s", buf);
+                context->lastErrno = static_cast<int>(req->result);
             }
             break;
         }
         context->fileIOIndex += req->result;
+        if (static_cast<size_t>(req->result) != contextIO->sizeIO && context->lastErrno == 0) {
+            WRITE_LOG(LOG_WARN, "OnFileIO short write %zd of %zu", req->result, contextIO->sizeIO);
+            context->lastErrno = UV_EIO;
+        }
         break;
     }
-    delete[] bufIO;
+    context->bufPool.push_back(bufIO);
     delete contextIO;  // req is part of contextIO, no need to release
+    if (context->closing && context->writing == 0) {
+        thisClass->CloseLocalLog();
+    }
 }
 
-bool HdcHostUnity::AppendLocalLog(const char *bufLog, const int sizeLog)
+// room for size bytes more in bufLog, the full one is written first
+bool HdcHostUnity::ReserveLocalLog(size_t size)
+{
+    if (opContext.bufLog != nullptr && opContext.bufLogSize + size > UNITY_LOG_BUF_SIZE && !FlushLocalLog()) {
+        return false;
+    }
+    if (opContext.bufLog != nullptr) {
+        return true;
+    }
+    if (!opContext.bufPool.empty()) {
+        opContext.bufLog = opContext.bufPool.back();
+        opContext.bufPool.pop_back();
+    } else {
+        opContext.bufLog = new(std::nothrow) uint8_t[UNITY_LOG_BUF_SIZE];
+    }
+    opContext.bufLogSize = 0;
+    return opContext.bufLog != nullptr;
+}
+
+bool HdcHostUnity::FlushLocalLog()
 {
-    auto buf = new uint8_t[sizeLog];
-    auto contextIO = new CtxUnityIO();
-    if (!buf || !contextIO) {
-        if (buf) {
-            delete[] buf;
+    if (opContext.bufLog == nullptr || opContext.bufLogSize == 0) {
+        return true;
+    }
+    uv_buf_t iov = uv_buf_init(reinterpret_cast<char *>(opContext.bufLog), opContext.bufLogSize);
+    if (opContext.writing >= UNITY_LOG_WRITE_BEHIND) {
+        // the disk is behind, the buffer is written in place and filled again
+        uv_fs_t req = {};
+        int rc = uv_fs_write(nullptr, &req, opContext.fileLog, &iov, 1, opContext.fileBufIndex, nullptr);
+        uv_fs_req_cleanup(&req);
+        if (rc < 0 || static_cast<size_t>(rc) != opContext.bufLogSize) {
+            WRITE_LOG(LOG_WARN, "bugreport write failed rc:%d channelId:%u", rc, taskInfo->channelId);
+            opContext.lastErrno = rc < 0 ? rc : UV_EIO;
+            return false;
         }
-        if (contextIO) {
-            delete contextIO;
+        opContext.fileIOIndex += opContext.bufLogSize;
+    } else {
+        auto contextIO = new(std::nothrow) CtxUnityIO();
+        if (contextIO == nullptr) {
+            return false;
         }
-        return false;
+        uv_fs_t *req = &contextIO->fs;
+        contextIO->bufIO = opContext.bufLog;
+        contextIO->sizeIO = opContext.bufLogSize;
+        contextIO->context = &opContext;
+        req->data = contextIO;
+        ++refCount;
+        ++opContext.writing;
+        uv_fs_write(loopTask, req, opContext.fileLog, &iov, 1, opContext.fileBufIndex, OnFileIO);
+        opContext.bufLog = nullptr;
     }
-    uv_fs_t *req = &contextIO->fs;
-    contextIO->bufIO = buf;
-    contextIO->context = &opContext;
-    req->data = contextIO;
-    ++refCount;
+    opContext.fileBufIndex += opContext.bufLogSize;
+    opContext.bufLogSize = 0;
+    return true;
+}
 
-    if (memcpy_s(buf, sizeLog, bufLog, sizeLog)) {
+bool HdcHostUnity::AppendLocalLog(const char *bufLog, const int sizeLog)
+{
+    size_t left = static_cast<size_t>(sizeLog);
+    opContext.logSize += left;
+    while (left > 0) {
+#ifdef HARMONY_PROJECT
+        if (opContext.lz4Ctx != nullptr) {
+            size_t chunk = std::min(left, UNITY_LOG_LZ4_CHUNK);
+            LZ4F_preferences_t prefs = Lz4Preferences();
+            if (!ReserveLocalLog(LZ4F_compressBound(chunk, &prefs))) {
+                return false;
+            }
+            size_t rc = LZ4F_compressUpdate(opContext.lz4Ctx, opContext.bufLog + opContext.bufLogSize,
+                                            UNITY_LOG_BUF_SIZE - opContext.bufLogSize, bufLog, chunk, nullptr);
+            if (LZ4F_isError(rc)) {
+                WRITE_LOG(LOG_WARN, "LZ4F_compressUpdate failed:%s", LZ4F_getErrorName(rc));
+                return false;
+            }
+            opContext.bufLogSize += rc;
+            bufLog += chunk;
+            left -= chunk;
+            continue;
+        }
+#endif
+        if (!ReserveLocalLog(1)) {
+            return false;
+        }
+        size_t size = std::min(left, UNITY_LOG_BUF_SIZE - opContext.bufLogSize);
+        if (memcpy_s(opContext.bufLog + opContext.bufLogSize, UNITY_LOG_BUF_SIZE - opContext.bufLogSize, bufLog,
+                     size) != EOK) {
+            return false;
+        }
+        opContext.bufLogSize += size;
+        bufLog += size;
+        left -= size;
     }
-    uv_buf_t iov = uv_buf_init(reinterpret_cast<char *>(buf), sizeLog);
-    uv_fs_write(loopTask, req, opContext.fileLog, &iov, 1, opContext.fileBufIndex, OnFileIO);
-    opContext.fileBufIndex += sizeLog;
     return true;
 }
 
@@ -149,7 +363,10 @@ bool HdcHostUnity::CommandDispatch(const uint16_t command, uint8_t *payload, con
         }
         case CMD_UNITY_BUGREPORT_DATA: {
             if (opContext.enableLog) {
-                AppendLocalLog(reinterpret_cast<const char *>(payload), payloadSize);
+                if (!AppendLocalLog(reinterpret_cast<const char *>(payload), payloadSize) &&
+                    opContext.lastErrno == 0) {
+                    opContext.lastErrno = UV_ENOMEM;
+                }
             } else {
                 ServerCommand(CMD_KERNEL_ECHO_RAW, payload, payloadSize);
             }
@@ -16,7 +16,11 @@
 #define HDC_HOST_UNITY_H
 #include "host_common.h"
 
+struct LZ4F_cctx_s;
+
 namespace Hdc {
+// The bugreport with a FILE is saved by the server: the payloads are gathered in buffers of UNITY_LOG_BUF_SIZE, a
+// full one is written while the next fills. With a FILE ending in ".lz4" the report is saved as one lz4 frame.
 class HdcHostUnity : public HdcTaskBase {
 public:
     HdcHostUnity(HTaskInfo hTaskInfo);
@@ -34,16 +38,33 @@ private:
         bool hasFilelogClosed;
         uv_fs_t fsClose;
         HdcHostUnity *thisClass;
+        uint8_t *bufLog;            // filling, nullptr until the next payload
+        size_t bufLogSize;
+        vector<uint8_t *> bufPool;  // written, to be filled again
+        uint16_t writing;           // the writes not done yet, no more than UNITY_LOG_WRITE_BEHIND
+        bool closing;               // stopped, closed when the last write is done
+        int lastErrno;
+        uint64_t logSize;           // received, fileIOIndex is what is written
+        uint64_t beginMSec;
+        LZ4F_cctx_s *lz4Ctx;
+        HChannel channel;           // of the client, held from StopTask until the summary is told
     };
     struct CtxUnityIO {
         uv_fs_t fs;
         uint8_t *bufIO;
+        size_t sizeIO;
         ContextUnity *context;
     };
     static void OnFileIO(uv_fs_t *req);
     static void OnFileClose(uv_fs_t *req);
     bool InitLocalLog(const char *path);
     bool AppendLocalLog(const char *bufLog, const int sizeLog);
+    bool StartLz4();
+    bool EndLz4();
+    bool ReserveLocalLog(size_t size);
+    bool FlushLocalLog();
+    void CloseLocalLog();
+    void ReportLocalLog();
 
     ContextUnity opContext = {};
 };
@@ -0,0 +1,695 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "loopback_daemon.h"
+#include <future>
+
+#include "decompress.h"
+#include "serial_struct.h"
+
+namespace Hdc {
+static const string LOOPBACK_DEVNAME = "loopback";
+static const string LOOPBACK_IP = "127.0.0.1";
+static const string ECHO_PREFIX = "echo ";
+static const string APP_DIR = "hdc_loopback_app";
+// a bugreport is made of lines of text, read from the pipe of the dump in packets of a page
+constexpr size_t BUGREPORT_SIZE = 32 * 1024 * 1024;
+constexpr size_t BUGREPORT_PACKET = 4096;
+// a hilog goes on as the log is written, a tick sends what was written since the last one
+constexpr uint64_t HILOG_TICK_MS = 1;
+constexpr size_t HILOG_TICK_SIZE = 256 * 1024;
+static const char *HILOG_TAGS[] = { "HDC", "AbilityManagerService", "WindowManager", "Bluetooth", "LOOPBACK" };
+
+HdcLoopbackApp::HdcLoopbackApp(HTaskInfo hTaskInfo) : HdcTransferBase(hTaskInfo)
+{
+    commandBegin = CMD_APP_BEGIN;
+    commandData = CMD_APP_DATA;
+    isStableBuf = hTaskInfo->isStableBuf;
+}
+
+HdcLoopbackApp::~HdcLoopbackApp()
+{
+    // not begun, the one being installed holds a ref of the task
+    for (Install *install : installs) {
+        unlink(install->path.c_str());
+        delete install;
+    }
+}
+
+bool HdcLoopbackApp::AddFeatures(FeatureFlagsUnion &feature)
+{
+    HdcTransferBase::AddFeatures(feature);
+    feature.bits.appPipeline = static_cast<HdcLoopbackDaemon *>(taskInfo->ownerSessionClass)->AppPipeline();
+#ifdef HARMONY_PROJECT
+    feature.bits.tarLz4 = 1;
+#endif
+    return true;
+}
+
+bool HdcLoopbackApp::SlaveCheck(uint8_t *payload, const int payloadSize)
+{
+    string serialString(reinterpret_cast<char *>(payload), payloadSize);
+    TransferConfig &stat = ctxNow.transferConfig;
+    SerialStruct::ParseFromString(stat, serialString);
+    string dir = Base::GetTmpDir() + APP_DIR;
+    string estr;
+    if (stat.optionalName.empty() || stat.optionalName.find(Base::GetPathSep()) != string::npos ||
+        !Base::TryCreateDirectory(dir, estr)) {
+        Reply(APPMOD_INSTALL, false, "[Fail]Loopback daemon can not take " + stat.optionalName);
+        return false;
+    }
+    ctxNow.fileSize = stat.fileSize;
+    ctxNow.localPath = dir + Base::GetPathSep() + stat.optionalName;
+    ctxNow.master = false;
+    ctxNow.fsOpenReq.data = &ctxNow;
+    receiving = true;
+    ++refCount;
+    uv_fs_open(loopTask, &ctxNow.fsOpenReq, ctxNow.localPath.c_str(), UV_FS_O_TRUNC | UV_FS_O_CREAT | UV_FS_O_WRONLY,
+               S_IWUSR | S_IRUSR, OnFileOpen);
+    ctxNow.transferBegin = Base::GetRuntimeMSec();
+    return true;
+}
+
+// what the walk finds is removed deepest first, then path itself, the number of files is returned
+uint32_t HdcLoopbackApp::RemoveTree(const string &path)
+{
+    vector<DirWalker::Item> items;
+    {
+        DirWalker walker(path, 0);
+        walker.Start();
+        DirWalker::Item item;
+        while (walker.Next(item, true)) {
+            items.push_back(std::move(item));
+        }
+    }
+    std::sort(items.begin(), items.end(),
+              [](const DirWalker::Item &a, const DirWalker::Item &b) { return a.relative > b.relative; });
+    uint32_t files = 0;
+    for (const auto &item : items) {
+        string sub = path + Base::GetPathSep() + item.relative;
+        if (item.isDir) {
+            rmdir(sub.c_str());
+        } else if (unlink(sub.c_str()) == 0) {
+            ++files;
+        }
+    }
+    rmdir(path.c_str());
+    return files;
+}
+
+void HdcLoopbackApp::WhenTransferFinish(CtxFile *context)
+{
+    Install *install = new(std::nothrow) Install();
+    if (install == nullptr) {
+        unlink(context->localPath.c_str());
+        Reply(APPMOD_INSTALL, false, "[Fail]Loopback daemon is out of memory");
+    } else {
+        install->app = this;
+        install->path = context->localPath;
+        install->size = context->indexIO;
+        install->ret = context->lastErrno == 0;
+        installs.push_back(install);
+        if (installs.size() == 1) {
+            StartInstall();
+        }
+    }
+    receiving = false;
+    if (!pendingCheck.empty()) {
+        string check;
+        check.swap(pendingCheck);
+        SlaveCheck(reinterpret_cast<uint8_t *>(check.data()), check.size());
+    }
+}
+
+void HdcLoopbackApp::StartInstall()
+{
+    ++refCount;
+    if (Base::StartWorkThread(loopTask, InstallWork, InstallDone, installs.front()) < 0) {
+        --refCount;
+        Install *install = installs.front();
+        installs.pop_front();
+        unlink(install->path.c_str());
+        Reply(APPMOD_INSTALL, false, "[Fail]Loopback daemon can not install " + install->path);
+        delete install;
+    }
+}
+
+// on the thread pool, the loop goes on with the next package
+void HdcLoopbackApp::InstallWork(uv_work_t *req)
+{
+    Install *install = static_cast<Install *>(req->data);
+    install->msg = Base::StringFormat("%" PRIu64 " bytes", install->size);
+    if (install->ret && install->app->MatchPackageExtendName(install->path, ".tar")) {
+        string dir = install->path + ".dir";
+        Decompress dec(install->path);
+        uint64_t begin = Base::GetRuntimeMSec();
+        install->ret = dec.DecompressToLocal(dir + Base::GetPathSep());
+        uint64_t extractMSec = Base::GetRuntimeMSec() - begin;
+        uint32_t files = RemoveTree(dir);
+        if (install->ret) {
+            install->msg += Base::StringFormat(", tar of %u files extracted in %" PRIu64 "ms", files, extractMSec);
+        } else {
+            install->msg += Base::StringFormat(", tar failed to extract after %u files in %" PRIu64 "ms", files,
+                                               extractMSec);
+        }
+    }
+    unlink(install->path.c_str());
+}
+
+void HdcLoopbackApp::InstallDone(uv_work_t *req, int status)
+{
+    Install *install = static_cast<Install *>(req->data);
+    HdcLoopbackApp *thisClass = install->app;
+    delete req;
+    thisClass->installs.pop_front();
+    thisClass->Reply(APPMOD_INSTALL, install->ret, (install->ret ? "[Success]Loopback daemon took " :
+                     "[Fail]Loopback daemon took ") + install->msg);
+    delete install;
+    if (!thisClass->installs.empty()) {
+        thisClass->StartInstall();
+    }
+    --thisClass->refCount;
+}
+
+void HdcLoopbackApp::Reply(AppModType mode, bool result, const string &msg)
+{
+    replies += msg + "\n";
+    string payload(2, 0);  // 2: mode and result
+    payload[0] = static_cast<char>(mode);
+    payload[1] = static_cast<char>(result);
+    payload += replies;
+    SendToAnother(CMD_APP_FINISH, reinterpret_cast<uint8_t *>(payload.data()), payload.size());
+}
+
+bool HdcLoopbackApp::CommandDispatch(const uint16_t command, uint8_t *payload, const int payloadSize)
+{
+    if (!HdcTransferBase::CommandDispatch(command, payload, payloadSize)) {
+        return false;
+    }
+    bool ret = true;
+    switch (command) {
+        case CMD_APP_CHECK:
+            if (receiving) {
+                // pipelined, the package before is still written, its context is taken when it is finished
+                pendingCheck.assign(reinterpret_cast<char *>(payload), payloadSize);
+                break;
+            }
+            ret = SlaveCheck(payload, payloadSize);
+            break;
+        case CMD_APP_UNINSTALL:
+            Reply(APPMOD_UNINSTALL, true, "[Success]Loopback daemon has nothing to uninstall");
+            break;
+        default:
+            break;
+    }
+    return ret;
+}
+
+HdcLoopbackDaemon::HdcLoopbackDaemon(bool authSignIn) : HdcSessionBase(false), tcpModule(this), authSign(authSignIn)
+{
+    servTCP.data = this;
+}
+
+HdcLoopbackDaemon::~HdcLoopbackDaemon()
+{
+    WRITE_LOG(LOG_DEBUG, "~HdcLoopbackDaemon");
+    // of sessions gone, their loops have closed the timers
+    for (auto &hilog : hilogs) {
+        delete hilog.second;
+    }
+}
+
+int HdcLoopbackDaemon::Initial(uint16_t port)
+{
+    struct sockaddr_in addr;
+    struct sockaddr_storage name;
+    int nameLen = sizeof(name);
+    uv_tcp_init(&loopMain, &servTCP);
+    uv_ip4_addr(LOOPBACK_IP.c_str(), port, &addr);
+    int ret = uv_tcp_bind(&servTCP, (const struct sockaddr *)&addr, 0);
+    if (ret < 0 || (ret = uv_listen((uv_stream_t *)&servTCP, UV_LISTEN_LBACKOG, AcceptClient)) < 0) {
+        WRITE_LOG(LOG_FATAL, "Loopback daemon listen %s:%u failed:%d", LOOPBACK_IP.c_str(), port, ret);
+        return ERR_API_FAIL;
+    }
+    if (uv_tcp_getsockname(&servTCP, (struct sockaddr *)&name, &nameLen) < 0) {
+        return ERR_API_FAIL;
+    }
+    port = ntohs(((struct sockaddr_in *)&name)->sin_port);
+    WRITE_LOG(LOG_INFO, "Loopback daemon listen %s:%u", LOOPBACK_IP.c_str(), port);
+    return port;
+}
+
+int HdcLoopbackDaemon::Start(HdcLoopbackDaemon **daemonOut, std::thread &threadOut, uint16_t port, bool authSign)
+{
+    std::promise<int> ready;
+    std::future<int> result = ready.get_future();
+    // threadSessionMain is taken in the constructor, so the instance is created by the thread running its loop
+    threadOut = std::thread([&ready, daemonOut, port, authSign]() {
+        HdcLoopbackDaemon *daemon = new(std::nothrow) HdcLoopbackDaemon(authSign);
+        if (daemon == nullptr) {
+            ready.set_value(ERR_BUF_ALLOC);
+            return;
+        }
+        int ret = daemon->Initial(port);
+        *daemonOut = ret > 0 ? daemon : nullptr;
+        ready.set_value(ret);
+        if (ret > 0) {
+            daemon->WorkerPendding();
+        } else {
+            uv_close((uv_handle_t *)&daemon->servTCP, nullptr);
+            uv_run(&daemon->loopMain, UV_RUN_NOWAIT);
+        }
+        delete daemon;
+    });
+    int ret = result.get();
+    if (ret <= 0) {
+        threadOut.join();
+    }
+    return ret;
+}
+
+void HdcLoopbackDaemon::Stop(HdcLoopbackDaemon *daemon, std::thread &thread)
+{
+    if (daemon != nullptr) {
+        daemon->PostStopInstanceMessage();
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void HdcLoopbackDaemon::NotifyInstanceSessionFree(HSession hSession, bool freeOrClear)
+{
+    if (!freeOrClear) {
+        std::lock_guard<std::mutex> lock(authMutex);
+        authStates.erase(hSession->sessionId);
+    }
+}
+
+void HdcLoopbackDaemon::ClearInstanceResource()
+{
+    ClearSessions();
+    Base::TryCloseHandle((uv_handle_t *)&servTCP);
+    ReMainLoopForInstanceClear();
+    Base::TryCloseLoop(&loopMain, "HdcLoopbackDaemon::ClearInstanceResource");
+}
+
+void HdcLoopbackDaemon::AcceptClient(uv_stream_t *server, int status)
+{
+    HdcLoopbackDaemon *thisClass = (HdcLoopbackDaemon *)server->data;
+    if (status < 0) {
+        WRITE_LOG(LOG_FATAL, "Loopback daemon accept status:%d", status);
+        return;
+    }
+    auto ctrl = thisClass->BuildCtrlString(SP_START_SESSION, 0, nullptr, 0);
+    HSession hSession = thisClass->MallocSession(false, CONN_TCP, &thisClass->tcpModule);
+    if (!hSession) {
+        return;
+    }
+    if (uv_accept(server, (uv_stream_t *)&hSession->hWorkTCP) < 0) {
+        goto Finish;
+    }
+    if ((hSession->fdChildWorkTCP = Base::DuplicateUvSocket(&hSession->hWorkTCP)) < 0) {
+        goto Finish;
+    }
+    Base::SetTcpOptions((uv_tcp_t *)&hSession->hWorkTCP);
+    Base::StartWorkThread(&thisClass->loopMain, thisClass->SessionWorkThread, Base::FinishWorkThread, hSession);
+    // wait for thread up
+    while (hSession->childLoop.active_handles == 0) {
+        uv_sleep(MINOR_TIMEOUT);
+    }
+    Base::SendToPollFd(hSession->ctrlFd[STREAM_MAIN], ctrl.data(), ctrl.size());
+    return;
+Finish:
+    WRITE_LOG(LOG_FATAL, "Loopback daemon accept failed sessionId:%u", hSession->sessionId);
+    thisClass->FreeSession(hSession->sessionId);
+}
+
+bool HdcLoopbackDaemon::DaemonSessionHandshake(HSession hSession, const uint32_t channelId, uint8_t *payload,
+                                               int payloadSize)
+{
+    // session handshake step2
+    string s = string(reinterpret_cast<char *>(payload), payloadSize);
+    SessionHandShake handshake;
+    SerialStruct::ParseFromString(handshake, s);
+    if (handshake.banner != HANDSHAKE_MESSAGE.c_str()) {
+        WRITE_LOG(LOG_FATAL, "Loopback daemon recv invalid handshake");
+        return false;
+    }
+    // use the id of the server, so that both sides log the same session
+    if (handshake.sessionId != hSession->sessionId) {
+        uint32_t oldSessionId = hSession->sessionId;
+        hSession->sessionId = handshake.sessionId;
+        AdminSession(OP_UPDATE, oldSessionId, hSession);
+    }
+    hSession->connectKey = handshake.connectKey;
+    if (handshake.authType != AUTH_NONE) {
+        return DaemonAuth(hSession, channelId, handshake);
+    }
+    AuthState state;
+    state.features = NegotiateFeatures(handshake.buf);
+    if (!authSign) {
+        return HandshakeOK(hSession, channelId, handshake, state);
+    }
+    std::map<string, string> tlvmap;
+    SessionTicketStore::Ticket ticket;
+    if ((state.features & FEATURE_TICKET) && Base::TlvToStringMap(handshake.buf, tlvmap) &&
+        tlvmap.find(TAG_TICKET_ID) != tlvmap.end() && tickets.Get(tlvmap[TAG_TICKET_ID], ticket) &&
+        ticket.connectKey == hSession->connectKey) {
+        state.ticketId = ticket.id;
+    }
+    {
+        std::lock_guard<std::mutex> lock(authMutex);
+        authStates[hSession->sessionId] = state;
+    }
+    if (!state.ticketId.empty()) {
+        string challenge = SessionTicketStore::RandomBytes(HdcAuth::RSA_TOKEN_SIZE);
+        hSession->tokenRSA = Base::Convert2HexStr(reinterpret_cast<uint8_t *>(challenge.data()), challenge.size());
+        handshake.authType = AUTH_TICKET;
+        handshake.buf = hSession->tokenRSA;
+    } else {
+        handshake.authType = AUTH_PUBLICKEY;
+        handshake.buf.clear();
+        Base::TlvAppend(handshake.buf, TAG_AUTH_TYPE, std::to_string(AuthVerifyType::RSA_3072_SHA512));
+    }
+    SendHandshake(hSession, channelId, handshake);
+    return true;
+}
+
+// AUTH_TICKET: the proof of the ticket, or AUTH_PUBLICKEY: the key of the server, the host is taken as known and a
+// token is sent to be signed, then AUTH_SIGNATURE: the signature
+bool HdcLoopbackDaemon::DaemonAuth(HSession hSession, const uint32_t channelId, SessionHandShake &handshake)
+{
+    AuthState state;
+    {
+        std::lock_guard<std::mutex> lock(authMutex);
+        auto it = authStates.find(hSession->sessionId);
+        if (!authSign || it == authStates.end()) {
+            WRITE_LOG(LOG_FATAL, "Loopback daemon recv unexpected authType:%u", handshake.authType);
+            return false;
+        }
+        state = it->second;
+        if (handshake.authType == AUTH_SIGNATURE || handshake.authType == AUTH_TICKET) {
+            authStates.erase(it);
+        }
+    }
+    if (handshake.authType == AUTH_TICKET) {
+        SessionTicketStore::Ticket ticket;
+        if (tickets.Get(state.ticketId, ticket) &&
+            SessionTicketStore::CheckProof(ticket, hSession->tokenRSA, handshake.buf)) {
+            WRITE_LOG(LOG_INFO, "Loopback daemon session %u resumed", hSession->sessionId);
+            state.pubkey.clear();  // no new ticket, the lifetime is from the full auth
+            return HandshakeOK(hSession, channelId, handshake, state);
+        }
+        WRITE_LOG(LOG_WARN, "Loopback daemon session %u ticket proof failed", hSession->sessionId);
+        tickets.Remove(state.ticketId);
+        state.ticketId.clear();
+        {
+            std::lock_guard<std::mutex> lock(authMutex);
+            authStates[hSession->sessionId] = state;
+        }
+        handshake.authType = AUTH_PUBLICKEY;
+        handshake.buf.clear();
+        Base::TlvAppend(handshake.buf, TAG_AUTH_TYPE, std::to_string(AuthVerifyType::RSA_3072_SHA512));
+        SendHandshake(hSession, channelId, handshake);
+        return true;
+    }
+    if (handshake.authType == AUTH_PUBLICKEY && !handshake.buf.empty()) {
+        size_t pos = handshake.buf.find(HDC_HOST_DAEMON_BUF_SEPARATOR);
+        {
+            std::lock_guard<std::mutex> lock(authMutex);
+            authStates[hSession->sessionId].pubkey = pos != string::npos ? handshake.buf.substr(pos + 1) : "";
+        }
+        hSession->tokenRSA = Base::GetRandomString(HdcAuth::RSA_TOKEN_SIZE);
+        handshake.authType = AUTH_SIGNATURE;
+        handshake.buf = hSession->tokenRSA;
+        SendHandshake(hSession, channelId, handshake);
+        return true;
+    }
+    if (handshake.authType != AUTH_SIGNATURE || handshake.buf.empty()) {
+        WRITE_LOG(LOG_FATAL, "Loopback daemon auth failed, authType:%u", handshake.authType);
+        return false;
+    }
+    return HandshakeOK(hSession, channelId, handshake, state);
+}
+
+bool HdcLoopbackDaemon::HandshakeOK(HSession hSession, const uint32_t channelId, SessionHandShake &handshake,
+                                    const AuthState &state)
+{
+    handshake.authType = AUTH_OK;
+    handshake.version = Base::GetVersion() + HDC_MSG_HASH;
+    handshake.buf.clear();
+    Base::TlvAppend(handshake.buf, TAG_DEVNAME, LOOPBACK_DEVNAME);
+    Base::TlvAppend(handshake.buf, TAG_DAEOMN_AUTHSTATUS, DAEOMN_AUTH_SUCCESS);
+    Base::TlvAppend(handshake.buf, TAG_FEATURE, FeatureToString(state.features));
+    SessionTicketStore::Ticket ticket;
+    if ((state.features & FEATURE_TICKET) && !state.pubkey.empty() && tickets.Issue(hSession->connectKey, ticket)) {
+        string key = ticket.key;
+        if (HdcAuth::PublicKeyEncryptBase64(state.pubkey, key)) {
+            Base::TlvAppend(handshake.buf, TAG_TICKET_ID, ticket.id);
+            Base::TlvAppend(handshake.buf, TAG_TICKET_KEY, key);
+            Base::TlvAppend(handshake.buf, TAG_TICKET_LIFE, std::to_string(SessionTicketStore::TICKET_LIFE));
+        } else {
+            tickets.Remove(ticket.id);
+        }
+    }
+    SendHandshake(hSession, channelId, handshake);
+    // the answer itself goes in the old format, the server switches when it gets it
+    hSession->stat.handshakeTime = Metrics::NowUs() - hSession->stat.beginTime;
+    hSession->handshakeOK = true;
+    return SetSessionFeatures(hSession, state.features);
+}
+
+void HdcLoopbackDaemon::SendHandshake(HSession hSession, const uint32_t channelId, SessionHandShake &handshake)
+{
+    string hs = SerialStruct::SerializeToString(handshake);
+    Send(hSession->sessionId, channelId, CMD_KERNEL_HANDSHAKE,
+         reinterpret_cast<uint8_t *>(const_cast<char *>(hs.c_str())), hs.size());
+}
+
+// 'shell echo xxx' is the only shell command, answered with its arguments and closed at once
+void HdcLoopbackDaemon::ExecuteEcho(HSession hSession, const uint32_t channelId, uint8_t *payload,
+                                    const int payloadSize)
+{
+    string cmd(reinterpret_cast<char *>(payload), payloadSize);
+    cmd = cmd.c_str();  // may be ended with '\0'
+    string echo;
+    if (!strncmp(cmd.c_str(), ECHO_PREFIX.c_str(), ECHO_PREFIX.size())) {
+        echo = cmd.substr(ECHO_PREFIX.size()) + "\n";
+    } else {
+        echo = "Loopback daemon supports 'echo' only\n";
+    }
+    Send(hSession->sessionId, channelId, CMD_KERNEL_ECHO_RAW, reinterpret_cast<uint8_t *>(echo.data()), echo.size());
+    uint8_t count = 1;
+    Send(hSession->sessionId, channelId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+}
+
+// a bugreport is BUGREPORT_SIZE of made up log lines, sent at once and closed
+void HdcLoopbackDaemon::ExecuteBugreport(HSession hSession, const uint32_t channelId)
+{
+    string packet;
+    for (size_t sent = 0, line = 0; sent < BUGREPORT_SIZE; ++line) {
+        packet += Base::StringFormat("%08zu I loopback/%zu: line %zu of the loopback bugreport\n", line, line % 97,
+                                     line);  // 97: vary the lines
+        if (packet.size() >= BUGREPORT_PACKET || sent + packet.size() >= BUGREPORT_SIZE) {
+            Send(hSession->sessionId, channelId, CMD_UNITY_BUGREPORT_DATA, reinterpret_cast<uint8_t *>(packet.data()),
+                 packet.size());
+            sent += packet.size();
+            packet.clear();
+        }
+    }
+    uint8_t count = 1;
+    Send(hSession->sessionId, channelId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+}
+
+// lines like hilog, mostly I and D, a W or E now and then, over a few tags
+void HdcLoopbackDaemon::ExecuteHilog(HSession hSession, const uint32_t channelId, uint8_t *payload,
+                                     const int payloadSize)
+{
+    if (payloadSize > 0 && payload[0] == 'h') {
+        string help = "Loopback daemon hilog has no options\n";
+        Send(hSession->sessionId, channelId, CMD_KERNEL_ECHO_RAW, reinterpret_cast<uint8_t *>(help.data()),
+             help.size());
+        uint8_t count = 1;
+        Send(hSession->sessionId, channelId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+        return;
+    }
+    Hilog *hilog = new(std::nothrow) Hilog();
+    if (hilog == nullptr) {
+        return;
+    }
+    hilog->daemon = this;
+    hilog->sessionId = hSession->sessionId;
+    hilog->channelId = channelId;
+    hilog->sent = 0;
+    hilog->line = 0;
+    hilog->timer.data = hilog;
+    {
+        std::lock_guard<std::mutex> lock(hilogMutex);
+        hilogs[channelId] = hilog;
+    }
+    uv_timer_init(&hSession->childLoop, &hilog->timer);
+    uv_timer_start(&hilog->timer, HilogTimer, 0, HILOG_TICK_MS);
+}
+
+void HdcLoopbackDaemon::HilogTimer(uv_timer_t *handle)
+{
+    Hilog *hilog = reinterpret_cast<Hilog *>(handle->data);
+    HdcLoopbackDaemon *thisClass = hilog->daemon;
+    string packet;
+    size_t tickEnd = std::min(hilog->sent + HILOG_TICK_SIZE, HILOG_SIZE);
+    while (hilog->sent < tickEnd) {
+        // 64, 16, 3, 7, 13: vary the lines, 1000 and 60: the ms and s of the time
+        size_t line = hilog->line++;
+        const char level = line % 64 == 0 ? 'E' : (line % 16 == 0 ? 'W' : (line % 3 == 0 ? 'D' : 'I'));
+        packet += Base::StringFormat("10-19 13:20:%02zu.%03zu  %5zu  %5zu %c C02d33/%s: event %zu done\n",
+                                     line / 1000 % 60, line % 1000, 1000 + line % 7, 1000 + line % 13, level,
+                                     HILOG_TAGS[line % (sizeof(HILOG_TAGS) / sizeof(HILOG_TAGS[0]))], line);
+        if (packet.size() >= BUGREPORT_PACKET || hilog->sent + packet.size() >= tickEnd) {
+            thisClass->Send(hilog->sessionId, hilog->channelId, CMD_KERNEL_ECHO_RAW,
+                            reinterpret_cast<uint8_t *>(packet.data()), packet.size());
+            hilog->sent += packet.size();
+            packet.clear();
+        }
+    }
+    if (hilog->sent >= HILOG_SIZE) {
+        uint8_t count = 1;
+        thisClass->Send(hilog->sessionId, hilog->channelId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+        thisClass->StopHilog(hilog->channelId);
+    }
+}
+
+void HdcLoopbackDaemon::StopHilog(uint32_t channelId)
+{
+    Hilog *hilog = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(hilogMutex);
+        auto it = hilogs.find(channelId);
+        if (it == hilogs.end()) {
+            return;
+        }
+        hilog = it->second;
+        hilogs.erase(it);
+    }
+    uv_timer_stop(&hilog->timer);
+    uv_close(reinterpret_cast<uv_handle_t *>(&hilog->timer), [](uv_handle_t *handle) {
+        delete reinterpret_cast<Hilog *>(handle->data);
+    });
+}
+
+bool HdcLoopbackDaemon::FetchCommand(HSession hSession, const uint32_t channelId, const uint16_t command,
+                                     uint8_t *payload, const int payloadSize)
+{
+    bool ret = true;
+    if (!hSession->handshakeOK && command != CMD_KERNEL_HANDSHAKE) {
+        return false;
+    }
+    switch (command) {
+        case CMD_KERNEL_HANDSHAKE:
+            ret = DaemonSessionHandshake(hSession, channelId, payload, payloadSize);
+            break;
+        case CMD_KERNEL_CHANNEL_CLOSE:
+            StopHilog(channelId);
+            ClearOwnTasks(hSession, channelId);
+            if (*payload != 0) {
+                --(*payload);
+                Send(hSession->sessionId, channelId, CMD_KERNEL_CHANNEL_CLOSE, payload, 1);
+            }
+            break;
+        default:
+            ret = DispatchTaskData(hSession, channelId, command, payload, payloadSize);
+            break;
+    }
+    return ret;
+}
+
+bool HdcLoopbackDaemon::ServerCommand(const uint32_t sessionId, const uint32_t channelId, const uint16_t command,
+                                      uint8_t *bufPtr, const int size)
+{
+    // as a daemon, the messages of the tasks go to the server
+    return Send(sessionId, channelId, command, bufPtr, size) > 0;
+}
+
+// clang-format off
+bool HdcLoopbackDaemon::RedirectToTask(HTaskInfo hTaskInfo, HSession hSession, const uint32_t channelId,
+                                       const uint16_t command, uint8_t *payload, const int payloadSize)
+// clang-format on
+{
+    bool ret = true;
+    hTaskInfo->ownerSessionClass = this;
+    switch (command) {
+        case CMD_UNITY_EXECUTE:
+            hTaskInfo->taskType = TYPE_UNITY;
+            ExecuteEcho(hSession, channelId, payload, payloadSize);
+            break;
+        case CMD_UNITY_BUGREPORT_INIT:
+            hTaskInfo->taskType = TYPE_UNITY;
+            ExecuteBugreport(hSession, channelId);
+            break;
+        case CMD_UNITY_HILOG:
+            hTaskInfo->taskType = TYPE_UNITY;
+            ExecuteHilog(hSession, channelId, payload, payloadSize);
+            break;
+        case CMD_FILE_INIT:
+        case CMD_FILE_BEGIN:
+        case CMD_FILE_CHECK:
+        case CMD_FILE_DATA:
+        case CMD_FILE_FINISH:
+        case CMD_FILE_MODE:
+        case CMD_DIR_MODE:
+            ret = TaskCommandDispatch<HdcFile>(hTaskInfo, TASK_FILE, command, payload, payloadSize);
+            break;
+        case CMD_APP_CHECK:
+        case CMD_APP_DATA:
+        case CMD_APP_UNINSTALL:
+            ret = TaskCommandDispatch<HdcLoopbackApp>(hTaskInfo, TASK_APP, command, payload, payloadSize);
+            break;
+        case CMD_FORWARD_INIT:
+        case CMD_FORWARD_CHECK:
+        case CMD_FORWARD_CHECK_RESULT:
+        case CMD_FORWARD_ACTIVE_MASTER:
+        case CMD_FORWARD_ACTIVE_SLAVE:
+        case CMD_FORWARD_DATA:
+        case CMD_FORWARD_FREE_CONTEXT:
+            ret = TaskCommandDispatch<HdcHostForward>(hTaskInfo, TASK_FORWARD, command, payload, payloadSize);
+            break;
+        default:
+            WRITE_LOG(LOG_WARN, "Loopback daemon ignore command:%u", command);
+            break;
+    }
+    return ret;
+}
+
+bool HdcLoopbackDaemon::RemoveInstanceTask(const uint8_t op, HTaskInfo hTask)
+{
+    bool ret = true;
+    switch (hTask->taskType) {
+        case TYPE_UNITY:
+            break;
+        case TASK_FILE:
+            ret = DoTaskRemove<HdcFile>(hTask, op);
+            break;
+        case TASK_FORWARD:
+            ret = DoTaskRemove<HdcHostForward>(hTask, op);
+            break;
+        case TASK_APP:
+            ret = DoTaskRemove<HdcLoopbackApp>(hTask, op);
+            break;
+        default:
+            ret = false;
+            break;
+    }
+    return ret;
+}
+}  // namespace Hdc
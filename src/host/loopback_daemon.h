@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HDC_LOOPBACK_DAEMON_H
+#define HDC_LOOPBACK_DAEMON_H
+#include "host_common.h"
+
+namespace Hdc {
+// The app slave of the loopback daemon: a package is received to the tmp dir like a file, a tar, or the lz4 frame of
+// one with tarLz4, is extracted on the thread pool, then all is removed again. Nothing is installed, the finish says
+// what was taken. With appPipeline the next package is received while one is extracted, one at a time in order.
+class HdcLoopbackApp : public HdcTransferBase {
+public:
+    explicit HdcLoopbackApp(HTaskInfo hTaskInfo);
+    virtual ~HdcLoopbackApp();
+    bool CommandDispatch(const uint16_t command, uint8_t *payload, const int payloadSize) override;
+
+private:
+    bool AddFeatures(FeatureFlagsUnion &feature) override;
+    void WhenTransferFinish(CtxFile *context) override;
+    bool SlaveCheck(uint8_t *payload, const int payloadSize);
+    void Reply(AppModType mode, bool result, const string &msg);
+    static uint32_t RemoveTree(const string &path);
+    // a package received, it waits for the ones before it
+    struct Install {
+        HdcLoopbackApp *app;
+        string path;
+        uint64_t size;
+        bool ret;
+        string msg;
+    };
+    void StartInstall();
+    static void InstallWork(uv_work_t *req);
+    static void InstallDone(uv_work_t *req, int status);
+
+    string replies;  // all of the task, the host shows what it has not shown yet
+    std::deque<Install *> installs;  // the first one is being installed
+    bool receiving = false;          // a check which comes now waits for the end of the package
+    string pendingCheck;
+};
+
+// Minimal daemon stand-in for 'hdc bench': speaks the session protocol over local tcp, so the server can 'tconn'
+// it like a real device. Handshake is answered with AUTH_OK at once, or with authSign after the AUTH_PUBLICKEY and
+// AUTH_SIGNATURE steps of a device which knows the host, so the server signs a token (the signature is not checked),
+// and after that with FEATURE_TICKET the resumption by AUTH_TICKET.
+// File and forward tasks run the common HdcFile/HdcHostForward slaves on the local filesystem and network,
+// 'shell echo ...' and a bugreport are answered inline, a hilog is HILOG_SIZE of log lines sent by a timer, an app
+// install is taken by HdcLoopbackApp. Everything else is ignored.
+// The instance must be created and run in its own thread, see Start/Stop.
+class HdcLoopbackDaemon : public HdcSessionBase {
+public:
+    static constexpr size_t HILOG_SIZE = 16 * 1024 * 1024;
+
+    HdcLoopbackDaemon(bool authSignIn = false);
+    virtual ~HdcLoopbackDaemon();
+    // listen on 127.0.0.1:port, port 0 picks a free one, return the port or RetErrCode
+    int Initial(uint16_t port);
+    bool FetchCommand(HSession hSession, const uint32_t channelId, const uint16_t command, uint8_t *payload,
+                      const int payloadSize) override;
+    // run the loop in a new thread, return the listen port or RetErrCode
+    static int Start(HdcLoopbackDaemon **daemonOut, std::thread &threadOut, uint16_t port = 0, bool authSign = false);
+    static void Stop(HdcLoopbackDaemon *daemon, std::thread &thread);
+    // the app slaves of the tasks begun after it say appPipeline or not
+    void SetAppPipeline(bool pipeline)
+    {
+        appPipeline = pipeline;
+    }
+    bool AppPipeline()
+    {
+        return appPipeline;
+    }
+
+private:
+    class TCPModule : public HdcTCPBase {
+    public:
+        TCPModule(void *ptrMainBase) : HdcTCPBase(false, ptrMainBase)
+        {
+        }
+    };
+    static void AcceptClient(uv_stream_t *server, int status);
+    bool DaemonSessionHandshake(HSession hSession, const uint32_t channelId, uint8_t *payload, int payloadSize);
+    // between the first handshake and AUTH_OK
+    struct AuthState {
+        uint32_t features = 0;
+        string ticketId;  // FEATURE_TICKET, the ticket the server came with
+        string pubkey;    // of the server, to encrypt the key of a new ticket
+    };
+    bool DaemonAuth(HSession hSession, const uint32_t channelId, SessionHandShake &handshake);
+    bool HandshakeOK(HSession hSession, const uint32_t channelId, SessionHandShake &handshake,
+                     const AuthState &state);
+    void SendHandshake(HSession hSession, const uint32_t channelId, SessionHandShake &handshake);
+    void ExecuteEcho(HSession hSession, const uint32_t channelId, uint8_t *payload, const int payloadSize);
+    void ExecuteBugreport(HSession hSession, const uint32_t channelId);
+    struct Hilog {
+        uv_timer_t timer;
+        HdcLoopbackDaemon *daemon;
+        uint32_t sessionId;
+        uint32_t channelId;
+        size_t sent;
+        size_t line;
+    };
+    void ExecuteHilog(HSession hSession, const uint32_t channelId, uint8_t *payload, const int payloadSize);
+    static void HilogTimer(uv_timer_t *handle);
+    void StopHilog(uint32_t channelId);
+    bool ServerCommand(const uint32_t sessionId, const uint32_t channelId, const uint16_t command, uint8_t *bufPtr,
+                       const int size) override;
+    bool RedirectToTask(HTaskInfo hTaskInfo, HSession hSession, const uint32_t channelId, const uint16_t command,
+                        uint8_t *payload, const int payloadSize) override;
+    bool RemoveInstanceTask(const uint8_t op, HTaskInfo hTask) override;
+    void NotifyInstanceSessionFree(HSession hSession, bool freeOrClear) override;
+    void ClearInstanceResource() override;
+
+    TCPModule tcpModule;
+    uv_tcp_t servTCP;
+    bool authSign;
+    std::mutex authMutex;
+    std::map<uint32_t, AuthState> authStates;  // by sessionId
+    SessionTicketStore tickets;                // by ticket id
+    std::mutex hilogMutex;
+    map<uint32_t, Hilog *> hilogs;  // by channelId, the timer is on the loop of the session
+    std::atomic<bool> appPipeline = true;
+};
+}  // namespace Hdc
+
+#endif
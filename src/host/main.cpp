@@ -13,8 +13,11 @@
  * limitations under the License.
  */
 
+#include <fstream>
 #include <iostream>
 #include "ext_client.h"
+#include "host_batch.h"
+#include "host_bench.h"
 #include "server.h"
 #include "server_for_client.h"
 
@@ -37,6 +40,7 @@ namespace {
     bool g_isCustomLoglevel = false;
     bool g_externalCmd = false;
     int g_isTestMethod = 0;
+    int g_optionExitCode = 0;  // of the options that do their work and exit, like -L
     string g_connectKey = "";
     string g_serverListenString = "";
     string g_containerInOut = "";
@@ -56,6 +60,11 @@ int IsRegisterCommand(string &outCommand, const char *cmd, const char *cmdnext)
     registerCommand.push_back(CMDSTR_CHECK_SERVER);
     registerCommand.push_back(CMDSTR_CHECK_DEVICE);
     registerCommand.push_back(CMDSTR_WAIT_FOR);
+    registerCommand.push_back(CMDSTR_SERVER_TRACE);
+    registerCommand.push_back(CMDSTR_SERVER_STAT);
+    registerCommand.push_back(CMDSTR_BENCH);
+    registerCommand.push_back(CMDSTR_BATCH);
+    registerCommand.push_back(CMDSTR_EACH);
     registerCommand.push_back(CMDSTR_CONNECT_ANY);
     registerCommand.push_back(CMDSTR_CONNECT_TARGET);
     registerCommand.push_back(CMDSTR_SHELL);
@@ -95,11 +104,8 @@ int IsRegisterCommand(string &outCommand, const char *cmd, const char *cmdnext)
     return 0;
 }
 
-void AppendCwdWhenTransfer(string &outCommand)
+bool GetClientCwd(string &cwd)
 {
-    if (outCommand != CMDSTR_FILE_SEND && outCommand != CMDSTR_FILE_RECV && outCommand != CMDSTR_APP_INSTALL) {
-        return;
-    }
     int value = -1;
     char path[PATH_MAX] = "";
     size_t size = sizeof(path);
@@ -109,19 +115,108 @@ void AppendCwdWhenTransfer(string &outCommand)
         char buf[bufSize] = { 0 };
         uv_strerror_r(value, buf, bufSize);
         WRITE_LOG(LOG_FATAL, "append cwd path failed: %s", buf);
-        return;
+        return false;
     }
     if (strlen(path) >= PATH_MAX - 1) {
         WRITE_LOG(LOG_FATAL, "append cwd path failed: buffer space max");
-        return;
+        return false;
     }
     if (path[strlen(path) - 1] != Base::GetPathSep()) {
         path[strlen(path)] = Base::GetPathSep();
     }
+    cwd = path;
+    return true;
+}
+
+void AppendCwdWhenTransfer(string &outCommand)
+{
+    if (outCommand != CMDSTR_FILE_SEND && outCommand != CMDSTR_FILE_RECV && outCommand != CMDSTR_APP_INSTALL) {
+        return;
+    }
+    string cwd;
+    if (!GetClientCwd(cwd)) {
+        return;
+    }
     outCommand += outCommand.size() ? " " : "";
     outCommand += CMDSTR_REMOTE_PARAMETER;
     outCommand += outCommand.size() ? " -cwd " : "-cwd ";
-    outCommand += Base::StringFormat("\"%s\"", path);
+    outCommand += Base::StringFormat("\"%s\"", cwd.c_str());
+}
+
+// each [-j N] [-T SECONDS] TARGETS file send|install ...: the server runs the transfer, the relative local paths are
+// of the client
+void AppendCwdWhenEach(string &commands)
+{
+    if (commands.compare(0, CMDSTR_EACH.size() + 1, CMDSTR_EACH + " ")) {
+        return;
+    }
+    size_t pos = CMDSTR_EACH.size() + 1;
+    int skip = 1;  // TARGETS
+    for (size_t opt = pos; opt != string::npos && (!commands.compare(opt, strlen("-j "), "-j ") ||
+                                                   !commands.compare(opt, strlen("-T "), "-T "));) {
+        skip += 2;  // 2: the option and its value
+        opt = commands.find(' ', opt + strlen("-j "));
+        opt = opt == string::npos ? opt : opt + 1;
+    }
+    for (int i = 0; i < skip && pos != string::npos; ++i) {
+        pos = commands.find(' ', pos);
+        pos = pos == string::npos ? pos : pos + 1;
+    }
+    if (pos == string::npos) {
+        return;
+    }
+    string prefix;
+    if (!commands.compare(pos, CMDSTR_FILE_SEND.size() + 1, CMDSTR_FILE_SEND + " ")) {
+        prefix = CMDSTR_FILE_SEND + " ";
+    } else if (!commands.compare(pos, CMDSTR_APP_INSTALL.size() + 1, CMDSTR_APP_INSTALL + " ")) {
+        prefix = CMDSTR_APP_INSTALL + " ";
+    }
+    string cwd;
+    if (prefix.empty() || !GetClientCwd(cwd)) {
+        return;
+    }
+    commands.insert(pos + prefix.size(), Base::StringFormat("-cwd \"%s\" ", cwd.c_str()));
+}
+
+// tconn ... -f FILE, the path is of the client: the keys in FILE, blank separated and # for comment, go instead
+bool ExpandTargetFile(string &commands)
+{
+    const string option = " -f ";
+    size_t pos = commands.find(option);
+    if (strncmp(commands.c_str(), (CMDSTR_CONNECT_TARGET + " ").c_str(), CMDSTR_CONNECT_TARGET.size() + 1) ||
+        pos == string::npos) {
+        return true;
+    }
+    size_t begin = pos + option.size();
+    size_t end = string::npos;
+    string path;
+    if (commands[begin] == '"') {  // quoted by SplitOptionAndCommand for the blank in it
+        end = commands.find('"', begin + 1);
+        path = commands.substr(begin + 1, end == string::npos ? string::npos : end - begin - 1);
+        end = end == string::npos ? end : end + 1;
+    } else {
+        end = commands.find(' ', begin);
+        path = commands.substr(begin, end == string::npos ? string::npos : end - begin);
+    }
+    std::ifstream in(path);
+    if (!in) {
+        Base::PrintMessage("Cannot read target file %s", path.c_str());
+        return false;
+    }
+    string keys;
+    string line;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        std::replace(line.begin(), line.end(), '\t', ' ');
+        std::replace(line.begin(), line.end(), '\r', ' ');
+        vector<string> words;
+        Base::SplitString(line, " ", words);
+        for (auto &word : words) {
+            keys += " " + word;
+        }
+    }
+    commands.replace(pos, end == string::npos ? string::npos : end - pos, keys);
+    return true;
 }
 
 int SplitOptionAndCommand(int argc, const char **argv, string &outOption, string &outCommand)
@@ -211,6 +306,18 @@ int RunClientMode(string &commands, string &serverListenString, string &connectK
         HdcServer::PullupServer(serverListenString.c_str());
         uv_sleep(START_SERVER_FOR_CLIENT_TIME);  // give time to start serverForClient,at least 200ms
     }
+    if (!strncmp(commands.c_str(), CMDSTR_BENCH.c_str(), CMDSTR_BENCH.size())) {
+        HdcHostBench bench(serverListenString, connectKey);
+        return bench.Run(commands) == RET_SUCCESS ? 0 : 1;
+    }
+    if (!strncmp(commands.c_str(), CMDSTR_BATCH.c_str(), CMDSTR_BATCH.size())) {
+        HdcHostBatch batch(serverListenString, connectKey);
+        return batch.Run(commands) == RET_SUCCESS ? 0 : 1;
+    }
+    if (!ExpandTargetFile(commands)) {
+        return 0;
+    }
+    AppendCwdWhenEach(commands);
     client.Initial(connectKey);
     client.ExecuteCommand(commands.c_str());
     return 0;
@@ -285,7 +392,7 @@ bool GetCommandlineOptions(int optArgc, const char *optArgv[])
     bool needExit = false;
     opterr = 0;
     // get option parameters first
-    while ((ch = getopt(optArgc, const_cast<char *const*>(optArgv), "hvpfmncs:Sd:t:l:")) != -1) {
+    while ((ch = getopt(optArgc, const_cast<char *const*>(optArgv), "hvpfmncs:Sd:t:l:L:")) != -1) {
         switch (ch) {
             case 'h': {
                 string usage = Hdc::TranslateCommand::Usage();
@@ -316,6 +423,14 @@ bool GetCommandlineOptions(int optArgc, const char *optArgv[])
                 Base::SetLogLevel(logLevel);
                 break;
             }
+            case 'L': {  // decode binary log file to stdout
+                // DecodeFile has told what is wrong with the file
+                if (BinaryLog::DecodeFile(optarg, stdout) != RET_SUCCESS) {
+                    g_optionExitCode = 1;
+                }
+                needExit = true;
+                return needExit;
+            }
             case 'm': {  // [not-publish] is server mode，or client mode
                 g_isServerMode = true;
                 break;
@@ -443,9 +558,10 @@ int main(int argc, const char *argv[])
     cmdOptionResult = GetCommandlineOptions(optArgc, const_cast<const char **>(optArgv));
     delete[](reinterpret_cast<char*>(optArgv));
     if (cmdOptionResult) {
-        return 0;
+        return g_optionExitCode;
     }
     Base::InitProcess();
+    Trace::StartByEnv();
     if (g_isServerMode) {
         // -m server.Run alone in the background, no -s will be listen loopback address
         Hdc::RunServerMode(g_serverListenString);
@@ -453,13 +569,19 @@ int main(int argc, const char *argv[])
         Hdc::RunPcDebugMode(g_isPullServer, g_isTCPorUSB, g_isTestMethod);
     } else {
         if (!g_isCustomLoglevel) {
-            Base::SetLogLevel(LOG_INFO);
+            // the loopback daemon of bench logs in this process, keep its report clean
+            Base::SetLogLevel(commands.compare(0, CMDSTR_BENCH.size(), CMDSTR_BENCH) ? LOG_INFO : LOG_FATAL);
         }
 
-        if (!ExtClient::SharedLibraryExist()) {
-            Hdc::RunClientMode(commands, g_serverListenString, g_connectKey, g_isPullServer);
+        // the commands of a batch and each, and bench, go to the hdc server only. The exit status of a batch or a
+        // bench is 1 if a command of it failed
+        if (!ExtClient::SharedLibraryExist() || !commands.compare(0, CMDSTR_BATCH.size(), CMDSTR_BATCH) ||
+            !commands.compare(0, CMDSTR_BENCH.size(), CMDSTR_BENCH) ||
+            !commands.compare(0, CMDSTR_EACH.size() + 1, CMDSTR_EACH + " ")) {
+            int ret = Hdc::RunClientMode(commands, g_serverListenString, g_connectKey, g_isPullServer);
+            Trace::FinishByEnv();
             Hdc::Base::RemoveLogCache();
-            _exit(0);
+            _exit(ret == 0 ? 0 : 1);
         }
         string str = "list targets";
         if (!strncmp(commands.c_str(), CMDSTR_LIST_TARGETS.c_str(), CMDSTR_LIST_TARGETS.size())) {
@@ -505,6 +627,7 @@ int main(int argc, const char *argv[])
         }
     }
     WRITE_LOG(LOG_DEBUG, "!!!!!!!!!Main finish main");
+    Trace::FinishByEnv();
     Hdc::Base::RemoveLogCache();
     return 0;
 }
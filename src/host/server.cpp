@@ -21,6 +21,7 @@ HdcServer::HdcServer(bool serverOrDaemonIn)
     : HdcSessionBase(serverOrDaemonIn)
 {
     clsTCPClt = nullptr;
+    clsConnectEngine = nullptr;
     // clsUSBClt = nullptr;
 // #ifdef HDC_SUPPORT_UART
 //     clsUARTClt = nullptr;
@@ -28,6 +29,11 @@ HdcServer::HdcServer(bool serverOrDaemonIn)
     clsServerForClient = nullptr;
     uv_rwlock_init(&daemonAdmin);
     uv_rwlock_init(&forwardAdmin);
+    daemonMapVersion = 0;
+    daemonIdSeq = 0;
+    daemonListVersion[0] = UINT64_MAX;
+    daemonListVersion[1] = UINT64_MAX;
+    daemonTracked = false;
 }
 
 HdcServer::~HdcServer()
@@ -44,6 +50,9 @@ void HdcServer::ClearInstanceResource()
     if (clsTCPClt) {
         delete clsTCPClt;
     }
+    if (clsConnectEngine) {
+        delete clsConnectEngine;
+    }
     // if (clsUSBClt) {
     //     delete clsUSBClt;
     // }
@@ -74,6 +83,8 @@ void HdcServer::TryStopInstance()
     if (clsServerForClient) {
         ((HdcServerForClient *)clsServerForClient)->Stop();
     }
+    daemonTracked = false;
+    Base::TryCloseHandle((uv_handle_t *)&asyncDaemonEvent);
     ReMainLoopForInstanceClear();
     ClearMapDaemonInfo();
 }
@@ -85,6 +96,8 @@ bool HdcServer::Initial(const char *listenString)
         return false;
     }
     Base::RemoveLogFile();
+    uv_async_init(&loopMain, &asyncDaemonEvent, DaemonEventCallback);
+    asyncDaemonEvent.data = this;
     clsServerForClient = new HdcServerForClient(true, listenString, this, &loopMain);
     int rc = (static_cast<HdcServerForClient *>(clsServerForClient))->Initial();
     if (rc != RET_SUCCESS) {
@@ -93,12 +106,13 @@ bool HdcServer::Initial(const char *listenString)
     }
     // clsUSBClt->InitLogging(ctxUSB);
     clsTCPClt = new HdcHostTCP(true, this);
+    clsConnectEngine = new(std::nothrow) HdcConnectEngine(this, &loopMain);
     // clsUSBClt = new HdcHostUSB(true, this, ctxUSB);
     // if (clsUSBClt->Initial() != RET_SUCCESS) {
     //     WRITE_LOG(LOG_FATAL, "clsUSBClt Initial failed");
     //     return false;
     // }
-    if (!clsServerForClient || !clsTCPClt) {
+    if (!clsServerForClient || !clsTCPClt || !clsConnectEngine) {
         WRITE_LOG(LOG_FATAL, "Class init failed");
         return false;
     }
@@ -216,32 +230,38 @@ void HdcServer::ClearMapDaemonInfo()
     uv_rwlock_rdunlock(&daemonAdmin);
     uv_rwlock_wrlock(&daemonAdmin);
     mapDaemon.clear();
+    ++daemonMapVersion;
     uv_rwlock_wrunlock(&daemonAdmin);
 }
 
-void HdcServer::BuildDaemonVisableLine(HDaemonInfo hdi, bool fullDisplay, string &out)
+// "type\tstatus\tdevname", what list targets -v shows of a daemon besides its key
+string HdcServer::BuildDaemonVisableState(HDaemonInfo hdi)
 {
-    if (fullDisplay) {
-        string sConn = conTypeDetail[CONN_UNKNOWN];
-        if (hdi->connType < CONN_UNKNOWN) {
-            sConn = conTypeDetail[hdi->connType];
-        }
+    string sConn = conTypeDetail[CONN_UNKNOWN];
+    if (hdi->connType < CONN_UNKNOWN) {
+        sConn = conTypeDetail[hdi->connType];
+    }
 
-        string sStatus = conStatusDetail[STATUS_UNKNOW];
-        if (hdi->connStatus < STATUS_UNAUTH) {
-            if (hdi->connStatus == STATUS_CONNECTED && hdi->daemonAuthStatus == DAEOMN_UNAUTHORIZED) {
-                sStatus = conStatusDetail[STATUS_UNAUTH];
-            } else {
-                sStatus = conStatusDetail[hdi->connStatus];
-            }
+    string sStatus = conStatusDetail[STATUS_UNKNOW];
+    if (hdi->connStatus < STATUS_UNAUTH) {
+        if (hdi->connStatus == STATUS_CONNECTED && hdi->daemonAuthStatus == DAEOMN_UNAUTHORIZED) {
+            sStatus = conStatusDetail[STATUS_UNAUTH];
+        } else {
+            sStatus = conStatusDetail[hdi->connStatus];
         }
+    }
 
-        string devname = hdi->devName;
-        if (devname.empty()) {
-            devname = "unknown...";
-        }
-        out = Base::StringFormat("%s\t\t%s\t%s\t%s\n", hdi->connectKey.c_str(), sConn.c_str(), sStatus.c_str(),
-                                 devname.c_str());
+    string devname = hdi->devName;
+    if (devname.empty()) {
+        devname = "unknown...";
+    }
+    return sConn + "\t" + sStatus + "\t" + devname;
+}
+
+void HdcServer::BuildDaemonVisableLine(HDaemonInfo hdi, bool fullDisplay, string &out)
+{
+    if (fullDisplay) {
+        out = hdi->connectKey + "\t\t" + BuildDaemonVisableState(hdi) + "\n";
     } else {
         if (hdi->connStatus == STATUS_CONNECTED) {
             out = Base::StringFormat("%s", hdi->connectKey.c_str());
@@ -253,6 +273,7 @@ void HdcServer::BuildDaemonVisableLine(HDaemonInfo hdi, bool fullDisplay, string
     }
 }
 
+// the text is rebuilt only when the map has changed since the last list
 string HdcServer::GetDaemonMapList(uint8_t opType)
 {
     string ret;
@@ -261,6 +282,12 @@ string HdcServer::GetDaemonMapList(uint8_t opType)
         fullDisplay = true;
     }
     uv_rwlock_rdlock(&daemonAdmin);
+    std::lock_guard<std::mutex> lock(daemonListMutex);
+    if (daemonListVersion[fullDisplay] == daemonMapVersion) {
+        ret = daemonListCache[fullDisplay];
+        uv_rwlock_rdunlock(&daemonAdmin);
+        return ret;
+    }
     map<string, HDaemonInfo>::iterator iter;
     string echoLine;
     for (iter = mapDaemon.begin(); iter != mapDaemon.end(); ++iter) {
@@ -272,10 +299,222 @@ string HdcServer::GetDaemonMapList(uint8_t opType)
         BuildDaemonVisableLine(di, fullDisplay, echoLine);
         ret += echoLine;
     }
+    daemonListCache[fullDisplay] = ret;
+    daemonListVersion[fullDisplay] = daemonMapVersion;
     uv_rwlock_rdunlock(&daemonAdmin);
     return ret;
 }
 
+// under the write lock of daemonAdmin, "add", "remove" or "change" of hdi
+void HdcServer::DaemonMapChanged(const char *event, HDaemonInfo hdi)
+{
+    ++daemonMapVersion;
+    if (!daemonTracked) {
+        return;
+    }
+    string line = Base::StringFormat("%" PRIu64 "\t%s\t%u\t%s\t", daemonMapVersion, event, hdi->deviceId,
+                                     hdi->connectKey.c_str()) + BuildDaemonVisableState(hdi);
+    daemonEventMutex.lock();
+    lstDaemonEvent.push_back({ daemonMapVersion, hdi->connectKey, line });
+    daemonEventMutex.unlock();
+    uv_async_send(&asyncDaemonEvent);
+}
+
+void HdcServer::DaemonEventCallback(uv_async_t *handle)
+{
+    HdcServer *thisClass = (HdcServer *)handle->data;
+    list<HdcDaemonEvent> events;
+    thisClass->daemonEventMutex.lock();
+    events.swap(thisClass->lstDaemonEvent);
+    thisClass->daemonEventMutex.unlock();
+    if (events.empty()) {
+        return;
+    }
+    if (thisClass->clsConnectEngine) {
+        thisClass->clsConnectEngine->NotifyDaemonEvents(events);
+    }
+    if (thisClass->clsServerForClient) {
+        ((HdcServerForClient *)thisClass->clsServerForClient)->NotifyDaemonEvents(events);
+    }
+}
+
+uint64_t HdcServer::DaemonMapSnapshot(vector<string> &events)
+{
+    uv_rwlock_rdlock(&daemonAdmin);
+    uint64_t version = daemonMapVersion;
+    for (auto &item : mapDaemon) {
+        HDaemonInfo hdi = item.second;
+        if (!hdi) {
+            continue;
+        }
+        events.push_back(Base::StringFormat("%" PRIu64 "\tadd\t%u\t%s\t", version, hdi->deviceId,
+                                            hdi->connectKey.c_str()) + BuildDaemonVisableState(hdi));
+    }
+    uv_rwlock_rdunlock(&daemonAdmin);
+    return version;
+}
+
+void HdcServer::DaemonMapConnected(vector<string> &connectKeys)
+{
+    uv_rwlock_rdlock(&daemonAdmin);
+    for (auto &item : mapDaemon) {
+        if (item.second && item.second->connStatus == STATUS_CONNECTED) {
+            connectKeys.push_back(item.first);
+        }
+    }
+    uv_rwlock_rdunlock(&daemonAdmin);
+}
+
+// off only when no tconn, 'list targets -w' or handshake of clsConnectEngine follows the changes
+void HdcServer::TrackDaemonMap(bool track)
+{
+    if (!track && ((clsConnectEngine && clsConnectEngine->Handshaking()) ||
+                   (clsServerForClient && ((HdcServerForClient *)clsServerForClient)->FollowsDaemonMap()))) {
+        return;
+    }
+    daemonTracked = track;
+    if (!track) {
+        daemonEventMutex.lock();
+        lstDaemonEvent.clear();
+        daemonEventMutex.unlock();
+    }
+}
+
+int HdcServer::SubscribeLog(HChannel hChannel, const string &parameters, string &error)
+{
+    std::unique_ptr<HdcLogFilter> filter(new(std::nothrow) HdcLogFilter());
+    if (filter == nullptr) {
+        error = "Out of memory";
+        return -1;
+    }
+    if (!filter->Parse(parameters, error)) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(logStreamMutex);
+    for (auto &stream : logStreams) {
+        if (stream.second.sessionId == hChannel->targetSessionId) {
+            WRITE_LOG(LOG_INFO, "hilog cid:%u subscribed to the stream of cid:%u", hChannel->channelId, stream.first);
+            stream.second.subscribers[hChannel->channelId] = std::move(filter);
+            return 1;
+        }
+    }
+    LogStream &stream = logStreams[hChannel->channelId];
+    stream.sessionId = hChannel->targetSessionId;
+    stream.subscribers[hChannel->channelId] = std::move(filter);
+    return 0;
+}
+
+void HdcServer::SendLog(HChannel hChannel, uint8_t *data, size_t size)
+{
+    HdcServerForClient *sfc = static_cast<HdcServerForClient *>(clsServerForClient);
+    // a channel packet must fit in the read buffer of the client
+    for (size_t pos = 0; pos < size; pos += MAX_SIZE_IOBUF) {
+        sfc->EchoClientRaw(hChannel, data + pos, std::min(size - pos, static_cast<size_t>(MAX_SIZE_IOBUF)));
+    }
+}
+
+// on the session thread of the stream, as are the subscribers
+bool HdcServer::PublishLog(uint32_t channelId, uint8_t *payload, const int payloadSize)
+{
+    HdcServerForClient *sfc = static_cast<HdcServerForClient *>(clsServerForClient);
+    std::lock_guard<std::mutex> lock(logStreamMutex);
+    auto it = logStreams.find(channelId);
+    if (it == logStreams.end()) {
+        return false;
+    }
+    string out;
+    for (auto &subscriber : it->second.subscribers) {
+        HChannel hChannel = sfc->AdminChannel(OP_QUERY, subscriber.first, nullptr);
+        if (hChannel == nullptr || hChannel->isDead) {
+            continue;
+        }
+        if (subscriber.second->Empty()) {
+            SendLog(hChannel, payload, payloadSize);
+            continue;
+        }
+        out.clear();
+        subscriber.second->Filter(payload, payloadSize, out);
+        if (!out.empty()) {
+            SendLog(hChannel, reinterpret_cast<uint8_t *>(out.data()), out.size());
+        }
+    }
+    return true;
+}
+
+// the daemon has ended the log, the subscribers end with it
+void HdcServer::EndLog(uint32_t channelId)
+{
+    HdcServerForClient *sfc = static_cast<HdcServerForClient *>(clsServerForClient);
+    LogStream stream;
+    {
+        std::lock_guard<std::mutex> lock(logStreamMutex);
+        auto it = logStreams.find(channelId);
+        if (it == logStreams.end()) {
+            return;
+        }
+        stream = std::move(it->second);
+        logStreams.erase(it);
+    }
+    for (auto &subscriber : stream.subscribers) {
+        HChannel hChannel = sfc->AdminChannel(OP_QUERY, subscriber.first, nullptr);
+        if (hChannel == nullptr || hChannel->isDead) {
+            continue;
+        }
+        string out;
+        subscriber.second->Flush(out);
+        if (!out.empty()) {
+            SendLog(hChannel, reinterpret_cast<uint8_t *>(out.data()), out.size());
+        }
+        if (subscriber.first != channelId) {  // it is freed by the close as always
+            sfc->FreeChannel(subscriber.first);
+        }
+    }
+}
+
+// true if channelId carries the log of other subscribers, its close is not sent to the daemon then
+bool HdcServer::UnsubscribeLog(HSession hSession, uint32_t channelId)
+{
+    std::lock_guard<std::mutex> lock(logStreamMutex);
+    for (auto it = logStreams.begin(); it != logStreams.end(); ++it) {
+        if (it->second.subscribers.erase(channelId) == 0) {
+            continue;
+        }
+        if (!it->second.subscribers.empty()) {
+            return it->first == channelId;
+        }
+        uint32_t streamId = it->first;
+        logStreams.erase(it);
+        if (streamId != channelId) {
+            // the first client has gone before, the daemon still sends on its channelId
+            uint8_t count = 0;
+            Send(hSession->sessionId, streamId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+        }
+        return false;
+    }
+    return false;
+}
+
+void HdcServer::UpdateDaemonStatus(const string &connectKey, uint8_t connStatus)
+{
+    uv_rwlock_wrlock(&daemonAdmin);
+    auto iter = mapDaemon.find(connectKey);
+    if (iter != mapDaemon.end() && iter->second && iter->second->connStatus != connStatus) {
+        iter->second->connStatus = connStatus;
+        DaemonMapChanged("change", iter->second);
+    }
+    uv_rwlock_wrunlock(&daemonAdmin);
+}
+
+void HdcServer::UpdateDaemonSession(const string &connectKey, HSession hSession)
+{
+    uv_rwlock_wrlock(&daemonAdmin);
+    auto iter = mapDaemon.find(connectKey);
+    if (iter != mapDaemon.end() && iter->second) {
+        iter->second->hSession = hSession;
+    }
+    uv_rwlock_wrunlock(&daemonAdmin);
+}
+
 void HdcServer::GetDaemonMapOnlyOne(HDaemonInfo &hDaemonInfoInOut)
 {
     uv_rwlock_rdlock(&daemonAdmin);
@@ -325,9 +564,17 @@ string HdcServer::AdminDaemonMap(uint8_t opType, const string &connectKey, HDaem
             *pdiNew = *hDaemonInfoInOut;
             uv_rwlock_wrlock(&daemonAdmin);
             if (!mapDaemon[hDaemonInfoInOut->connectKey]) {
+                uint32_t &deviceId = daemonIds[hDaemonInfoInOut->connectKey];
+                if (deviceId == 0) {
+                    deviceId = ++daemonIdSeq;
+                }
+                pdiNew->deviceId = deviceId;
                 mapDaemon[hDaemonInfoInOut->connectKey] = pdiNew;
+                DaemonMapChanged("add", pdiNew);
+                pdiNew = nullptr;
             }
             uv_rwlock_wrunlock(&daemonAdmin);
+            delete pdiNew;  // there is one already
             break;
         }
         case OP_GET_STRLIST:
@@ -345,8 +592,12 @@ string HdcServer::AdminDaemonMap(uint8_t opType, const string &connectKey, HDaem
         }
         case OP_REMOVE: {
             uv_rwlock_wrlock(&daemonAdmin);
-            if (mapDaemon.count(connectKey)) {
-                mapDaemon.erase(connectKey);
+            auto iter = mapDaemon.find(connectKey);
+            if (iter != mapDaemon.end()) {
+                if (iter->second) {
+                    DaemonMapChanged("remove", iter->second);
+                }
+                mapDaemon.erase(iter);
             }
             uv_rwlock_wrunlock(&daemonAdmin);
             break;
@@ -377,9 +628,16 @@ string HdcServer::AdminDaemonMap(uint8_t opType, const string &connectKey, HDaem
         }
         case OP_UPDATE: {  // Cannot update the Object HDi lower key value by direct value
             uv_rwlock_wrlock(&daemonAdmin);
-            HDaemonInfo hdi = mapDaemon[hDaemonInfoInOut->connectKey];
+            auto iter = mapDaemon.find(hDaemonInfoInOut->connectKey);
+            HDaemonInfo hdi = iter != mapDaemon.end() ? iter->second : nullptr;
             if (hdi) {
-                *mapDaemon[hDaemonInfoInOut->connectKey] = *hDaemonInfoInOut;
+                string state = BuildDaemonVisableState(hdi);
+                uint32_t deviceId = hdi->deviceId;
+                *hdi = *hDaemonInfoInOut;
+                hdi->deviceId = deviceId;
+                if (BuildDaemonVisableState(hdi) != state) {
+                    DaemonMapChanged("change", hdi);
+                }
             }
             uv_rwlock_wrunlock(&daemonAdmin);
             break;
@@ -399,12 +657,15 @@ void HdcServer::NotifyInstanceSessionFree(HSession hSession, bool freeOrClear)
         return;
     }
     if (!freeOrClear) {  // step1
-        // update
-        HdcDaemonInformation diNew = *hdiOld;
-        diNew.connStatus = STATUS_OFFLINE;
-        HDaemonInfo hdiNew = &diNew;
-        AdminDaemonMap(OP_UPDATE, hSession->connectKey, hdiNew);
+        UpdateDaemonStatus(hSession->connectKey, STATUS_OFFLINE);
         CleanForwardMap(hSession->sessionId);
+        if (clsServerForClient) {
+            static_cast<HdcServerForClient *>(clsServerForClient)->FreeSinkChannels(hSession->sessionId);
+        }
+        std::lock_guard<std::mutex> lock(logStreamMutex);
+        for (auto it = logStreams.begin(); it != logStreams.end();) {
+            it = it->second.sessionId == hSession->sessionId ? logStreams.erase(it) : std::next(it);
+        }
     // } else {  // step2
     //     string usbMountPoint = hdiOld->usbMountPoint;
     //     // The waiting time must be longer than DEVICE_CHECK_INTERVAL. Wait the method WatchUsbNodeChange
@@ -452,6 +713,8 @@ bool HdcServer::HandServerAuth(HSession hSession, SessionHandShake &handshake)
     switch (handshake.authType) {
         case AUTH_PUBLICKEY: {
             WRITE_LOG(LOG_INFO, "recive get publickey cmd");
+            // full auth, the daemon has not taken the ticket if any
+            tickets.Remove(hSession->connectKey);
             GetDaemonAuthType(hSession, handshake);
             if (!HdcAuth::GetPublicKeyinfo(handshake.buf)) {
                 WRITE_LOG(LOG_FATAL, "load public key failed");
@@ -478,12 +741,60 @@ bool HdcServer::HandServerAuth(HSession hSession, SessionHandShake &handshake)
             WRITE_LOG(LOG_INFO, "response auth signture success");
             return true;
         }
+        case AUTH_TICKET: {
+            // the buf is the challenge, a wrong proof makes the daemon go on with AUTH_PUBLICKEY
+            WRITE_LOG(LOG_INFO, "recive auth ticket cmd");
+            SessionTicketStore::Ticket ticket;
+            if (tickets.Get(hSession->connectKey, ticket)) {
+                handshake.buf = SessionTicketStore::MakeProof(ticket, handshake.buf);
+            } else {
+                handshake.buf.clear();
+            }
+            handshake.authType = AUTH_TICKET;
+            bufString = SerialStruct::SerializeToString(handshake);
+            Send(hSession->sessionId, 0, CMD_KERNEL_HANDSHAKE,
+                 reinterpret_cast<uint8_t *>(const_cast<char *>(bufString.c_str())), bufString.size());
+            return true;
+        }
         default:
             WRITE_LOG(LOG_FATAL, "invalid auth type %d", handshake.authType);
             return false;
     }
 }
 
+void HdcServer::AppendHandshakeTlv(HSession hSession, string &tlv)
+{
+    SessionTicketStore::Ticket ticket;
+    if (tickets.Get(hSession->connectKey, ticket)) {
+        Base::TlvAppend(tlv, TAG_TICKET_ID, ticket.id);
+    }
+}
+
+// the ticket given at AUTH_OK of a full auth, its key is encrypted to the host key
+void HdcServer::SaveTicket(HSession hSession, const string &tlv)
+{
+    std::map<string, string> tlvmap;
+    if (!Base::TlvToStringMap(tlv, tlvmap) || tlvmap.find(TAG_TICKET_ID) == tlvmap.end() ||
+        tlvmap.find(TAG_TICKET_KEY) == tlvmap.end()) {
+        return;
+    }
+    SessionTicketStore::Ticket ticket;
+    ticket.id = tlvmap[TAG_TICKET_ID];
+    ticket.key = tlvmap[TAG_TICKET_KEY];
+    ticket.connectKey = hSession->connectKey;
+    if (!HdcAuth::PrivateKeyDecryptBase64(ticket.key) || ticket.key.size() != SessionTicketStore::TICKET_KEY_SIZE) {
+        WRITE_LOG(LOG_WARN, "session %u ticket key invalid", hSession->sessionId);
+        return;
+    }
+    uint32_t life = SessionTicketStore::TICKET_LIFE;
+    if (tlvmap.find(TAG_TICKET_LIFE) != tlvmap.end()) {
+        life = std::min<uint32_t>(life, strtoul(tlvmap[TAG_TICKET_LIFE].c_str(), nullptr, 10));  // 10: decimal
+    }
+    ticket.expireTime = SessionTicketStore::ExpireTime(life);
+    tickets.Put(hSession->connectKey, ticket);
+    WRITE_LOG(LOG_INFO, "session %u ticket saved, life:%us", hSession->sessionId, life);
+}
+
 void HdcServer::UpdateHdiInfo(Hdc::HdcSessionBase::SessionHandShake &handshake, const string &connectKey)
 {
     HDaemonInfo hdiOld = nullptr;
@@ -544,6 +855,9 @@ bool HdcServer::ServerSessionHandshake(HSession hSession, uint8_t *payload, int
         return false;
     }
     if (handshake.authType != AUTH_OK) {
+        if (hSession->stat.authBeginTime == 0) {
+            hSession->stat.authBeginTime = Metrics::NowUs();
+        }
         if (!HandServerAuth(hSession, handshake)) {
             WRITE_LOG(LOG_WARN, "Auth failed");
             return false;
@@ -552,6 +866,18 @@ bool HdcServer::ServerSessionHandshake(HSession hSession, uint8_t *payload, int
     }
     // handshake auth OK
     UpdateHdiInfo(handshake, hSession->connectKey);
+    uint32_t features = NegotiateFeatures(handshake.buf);
+    if (!SetSessionFeatures(hSession, features)) {
+        return false;
+    }
+    if (features & FEATURE_TICKET) {
+        SaveTicket(hSession, handshake.buf);
+    }
+    uint64_t now = Metrics::NowUs();
+    hSession->stat.handshakeTime = now - hSession->stat.beginTime;
+    if (hSession->stat.authBeginTime > 0) {
+        hSession->stat.authTime = now - hSession->stat.authBeginTime;
+    }
     hSession->handshakeOK = true;
     return true;
 }
@@ -568,6 +894,12 @@ bool HdcServer::FetchCommand(HSession hSession, const uint32_t channelId, const
                   hSession->connType);
         return ret;
     }
+    if (command == CMD_KERNEL_ECHO_RAW && PublishLog(channelId, payload, payloadSize)) {
+        return ret;
+    }
+    if (command == CMD_KERNEL_CHANNEL_CLOSE) {
+        EndLog(channelId);
+    }
     // When you first initialize, ChannelID may be 0
     HChannel hChannel = sfc->AdminChannel(OP_QUERY_REF, channelId, nullptr);
     if (!hChannel) {
@@ -832,21 +1164,10 @@ int HdcServer::CreateConnect(const string &connectKey, bool isCheck)
         WRITE_LOG(LOG_WARN, "USB connection is not supported in this streamlined build.");
         return ERR_NO_SUPPORT;
     }
-    HDaemonInfo hdi = nullptr;
     if (connectKey == "any") {
         return RET_SUCCESS;
     }
-    AdminDaemonMap(OP_QUERY, connectKey, hdi);
-    if (hdi == nullptr) {
-        HdcDaemonInformation di = {};
-        di.connectKey = connectKey;
-        di.connType = connType;
-        di.connStatus = STATUS_UNKNOW;
-        HDaemonInfo pDi = reinterpret_cast<HDaemonInfo>(&di);
-        AdminDaemonMap(OP_ADD, "", pDi);
-        AdminDaemonMap(OP_QUERY, connectKey, hdi);
-    }
-    if (!hdi || hdi->connStatus == STATUS_CONNECTED) {
+    if (!PrepareConnect(connectKey, connType)) {
         WRITE_LOG(LOG_FATAL, "Connected return");
         return ERR_GENERIC;
     }
@@ -886,17 +1207,50 @@ int HdcServer::CreateConnect(const string &connectKey, bool isCheck)
     } else if (connType == CONN_USB) {
         return ERR_NO_SUPPORT;
     }
-    HDaemonInfo hdiQuery = nullptr;
-    AdminDaemonMap(OP_QUERY, connectKey, hdiQuery);
-    if (hdiQuery) {
-        HdcDaemonInformation diNew = *hdiQuery;
-        diNew.hSession = hSession;
-        HDaemonInfo hdiNew = &diNew;
-        AdminDaemonMap(OP_UPDATE, hdiQuery->connectKey, hdiNew);
-    }
+    UpdateDaemonSession(connectKey, hSession);
     return RET_SUCCESS;
 }
 
+// the daemon of connectKey in the map, added if new, false if it is connected already
+bool HdcServer::PrepareConnect(const string &connectKey, uint8_t connType)
+{
+    HDaemonInfo hdi = nullptr;
+    AdminDaemonMap(OP_QUERY, connectKey, hdi);
+    if (hdi == nullptr) {
+        HdcDaemonInformation di = {};
+        di.connectKey = connectKey;
+        di.connType = connType;
+        di.connStatus = STATUS_UNKNOW;
+        HDaemonInfo pDi = reinterpret_cast<HDaemonInfo>(&di);
+        AdminDaemonMap(OP_ADD, "", pDi);
+        AdminDaemonMap(OP_QUERY, connectKey, hdi);
+    }
+    return hdi && hdi->connStatus != STATUS_CONNECTED;
+}
+
+HSession HdcServer::AttachConnect(const string &connectKey, uv_os_sock_t fd)
+{
+    if (!PrepareConnect(connectKey, CONN_TCP)) {
+        WRITE_LOG(LOG_FATAL, "AttachConnect connected already %s", Hdc::MaskString(connectKey).c_str());
+#ifdef _WIN32
+        closesocket(fd);
+#else
+        Base::CloseFd(fd);
+#endif
+        return nullptr;
+    }
+    // a new try, the end of its handshake is a change of the map whatever the last one left
+    UpdateDaemonStatus(connectKey, STATUS_UNKNOW);
+    HSession hSession = clsTCPClt->AttachDaemon(connectKey, fd);
+    if (!hSession) {
+        WRITE_LOG(LOG_FATAL, "AttachConnect hSession nullptr");
+        UpdateDaemonStatus(connectKey, STATUS_OFFLINE);
+        return nullptr;
+    }
+    UpdateDaemonSession(connectKey, hSession);
+    return hSession;
+}
+
 void HdcServer::AttachChannel(HSession hSession, const uint32_t channelId)
 {
     int ret = 0;
@@ -909,6 +1263,15 @@ void HdcServer::AttachChannel(HSession hSession, const uint32_t channelId)
     uv_tcp_init(&hSession->childLoop, &hChannel->hChildWorkTCP);
     hChannel->hChildWorkTCP.data = hChannel;
     hChannel->targetSessionId = hSession->sessionId;
+    // on the session thread, the ring frames go on the child stream from now on
+    hChannel->ringThread = uv_thread_self();
+    hChannel->ringStream.store((uv_stream_t *)&hChannel->hChildWorkTCP, std::memory_order_release);
+    if (hChannel->sink) {
+        // no stream of a client to open, the command starts here as ReadChannel would do it
+        hSfc->RunSinkCommand(hChannel);
+        --hChannel->ref;
+        return;
+    }
     if ((ret = uv_tcp_open((uv_tcp_t *)&hChannel->hChildWorkTCP, hChannel->fdChildWorkTCP)) < 0) {
         constexpr int bufSize = 1024;
         char buf[bufSize] = { 0 };
@@ -929,10 +1292,14 @@ void HdcServer::DeatchChannel(HSession hSession, const uint32_t channelId)
     HdcServerForClient *hSfc = static_cast<HdcServerForClient *>(clsServerForClient);
     // childCleared has not set, no need OP_QUERY_REF
     HChannel hChannel = hSfc->AdminChannel(OP_QUERY, channelId, nullptr);
+    // the daemon goes on with a log other clients have subscribed to
+    bool keepDaemonChannel = UnsubscribeLog(hSession, channelId);
     if (!hChannel) {
         ClearOwnTasks(hSession, channelId);
         uint8_t count = 0;
-        Send(hSession->sessionId, channelId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+        if (!keepDaemonChannel) {
+            Send(hSession->sessionId, channelId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+        }
         WRITE_LOG(LOG_WARN, "DeatchChannel hChannel null channelId:%u", channelId);
         return;
     }
@@ -943,7 +1310,9 @@ void HdcServer::DeatchChannel(HSession hSession, const uint32_t channelId)
     // The own task for this channel must be clear before free channel
     ClearOwnTasks(hSession, channelId);
     uint8_t count = 0;
-    Send(hSession->sessionId, hChannel->channelId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+    if (!keepDaemonChannel) {
+        Send(hSession->sessionId, hChannel->channelId, CMD_KERNEL_CHANNEL_CLOSE, &count, 1);
+    }
     WRITE_LOG(LOG_DEBUG, "Childchannel begin close, cid:%u, sid:%u", hChannel->channelId, hSession->sessionId);
     if (uv_is_closing((const uv_handle_t *)&hChannel->hChildWorkTCP)) {
         Base::DoNextLoop(&hSession->childLoop, hChannel, [](const uint8_t flag, string &msg, const void *data) {
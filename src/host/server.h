@@ -15,6 +15,7 @@
 #ifndef HDC_SERVER_H
 #define HDC_SERVER_H
 #include "host_common.h"
+#include "host_log_filter.h"
 
 namespace Hdc {
 class HdcServer : public HdcSessionBase {
@@ -28,6 +29,8 @@ public:
     string AdminForwardMap(uint8_t opType, const string &taskString, HForwardInfo &hForwardInfoInOut);
     void CleanForwardMap(uint32_t sessionId);
     int CreateConnect(const string &connectKey, bool isCheck);
+    // a session of connectKey on fd, connected already by HdcConnectEngine, it owns fd even if it fails
+    HSession AttachConnect(const string &connectKey, uv_os_sock_t fd);
     bool Initial(const char *listenString);
     void AttachChannel(HSession hSession, const uint32_t channelId) override;
     void DeatchChannel(HSession hSession, const uint32_t channelId) override;
@@ -35,8 +38,22 @@ public:
     static bool PullupServer(const char *listenString);
     static void UsbPreConnect(uv_timer_t *handle);
     void NotifyInstanceSessionFree(HSession hSession, bool freeOrClear) override;
+    // single field updates of the daemon map, no copy of the strings
+    void UpdateDaemonStatus(const string &connectKey, uint8_t connStatus);
+    void UpdateDaemonSession(const string &connectKey, HSession hSession);
+    // 'list targets -w': the daemons as "add" events and the version they are at, the later changes go to
+    // HdcServerForClient::NotifyDaemonEvents on the main loop while tracked
+    uint64_t DaemonMapSnapshot(vector<string> &events);
+    // the connectKeys of the connected daemons, for 'each'
+    void DaemonMapConnected(vector<string> &connectKeys);
+    void TrackDaemonMap(bool track);
+    // 'hilog' of a client channel on its session thread: the first of a target has the log sent by the daemon on its
+    // channelId, the later ones are given the same stream, each with its own filter. <0 on wrong options with error,
+    // 1 if the stream was there already
+    int SubscribeLog(HChannel hChannel, const string &parameters, string &error);
 
     HdcHostTCP *clsTCPClt;
+    HdcConnectEngine *clsConnectEngine;
     // HdcHostUSB *clsUSBClt;
 #ifdef HDC_SUPPORT_UART
     void CreatConnectUart(HSession hSession);
@@ -48,8 +65,12 @@ public:
 private:
     void ClearInstanceResource() override;
     void BuildDaemonVisableLine(HDaemonInfo hdi, bool fullDisplay, string &out);
+    string BuildDaemonVisableState(HDaemonInfo hdi);
+    void DaemonMapChanged(const char *event, HDaemonInfo hdi);
+    static void DaemonEventCallback(uv_async_t *handle);
     void BuildForwardVisableLine(bool fullOrSimble, HForwardInfo hfi, string &echo);
     void ClearMapDaemonInfo();
+    bool PrepareConnect(const string &connectKey, uint8_t connType);
     bool ServerCommand(const uint32_t sessionId, const uint32_t channelId, const uint16_t command, uint8_t *bufPtr,
                        const int size) override;
     bool RedirectToTask(HTaskInfo hTaskInfo, HSession hSession, const uint32_t channelId, const uint16_t command,
@@ -57,6 +78,8 @@ private:
     bool RemoveInstanceTask(const uint8_t op, HTaskInfo hTask) override;
     void BuildForwardVisableLine(HDaemonInfo hdi, char *out, int sizeOutBuf);
     bool HandServerAuth(HSession hSession, SessionHandShake &handshake);
+    void AppendHandshakeTlv(HSession hSession, string &tlv) override;
+    void SaveTicket(HSession hSession, const string &tlv);
     void GetDaemonAuthType(HSession hSession, SessionHandShake &handshake);
     string GetDaemonMapList(uint8_t opType);
     void UpdateHdiInfo(Hdc::HdcSessionBase::SessionHandShake &handshake, const string &connectKey);
@@ -64,11 +87,33 @@ private:
     void GetDaemonMapOnlyOne(HDaemonInfo &hDaemonInfoInOut);
     void TryStopInstance();
     static bool PullupServerWin32(const char *path, const char *listenString);
+    struct LogStream {
+        uint32_t sessionId;
+        map<uint32_t, std::unique_ptr<HdcLogFilter>> subscribers;  // by the client channel
+    };
+    bool PublishLog(uint32_t channelId, uint8_t *payload, const int payloadSize);
+    void EndLog(uint32_t channelId);
+    bool UnsubscribeLog(HSession hSession, uint32_t channelId);
+    void SendLog(HChannel hChannel, uint8_t *data, size_t size);
 
     uv_rwlock_t daemonAdmin;
     map<string, HDaemonInfo> mapDaemon;
+    // under daemonAdmin: the version counts the changes list targets can show, the ids are never reused
+    uint64_t daemonMapVersion;
+    uint32_t daemonIdSeq;
+    map<string, uint32_t> daemonIds;
+    std::mutex daemonListMutex;
+    string daemonListCache[2];  // OP_GET_STRLIST and OP_GET_STRLIST_FULL at daemonListVersion
+    uint64_t daemonListVersion[2];
+    std::atomic<bool> daemonTracked;
+    std::mutex daemonEventMutex;
+    list<HdcDaemonEvent> lstDaemonEvent;
+    uv_async_t asyncDaemonEvent;
     uv_rwlock_t forwardAdmin;
     map<string, HForwardInfo> mapForward;
+    SessionTicketStore tickets;  // FEATURE_TICKET, by connectKey
+    std::mutex logStreamMutex;
+    map<uint32_t, LogStream> logStreams;  // by the channelId the daemon sends the log on, it may be gone already
 };
 }  // namespace Hdc
 #endif
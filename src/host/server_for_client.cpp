@@ -19,8 +19,9 @@
 #include "server.h"
 
 namespace Hdc {
-static const int MAX_RETRY_COUNT = 500;
-static const int MAX_CONNECT_DEVICE_RETRY_COUNT = 100;
+static const int CONNECT_RESULT_TIMEOUT = 5000;         // ms
+static const int CONNECT_DEVICE_RESULT_TIMEOUT = 1000;  // ms, of 127.0.0.1
+static const int DISCOVER_WAIT = 1000;  // ms, for the replies to the first probe
 
 HdcServerForClient::HdcServerForClient(const bool serverOrClient, const string &addrString, void *pClsServer,
                                        uv_loop_t *loopMainIn)
@@ -36,7 +37,19 @@ HdcServerForClient::~HdcServerForClient()
 
 void HdcServerForClient::Stop()
 {
+    StopStatDump();
+    if (timerFanout != nullptr) {
+        Base::TryCloseHandle((uv_handle_t *)timerFanout, Base::CloseTimerCallback);
+        timerFanout = nullptr;
+    }
     Base::TryCloseHandle((uv_handle_t *)&tcpListen);
+#ifdef HOST_LINUX
+    if (localListenFd >= 0) {
+        Base::TryCloseHandle((uv_handle_t *)&localListen);
+        close(localListenFd);
+        localListenFd = -1;
+    }
+#endif
 }
 
 uint16_t HdcServerForClient::GetTCPListenPort()
@@ -61,6 +74,11 @@ void HdcServerForClient::AcceptClient(uv_stream_t *server, int status)
         return;
     }
     WRITE_LOG(LOG_DEBUG, "AcceptClient uid:%u", uid);
+    thisClass->StartHandshake(hChannel);
+}
+
+void HdcServerForClient::StartHandshake(HChannel hChannel)
+{
     // limit first recv
     int bufMaxSize = 0;
     uv_recv_buffer_size((uv_handle_t *)&hChannel->hWorkTCP, &bufMaxSize);
@@ -88,15 +106,72 @@ void HdcServerForClient::AcceptClient(uv_stream_t *server, int status)
             return;
         }
 #ifdef HDC_VERSION_CHECK
-    thisClass->Send(hChannel->channelId, (uint8_t *)&handShake, sizeof(struct ChannelHandShake));
+    Send(hChannel->channelId, (uint8_t *)&handShake, sizeof(struct ChannelHandShake));
 #else
     // do not send version message if check feature disable
-    thisClass->Send(hChannel->channelId, reinterpret_cast<uint8_t *>(&handShake),
+    Send(hChannel->channelId, reinterpret_cast<uint8_t *>(&handShake),
                     offsetof(struct ChannelHandShake, version));
 #endif
     }
 }
 
+#ifdef HOST_LINUX
+void HdcServerForClient::AcceptLocalClient(uv_poll_t *handle, int status, int events)
+{
+    HdcServerForClient *thisClass = (HdcServerForClient *)handle->data;
+    if (status < 0) {
+        WRITE_LOG(LOG_WARN, "AcceptLocalClient status:%d", status);
+        return;
+    }
+    int fd = -1;
+    while ((fd = ChannelShm::Accept(thisClass->localListenFd)) >= 0) {
+        int memfd = -1;
+        ChannelShm *shm = ChannelShm::Create(memfd);
+        bool sent = shm != nullptr && ChannelShm::SendFd(fd, memfd);
+        if (memfd >= 0) {
+            close(memfd);
+        }
+        HChannel hChannel = nullptr;
+        uint32_t uid = sent ? thisClass->MallocChannel(&hChannel) : 0;
+        if (!hChannel) {
+            WRITE_LOG(LOG_FATAL, "AcceptLocalClient memfd sent:%d", sent);
+            delete shm;
+            close(fd);
+            continue;
+        }
+        hChannel->shm = shm;
+        int rc = uv_tcp_open(&hChannel->hWorkTCP, fd);
+        if (rc < 0) {
+            WRITE_LOG(LOG_FATAL, "AcceptLocalClient uv_tcp_open error rc:%d uid:%u", rc, uid);
+            close(fd);
+            thisClass->FreeChannel(uid);
+            continue;
+        }
+        WRITE_LOG(LOG_DEBUG, "AcceptLocalClient uid:%u", uid);
+        thisClass->StartHandshake(hChannel);
+    }
+}
+
+// the abstract unix socket of the local channel, optional: the clients fall back to TCP without it
+void HdcServerForClient::SetLocalListen()
+{
+    localListenFd = ChannelShm::Listen(channelPort);
+    if (localListenFd < 0) {
+        return;
+    }
+    localListen.data = this;
+    if (uv_poll_init(loopMain, &localListen, localListenFd) < 0 ||
+        uv_poll_start(&localListen, UV_READABLE, AcceptLocalClient) < 0) {
+        WRITE_LOG(LOG_WARN, "local channel poll failed");
+        Base::TryCloseHandle((uv_handle_t *)&localListen);
+        close(localListenFd);
+        localListenFd = -1;
+        return;
+    }
+    WRITE_LOG(LOG_DEBUG, "local channel listen %s", ChannelShm::LocalName(channelPort).c_str());
+}
+#endif
+
 bool HdcServerForClient::SetTCPListen()
 {
     char buffer[BUF_SIZE_DEFAULT] = { 0 };
@@ -161,6 +236,13 @@ int HdcServerForClient::Initial()
         int listenError = -3;  // -3:error for SetTCPListen failed
         return listenError;
     }
+#ifdef HOST_LINUX
+    SetLocalListen();
+#endif
+    char *env = getenv(Metrics::ENV_STAT_DUMP.c_str());
+    if (env != nullptr && strlen(env) > 0) {
+        StartStatDump(env, Metrics::DEFAULT_DUMP_INTERVAL);
+    }
     return 0;
 }
 
@@ -228,26 +310,11 @@ bool HdcServerForClient::SendToDaemon(HChannel hChannel, const uint16_t commandF
     return ret;
 }
 
-void HdcServerForClient::OrderFindTargets(HChannel hChannel)
+void HdcServerForClient::EchoLanDaemons(HChannel hChannel)
 {
-    int count = 0;
-    EchoClient(hChannel, MSG_INFO, "Please add HDC server's firewall ruler to allow udp incoming, udpport:%d",
-               DEFAULT_PORT);
     HdcServer *ptrServer = (HdcServer *)clsServer;
-    ptrServer->clsTCPClt->FindLanDaemon();
-    list<string> &lst = ptrServer->clsTCPClt->lstDaemonResult;
-    // refresh main list
-    HdcDaemonInformation di;
-    while (!lst.empty()) {
-        di = {};
-        ++count;
-        di.connectKey = lst.front();
-        di.connType = CONN_TCP;
-        di.connStatus = STATUS_READY;
-        HDaemonInfo pDi = reinterpret_cast<HDaemonInfo>(&di);
-        ptrServer->AdminDaemonMap(OP_ADD, STRING_EMPTY, pDi);
-        lst.pop_front();
-    }
+    vector<string> keys = ptrServer->clsTCPClt->GetLanDaemons();
+    int count = static_cast<int>(keys.size());
     EchoClient(hChannel, MSG_INFO, "Broadcast find daemon, total:%d", count);
 #ifdef UNIT_TEST
     string bufString = std::to_string(count);
@@ -256,13 +323,57 @@ void HdcServerForClient::OrderFindTargets(HChannel hChannel)
 #endif
 }
 
+// "[-c SECONDS]", the answer comes from the cache of HdcHostTCP at once and a probe refreshes it for the next time,
+// only the first discover of the server waits DISCOVER_WAIT for the replies
+bool HdcServerForClient::OrderFindTargets(HChannel hChannel, const string &parameters)
+{
+    HdcServer *ptrServer = (HdcServer *)clsServer;
+    HdcHostTCP *ptrTCP = ptrServer->clsTCPClt;
+    if (!parameters.empty()) {
+        int interval = atoi(parameters.c_str());
+        ptrTCP->SetDiscoverInterval(interval);
+        if (interval > 0) {
+            EchoClient(hChannel, MSG_INFO, "LAN discover every %ds, a daemon is dropped after %us unheard", interval,
+                       HdcHostTCP::DISCOVER_TTL);
+        } else {
+            EchoClient(hChannel, MSG_INFO, "LAN discover stopped");
+        }
+    }
+    EchoClient(hChannel, MSG_INFO, "Please add HDC server's firewall ruler to allow udp incoming, udpport:%d",
+               DEFAULT_PORT);
+    bool probed = ptrTCP->LanDaemonProbed();
+    ptrTCP->FindLanDaemon();
+    if (probed) {
+        EchoLanDaemons(hChannel);
+        return false;
+    }
+    uint32_t channelId = hChannel->channelId;
+    Base::DelayDoSimple(&ptrServer->loopMain, DISCOVER_WAIT, [this, channelId](const uint8_t, string &, const void *) {
+        HChannel hChannel = AdminChannel(OP_QUERY_REF, channelId, nullptr);
+        if (!hChannel) {
+            return;
+        }
+        if (!hChannel->isDead) {
+            EchoLanDaemons(hChannel);
+        }
+        --hChannel->ref;
+        FreeChannel(channelId);
+    });
+    return true;
+}
+
 void HdcServerForClient::OrderConnecTargetResult(uv_timer_t *req)
 {
     HChannel hChannel = (HChannel)req->data;
     HdcServerForClient *thisClass = (HdcServerForClient *)hChannel->clsChannel;
-    HdcServer *ptrServer = (HdcServer *)thisClass->clsServer;
-    bool bConnectOK = false;
-    bool bExitRepet = false;
+    thisClass->CheckConnectResult(req, true);
+}
+
+// the tconn of req is done if its target is connected, or at the deadline, true if done
+bool HdcServerForClient::CheckConnectResult(uv_timer_t *req, bool deadline)
+{
+    HChannel hChannel = (HChannel)req->data;
+    HdcServer *ptrServer = (HdcServer *)clsServer;
     HDaemonInfo hdi = nullptr;
     string sRet;
     string target = std::string(hChannel->bufStd + 2);
@@ -272,38 +383,25 @@ void HdcServerForClient::OrderConnecTargetResult(uv_timer_t *req)
         ptrServer->AdminDaemonMap(OP_QUERY, target, hdi);
     }
     if (hdi && hdi->connStatus == STATUS_CONNECTED) {
-        bConnectOK = true;
-    }
-    while (true) {
-        if (bConnectOK) {
-            bExitRepet = true;
-            if (hChannel->isCheck) {
-                WRITE_LOG(LOG_INFO, "%s check device success and remove %s", __FUNCTION__, hChannel->key.c_str());
-                thisClass->CommandRemoveSession(hChannel, hChannel->key.c_str());
-                thisClass->EchoClient(hChannel, MSG_OK, const_cast<char *>(hdi->version.c_str()));
-            } else {
-                sRet = "Connect OK";
-                thisClass->EchoClient(hChannel, MSG_OK, const_cast<char *>(sRet.c_str()));
-            }
-            break;
+        if (hChannel->isCheck) {
+            WRITE_LOG(LOG_INFO, "%s check device success and remove %s", __FUNCTION__, hChannel->key.c_str());
+            CommandRemoveSession(hChannel, hChannel->key.c_str());
+            EchoClient(hChannel, MSG_OK, const_cast<char *>(hdi->version.c_str()));
         } else {
-            uint16_t *bRetryCount = reinterpret_cast<uint16_t *>(hChannel->bufStd);
-            ++(*bRetryCount);
-            if (*bRetryCount > MAX_RETRY_COUNT ||
-                (hChannel->connectLocalDevice && *bRetryCount > MAX_CONNECT_DEVICE_RETRY_COUNT)) {
-                // 5s or localDevice 1s
-                bExitRepet = true;
-                sRet = "Connect failed";
-                thisClass->EchoClient(hChannel, MSG_FAIL, const_cast<char *>(sRet.c_str()));
-                break;
-            }
+            sRet = "Connect OK";
+            EchoClient(hChannel, MSG_OK, const_cast<char *>(sRet.c_str()));
         }
-        break;
-    }
-    if (bExitRepet) {
-        thisClass->FreeChannel(hChannel->channelId);
-        Base::TryCloseHandle((const uv_handle_t *)req, Base::CloseTimerCallback);
+    } else if (deadline) {
+        sRet = "Connect failed";
+        EchoClient(hChannel, MSG_FAIL, const_cast<char *>(sRet.c_str()));
+    } else {
+        return false;
     }
+    connectWaiters.remove(req);
+    FreeChannel(hChannel->channelId);
+    Base::TryCloseHandle((const uv_handle_t *)req, Base::CloseTimerCallback);
+    ptrServer->TrackDaemonMap(false);
+    return true;
 }
 
 bool HdcServerForClient::NewConnectTry(void *ptrServer, HChannel hChannel, const string &connectKey, bool isCheck)
@@ -311,34 +409,76 @@ bool HdcServerForClient::NewConnectTry(void *ptrServer, HChannel hChannel, const
 #ifdef HDC_DEBUG
     WRITE_LOG(LOG_ALL, "%s %s", __FUNCTION__, Hdc::MaskString(connectKey).c_str());
 #endif
-    int childRet = ((HdcServer *)ptrServer)->CreateConnect(connectKey, isCheck);
-    bool ret = false;
-    int connectError = -2;
+    size_t pos = connectKey.find(":");
+    if (pos != std::string::npos) {
+        string ip = connectKey.substr(0, pos);
+        if (ip == "127.0.0.1") {
+            hChannel->connectLocalDevice = true;
+        }
+    }
     constexpr uint8_t bufOffsetTwo = 2;
     constexpr uint8_t bufOffsetThree = 3;
+    Base::ZeroBuf(hChannel->bufStd, bufOffsetTwo);
+    int childRet = snprintf_s(hChannel->bufStd + bufOffsetTwo, sizeof(hChannel->bufStd) - bufOffsetTwo,
+                              sizeof(hChannel->bufStd) - bufOffsetThree, "%s", const_cast<char *>(connectKey.c_str()));
+    uv_timer_t *req = childRet > 0 ? new(std::nothrow) uv_timer_t() : nullptr;
+    if (req == nullptr) {
+        EchoClient(hChannel, MSG_FAIL, "CreateConnect failed");
+        WRITE_LOG(LOG_FATAL, "NewConnectTry no waiter");
+        return false;
+    }
+    req->data = hChannel;
+    uv_timer_init(loopMain, req);
+    uv_timer_start(req, OrderConnecTargetResult,
+                   hChannel->connectLocalDevice ? CONNECT_DEVICE_RESULT_TIMEOUT : CONNECT_RESULT_TIMEOUT, 0);
+    connectWaiters.push_back(req);
+    // the result comes with the change of the daemon map, followed before the session can change it
+    ((HdcServer *)ptrServer)->TrackDaemonMap(true);
+    childRet = ((HdcServer *)ptrServer)->CreateConnect(connectKey, isCheck);
+    int connectError = -2;
+    if (childRet != -1 && childRet != connectError) {
+        return true;
+    }
+    connectWaiters.remove(req);
+    Base::TryCloseHandle((const uv_handle_t *)req, Base::CloseTimerCallback);
+    ((HdcServer *)ptrServer)->TrackDaemonMap(false);
     if (childRet == -1) {
         EchoClient(hChannel, MSG_INFO, "Target is connected, repeat operation");
-    } else if (childRet == connectError) {
+    } else {
         EchoClient(hChannel, MSG_FAIL, "CreateConnect failed");
         WRITE_LOG(LOG_FATAL, "CreateConnect failed");
-    } else {
-        size_t pos = connectKey.find(":");
-        if (pos != std::string::npos) {
-            string ip = connectKey.substr(0, pos);
-            if (ip == "127.0.0.1") {
-                hChannel->connectLocalDevice = true;
-            }
+    }
+    return false;
+}
+
+// tconn [-c N] [-r N] [-w MS] key..., the channel lives till the summary of the batch
+bool HdcServerForClient::ConnectTargets(HChannel hChannel, const string &parameters)
+{
+    HdcServer *ptrServer = (HdcServer *)clsServer;
+    HdcConnectEngine::Options options;
+    vector<string> keys;
+    string error = HdcConnectEngine::ParseParameters(parameters, options, keys);
+    if (!error.empty()) {
+        EchoClient(hChannel, MSG_FAIL, "%s", error.c_str());
+        return false;
+    }
+    uint32_t channelId = hChannel->channelId;
+    auto report = [this, channelId](const string &line, bool finish) {
+        // the client may be gone, the batch goes on for the server
+        HChannel hChannel = AdminChannel(OP_QUERY_REF, channelId, nullptr);
+        if (!hChannel) {
+            return;
         }
-        Base::ZeroBuf(hChannel->bufStd, bufOffsetTwo);
-        childRet = snprintf_s(hChannel->bufStd + bufOffsetTwo, sizeof(hChannel->bufStd) - bufOffsetTwo,
-                              sizeof(hChannel->bufStd) - bufOffsetThree, "%s",
-                              const_cast<char *>(connectKey.c_str()));
-        if (childRet > 0) {
-            Base::TimerUvTask(loopMain, hChannel, OrderConnecTargetResult, UV_START_REPEAT);
-            ret = true;
+        if (!hChannel->isDead) {
+            EchoClient(hChannel, MSG_OK, "%s", line.c_str());
         }
-    }
-    return ret;
+        --hChannel->ref;
+        if (finish) {
+            FreeChannel(channelId);
+        }
+    };
+    ptrServer->clsConnectEngine->Start(keys, options, report);
+    return true;
 }
 
 bool HdcServerForClient::CommandRemoveSession(HChannel hChannel, const char *connectKey)
@@ -383,10 +523,398 @@ bool HdcServerForClient::RemoveFportkey(const string &forwardKey)
     return true;
 }
 
-void HdcServerForClient::GetTargetList(HChannel hChannel, void *formatCommandInput)
+// "version\tevent\tid\tkey\ttype\tstatus\tdevname" lines, a snapshot as "add" events first and then each change
+// till the client goes away
+bool HdcServerForClient::TrackTargets(HChannel hChannel)
+{
+    HdcServer *ptrServer = (HdcServer *)clsServer;
+    vector<string> events;
+    ptrServer->TrackDaemonMap(true);
+    uint64_t version = ptrServer->DaemonMapSnapshot(events);
+    string echo;
+    for (auto &line : events) {
+        echo += line + "\n";
+    }
+    if (!echo.empty()) {
+        echo.pop_back();
+        EchoClient(hChannel, MSG_OK, "%s", echo.c_str());
+    }
+    daemonTrackers.push_back(std::make_pair(hChannel->channelId, version));
+    return true;
+}
+
+void HdcServerForClient::NotifyDaemonEvents(const list<HdcDaemonEvent> &events)
+{
+    list<uv_timer_t *> waiters = connectWaiters;
+    for (uv_timer_t *req : waiters) {
+        string target = std::string(((HChannel)req->data)->bufStd + 2);
+        for (auto &event : events) {
+            if (target == "any" || target == event.connectKey) {
+                CheckConnectResult(req, false);
+                break;
+            }
+        }
+    }
+    for (auto it = daemonTrackers.begin(); it != daemonTrackers.end();) {
+        HChannel hChannel = AdminChannel(OP_QUERY_REF, it->first, nullptr);
+        if (!hChannel || hChannel->isDead) {
+            if (hChannel) {
+                --hChannel->ref;
+            }
+            it = daemonTrackers.erase(it);
+            continue;
+        }
+        string echo;
+        for (auto &event : events) {
+            if (event.version > it->second) {
+                echo += event.line + "\n";
+            }
+        }
+        if (!echo.empty()) {
+            echo.pop_back();
+            EchoClient(hChannel, MSG_OK, "%s", echo.c_str());
+            it->second = events.back().version;
+        }
+        --hChannel->ref;
+        ++it;
+    }
+    ((HdcServer *)clsServer)->TrackDaemonMap(false);
+}
+
+// '*' any run, '?' one char
+static bool MatchTargetPattern(const char *pattern, const char *key)
+{
+    if (*pattern == '\0') {
+        return *key == '\0';
+    }
+    if (*pattern == '*') {
+        return MatchTargetPattern(pattern + 1, key) || (*key != '\0' && MatchTargetPattern(pattern, key + 1));
+    }
+    return *key != '\0' && (*pattern == '?' || *pattern == *key) && MatchTargetPattern(pattern + 1, key + 1);
+}
+
+// one shot commands of a target, no stdin, no local file written, no port kept
+static bool IsFanoutCommand(const TranslateCommand::FormatCommand &formatCommand)
+{
+    switch (formatCommand.cmdFlag) {
+        case CMD_UNITY_EXECUTE:
+        case CMD_UNITY_REMOUNT:
+        case CMD_UNITY_REBOOT:
+        case CMD_UNITY_RUNMODE:
+        case CMD_UNITY_ROOTRUN:
+        case CMD_JDWP_LIST:
+        case CMD_APP_INIT:
+        case CMD_APP_UNINSTALL:
+            return !formatCommand.bJumpDo;
+        case CMD_FILE_INIT:
+            return !formatCommand.bJumpDo && !formatCommand.parameters.compare(0, strlen("send "), "send ");
+        default:
+            return false;
+    }
+}
+
+// all, the connected keys matching a pattern, or a key as it is, its frame says if it is not there
+void HdcServerForClient::ExpandFanoutTargets(const string &targets, list<string> &connectKeys)
+{
+    vector<string> connected;
+    ((HdcServer *)clsServer)->DaemonMapConnected(connected);
+    vector<string> patterns;
+    Base::SplitString(targets, ",", patterns);
+    std::set<string> added;
+    for (const string &pattern : patterns) {
+        bool wildcard = pattern == "all" || pattern.find_first_of("*?") != string::npos;
+        for (const string &key : wildcard ? connected : vector<string> { pattern }) {
+            if ((pattern == "all" || MatchTargetPattern(pattern.c_str(), key.c_str())) && !added.count(key)) {
+                added.insert(key);
+                connectKeys.push_back(key);
+            }
+        }
+    }
+}
+
+// parameters: [-j N] TARGETS COMMAND
+bool HdcServerForClient::StartFanout(HChannel hChannel, const string &parameters)
+{
+    Fanout fanout;
+    fanout.jobs = FANOUT_DEFAULT_JOBS;
+    fanout.timeout = 0;
+    string rest = parameters;
+    while (!rest.compare(0, strlen("-j "), "-j ") || !rest.compare(0, strlen("-T "), "-T ")) {
+        bool jobs = rest[1] == 'j';
+        int value = atoi(rest.c_str() + strlen("-j "));
+        size_t pos = rest.find(' ', strlen("-j "));
+        if (jobs && (value <= 0 || value > FANOUT_MAX_JOBS || pos == string::npos)) {
+            EchoClient(hChannel, MSG_FAIL, "Error each command, -j is 1 to %u", FANOUT_MAX_JOBS);
+            return false;
+        }
+        if (!jobs && (value <= 0 || pos == string::npos)) {
+            EchoClient(hChannel, MSG_FAIL, "Error each command, -T is the seconds a target may take");
+            return false;
+        }
+        if (jobs) {
+            fanout.jobs = static_cast<uint16_t>(value);
+        } else {
+            fanout.timeout = static_cast<uint32_t>(value);
+        }
+        rest = rest.substr(pos + 1);
+    }
+    size_t pos = rest.find(' ');
+    if (pos == string::npos) {
+        EchoClient(hChannel, MSG_FAIL, "Error each command, use 'each [-j N] [-T SECONDS] all|KEY[,KEY..] COMMAND'");
+        return false;
+    }
+    fanout.command = rest.substr(pos + 1);
+    struct TranslateCommand::FormatCommand formatCommand = { 0 };
+    String2FormatCommand(fanout.command.c_str(), fanout.command.size() + 1, &formatCommand);
+    if (!IsFanoutCommand(formatCommand)) {
+        EchoClient(hChannel, MSG_FAIL, "Not a command to run on each target: %s", fanout.command.c_str());
+        return false;
+    }
+    ExpandFanoutTargets(rest.substr(0, pos), fanout.pending);
+    if (fanout.pending.empty()) {
+        EchoClient(hChannel, MSG_FAIL, "No target matched %s", rest.substr(0, pos).c_str());
+        return false;
+    }
+    fanout.total = fanout.pending.size();
+    fanout.failed = 0;
+    fanout.beginTime = Metrics::NowUs();
+    WRITE_LOG(LOG_INFO, "each cid:%u targets:%u jobs:%u timeout:%u command:%s", hChannel->channelId, fanout.total,
+              fanout.jobs, fanout.timeout, fanout.command.c_str());
+    fanouts[hChannel->channelId] = fanout;
+    if (fanout.timeout > 0 && timerFanout == nullptr) {
+        timerFanout = new(std::nothrow) uv_timer_t;
+        if (timerFanout != nullptr) {
+            uv_timer_init(loopMain, timerFanout);
+            timerFanout->data = this;
+            uv_timer_start(timerFanout, FanoutTimer, TIME_BASE, TIME_BASE);
+        }
+    }
+    NextFanout(hChannel->channelId);
+    return true;
+}
+
+// a target over the timeout of its fanout is failed and its member freed, so one hung target does not hold the rest
+void HdcServerForClient::FanoutTimer(uv_timer_t *handle)
+{
+    HdcServerForClient *thisClass = (HdcServerForClient *)handle->data;
+    uint64_t now = Metrics::NowUs();
+    vector<uint32_t> expired;
+    bool timed = false;
+    for (auto &item : thisClass->fanouts) {
+        uint32_t timeout = item.second.timeout;
+        if (timeout == 0) {
+            continue;
+        }
+        timed = true;
+        std::lock_guard<std::mutex> lock(thisClass->fanoutMutex);
+        for (uint32_t memberId : item.second.running) {
+            auto it = thisClass->fanoutMembers.find(memberId);
+            if (it == thisClass->fanoutMembers.end() || it->second.timedOut ||
+                now - it->second.beginTime < static_cast<uint64_t>(timeout) * TIME_BASE * TIME_BASE) {
+                continue;
+            }
+            it->second.timedOut = true;
+            it->second.output += MESSAGE_FAIL + Base::StringFormat("Timeout after %us on the target\n", timeout);
+            expired.push_back(memberId);
+        }
+    }
+    for (uint32_t memberId : expired) {
+        WRITE_LOG(LOG_WARN, "each member cid:%u timeout", memberId);
+        thisClass->FreeChannel(memberId);
+    }
+    if (!timed) {
+        Base::TryCloseHandle((uv_handle_t *)handle, Base::CloseTimerCallback);
+        thisClass->timerFanout = nullptr;
+    }
+}
+
+// a member is a channel with sink and the connectKey of its target, attached to the session like a client channel
+void HdcServerForClient::NextFanout(uint32_t channelId)
+{
+    auto it = fanouts.find(channelId);
+    if (it == fanouts.end()) {
+        return;
+    }
+    Fanout &fanout = it->second;
+    while (fanout.running.size() < fanout.jobs && !fanout.pending.empty()) {
+        string connectKey = fanout.pending.front();
+        fanout.pending.pop_front();
+        HChannel hMember = nullptr;
+        if (MallocChannel(&hMember) == 0) {
+            WRITE_LOG(LOG_FATAL, "each cid:%u no channel for %s", channelId, Hdc::MaskString(connectKey).c_str());
+            if (FanoutFrame(channelId, connectKey, Metrics::NowUs(), MESSAGE_FAIL + "No channel for the target\n")) {
+                return;  // it was the last
+            }
+            continue;
+        }
+        hMember->sink = true;
+        hMember->handshakeOK = true;
+        hMember->connectKey = connectKey;
+        {
+            std::lock_guard<std::mutex> lock(fanoutMutex);
+            fanoutMembers[hMember->channelId] = { channelId, connectKey, fanout.command, Metrics::NowUs(), "", false };
+        }
+        fanout.running.insert(hMember->channelId);
+        // why it is not found goes to the output of the member
+        HSession hSession = FindAliveSessionFromDaemonMap(hMember);
+        if (hSession == nullptr) {
+            FreeChannel(hMember->channelId);
+            continue;
+        }
+        // before the attach, so FreeSinkChannels finds the member if the session dies before it attaches
+        hMember->targetSessionId = hSession->sessionId;
+        auto ctrl = HdcSessionBase::BuildCtrlString(SP_ATTACH_CHANNEL, hMember->channelId, nullptr, 0);
+        Base::SendToPollFd(hSession->ctrlFd[STREAM_MAIN], ctrl.data(), ctrl.size());
+    }
+}
+
+void HdcServerForClient::RunSinkCommand(HChannel hChannel)
+{
+    string command;
+    {
+        std::lock_guard<std::mutex> lock(fanoutMutex);
+        auto it = fanoutMembers.find(hChannel->channelId);
+        if (it != fanoutMembers.end()) {
+            command = it->second.command;
+        }
+    }
+    struct TranslateCommand::FormatCommand formatCommand = { 0 };
+    if (command.empty()) {
+        FreeChannel(hChannel->channelId);
+        return;
+    }
+    String2FormatCommand(command.c_str(), command.size() + 1, &formatCommand);
+    if (!DoCommandRemote(hChannel, &formatCommand)) {
+        FreeChannel(hChannel->channelId);
+    }
+}
+
+void HdcServerForClient::SinkOutput(HChannel hChannel, uint8_t *bufPtr, const int size)
+{
+    std::lock_guard<std::mutex> lock(fanoutMutex);
+    auto it = fanoutMembers.find(hChannel->channelId);
+    if (it == fanoutMembers.end() || size <= 0) {
+        return;
+    }
+    string &output = it->second.output;
+    if (output.size() + size > FANOUT_MAX_OUTPUT) {
+        WRITE_LOG(LOG_WARN, "each output of %s over %zu, dropped %d", Hdc::MaskString(it->second.connectKey).c_str(),
+                  FANOUT_MAX_OUTPUT, size);
+        return;
+    }
+    output.append(reinterpret_cast<char *>(bufPtr), size);
+}
+
+void HdcServerForClient::FanoutMemberDone(HChannel hChannel)
+{
+    FanoutMember member;
+    {
+        std::lock_guard<std::mutex> lock(fanoutMutex);
+        auto it = fanoutMembers.find(hChannel->channelId);
+        if (it == fanoutMembers.end()) {
+            return;
+        }
+        member = std::move(it->second);
+        fanoutMembers.erase(it);
+    }
+    auto it = fanouts.find(member.parentId);
+    if (it == fanouts.end()) {
+        return;  // the client has gone
+    }
+    it->second.running.erase(hChannel->channelId);
+    if (!FanoutFrame(member.parentId, member.connectKey, member.beginTime, member.output)) {
+        NextFanout(member.parentId);
+    }
+}
+
+// "hdceach KEY STATUS MS LENGTH\n" and the output, STATUS 1 if it has [Fail], at last "hdceach-end TOTAL FAILED MS\n",
+// true if the fanout has ended with this target
+bool HdcServerForClient::FanoutFrame(uint32_t parentId, const string &connectKey, uint64_t beginTime,
+                                     const string &output)
+{
+    auto it = fanouts.find(parentId);
+    if (it == fanouts.end()) {
+        return true;
+    }
+    Fanout &fanout = it->second;
+    bool failed = !output.compare(0, MESSAGE_FAIL.size(), MESSAGE_FAIL) ||
+                  output.find("\n" + MESSAGE_FAIL) != string::npos;
+    fanout.failed += failed ? 1 : 0;
+    uint64_t now = Metrics::NowUs();
+    string frame = Base::StringFormat("hdceach %s %d %" PRIu64 " %zu\n", connectKey.c_str(), failed ? 1 : 0,
+                                      (now - beginTime) / TIME_BASE, output.size()) + output;
+    bool end = fanout.running.empty() && fanout.pending.empty();
+    if (end) {
+        frame += Base::StringFormat("hdceach-end %u %u %" PRIu64 "\n", fanout.total, fanout.failed,
+                                    (now - fanout.beginTime) / TIME_BASE);
+    }
+    HChannel hParent = AdminChannel(OP_QUERY, parentId, nullptr);
+    if (hParent != nullptr && !hParent->isDead) {
+        // a channel packet must fit in the read buffer of the client
+        for (size_t pos = 0; pos < frame.size(); pos += MAX_SIZE_IOBUF) {
+            EchoClientRaw(hParent, reinterpret_cast<uint8_t *>(&frame[pos]),
+                          std::min(frame.size() - pos, static_cast<size_t>(MAX_SIZE_IOBUF)));
+        }
+    }
+    if (end) {
+        WRITE_LOG(LOG_INFO, "each cid:%u done targets:%u failed:%u", parentId, fanout.total, fanout.failed);
+        fanouts.erase(it);
+        FreeChannel(parentId);
+    }
+    return end;
+}
+
+void HdcServerForClient::StopFanout(uint32_t channelId)
+{
+    auto it = fanouts.find(channelId);
+    if (it == fanouts.end()) {
+        return;
+    }
+    WRITE_LOG(LOG_INFO, "each cid:%u stopped, running:%zu pending:%zu", channelId, it->second.running.size(),
+              it->second.pending.size());
+    std::set<uint32_t> running = it->second.running;
+    fanouts.erase(it);
+    for (uint32_t memberId : running) {
+        FreeChannel(memberId);
+    }
+}
+
+void HdcServerForClient::FreeSinkChannels(uint32_t sessionId)
+{
+    vector<uint32_t> members;
+    EnumChannel([&members, sessionId](HChannel hChannel) {
+        if (hChannel->sink && hChannel->targetSessionId == sessionId) {
+            members.push_back(hChannel->channelId);
+        }
+    });
+    for (uint32_t channelId : members) {
+        HChannel hChannel = AdminChannel(OP_QUERY, channelId, nullptr);
+        if (hChannel == nullptr) {
+            continue;
+        }
+        EchoClient(hChannel, MSG_FAIL, "The session of the target is gone");
+        // the session thread is stopping, it closes the child handle and has no detach for it
+        hChannel->childCleared = true;
+        FreeChannel(channelId);
+    }
+}
+
+void HdcServerForClient::NotifyInstanceChannelFree(HChannel hChannel)
+{
+    if (hChannel->sink) {
+        FanoutMemberDone(hChannel);
+    } else if (fanouts.count(hChannel->channelId)) {
+        StopFanout(hChannel->channelId);
+    }
+}
+
+bool HdcServerForClient::GetTargetList(HChannel hChannel, void *formatCommandInput)
 {
     TranslateCommand::FormatCommand *formatCommand = (TranslateCommand::FormatCommand *)formatCommandInput;
     HdcServer *ptrServer = (HdcServer *)clsServer;
+    if (formatCommand->parameters == "w") {
+        return TrackTargets(hChannel);
+    }
     uint16_t cmd = OP_GET_STRLIST;
     if (formatCommand->parameters == "v") {
         cmd = OP_GET_STRLIST_FULL;
@@ -401,6 +929,7 @@ void HdcServerForClient::GetTargetList(HChannel hChannel, void *formatCommandInp
     Base::WriteBinFile((UT_TMP_PATH + "/base-list.result").c_str(), (uint8_t *)MESSAGE_SUCCESS.c_str(),
                        MESSAGE_SUCCESS.size(), true);
 #endif
+    return false;
 }
 
 bool HdcServerForClient::GetAnyTarget(HChannel hChannel)
@@ -440,6 +969,121 @@ bool HdcServerForClient::WaitForAny(HChannel hChannel)
     return true;
 }
 
+void HdcServerForClient::ServerTrace(HChannel hChannel, const string &parameters)
+{
+    if (parameters == "start") {
+        Trace::Start();
+        EchoClient(hChannel, MSG_OK, "Server trace started");
+        return;
+    }
+    string path = Base::GetTmpDir() + Trace::TRACE_FILE_NAME;
+    constexpr size_t stopSize = 5;  // "stop " size
+    if (parameters.size() > stopSize && !strncmp(parameters.c_str(), "stop ", stopSize)) {
+        path = parameters.substr(stopSize);
+        Base::Trim(path);
+    } else if (parameters != "stop") {
+        path = "";
+    }
+    if (path.empty()) {
+        EchoClient(hChannel, MSG_FAIL, "Error trace command, use 'trace start' or 'trace stop [FILE]'");
+        return;
+    }
+    int count = Trace::Stop(path);
+    if (count < 0) {
+        EchoClient(hChannel, MSG_FAIL, "Server trace is not started or save to %s failed", path.c_str());
+        return;
+    }
+    EchoClient(hChannel, MSG_OK, "Server trace stopped, %d events saved to %s", count, path.c_str());
+}
+
+string HdcServerForClient::GetServerStat(bool json)
+{
+    HdcServer *ptrServer = (HdcServer *)clsServer;
+    string sessions;
+    string channels;
+    string split = json ? "," : "";
+    ptrServer->EnumSession([&](HSession hSession) {
+        sessions += (sessions.empty() ? "" : split) + Metrics::SessionToString(hSession, json);
+    });
+    EnumChannel([&](HChannel hChannel) {
+        channels += (channels.empty() ? "" : split) + Metrics::ChannelToString(hChannel, json);
+    });
+    if (json) {
+        return Base::StringFormat("{\"time\":%" PRIu64 ",\"sessions\":[", static_cast<uint64_t>(time(nullptr))) +
+               sessions + "],\"channels\":[" + channels + "]}\n";
+    }
+    if (sessions.empty()) {
+        sessions = "No session\n";
+    }
+    return sessions + channels;
+}
+
+void HdcServerForClient::StatDumpTimer(uv_timer_t *handle)
+{
+    HdcServerForClient *thisClass = (HdcServerForClient *)handle->data;
+    string stat = thisClass->GetServerStat(true);
+    FILE *fp = fopen(thisClass->statDumpPath.c_str(), "a");
+    if (fp == nullptr) {
+        WRITE_LOG(LOG_WARN, "stat dump open %s failed errno:%d", thisClass->statDumpPath.c_str(), errno);
+        return;
+    }
+    fwrite(stat.c_str(), 1, stat.size(), fp);
+    fclose(fp);
+}
+
+void HdcServerForClient::StartStatDump(const string &path, uint32_t interval)
+{
+    if (timerStatDump == nullptr) {
+        timerStatDump = new(std::nothrow) uv_timer_t;
+        if (timerStatDump == nullptr) {
+            WRITE_LOG(LOG_FATAL, "StartStatDump new timer failed");
+            return;
+        }
+        uv_timer_init(loopMain, timerStatDump);
+        timerStatDump->data = this;
+    }
+    statDumpPath = path;
+    uint64_t intervalMs = static_cast<uint64_t>(interval) * TIME_BASE;
+    uv_timer_start(timerStatDump, StatDumpTimer, intervalMs, intervalMs);
+    WRITE_LOG(LOG_INFO, "stat dump to %s every %us", path.c_str(), interval);
+}
+
+void HdcServerForClient::StopStatDump()
+{
+    if (timerStatDump == nullptr) {
+        return;
+    }
+    Base::TryCloseHandle((uv_handle_t *)timerStatDump, Base::CloseTimerCallback);
+    timerStatDump = nullptr;
+    statDumpPath = "";
+}
+
+// stat [-j] | stat -d SECONDS FILE | stat -d 0
+void HdcServerForClient::ServerStat(HChannel hChannel, const string &parameters)
+{
+    constexpr size_t dumpSize = 3;  // "-d " size
+    if (strncmp(parameters.c_str(), "-d ", dumpSize)) {
+        string stat = GetServerStat(parameters == "-j");
+        EchoClientRaw(hChannel, reinterpret_cast<uint8_t *>(const_cast<char *>(stat.c_str())), stat.size());
+        return;
+    }
+    string dumpArgs = parameters.substr(dumpSize);
+    size_t pos = dumpArgs.find(' ');
+    int interval = atoi(dumpArgs.substr(0, pos).c_str());
+    if (interval <= 0) {
+        StopStatDump();
+        EchoClient(hChannel, MSG_OK, "Server stat dump stopped");
+        return;
+    }
+    if (pos == string::npos || pos + 1 >= dumpArgs.size()) {
+        EchoClient(hChannel, MSG_FAIL, "Server stat dump needs a file");
+        return;
+    }
+    string path = dumpArgs.substr(pos + 1);
+    StartStatDump(path, interval);
+    EchoClient(hChannel, MSG_OK, "Server stat dump to %s every %ds", path.c_str(), interval);
+}
+
 bool HdcServerForClient::RemoveForward(HChannel hChannel, const char *parameterString)
 {
     HdcServer *ptrServer = (HdcServer *)clsServer;
@@ -476,13 +1120,11 @@ bool HdcServerForClient::DoCommandLocal(HChannel hChannel, void *formatCommandIn
     // Main thread command, direct Listen main thread
     switch (formatCommand->cmdFlag) {
         case CMD_KERNEL_TARGET_DISCOVER: {
-            OrderFindTargets(hChannel);
-            ret = false;
+            ret = OrderFindTargets(hChannel, formatCommand->parameters);
             break;
         }
         case CMD_KERNEL_TARGET_LIST: {
-            GetTargetList(hChannel, formatCommandInput);
-            ret = false;
+            ret = GetTargetList(hChannel, formatCommandInput);
             break;
         }
         case CMD_CHECK_SERVER: {
@@ -496,6 +1138,16 @@ bool HdcServerForClient::DoCommandLocal(HChannel hChannel, void *formatCommandIn
             ret = !WaitForAny(hChannel);
             break;
         }
+        case CMD_SERVER_TRACE: {
+            ServerTrace(hChannel, formatCommand->parameters);
+            ret = false;
+            break;
+        }
+        case CMD_SERVER_STAT: {
+            ServerStat(hChannel, formatCommand->parameters);
+            ret = false;
+            break;
+        }
         case CMD_KERNEL_TARGET_ANY: {
 #ifdef HDC_DEBUG
             WRITE_LOG(LOG_DEBUG, "%s CMD_KERNEL_TARGET_ANY %s", __FUNCTION__, formatCommand->parameters.c_str());
@@ -510,6 +1162,14 @@ bool HdcServerForClient::DoCommandLocal(HChannel hChannel, void *formatCommandIn
             ret = NewConnectTry(ptrServer, hChannel, formatCommand->parameters.c_str());
             break;
         }
+        case CMD_KERNEL_TARGET_CONNECT_BATCH: {
+            ret = ConnectTargets(hChannel, formatCommand->parameters);
+            break;
+        }
+        case CMD_KERNEL_TARGET_EACH: {
+            ret = StartFanout(hChannel, formatCommand->parameters);
+            break;
+        }
         case CMD_CHECK_DEVICE: {
             WRITE_LOG(LOG_INFO, "%s CMD_CHECK_DEVICE %s", __FUNCTION__, formatCommand->parameters.c_str());
             hChannel->isCheck = true;
@@ -633,6 +1293,19 @@ bool HdcServerForClient::DoCommandRemote(HChannel hChannel, void *formatCommandI
 {
     TranslateCommand::FormatCommand *formatCommand = (TranslateCommand::FormatCommand *)formatCommandInput;
     bool ret = false;
+    if (formatCommand->cmdFlag == CMD_UNITY_HILOG && formatCommand->parameters != "h" && !hChannel->sink) {
+        // the filter options stay in the server, the daemon is asked for the log only by the first of a target
+        string error;
+        int subscribed = ((HdcServer *)clsServer)->SubscribeLog(hChannel, formatCommand->parameters, error);
+        if (subscribed < 0) {
+            EchoClient(hChannel, MSG_FAIL, "%s", error.c_str());
+            return false;
+        }
+        if (subscribed > 0) {
+            return true;
+        }
+        formatCommand->parameters.clear();
+    }
     int sizeSend = formatCommand->parameters.size();
     string cmdFlag;
     switch (formatCommand->cmdFlag) {
@@ -29,17 +29,57 @@ public:
                              const int payloadSize);
     uint16_t GetTCPListenPort();
     void Stop();
+    // the changes of the daemon map, on the main loop: to the channels of 'list targets -w' and the tconn waiting
+    void NotifyDaemonEvents(const list<HdcDaemonEvent> &events);
+    bool FollowsDaemonMap() const
+    {
+        return !connectWaiters.empty() || !daemonTrackers.empty();
+    }
+    // 'each': the command of a member channel on its session thread, and the members a dead session leaves
+    void RunSinkCommand(HChannel hChannel);
+    void FreeSinkChannels(uint32_t sessionId);
 
 protected:
 private:
+    // 'each': a command of the client channel run on many targets, by a member channel with sink for each
+    struct FanoutMember {
+        uint32_t parentId;  // the client channel
+        string connectKey;
+        string command;
+        uint64_t beginTime;  // us
+        string output;
+        bool timedOut;
+    };
+    struct Fanout {
+        uint16_t jobs;
+        uint32_t timeout;  // s of a target, 0 for none
+        string command;
+        list<string> pending;        // connectKeys not started yet
+        std::set<uint32_t> running;  // member channelIds
+        uint32_t total;
+        uint32_t failed;
+        uint64_t beginTime;  // us
+    };
+    static constexpr uint16_t FANOUT_DEFAULT_JOBS = 8;
+    static constexpr uint16_t FANOUT_MAX_JOBS = 256;
+    static constexpr size_t FANOUT_MAX_OUTPUT = 16 * 1024 * 1024;  // of a target, the rest is dropped
+
     static void AcceptClient(uv_stream_t *server, int status);
+    void StartHandshake(HChannel hChannel);
     bool SetTCPListen();
+#ifdef HOST_LINUX
+    static void AcceptLocalClient(uv_poll_t *handle, int status, int events);
+    void SetLocalListen();
+#endif
     int ReadChannel(HChannel hChannel, uint8_t *bufPtr, const int bytesIO) override;
     void ReportServerVersion(HChannel hChannel);
     bool DoCommand(HChannel hChannel, void *formatCommandInput);
-    void OrderFindTargets(HChannel hChannel);
+    bool OrderFindTargets(HChannel hChannel, const string &parameters);
+    void EchoLanDaemons(HChannel hChannel);
     bool NewConnectTry(void *ptrServer, HChannel hChannel, const string &connectKey, bool isCheck = false);
     static void OrderConnecTargetResult(uv_timer_t *req);
+    bool CheckConnectResult(uv_timer_t *req, bool deadline);
+    bool ConnectTargets(HChannel hChannel, const string &parameters);
     bool SendToDaemon(HChannel hChannel, const uint16_t commandFlag, uint8_t *bufPtr, const int bufSize);
     int BindChannelToSession(HChannel hChannel, uint8_t *bufPtr, const int bytesIO);
     bool CheckAutoFillTarget(HChannel hChannel);
@@ -48,9 +88,16 @@ private:
     bool RemoveFportkey(const string &forwardKey);
     bool DoCommandLocal(HChannel hChannel, void *formatCommandInput);
     bool DoCommandRemote(HChannel hChannel, void *formatCommandInput);
-    void GetTargetList(HChannel hChannel, void *formatCommandInput);
+    bool GetTargetList(HChannel hChannel, void *formatCommandInput);
+    bool TrackTargets(HChannel hChannel);
     bool GetAnyTarget(HChannel hChannel);
     bool WaitForAny(HChannel hChannel);
+    void ServerTrace(HChannel hChannel, const string &parameters);
+    void ServerStat(HChannel hChannel, const string &parameters);
+    string GetServerStat(bool json);
+    void StartStatDump(const string &path, uint32_t interval);
+    void StopStatDump();
+    static void StatDumpTimer(uv_timer_t *handle);
     bool RemoveForward(HChannel hChannel, const char *parameterString);
     bool TaskCommand(HChannel hChannel, void *formatCommandInput);
     void HandleRemote(HChannel hChannel, string &parameters, RemoteType flag);
@@ -58,9 +105,30 @@ private:
     bool ChannelSendSessionCtrlMsg(vector<uint8_t> &ctrlMsg, uint32_t sessionId) override;
     HSession FindAliveSession(uint32_t sessionId);
     HSession FindAliveSessionFromDaemonMap(const HChannel hChannel);
+    bool StartFanout(HChannel hChannel, const string &parameters);
+    void ExpandFanoutTargets(const string &targets, list<string> &connectKeys);
+    void NextFanout(uint32_t channelId);
+    void FanoutMemberDone(HChannel hChannel);
+    bool FanoutFrame(uint32_t parentId, const string &connectKey, uint64_t beginTime, const string &output);
+    void StopFanout(uint32_t channelId);
+    static void FanoutTimer(uv_timer_t *handle);
+    void SinkOutput(HChannel hChannel, uint8_t *bufPtr, const int size) override;
+    void NotifyInstanceChannelFree(HChannel hChannel) override;
 
     uv_tcp_t tcpListen;
+#ifdef HOST_LINUX
+    uv_poll_t localListen;
+    int localListenFd = -1;
+#endif
     void *clsServer;
+    uv_timer_t *timerStatDump = nullptr;
+    uv_timer_t *timerFanout = nullptr;  // while a fanout has a timeout
+    list<std::pair<uint32_t, uint64_t>> daemonTrackers;  // channelId, the version of its snapshot
+    list<uv_timer_t *> connectWaiters;                    // the deadline of each tconn, data is the channel
+    string statDumpPath;
+    map<uint32_t, Fanout> fanouts;  // by the client channel, main loop only
+    std::mutex fanoutMutex;
+    map<uint32_t, FanoutMember> fanoutMembers;  // by the member channel, under fanoutMutex
 };
 }  // namespace Hdc
 #endif
@@ -28,7 +28,9 @@ namespace TranslateCommand {
               "\n"
               "---------------------------------component commands:-------------------------------\n"
               "session commands(on server):\n"
-              " list targets [-v]                     - List all devices status, -v for detail\n"
+              " list targets [-v|-w]                  - List all devices status, -v for detail, -w to follow the\n"
+            "                                         changes: version, add/remove/change, id, key, type,\n"
+            "                                         status and name, a line each\n"
               " start [-r]                            - Start server. If with '-r', will be restart server\n"
               " kill [-r]                             - Kill server. If with '-r', will be restart server\n"
               "\n"
@@ -75,10 +77,14 @@ namespace TranslateCommand {
               "                                         -s: remove shared bundle\n"
               "\n"
               "debug commands:\n"
-              " hilog [-h]                            - Show device log, -h for detail\n"
+              " hilog [-h] [-L|-T|-e VALUE]           - Show device log, -h for detail\n"
+              "                                         -L/-T/-e: only the lines of the levels (D,I,W,E,F), tags or\n"
+              "                                         regex, chosen in the server. A second hilog of a target\n"
+              "                                         joins the log the first one is showing\n"
               " shell [COMMAND...]                    - Run shell command (interactive shell if no command given)\n"
               " bugreport [FILE]                      - Return all information from the device, stored in file if "
               "FILE is specified\n"
+              "                                         FILE ending with .lz4 is saved as an lz4 frame\n"
               " jpid                                  - List PIDs of processes hosting a JDWP transport\n"
               " track-jpid [-a|-p]                    - Track PIDs of debug processes hosting a JDWP transport\n"
               "                                         -a: include debug and release processes\n"
@@ -97,20 +103,48 @@ namespace TranslateCommand {
             " -h/help [verbose]                     - Print hdc help, 'verbose' for more other cmds\n"
             " -v/version                            - Print hdc version\n"
             " -l[0-5]                               - Set runtime loglevel\n"
+            " -L logfile                            - Decode binary log file(hdc.log) to text\n"
             " -t connectkey                         - Use device with given connect key\n"
             " checkserver                           - check client-server version\n"
             " checkdevice                           - check server-daemon version(only uart)\n"
             "\n"
             "---------------------------------component commands:-------------------------------\n"
             "session commands(on server):\n"
-            " discover                              - Discover devices listening on TCP via LAN broadcast\n"
-            " list targets [-v]                     - List all devices status, -v for detail\n"
+            " discover [-c SECONDS]                 - Discover devices listening on TCP via LAN broadcast,\n"
+            "                                         answered from the cache of the server, -c probes every\n"
+            "                                         SECONDS in the background, 0 to stop\n"
+            " list targets [-v|-w]                  - List all devices status, -v for detail, -w to follow the\n"
+            "                                         changes: version, add/remove/change, id, key, type,\n"
+            "                                         status and name, a line each\n"
             " tconn key                             - Connect device via key, TCP use ip:port\n"
             "                                         example:192.168.0.100:10178/192.168.0.100\n"
             "                                         TCP need to connect manually\n"
+            " tconn [-c N] [-r N] [-w MS] key...|-f FILE\n"
+            "                                       - Connect many devices at once, -c in parallel(8), -r retries\n"
+            "                                         with backoff(3), -w timeout of a try(5000), FILE has a key\n"
+            "                                         per line. Shows connect/handshake latency of each\n"
             " start [-r]                            - Start server. If with '-r', will be restart server\n"
             " kill [-r]                             - Kill server. If with '-r', will be restart server\n"
             " -s [ip:]port                          - Set hdc server listen config\n"
+            " trace start|stop [FILE]               - Start/stop server tracing, stop saves chrome trace json to\n"
+            "                                         FILE, default is hdc_trace.json in tmp dir\n"
+            " stat [-j]                             - Show traffic, latency and handshake stat of server sessions\n"
+            "                                         and channels, '-j' in json\n"
+            " stat -d SECONDS FILE|0                - Append json stat to FILE every SECONDS, 0 to stop\n"
+            " bench [-s MB] [-n COUNT]              - Benchmark file send/recv, shell echo and fport through\n"
+            "                                         the server, MB for transfer size, COUNT for shell echo,\n"
+            "                                         without -t runs against a local loopback daemon\n"
+            " batch [-j N] [FILE]                   - Run the commands of FILE or stdin, one '[-t key] command'\n"
+            "                                         per line, by N workers(1) in one process. The output of\n"
+            "                                         each is framed as 'hdcbatch SEQ STATUS LENGTH' and LENGTH\n"
+            "                                         bytes, STATUS 0 ok, 1 [Fail], 2 not run\n"
+            " each [-j N] [-T SECONDS] all|KEY[,KEY..] COMMAND\n"
+            "                                       - Run COMMAND on many targets in the server, N at a time(8),\n"
+            "                                         a target failed after SECONDS if given.\n"
+            "                                         KEY may have '*' and '?'. COMMAND is shell CMD, file send,\n"
+            "                                         install, uninstall or a target command. The output of a\n"
+            "                                         target is framed as 'hdceach KEY STATUS MS LENGTH' and\n"
+            "                                         LENGTH bytes, 'hdceach-end TOTAL FAILED MS' at last\n"
             "\n"
             "service commands(on daemon):\n"
             " target mount                          - Set /system /vendor partition read-write\n"
@@ -154,10 +188,14 @@ namespace TranslateCommand {
             "                                         -s: remove shared bundle\n"
             "\n"
             "debug commands:\n"
-            " hilog [-h]                            - Show device log, -h for detail\n"
+            " hilog [-h] [-L|-T|-e VALUE]           - Show device log, -h for detail\n"
+            "                                         -L/-T/-e: only the lines of the levels (D,I,W,E,F), tags or\n"
+            "                                         regex, chosen in the server. A second hilog of a target\n"
+            "                                         joins the log the first one is showing\n"
             " shell [COMMAND...]                    - Run shell command (interactive shell if no command given)\n"
             " bugreport [FILE]                      - Return all information from the device, stored in file if FILE "
             "is specified\n"
+            "                                         FILE ending with .lz4 is saved as an lz4 frame\n"
             " jpid                                  - List PIDs of processes hosting a JDWP transport\n"
             "\n"
             "security commands:\n"
@@ -170,12 +208,43 @@ namespace TranslateCommand {
         return ret;
     }
 
+    string TargetDiscover(FormatCommand *outCmd, const string &input)
+    {
+        constexpr int maxInterval = 86400;  // s, a day
+        string stringError;
+        string option = input.c_str() + CMDSTR_TARGET_DISCOVER.size();
+        Base::Trim(option);
+        if (option.empty()) {
+            return stringError;
+        }
+        if (option.size() > 3 && !option.compare(0, 3, "-c ")) {  // 3: "-c " size
+            string value = option.substr(3);
+            Base::Trim(value);
+            if (!value.empty() && value.size() <= 5 &&  // 5: digits of maxInterval
+                value.find_first_not_of("0123456789") == string::npos && std::stoi(value) <= maxInterval) {
+                outCmd->parameters = value;
+                return stringError;
+            }
+        }
+        stringError = "Usage: discover [-c SECONDS], SECONDS 0-86400";
+        outCmd->bJumpDo = true;
+        return stringError;
+    }
+
     string TargetConnect(FormatCommand *outCmd)
     {
         string stringError;
         if (Base::StringEndsWith(outCmd->parameters, " -remove")) {
             outCmd->parameters = outCmd->parameters.substr(0, outCmd->parameters.size() - CMD_REMOTE_SIZE);
             outCmd->cmdFlag = CMD_KERNEL_TARGET_DISCONNECT;
+        } else if (outCmd->parameters.find(' ') != string::npos || outCmd->parameters[0] == '-') {
+            // many targets or with options, to HdcConnectEngine
+            outCmd->cmdFlag = CMD_KERNEL_TARGET_CONNECT_BATCH;
+            HdcConnectEngine::Options options;
+            vector<string> keys;
+            stringError = HdcConnectEngine::ParseParameters(outCmd->parameters, options, keys);
+            outCmd->bJumpDo = !stringError.empty();
+            return stringError;
         } else {
             outCmd->cmdFlag = CMD_KERNEL_TARGET_CONNECT;
             constexpr int maxKeyLength = 50; // 50: tcp max=21,USB max=8bytes, serial device name maybe long
@@ -304,12 +373,15 @@ namespace TranslateCommand {
             outCmd->cmdFlag = CMD_KERNEL_HELP;
             stringError = Base::GetVersion();
             outCmd->bJumpDo = true;
-        } else if (!strcmp(input.c_str(), CMDSTR_TARGET_DISCOVER.c_str())) {
+        } else if (!strncmp(input.c_str(), CMDSTR_TARGET_DISCOVER.c_str(), CMDSTR_TARGET_DISCOVER.size())) {
             outCmd->cmdFlag = CMD_KERNEL_TARGET_DISCOVER;
+            stringError = TargetDiscover(outCmd, input);
         } else if (!strncmp(input.c_str(), CMDSTR_LIST_TARGETS.c_str(), CMDSTR_LIST_TARGETS.size())) {
             outCmd->cmdFlag = CMD_KERNEL_TARGET_LIST;
             if (strstr(input.c_str(), " -v")) {
                 outCmd->parameters = "v";
+            } else if (strstr(input.c_str(), " -w")) {
+                outCmd->parameters = "w";
             }
         } else if (!strncmp(input.c_str(), CMDSTR_CHECK_SERVER.c_str(), CMDSTR_CHECK_SERVER.size())) {
             outCmd->cmdFlag = CMD_CHECK_SERVER;
@@ -318,6 +390,27 @@ namespace TranslateCommand {
             outCmd->cmdFlag = CMD_CHECK_DEVICE;
         } else if (!strncmp(input.c_str(), CMDSTR_WAIT_FOR.c_str(), CMDSTR_WAIT_FOR.size())) {
             outCmd->cmdFlag = CMD_WAIT_FOR;
+        } else if (!strncmp(input.c_str(), (CMDSTR_SERVER_TRACE + " ").c_str(), CMDSTR_SERVER_TRACE.size() + 1)) {
+            outCmd->cmdFlag = CMD_SERVER_TRACE;
+            outCmd->parameters = input.c_str() + CMDSTR_SERVER_TRACE.size() + 1;  // with ' '
+            if (outCmd->parameters != "start" && outCmd->parameters != "stop" &&
+                strncmp(outCmd->parameters.c_str(), "stop ", 5)) {  // 5: "stop " size
+                stringError = "Error trace command, use 'trace start' or 'trace stop [FILE]'";
+                outCmd->bJumpDo = true;
+            }
+        } else if (!strcmp(input.c_str(), CMDSTR_SERVER_STAT.c_str())) {
+            outCmd->cmdFlag = CMD_SERVER_STAT;
+        } else if (!strncmp(input.c_str(), (CMDSTR_SERVER_STAT + " ").c_str(), CMDSTR_SERVER_STAT.size() + 1)) {
+            outCmd->cmdFlag = CMD_SERVER_STAT;
+            outCmd->parameters = input.c_str() + CMDSTR_SERVER_STAT.size() + 1;  // with ' '
+            if (!outCmd->parameters.empty() && outCmd->parameters != "-j" &&
+                strncmp(outCmd->parameters.c_str(), "-d ", 3)) {  // 3: "-d " size
+                stringError = "Error stat command, use 'stat [-j]' or 'stat -d SECONDS FILE'";
+                outCmd->bJumpDo = true;
+            }
+        } else if (!strncmp(input.c_str(), (CMDSTR_EACH + " ").c_str(), CMDSTR_EACH.size() + 1)) {
+            outCmd->cmdFlag = CMD_KERNEL_TARGET_EACH;
+            outCmd->parameters = input.c_str() + CMDSTR_EACH.size() + 1;  // with ' '
         } else if (!strcmp(input.c_str(), CMDSTR_CONNECT_ANY.c_str())) {
             outCmd->cmdFlag = CMD_KERNEL_TARGET_ANY;
         } else if (!strncmp(input.c_str(), CMDSTR_CONNECT_TARGET.c_str(), CMDSTR_CONNECT_TARGET.size())) {
@@ -371,6 +464,10 @@ namespace TranslateCommand {
             outCmd->cmdFlag = CMD_UNITY_HILOG;
             if (strstr(input.c_str(), " -h")) {
                 outCmd->parameters = "h";
+            } else {
+                // the filter options, they are taken by the server
+                outCmd->parameters = input.c_str() + CMDSTR_HILOG.size();
+                Base::Trim(outCmd->parameters);
             }
         } else if (!strncmp(input.c_str(), CMDSTR_STARTUP_MODE.c_str(), CMDSTR_STARTUP_MODE.size())) {
             outCmd->cmdFlag = CMD_UNITY_ROOTRUN;
@@ -0,0 +1,461 @@
+/*
+ * Copyright (C) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Microbenchmarks of the protocol primitives on the io path.
+// make -f Makefile.simple benchmark && build/hdc_benchmark [--benchmark_filter=regex]
+#include <benchmark/benchmark.h>
+#include <lz4.h>
+
+#include "common.h"
+#include "circle_buffer.h"
+#include "crc32c.h"
+#include "header.h"
+#include "serial_struct.h"
+
+using namespace Hdc;
+
+namespace {
+constexpr uint8_t PAYLOAD_VCODE = 0x09;  // HdcSessionBase::payloadProtectStaticVcode
+constexpr uint32_t SMALL_PACKET_SIZE = 64;
+
+// file content like data, half text half random bytes, so lz4 has something to do but not everything
+vector<uint8_t> MakeData(size_t size)
+{
+    vector<uint8_t> data(size);
+    const string text = "OpenHarmony device connector, file transfer payload. ";
+    uint32_t seed = 0x12345678;
+    for (size_t i = 0; i < size; ++i) {
+        if ((i / text.size()) % 2 == 0) {  // 2: every other sentence
+            data[i] = static_cast<uint8_t>(text[i % text.size()]);
+        } else {
+            seed = seed * 1103515245 + 12345;  // 1103515245 12345: LCG of ANSI C
+            data[i] = static_cast<uint8_t>(seed >> 24);  // 24: high byte
+        }
+    }
+    return data;
+}
+
+HdcTransferBase::TransferConfig MakeTransferConfig()
+{
+    HdcTransferBase::TransferConfig config = {};
+    config.fileSize = 123456789;  // 123456789: any size
+    config.atime = 1700000000000000000;  // 1700000000000000000: ns
+    config.mtime = 1700000000000000000;  // 1700000000000000000: ns
+    config.options = "-a -z";
+    config.path = "/data/local/tmp/benchmark/some_directory/file_name.bin";
+    config.optionalName = "file_name.bin";
+    config.updateIfNew = true;
+    config.compressType = HdcTransferBase::COMPRESS_LZ4;
+    config.holdTimestamp = true;
+    config.functionName = "send";
+    config.clientCwd = "/home/user/workspace/project";
+    return config;
+}
+
+// OnRead is the packet parser of a session, FetchCommand just takes the packet
+class BenchmarkSession : public HdcSessionBase {
+public:
+    BenchmarkSession() : HdcSessionBase(true)
+    {
+    }
+    bool FetchCommand(HSession hSession, const uint32_t channelId, const uint16_t command, uint8_t *payload,
+                      int payloadSize) override
+    {
+        benchmark::DoNotOptimize(payload);
+        return true;
+    }
+    // fixedHead: PayloadProtect in the FEATURE_FIXED_HEAD layout
+    vector<uint8_t> BuildPacket(const uint16_t command, int dataSize, bool fixedHead = false)
+    {
+        PayloadProtect protectBuf = {};
+        protectBuf.channelId = 1;
+        protectBuf.commandFlag = command;
+        protectBuf.vCode = PAYLOAD_VCODE;
+        string s;
+        if (fixedHead) {
+            s.resize(FIXED_PROTECT_SIZE);
+            uint8_t *fixed = reinterpret_cast<uint8_t *>(s.data());
+            Base::StoreLe32(fixed, protectBuf.channelId);
+            Base::StoreLe32(fixed + sizeof(uint32_t), protectBuf.commandFlag);
+            fixed[sizeof(uint32_t) * 2 + 1] = protectBuf.vCode;  // 2: after channelId and commandFlag
+        } else {
+            s = SerialStruct::SerializeToString(protectBuf);
+        }
+        vector<uint8_t> packet(sizeof(PayloadHead) + s.size() + dataSize);
+        PayloadHead *head = reinterpret_cast<PayloadHead *>(packet.data());
+        head->flag[0] = PACKET_FLAG[0];
+        head->flag[1] = PACKET_FLAG[1];
+        head->reserve[0] = fixedHead ? PAYLOAD_OPTION_FIXED_PROTECT : 0;
+        head->protocolVer = VER_PROTOCOL;
+        head->headSize = htons(s.size());
+        head->dataSize = htonl(dataSize);
+        (void)memcpy_s(packet.data() + sizeof(PayloadHead), s.size(), s.data(), s.size());
+        return packet;
+    }
+};
+}  // namespace
+
+static void BM_SerializePayloadProtect(benchmark::State &state)
+{
+    HdcSessionBase::PayloadProtect protectBuf = { 1, CMD_FILE_DATA, 0, PAYLOAD_VCODE };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SerialStruct::SerializeToString(protectBuf));
+    }
+}
+BENCHMARK(BM_SerializePayloadProtect);
+
+static void BM_ParsePayloadProtect(benchmark::State &state)
+{
+    HdcSessionBase::PayloadProtect protectBuf = { 1, CMD_FILE_DATA, 0, PAYLOAD_VCODE };
+    string s = SerialStruct::SerializeToString(protectBuf);
+    for (auto _ : state) {
+        HdcSessionBase::PayloadProtect out = {};
+        benchmark::DoNotOptimize(SerialStruct::ParseFromString(out, s));
+    }
+}
+BENCHMARK(BM_ParsePayloadProtect);
+
+static void BM_SerializeTransferPayload(benchmark::State &state)
+{
+    HdcTransferBase::TransferPayload payload = { 1000, HdcTransferBase::COMPRESS_LZ4, 40000, MAX_USBFFS_BULK_STABLE };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SerialStruct::SerializeToString(payload));
+    }
+}
+BENCHMARK(BM_SerializeTransferPayload);
+
+static void BM_ParseTransferPayload(benchmark::State &state)
+{
+    HdcTransferBase::TransferPayload payload = { 1000, HdcTransferBase::COMPRESS_LZ4, 40000, MAX_USBFFS_BULK_STABLE };
+    string s = SerialStruct::SerializeToString(payload);
+    for (auto _ : state) {
+        HdcTransferBase::TransferPayload out = {};
+        benchmark::DoNotOptimize(SerialStruct::ParseFromString(out, s));
+    }
+}
+BENCHMARK(BM_ParseTransferPayload);
+
+static void BM_SerializePayloadProtectToBuffer(benchmark::State &state)
+{
+    HdcSessionBase::PayloadProtect protectBuf = { 1, CMD_FILE_DATA, 0, PAYLOAD_VCODE };
+    uint8_t buf[SerialStruct::MaxSerializedSize<HdcSessionBase::PayloadProtect>()];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SerialStruct::SerializeToBuffer(protectBuf, buf, sizeof(buf)));
+    }
+}
+BENCHMARK(BM_SerializePayloadProtectToBuffer);
+
+static void BM_ParsePayloadProtectFromView(benchmark::State &state)
+{
+    HdcSessionBase::PayloadProtect protectBuf = { 1, CMD_FILE_DATA, 0, PAYLOAD_VCODE };
+    string s = SerialStruct::SerializeToString(protectBuf);
+    for (auto _ : state) {
+        HdcSessionBase::PayloadProtect out = {};
+        benchmark::DoNotOptimize(SerialStruct::ParseFromStringView(out, std::string_view(s)));
+    }
+}
+BENCHMARK(BM_ParsePayloadProtectFromView);
+
+static void BM_SerializeTransferPayloadToBuffer(benchmark::State &state)
+{
+    HdcTransferBase::TransferPayload payload = { 1000, HdcTransferBase::COMPRESS_LZ4, 40000, MAX_USBFFS_BULK_STABLE };
+    uint8_t buf[SerialStruct::MaxSerializedSize<HdcTransferBase::TransferPayload>()];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SerialStruct::SerializeToBuffer(payload, buf, sizeof(buf)));
+    }
+}
+BENCHMARK(BM_SerializeTransferPayloadToBuffer);
+
+static void BM_ParseTransferPayloadFromView(benchmark::State &state)
+{
+    HdcTransferBase::TransferPayload payload = { 1000, HdcTransferBase::COMPRESS_LZ4, 40000, MAX_USBFFS_BULK_STABLE };
+    string s = SerialStruct::SerializeToString(payload);
+    for (auto _ : state) {
+        HdcTransferBase::TransferPayload out = {};
+        benchmark::DoNotOptimize(SerialStruct::ParseFromStringView(out, std::string_view(s)));
+    }
+}
+BENCHMARK(BM_ParseTransferPayloadFromView);
+
+static void BM_SerializeTransferConfig(benchmark::State &state)
+{
+    HdcTransferBase::TransferConfig config = MakeTransferConfig();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SerialStruct::SerializeToString(config));
+    }
+}
+BENCHMARK(BM_SerializeTransferConfig);
+
+static void BM_ParseTransferConfig(benchmark::State &state)
+{
+    string s = SerialStruct::SerializeToString(MakeTransferConfig());
+    for (auto _ : state) {
+        HdcTransferBase::TransferConfig out = {};
+        benchmark::DoNotOptimize(SerialStruct::ParseFromString(out, s));
+    }
+}
+BENCHMARK(BM_ParseTransferConfig);
+
+static void BM_SessionOnRead(benchmark::State &state)
+{
+    BenchmarkSession session;
+    HdcSession hSession;
+    vector<uint8_t> packet = session.BuildPacket(CMD_FILE_DATA, state.range(0), state.range(1));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(session.OnRead(&hSession, packet.data(), packet.size()));
+    }
+    // the payload is passed by pointer, so count packets not bytes
+    state.SetItemsProcessed(state.iterations());
+}
+// second arg: FEATURE_FIXED_HEAD
+BENCHMARK(BM_SessionOnRead)->ArgsProduct({ { SMALL_PACKET_SIZE, MAX_USBFFS_BULK_STABLE, MAX_SIZE_IOBUF }, { 0, 1 } });
+
+static void BM_Base64Encode(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Base::Base64Encode(data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Base64Encode)->Arg(SMALL_PACKET_SIZE)->Arg(BUF_SIZE_DEFAULT)->Arg(MAX_USBFFS_BULK_STABLE);
+
+static void BM_Base64DecodeBuf(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    vector<uint8_t> encoded = Base::Base64Encode(data.data(), data.size());
+    vector<uint8_t> out(data.size() + 3);  // 3: padding of base64
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Base::Base64DecodeBuf(encoded.data(), encoded.size(), out.data()));
+    }
+    state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_Base64DecodeBuf)->Arg(SMALL_PACKET_SIZE)->Arg(BUF_SIZE_DEFAULT)->Arg(MAX_USBFFS_BULK_STABLE);
+
+static void BM_CalcCheckSum(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Base::CalcCheckSum(data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_CalcCheckSum)->Arg(MAX_USBFFS_BULK_STABLE)->Arg(MAX_SIZE_IOBUF);
+
+static void BM_Crc32c(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Crc32c::Extend(0, data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+    state.SetLabel(Crc32c::Implementation());
+}
+BENCHMARK(BM_Crc32c)->Arg(MAX_USBFFS_BULK_STABLE)->Arg(MAX_SIZE_IOBUF);
+
+static void BM_Crc32cPortable(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Crc32c::ExtendPortable(0, data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc32cPortable)->Arg(MAX_USBFFS_BULK_STABLE)->Arg(MAX_SIZE_IOBUF);
+
+// the copy of the data into the packet in HdcSessionBase::Send, without and with FEATURE_CRC32C
+static void BM_FramingCopy(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    vector<uint8_t> packet(data.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(memcpy_s(packet.data(), packet.size(), data.data(), data.size()));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_FramingCopy)->Arg(MAX_USBFFS_BULK_STABLE)->Arg(MAX_SIZE_IOBUF);
+
+static void BM_FramingCopyCrc32c(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    vector<uint8_t> packet(data.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Crc32c::CopyAndExtend(0, packet.data(), data.data(), data.size()));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_FramingCopyCrc32c)->Arg(MAX_USBFFS_BULK_STABLE)->Arg(MAX_SIZE_IOBUF);
+
+static void BM_CircleBufferMallocFree(benchmark::State &state)
+{
+    CircleBuffer circleBuffer;
+    for (auto _ : state) {
+        uint8_t *buf = circleBuffer.Malloc();
+        benchmark::DoNotOptimize(buf);
+        circleBuffer.Free(buf);
+    }
+}
+BENCHMARK(BM_CircleBufferMallocFree);
+
+// the chunk sizes of file transfer: stable 61KB and huge buffer 512KB
+static void BM_Lz4Compress(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    vector<char> out(LZ4_compressBound(data.size()));
+    int compressSize = 0;
+    for (auto _ : state) {
+        compressSize = LZ4_compress_default(reinterpret_cast<const char *>(data.data()), out.data(), data.size(),
+                                            out.size());
+        benchmark::DoNotOptimize(compressSize);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+    state.counters["ratio"] = compressSize > 0 ? static_cast<double>(data.size()) / compressSize : 0;
+}
+BENCHMARK(BM_Lz4Compress)->Arg(MAX_USBFFS_BULK_STABLE)->Arg(MAX_USBFFS_BULK);
+
+static void BM_Lz4Decompress(benchmark::State &state)
+{
+    vector<uint8_t> data = MakeData(state.range(0));
+    vector<char> compressed(LZ4_compressBound(data.size()));
+    int compressSize = LZ4_compress_default(reinterpret_cast<const char *>(data.data()), compressed.data(),
+                                            data.size(), compressed.size());
+    vector<char> out(data.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(LZ4_decompress_safe(compressed.data(), out.data(), compressSize, out.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Lz4Decompress)->Arg(MAX_USBFFS_BULK_STABLE)->Arg(MAX_USBFFS_BULK);
+
+// FEATURE_LZ4 of a session, the packets of one command one after another in the stream, as Send does it. Every packet
+// is the next part of a stream far over the 64KB dictionary, a packet sent again would compress to nothing. A packet
+// of the half random data which does not compress enough turns the command off for a while, rawPackets tells how many
+// went raw
+static void BM_SessionCompress(benchmark::State &state)
+{
+    constexpr size_t streamSize = 4 * 1024 * 1024;
+    vector<uint8_t> stream = MakeData(streamSize);
+    size_t size = state.range(0);
+    size_t offset = 0;
+    SessionCompress compress;
+    compress.Initial();
+    uint64_t sendBytes = 0;
+    uint64_t rawPackets = 0;
+    for (auto _ : state) {
+        int ret = compress.Compress(CMD_KERNEL_ECHO_RAW, stream.data() + offset, size);
+        sendBytes += ret > 0 ? ret : size;
+        rawPackets += ret == 0 ? 1 : 0;
+        benchmark::DoNotOptimize(ret);
+        offset = offset + size * 2 > streamSize ? 0 : offset + size;  // 2: this one and the next
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    state.counters["ratio"] = static_cast<double>(sendBytes) / (state.iterations() * size);
+    state.counters["rawPackets"] = static_cast<double>(rawPackets) / state.iterations();
+}
+BENCHMARK(BM_SessionCompress)->Arg(SMALL_PACKET_SIZE)->Arg(BUF_SIZE_DEFAULT)->Arg(MAX_USBFFS_BULK_STABLE);
+
+// the same stream with every packet compressed, which Send never does: each packet has a command not skipped yet, and
+// the session compress starts over when the commands are used up
+static void BM_SessionCompressForced(benchmark::State &state)
+{
+    constexpr size_t streamSize = 4 * 1024 * 1024;
+    vector<uint8_t> stream = MakeData(streamSize);
+    size_t size = state.range(0);
+    size_t offset = 0;
+    auto compress = std::make_unique<SessionCompress>();
+    compress->Initial();
+    uint32_t command = 0;
+    uint64_t sendBytes = 0;
+    for (auto _ : state) {
+        if (command > UINT16_MAX) {
+            state.PauseTiming();
+            compress = std::make_unique<SessionCompress>();
+            compress->Initial();
+            command = 0;
+            state.ResumeTiming();
+        }
+        int ret = compress->Compress(static_cast<uint16_t>(command++), stream.data() + offset, size);
+        sendBytes += ret > 0 ? ret : size;
+        benchmark::DoNotOptimize(ret);
+        offset = offset + size * 2 > streamSize ? 0 : offset + size;  // 2: this one and the next
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    state.counters["ratio"] = static_cast<double>(sendBytes) / (state.iterations() * size);
+}
+BENCHMARK(BM_SessionCompressForced)->Arg(SMALL_PACKET_SIZE)->Arg(BUF_SIZE_DEFAULT)->Arg(MAX_USBFFS_BULK_STABLE);
+
+static void BM_HeaderEncode(benchmark::State &state)
+{
+    uint8_t data[HEADER_LEN];
+    for (auto _ : state) {
+        Header header;
+        header.UpdataName("benchmark/some_directory/sub_directory/file_name.bin");
+        header.UpdataSize(123456789);  // 123456789: any size
+        header.UpdataFileType(TypeFlage::ORDINARYFILE);
+        header.UpdataCheckSum();
+        header.GetBytes(data, HEADER_LEN);
+        benchmark::DoNotOptimize(data);
+    }
+}
+BENCHMARK(BM_HeaderEncode);
+
+static void BM_HeaderDecode(benchmark::State &state)
+{
+    uint8_t data[HEADER_LEN];
+    Header header;
+    header.UpdataName("benchmark/some_directory/sub_directory/file_name.bin");
+    header.UpdataSize(123456789);  // 123456789: any size
+    header.UpdataFileType(TypeFlage::ORDINARYFILE);
+    header.UpdataCheckSum();
+    header.GetBytes(data, HEADER_LEN);
+    for (auto _ : state) {
+        Header in(data, HEADER_LEN);
+        benchmark::DoNotOptimize(in.Name());
+        benchmark::DoNotOptimize(in.Size());
+        benchmark::DoNotOptimize(in.FileType());
+    }
+}
+BENCHMARK(BM_HeaderDecode);
+
+// host side of a session auth, what HdcServer::HandServerAuth does for AUTH_PUBLICKEY and AUTH_SIGNATURE, with the
+// user key of ~/.harmony like the server. Threads are sessions authenticating at the same time.
+static void BM_HandshakeAuth(benchmark::State &state)
+{
+    const string token(HdcAuth::RSA_TOKEN_SIZE, 't');
+    for (auto _ : state) {
+        string pubkeyInfo;
+        string buf = token;
+        if (!HdcAuth::GetPublicKeyinfo(pubkeyInfo) || !HdcAuth::RsaSignAndBase64(buf, RSA_3072_SHA512)) {
+            state.SkipWithError("host key failed");
+            break;
+        }
+        benchmark::DoNotOptimize(buf);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HandshakeAuth)->ThreadRange(1, 8)->UseRealTime();  // 8: a farm reconnecting
+
+int main(int argc, char **argv)
+{
+    Base::SetLogLevel(LOG_OFF);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}